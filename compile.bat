@@ -1,4 +1,12 @@
-C:\GFX\Vulkan\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
-C:\GFX\Vulkan\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
-C:\GFX\Vulkan\Bin\glslc.exe point_light.vert -o point_light.vert.spv
-C:\GFX\Vulkan\Bin\glslc.exe point_light.frag -o point_light.frag.spv
\ No newline at end of file
+@echo off
+rem glslc is taken from %GLSLC%, then %VULKAN_SDK%\Bin, then PATH
+if not defined GLSLC (
+    if defined VULKAN_SDK if exist "%VULKAN_SDK%\Bin\glslc.exe" set "GLSLC=%VULKAN_SDK%\Bin\glslc.exe"
+)
+if not defined GLSLC set "GLSLC=glslc"
+
+"%GLSLC%" simple_shader.vert -o simple_shader.vert.spv || exit /b 1
+"%GLSLC%" simple_shader.frag -o simple_shader.frag.spv || exit /b 1
+"%GLSLC%" point_light.vert -o point_light.vert.spv || exit /b 1
+"%GLSLC%" point_light.frag -o point_light.frag.spv || exit /b 1
+"%GLSLC%" hiz_downsample.comp -o hiz_downsample.comp.spv || exit /b 1
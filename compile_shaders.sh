@@ -0,0 +1,107 @@
+#!/usr/bin/env bash
+# Compiles the shaders to SPIR-V and embeds them in lve_embedded_shaders.hpp.
+# glslc is taken from $GLSLC, then $VULKAN_SDK/bin, then PATH.
+set -euo pipefail
+
+cd "$(dirname "$0")"
+
+GLSLC="${GLSLC:-}"
+if [ -z "$GLSLC" ]; then
+    if [ -n "${VULKAN_SDK:-}" ] && [ -x "$VULKAN_SDK/bin/glslc" ]; then
+        GLSLC="$VULKAN_SDK/bin/glslc"
+    else
+        GLSLC="glslc"
+    fi
+fi
+
+SHADERS=(
+    simple_shader.vert
+    simple_shader.frag
+    point_light.vert
+    point_light.frag
+    hiz_downsample.comp
+)
+
+# Precompiled #define permutations for builds without shaderc, written as
+# <shader>:<NAME>[=<VALUE>],... and named like LveShaderModuleCache::permutationName,
+# e.g. simple_shader.frag:UNLIT becomes simple_shader.frag.UNLIT.spv
+PERMUTATIONS=(
+)
+
+OUT=lve_embedded_shaders.hpp
+TMP="$(mktemp)"
+trap 'rm -f "$TMP"' EXIT
+
+NAMES=()
+SYMBOLS=()
+
+# embed <shader> <spv name> [glslc args...]
+embed() {
+    local shader="$1" name="$2"
+    shift 2
+
+    # Loose .spv files are still written for LVE_SHADER_DIR overrides
+    "$GLSLC" "$@" "$shader" -o "$name"
+
+    local symbol="${name%.spv}"
+    symbol="${symbol//[.=]/_}"
+    NAMES+=("$name")
+    SYMBOLS+=("$symbol")
+    {
+        echo "        constexpr uint32_t $symbol[] = {"
+        "$GLSLC" "$@" "$shader" -mfmt=num -o - \
+            | tr -d ' \r\n' | tr ',' '\n' | sed '/^$/d' \
+            | xargs -n 8 | sed 's/ /, /g; s/^/            /; s/$/,/'
+        echo "        };"
+        echo ""
+    } >> "$TMP"
+}
+
+{
+    echo "#pragma once"
+    echo ""
+    echo "// Generated by compile_shaders.sh, do not edit"
+    echo ""
+    echo "// std"
+    echo "#include <cstddef>"
+    echo "#include <cstdint>"
+    echo ""
+    echo "namespace lve {"
+    echo "    namespace embedded_shaders {"
+} > "$TMP"
+
+for shader in "${SHADERS[@]}"; do
+    embed "$shader" "$shader.spv"
+done
+
+for permutation in ${PERMUTATIONS[@]+"${PERMUTATIONS[@]}"}; do
+    shader="${permutation%%:*}"
+    suffix=""
+    args=()
+    IFS=',' read -ra defines <<< "${permutation#*:}"
+    for define in "${defines[@]}"; do
+        args+=("-D$define")
+        suffix+=".${define/=/_}"
+    done
+    embed "$shader" "$shader$suffix.spv" "${args[@]}"
+done
+
+{
+    echo "        struct EmbeddedShader {"
+    echo "            const char* name;"
+    echo "            const uint32_t* code;"
+    echo "            size_t codeSize;"
+    echo "        };"
+    echo ""
+    echo "        constexpr EmbeddedShader shaders[] = {"
+    for i in "${!NAMES[@]}"; do
+        echo "            { \"${NAMES[$i]}\", ${SYMBOLS[$i]}, sizeof(${SYMBOLS[$i]}) },"
+    done
+    echo "        };"
+    echo "    }"
+    echo "}"
+} >> "$TMP"
+
+mv "$TMP" "$OUT"
+trap - EXIT
+echo "Wrote $OUT"
@@ -2,11 +2,19 @@
 
 #include "first_app.hpp"
 
+#include "lve_archive.hpp"
+#include "lve_gltf_scene.hpp"
 #include "lve_keyboard.hpp"
 #include "lve_camera.hpp"
 #include "simple_render_system.hpp"
 #include "point_light_system.hpp"
 #include "lve_buffer.hpp"
+#include "lve_light_clusters.hpp"
+#include "lve_hiz_culler.hpp"
+#include "lve_masked_occlusion_culler.hpp"
+#include "lve_layout_cache.hpp"
+#include "lve_picker.hpp"
+#include "lve_profiler.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -18,27 +26,64 @@
 #include <array>
 #include <chrono>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
 #include <stdexcept>
+#include <unordered_set>
 #include <math.h>
 
 
 namespace lve {
 
-    struct GlobalUbo {
-        glm::mat4 projection{ 10.f };
-        glm::mat4 view{ 10.f };
-        glm::vec4 ambientLightColor{ 1.f,1.f,1.f, 0.01f };
-        glm::vec3 lightPosition{ -20.f, -15.f, 50.f };
-        alignas(16) glm::vec4 lightColor{ 20.f };
-};
+    enum class OcclusionMode { HiZ, Masked, Off };
 
     FirstApp::FirstApp() {
+        // Written by pack_assets.sh; without it assets are loose files
+        if (std::ifstream{ ASSET_ARCHIVE }.good()) {
+            LveArchive::mount(ASSET_ARCHIVE);
+        }
+
         globalPool = LveDescriptorPool::Builder(lveDevice)
             .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
             .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+        frameDescriptorAllocator = LveDescriptorAllocator::Builder(lveDevice)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0.5f)
             .build();
 
         loadGameObjects();
+        for (auto& kv : gameObjects) {
+            sceneBvh.insert(kv.second);
+        }
+        if (worldStreamer) {
+            worldStreamer->setSpatialIndex(&sceneBvh);
+        }
+
+        // LVE_PROFILE_INTERVAL=seconds prints the profiler report periodically
+        if (const char* interval = std::getenv("LVE_PROFILE_INTERVAL")) {
+            LveProfiler::setReportInterval(std::strtof(interval, nullptr));
+        }
+        // Swap chain recreation benchmark: LVE_RECREATE_EVERY=n recreates it
+        // every n frames, LVE_RECREATE_WAIT_IDLE=1 waits for the device first
+        // as it used to. The profiler report, with LVE_PROFILE_INTERVAL set,
+        // compares the frame times.
+        if (const char* every = std::getenv("LVE_RECREATE_EVERY")) {
+            recreateEvery = static_cast<uint32_t>(std::strtoul(every, nullptr, 10));
+        }
+        if (const char* waitIdle = std::getenv("LVE_RECREATE_WAIT_IDLE")) {
+            lveRenderer.setWaitIdleOnRecreate(std::strcmp(waitIdle, "1") == 0);
+        }
+
+#ifndef NDEBUG
+        const char* shaderDir = std::getenv("LVE_SHADER_DIR");
+        shaderHotReloader = std::make_unique<LveShaderHotReloader>(
+            pipelineManager, threadPool, shaderDir != nullptr ? shaderDir : ".");
+#endif
     }
 
     FirstApp::~FirstApp() {}
@@ -56,24 +101,66 @@ namespace lve {
             uboBuffers[i]->map();
         }
 
+        LveLightClusters lightClusters{ lveDevice };
+
         auto globalSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
             .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
 
         std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
         for (int i = 0; i < globalDescriptorSets.size(); i++) {
             auto bufferInfo = uboBuffers[i]->descriptorInfo();
+            auto lightInfo = lightClusters.lightBufferInfo(i);
+            auto clusterInfo = lightClusters.clusterBufferInfo(i);
+            auto lightIndexInfo = lightClusters.lightIndexBufferInfo(i);
             LveDescriptorWriter(*globalSetLayout, *globalPool)
                 .writeBuffer(0, &bufferInfo)
+                .writeBuffer(1, &lightInfo)
+                .writeBuffer(2, &clusterInfo)
+                .writeBuffer(3, &lightIndexInfo)
                 .build(globalDescriptorSets[i]);
         }
 
+        // Render systems derive their layouts from their shaders with the global
+        // set as set 0 and the material set as set 1, which makes them
+        // compatible with this one for the sets they use
+        VkPipelineLayout globalPipelineLayout = lveDevice.layoutCache().getPipelineLayout(
+            { globalSetLayout->getDescriptorSetLayout(), materialSystem.getSetLayout() },
+            { LveLayoutCache::pushConstantRange(
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0) });
+
         SimpleRenderSystem simpleRenderSystem{ lveDevice,
-            lveRenderer.getSwapChainRenderPass(),
-            globalSetLayout->getDescriptorSetLayout() };
+            pipelineManager,
+            lveRenderer.getSwapChainRenderTarget(),
+            globalSetLayout->getDescriptorSetLayout(),
+            materialSystem.getSetLayout() };
         PointLightSystem pointLightSystem{
-            lveDevice, lveRenderer.getSwapChainRenderPass(),
+            lveDevice, pipelineManager, lveRenderer.getSwapChainRenderTarget(),
             globalSetLayout->getDescriptorSetLayout() };
+        // Both systems queued their pipelines, let them build in parallel
+        pipelineManager.waitIdle();
+
+        // Models and shaders have all been read by now
+        LveArchive::IoStats ioStats = LveArchive::getIoStats();
+        std::cout << "Startup asset I/O: " << ioStats.archiveReads << " archive and "
+            << ioStats.looseReads << " loose reads, " << ioStats.bytes / 1024 << " KB in "
+            << ioStats.milliseconds << " ms" << std::endl;
+        LveHiZCuller hizCuller{ lveDevice };
+        LveMaskedOcclusionCuller maskedCuller{ threadPool };
+        maskedCuller.setEnabled(false);
+        OcclusionMode occlusionMode = OcclusionMode::HiZ;
+        std::unordered_set<LveGameObject::id_t> occludedObjects;
+        std::vector<LveGameObject::id_t> visibleObjects;
+        bool cullToggleWasDown = false;
+        bool statsKeyWasDown = false;
+        LvePicker picker{ sceneBvh, gameObjects };
+        LveGameObject::id_t selectedObject = LvePicker::NO_OBJECT;
+        bool pickButtonWasDown = false;
+        bool dropKeyWasDown = false;
+        uint32_t framesSinceRecreate = 0;
         LveCamera camera{};
 
         auto viewerObject = LveGameObject::createGameObject();
@@ -88,37 +175,170 @@ namespace lve {
                 std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
 
+            // O cycles between Hi-Z, CPU masked and no occlusion culling
+            bool cullToggleDown = glfwGetKey(lveWindow.getGLFWwindow(), GLFW_KEY_O) == GLFW_PRESS;
+            if (cullToggleDown && !cullToggleWasDown) {
+                switch (occlusionMode) {
+                case OcclusionMode::HiZ: occlusionMode = OcclusionMode::Masked; break;
+                case OcclusionMode::Masked: occlusionMode = OcclusionMode::Off; break;
+                case OcclusionMode::Off: occlusionMode = OcclusionMode::HiZ; break;
+                }
+                hizCuller.setEnabled(occlusionMode == OcclusionMode::HiZ);
+                maskedCuller.setEnabled(occlusionMode == OcclusionMode::Masked);
+                // Only Hi-Z reads the depth buffer back, otherwise it can stay transient
+                lveRenderer.setDepthSampled(occlusionMode == OcclusionMode::HiZ);
+                std::cout << "Occlusion culling: "
+                    << (hizCuller.isEnabled() ? "Hi-Z" : maskedCuller.isEnabled() ? "CPU masked" : "off")
+                    << std::endl;
+            }
+            cullToggleWasDown = cullToggleDown;
+
+            // T prints texture and world residency, the spatial index and I/O throughput
+            bool statsKeyDown = glfwGetKey(lveWindow.getGLFWwindow(), GLFW_KEY_T) == GLFW_PRESS;
+            if (statsKeyDown && !statsKeyWasDown) {
+                textureStreamer.printStats(std::cout);
+                if (worldStreamer) {
+                    worldStreamer->printStats(std::cout);
+                }
+                sceneBvh.printStats(std::cout);
+                asyncIo.printStats(std::cout);
+            }
+            statsKeyWasDown = statsKeyDown;
+
             cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerObject);
             camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
             float aspect = lveRenderer.getAspectRatio();
             camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 1000.f);
 
+            // Left click selects the object under the cursor, G drops it onto
+            // whatever is below it
+            bool pickButtonDown =
+                glfwGetMouseButton(lveWindow.getGLFWwindow(), GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            if (pickButtonDown && !pickButtonWasDown) {
+                double cursorX = 0.0;
+                double cursorY = 0.0;
+                int windowWidth = 0;
+                int windowHeight = 0;
+                glfwGetCursorPos(lveWindow.getGLFWwindow(), &cursorX, &cursorY);
+                glfwGetWindowSize(lveWindow.getGLFWwindow(), &windowWidth, &windowHeight);
+
+                auto pickStart = std::chrono::high_resolution_clock::now();
+                LvePicker::Hit hit{};
+                bool picked = picker.pick(
+                    camera,
+                    { static_cast<float>(cursorX), static_cast<float>(cursorY) },
+                    { static_cast<float>(windowWidth), static_cast<float>(windowHeight) },
+                    hit);
+                float pickMicroseconds = std::chrono::duration<float, std::micro>(
+                    std::chrono::high_resolution_clock::now() - pickStart).count();
+                selectedObject = picked ? hit.id : LvePicker::NO_OBJECT;
+                if (picked) {
+                    std::cout << "Picked object " << hit.id;
+                    if (hit.triangle != LvePicker::NO_TRIANGLE) {
+                        std::cout << ", triangle " << hit.triangle;
+                    }
+                    std::cout << " at " << hit.distance << " in " << pickMicroseconds << " us" << std::endl;
+                } else {
+                    std::cout << "Nothing picked in " << pickMicroseconds << " us" << std::endl;
+                }
+            }
+            pickButtonWasDown = pickButtonDown;
+
+            bool dropKeyDown = glfwGetKey(lveWindow.getGLFWwindow(), GLFW_KEY_G) == GLFW_PRESS;
+            if (dropKeyDown && !dropKeyWasDown && selectedObject != LvePicker::NO_OBJECT &&
+                !picker.dropToGround(selectedObject)) {
+                std::cout << "Nothing below object " << selectedObject << std::endl;
+            }
+            dropKeyWasDown = dropKeyDown;
+
+            if (shaderHotReloader) {
+                shaderHotReloader->update();
+            }
+
+            if (recreateEvery > 0 && ++framesSinceRecreate >= recreateEvery) {
+                lveRenderer.requestSwapChainRecreation();
+                framesSinceRecreate = 0;
+            }
+
             if (auto commandBuffer = lveRenderer.beginFrame()) {
+                // Frame boundary: rebuilt pipelines are swapped in before recording
+                pipelineManager.applyReloads();
+
                 int frameIndex = lveRenderer.getFrameIndex();
+                frameDescriptorAllocator->beginFrame(frameIndex);
                 FrameInfo frameInfo{
                     frameIndex,
                     frameTime,
                     commandBuffer,
                     camera, 
                     globalDescriptorSets[frameIndex],
-                    gameObjects
+                    gameObjects,
+                    &occludedObjects,
+                    frameDescriptorAllocator.get(),
+                    &visibleObjects
                 };
 
+                // stream level cells: objects are added and removed before
+                // anything this frame looks at the map
+                if (worldStreamer) {
+                    worldStreamer->update(viewerObject.transform.translation, gameObjects);
+                }
+
+                // cull: the frustum through the spatial index, then occlusion
+                // for what is left
+                sceneBvh.commit();
+                visibleObjects.clear();
+                sceneBvh.queryFrustum(
+                    LveBvh::Frustum::fromViewProjection(camera.getProjection() * camera.getView()),
+                    visibleObjects);
+                occludedObjects.clear();
+                hizCuller.cullObjects(frameInfo, occludedObjects);
+                maskedCuller.cullObjects(frameInfo, occludedObjects);
+
+                // stream textures: finished reads queue their decode jobs, and
+                // finished uploads are swapped in before this frame's texture
+                // table is published
+                asyncIo.poll();
+                uploadQueue.poll();
+                textureStreamer.update(frameInfo, lveRenderer.getSwapChainExtent());
+                uploadQueue.flush();
+                materialSystem.beginFrame(frameIndex);
+
                 // update
                 GlobalUbo ubo{};
                 ubo.projection = camera.getProjection();
                 ubo.view = camera.getView();
+                lightClusters.update(frameInfo, lveRenderer.getSwapChainExtent(), ubo);
                 uboBuffers[frameIndex]->writeToBuffer(&ubo);
                 uboBuffers[frameIndex]->flush();
 
                 // render
                 lveRenderer.beginSwapChainRenderPass(commandBuffer);
+                std::array<VkDescriptorSet, 2> sharedSets{
+                    frameInfo.globalDescriptionSet, materialSystem.getDescriptorSet() };
+                uint32_t textureTableOffset = materialSystem.getDynamicOffset(frameIndex);
+                vkCmdBindDescriptorSets(
+                    commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    globalPipelineLayout,
+                    0,
+                    static_cast<uint32_t>(sharedSets.size()),
+                    sharedSets.data(),
+                    1,
+                    &textureTableOffset);
                 simpleRenderSystem.renderGameObjects(frameInfo);
                 pointLightSystem.render(frameInfo);
                 lveRenderer.endSwapChainRenderPass(commandBuffer);
+                hizCuller.buildPyramid(
+                    frameInfo,
+                    lveRenderer.getCurrentDepthImage(),
+                    lveRenderer.getCurrentDepthImageView(),
+                    lveRenderer.getSwapChainDepthFormat(),
+                    lveRenderer.getSwapChainExtent());
                 lveRenderer.endFrame();
             }
+            LveProfiler::endFrame(frameTime);
         }
         vkDeviceWaitIdle(lveDevice.device());
     }
@@ -126,7 +346,22 @@ namespace lve {
     // temporary helper function, creates a 1x1x1 cube centered at offset
 
     void FirstApp::loadGameObjects() {
-        std::shared_ptr<LveModel> lveModel = LveModel::createModelFromFile(lveDevice, "koenig.obj");
+        // A saved level replaces the built in car and lights, and is streamed
+        // in around the camera. The floor below is always added, its
+        // material isn't part of the scene format.
+        if (std::ifstream{ LEVEL_FILE }.good()) {
+            worldStreamer = std::make_unique<LveWorldStreamer>(
+                lveDevice, uploadQueue, threadPool, LEVEL_FILE, LveWorldStreamer::Settings{});
+            std::cout << "Streaming " << LEVEL_FILE << ": " << worldStreamer->getStats().cells << " cells"
+                << std::endl;
+            loadFloor();
+            return;
+        }
+
+        LveModel::Builder carBuilder{};
+        carBuilder.loadModel("koenig.obj");
+        std::shared_ptr<LveModel> lveModel = std::make_shared<LveModel>(lveDevice, carBuilder);
+        auto carOccluder = LveMaskedOcclusionCuller::createOccluder(carBuilder);
         
         const int numCubes = 1;
         float scale = 1;
@@ -136,6 +371,7 @@ namespace lve {
 
             auto car = LveGameObject::createGameObject();
             car.model = lveModel;
+            car.occluder = carOccluder;
             car.transform.translation = { 0, 10, 50 };
             car.transform.scale = { scale, scale, scale };
             car.transform.rotation = { 0, M_PI, M_PI};
@@ -144,13 +380,67 @@ namespace lve {
             gameObjects.emplace(car.getId(),  std::move(car));
         }
 
-        lveModel = LveModel::createModelFromFile(lveDevice, "quad.obj");
+        // Optional glTF content, placed and oriented like the car
+        if (std::ifstream{ GLTF_SCENE }.good()) {
+            TransformComponent placement{};
+            placement.translation = { 0, 10, 50 };
+            placement.rotation = { 0, M_PI, M_PI };
+            for (auto& gameObject : LveGltfScene::load(lveDevice, materialSystem, GLTF_SCENE, placement.mat4())) {
+                gameObjects.emplace(gameObject.getId(), std::move(gameObject));
+            }
+        }
+
+        loadFloor();
+
+        auto keyLight = LveGameObject::makePointLight(20.f);
+        keyLight.transform.translation = { -20.f, -15.f, 50.f };
+        gameObjects.emplace(keyLight.getId(), std::move(keyLight));
+
+        std::vector<glm::vec3> lightColors{
+            {1.f, .1f, .1f},
+            {.1f, .1f, 1.f},
+            {.1f, 1.f, .1f},
+            {1.f, 1.f, .1f},
+            {.1f, 1.f, 1.f},
+            {1.f, 1.f, 1.f}
+        };
+
+        for (int i = 0; i < lightColors.size(); i++) {
+            auto pointLight = LveGameObject::makePointLight(2.f);
+            pointLight.color = lightColors[i];
+            float angle = i * glm::two_pi<float>() / lightColors.size();
+            pointLight.transform.translation = {
+                6.f * glm::cos(angle), 8.f, 50.f + 6.f * glm::sin(angle) };
+            gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+        }
+
+    }
+
+    void FirstApp::loadFloor() {
+        // Procedural checkerboard, tiled across the floor. Large enough that
+        // its top levels are only streamed in when the camera gets close.
+        const uint32_t checkerSize = 1024;
+        const uint32_t squareSize = 16;
+        std::vector<uint8_t> checkerPixels(checkerSize * checkerSize * 4);
+        for (uint32_t y = 0; y < checkerSize; y++) {
+            for (uint32_t x = 0; x < checkerSize; x++) {
+                uint8_t value = ((x / squareSize + y / squareSize) % 2 == 0) ? 255 : 128;
+                uint8_t* pixel = &checkerPixels[(y * checkerSize + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = value;
+                pixel[3] = 255;
+            }
+        }
+        Material floorMaterial{};
+        floorMaterial.baseColorTexture = textureStreamer.addTexture(
+            "checkerboard", checkerSize, checkerSize, std::move(checkerPixels));
+        floorMaterial.uvScale = { 4.f, 4.f };
+
+        std::shared_ptr<LveModel> lveModel = LveModel::createModelFromFile(lveDevice, "quad.obj");
         auto quad = LveGameObject::createGameObject();
         quad.model = lveModel;
+        quad.materialIndex = materialSystem.addMaterial(floorMaterial);
         quad.transform.translation = { 0, 10.25, 50 };
         quad.transform.scale = { 100, 100, 100 };
         gameObjects.emplace(quad.getId(), std::move(quad));
-
-
     }
 }
\ No newline at end of file
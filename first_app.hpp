@@ -1,10 +1,19 @@
 #pragma once
 
+#include "lve_bvh.hpp"
 #include "lve_device.hpp"
 #include "lve_game_object.hpp"
 #include "lve_renderer.hpp"
 #include "lve_window.hpp"
+#include "lve_async_io.hpp"
 #include "lve_descriptors.hpp"
+#include "lve_material_system.hpp"
+#include "lve_pipeline_manager.hpp"
+#include "lve_shader_hot_reloader.hpp"
+#include "lve_texture_streamer.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_queue.hpp"
+#include "lve_world_streamer.hpp"
 
 // std
 #include <memory>
@@ -15,6 +24,10 @@ namespace lve {
 	public:
 		static constexpr int WIDTH = 2560;
 		static constexpr int HEIGHT = 1440;
+		static constexpr const char* ASSET_ARCHIVE = "assets.lvepak";
+		static constexpr const char* GLTF_SCENE = "scene.glb";
+		// Written with LveSceneWriter or tools/lve_scene
+		static constexpr const char* LEVEL_FILE = "level.lvescene";
 
 		FirstApp();
 		~FirstApp();
@@ -26,12 +39,29 @@ namespace lve {
 
 	private:
 		void loadGameObjects();
+		void loadFloor();
 
 		LveWindow lveWindow{ WIDTH, HEIGHT, "LVE" };
 		LveDevice lveDevice{ lveWindow };
 		LveRenderer lveRenderer{ lveWindow, lveDevice };
+		LveThreadPool threadPool{};
+		LvePipelineManager pipelineManager{ lveDevice, threadPool };
+		// Only created in debug builds
+		std::unique_ptr<LveShaderHotReloader> shaderHotReloader;
 
 		std::unique_ptr<LveDescriptorPool> globalPool{};
+		std::unique_ptr<LveDescriptorAllocator> frameDescriptorAllocator{};
+		LveMaterialSystem materialSystem{ lveDevice };
+		LveUploadQueue uploadQueue{ lveDevice };
+		LveAsyncIo asyncIo{ threadPool };
+		LveTextureStreamer textureStreamer{
+			lveDevice, materialSystem, uploadQueue, threadPool, asyncIo };
+		// Only created when LEVEL_FILE exists
+		std::unique_ptr<LveWorldStreamer> worldStreamer;
 		LveGameObject::Map gameObjects;
+		// Bounds of every object in gameObjects. Only objects dropped with G move.
+		LveBvh sceneBvh;
+		// From LVE_RECREATE_EVERY, 0 unless benchmarking swap chain recreation
+		uint32_t recreateEvery = 0;
 	};
 }
\ No newline at end of file
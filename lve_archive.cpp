@@ -0,0 +1,307 @@
+#include "lve_archive.hpp"
+
+#include "lve_hash.hpp"
+#include "lve_lz4.hpp"
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        const char ARCHIVE_MAGIC[8] = { 'L', 'V', 'E', 'P', 'A', 'K', '\0', '\0' };
+
+        static_assert(sizeof(LveArchive::Header) == 40, "archive header must not be padded");
+        static_assert(sizeof(LveArchive::TocEntry) == 48, "archive TOC entries must not be padded");
+
+        struct MountState {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<const LveArchive>> archives;
+            LveArchive::IoStats stats{};
+        };
+
+        MountState& mountState() {
+            static MountState state;
+            return state;
+        }
+
+        void recordRead(
+            bool fromArchive, size_t bytes, std::chrono::high_resolution_clock::time_point start) {
+            double milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+            LveProfiler::addTime("assets.read", milliseconds);
+            LveProfiler::addCounter(fromArchive ? "assets.archiveReads" : "assets.looseReads", 1);
+
+            auto& state = mountState();
+            std::lock_guard<std::mutex> lock{ state.mutex };
+            (fromArchive ? state.stats.archiveReads : state.stats.looseReads)++;
+            state.stats.bytes += bytes;
+            state.stats.milliseconds += milliseconds;
+        }
+    }
+
+    LveArchive::LveArchive(const std::string& filepath) : filepath{ filepath }, file{ filepath } {
+        if (file.size() < sizeof(Header) ||
+            std::memcmp(header().magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+            throw std::runtime_error("not an asset archive: " + filepath);
+        }
+        if (header().version != VERSION) {
+            throw std::runtime_error("unsupported asset archive version: " + filepath);
+        }
+
+        const Header& h = header();
+        if (h.tocOffset % alignof(TocEntry) != 0 || h.tocOffset > file.size() ||
+            h.entryCount > (file.size() - h.tocOffset) / sizeof(TocEntry) ||
+            h.namesOffset > file.size() || h.namesSize > file.size() - h.namesOffset) {
+            throw std::runtime_error("corrupt asset archive table of contents: " + filepath);
+        }
+
+        // Checked once so reads can trust the table
+        for (uint32_t i = 0; i < h.entryCount; i++) {
+            const TocEntry& entry = toc()[i];
+            if (entry.dataOffset > file.size() || entry.storedSize > file.size() - entry.dataOffset ||
+                static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > h.namesSize ||
+                entry.compression > static_cast<uint32_t>(Compression::Lz4) ||
+                (i > 0 && toc()[i - 1].nameHash > entry.nameHash)) {
+                throw std::runtime_error("corrupt asset archive entry in " + filepath);
+            }
+        }
+    }
+
+    uint64_t LveArchive::hashName(const std::string& name) {
+        return LveHasher::hash64(name.data(), name.size());
+    }
+
+    std::string LveArchive::getEntryName(uint32_t index) const {
+        const TocEntry& entry = toc()[index];
+        return std::string(
+            reinterpret_cast<const char*>(file.data() + header().namesOffset + entry.nameOffset),
+            entry.nameLength);
+    }
+
+    const LveArchive::TocEntry* LveArchive::find(const std::string& name) const {
+        uint64_t hash = hashName(name);
+        const TocEntry* begin = toc();
+        const TocEntry* end = begin + header().entryCount;
+        auto it = std::lower_bound(begin, end, hash, [](const TocEntry& entry, uint64_t value) {
+            return entry.nameHash < value;
+        });
+
+        const char* names = reinterpret_cast<const char*>(file.data() + header().namesOffset);
+        for (; it != end && it->nameHash == hash; ++it) {
+            if (it->nameLength == name.size() &&
+                std::memcmp(names + it->nameOffset, name.data(), name.size()) == 0) {
+                return it;
+            }
+        }
+        return nullptr;
+    }
+
+    std::unique_ptr<LveArchive::Data> LveArchive::read(const std::string& name) const {
+        const TocEntry* entry = find(name);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+
+        auto data = std::make_unique<Data>();
+        const unsigned char* stored = file.data() + entry->dataOffset;
+        if (static_cast<Compression>(entry->compression) == Compression::None) {
+            data->data_ = stored;
+            data->size_ = static_cast<size_t>(entry->storedSize);
+            return data;
+        }
+
+        size_t size = static_cast<size_t>(entry->size);
+        data->decompressed.resize((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        auto* dst = reinterpret_cast<uint8_t*>(data->decompressed.data());
+        if (!LveLz4::decompress(stored, static_cast<size_t>(entry->storedSize), dst, size)) {
+            throw std::runtime_error("corrupt compressed entry " + name + " in " + filepath);
+        }
+        LveProfiler::addCounter("assets.bytesDecompressed", static_cast<int64_t>(entry->size));
+        data->data_ = dst;
+        data->size_ = size;
+        return data;
+    }
+
+    void LveArchive::mount(const std::string& filepath) {
+        auto archive = std::make_shared<const LveArchive>(filepath);
+        auto& state = mountState();
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        state.archives.push_back(std::move(archive));
+    }
+
+    void LveArchive::unmountAll() {
+        auto& state = mountState();
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        state.archives.clear();
+    }
+
+    std::unique_ptr<LveArchive::Data> LveArchive::readMounted(const std::string& name) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<std::shared_ptr<const LveArchive>> archives;
+        {
+            auto& state = mountState();
+            std::lock_guard<std::mutex> lock{ state.mutex };
+            archives = state.archives;
+        }
+
+        for (const auto& archive : archives) {
+            if (auto data = archive->read(name)) {
+                data->archive = archive;
+                recordRead(true, data->size(), start);
+                return data;
+            }
+        }
+        return nullptr;
+    }
+
+    std::unique_ptr<LveArchive::Data> LveArchive::readAsset(const std::string& name) {
+        if (auto data = readMounted(name)) {
+            return data;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto data = std::make_unique<Data>();
+        data->file = std::make_unique<LveMappedFile>(name);
+        data->data_ = data->file->data();
+        data->size_ = data->file->size();
+        recordRead(false, data->size(), start);
+        return data;
+    }
+
+    LveArchive::IoStats LveArchive::getIoStats() {
+        auto& state = mountState();
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        return state.stats;
+    }
+
+    LveArchiveWriter::LveArchiveWriter(uint32_t alignment) : alignment{ alignment } {
+        if (alignment < alignof(LveArchive::TocEntry) || (alignment & (alignment - 1)) != 0) {
+            throw std::runtime_error("archive alignment must be a power of two of at least 8");
+        }
+    }
+
+    void LveArchiveWriter::add(
+        const std::string& name, const void* data, size_t size, LveArchive::Compression compression) {
+        for (const auto& entry : entries) {
+            if (entry.name == name) {
+                throw std::runtime_error("duplicate archive entry: " + name);
+            }
+        }
+
+        PendingEntry entry{ name, LveArchive::Compression::None, size, {} };
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        if (compression == LveArchive::Compression::Lz4 && size > 0) {
+            entry.stored.resize(LveLz4::compressBound(size));
+            size_t compressedSize =
+                LveLz4::compress(bytes, size, entry.stored.data(), entry.stored.size());
+            if (compressedSize > 0 && compressedSize < size) {
+                entry.stored.resize(compressedSize);
+                entry.compression = LveArchive::Compression::Lz4;
+            }
+        }
+        if (entry.compression == LveArchive::Compression::None) {
+            entry.stored.assign(bytes, bytes + size);
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    void LveArchiveWriter::addFile(
+        const std::string& name, const std::string& filepath, LveArchive::Compression compression) {
+        LveMappedFile file{ filepath };
+        add(name, file.data(), file.size(), compression);
+    }
+
+    uint64_t LveArchiveWriter::getTotalSize() const {
+        uint64_t size = 0;
+        for (const auto& entry : entries) {
+            size += entry.size;
+        }
+        return size;
+    }
+
+    uint64_t LveArchiveWriter::getTotalStoredSize() const {
+        uint64_t size = 0;
+        for (const auto& entry : entries) {
+            size += entry.stored.size();
+        }
+        return size;
+    }
+
+    void LveArchiveWriter::write(const std::string& filepath) const {
+        auto alignUp = [](uint64_t offset, uint64_t alignment) {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        };
+
+        std::vector<LveArchive::TocEntry> toc;
+        std::string names;
+        uint64_t offset = sizeof(LveArchive::Header);
+        for (const auto& entry : entries) {
+            offset = alignUp(offset, alignment);
+            LveArchive::TocEntry tocEntry{};
+            tocEntry.nameHash = LveArchive::hashName(entry.name);
+            tocEntry.dataOffset = offset;
+            tocEntry.storedSize = entry.stored.size();
+            tocEntry.size = entry.size;
+            tocEntry.nameOffset = static_cast<uint32_t>(names.size());
+            tocEntry.nameLength = static_cast<uint32_t>(entry.name.size());
+            tocEntry.compression = static_cast<uint32_t>(entry.compression);
+            toc.push_back(tocEntry);
+            names += entry.name;
+            offset += entry.stored.size();
+        }
+
+        LveArchive::Header header{};
+        std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        header.version = LveArchive::VERSION;
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.namesOffset = offset;
+        header.namesSize = names.size();
+        header.tocOffset = alignUp(offset + names.size(), alignof(LveArchive::TocEntry));
+
+        // Data offsets were taken in insertion order, the table is sorted after
+        std::stable_sort(toc.begin(), toc.end(), [](const auto& a, const auto& b) {
+            return a.nameHash < b.nameHash;
+        });
+
+        std::ofstream out{ filepath, std::ios::binary | std::ios::trunc };
+        if (!out.is_open()) {
+            throw std::runtime_error("failed to open archive for writing: " + filepath);
+        }
+
+        const char zeros[64] = {};
+        auto pad = [&](uint64_t from, uint64_t to) {
+            for (; from < to; from += std::min<uint64_t>(to - from, sizeof(zeros))) {
+                out.write(
+                    zeros, static_cast<std::streamsize>(std::min<uint64_t>(to - from, sizeof(zeros))));
+            }
+        };
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset = sizeof(header);
+        for (const auto& entry : entries) {
+            uint64_t aligned = alignUp(offset, alignment);
+            pad(offset, aligned);
+            out.write(
+                reinterpret_cast<const char*>(entry.stored.data()),
+                static_cast<std::streamsize>(entry.stored.size()));
+            offset = aligned + entry.stored.size();
+        }
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+        pad(header.namesOffset + names.size(), header.tocOffset);
+        out.write(
+            reinterpret_cast<const char*>(toc.data()),
+            static_cast<std::streamsize>(toc.size() * sizeof(toc[0])));
+
+        if (!out) {
+            throw std::runtime_error("failed to write archive: " + filepath);
+        }
+    }
+}
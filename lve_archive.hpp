@@ -0,0 +1,133 @@
+#pragma once
+
+#include "lve_mapped_file.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Read-only pack of asset files, mapped as a whole so opening an asset
+    // is a table lookup instead of a file system round trip. The table of
+    // contents is sorted by name hash and searched in place. Entries are
+    // either stored, aligned so they can be used straight from the mapping,
+    // or LZ4 compressed and decompressed on read.
+    //
+    // Layout, little endian: Header, entry data, entry names, TocEntry array.
+    class LveArchive {
+    public:
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t DEFAULT_ALIGNMENT = 16;
+
+        enum class Compression : uint32_t { None = 0, Lz4 = 1 };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t entryCount;
+            uint64_t tocOffset;
+            uint64_t namesOffset;
+            uint64_t namesSize;
+        };
+
+        struct TocEntry {
+            uint64_t nameHash;
+            uint64_t dataOffset;
+            uint64_t storedSize;
+            uint64_t size;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            uint32_t compression;
+            uint32_t reserved;
+        };
+
+        // Contents of one asset. Stored archive entries point into the mapping
+        // and keep their archive alive; compressed entries and loose files own
+        // their bytes. The data is at least 4 byte aligned.
+        class Data {
+        public:
+            const unsigned char* data() const { return data_; }
+            size_t size() const { return size_; }
+
+        private:
+            friend class LveArchive;
+
+            const unsigned char* data_ = nullptr;
+            size_t size_ = 0;
+            std::shared_ptr<const LveArchive> archive;
+            std::vector<uint32_t> decompressed;
+            std::unique_ptr<LveMappedFile> file;
+        };
+
+        struct IoStats {
+            uint64_t archiveReads;
+            uint64_t looseReads;
+            uint64_t bytes;
+            double milliseconds;
+        };
+
+        LveArchive(const std::string& filepath);
+
+        LveArchive(const LveArchive&) = delete;
+        LveArchive& operator=(const LveArchive&) = delete;
+
+        const TocEntry* find(const std::string& name) const;
+        // Returns nullptr if the archive has no such entry
+        std::unique_ptr<Data> read(const std::string& name) const;
+        uint32_t getEntryCount() const { return header().entryCount; }
+        std::string getEntryName(uint32_t index) const;
+
+        // Mounted archives are searched in mount order by the readers below
+        static void mount(const std::string& filepath);
+        static void unmountAll();
+        // From a mounted archive, or nullptr if none has the name
+        static std::unique_ptr<Data> readMounted(const std::string& name);
+        // From a mounted archive, falling back to the loose file
+        static std::unique_ptr<Data> readAsset(const std::string& name);
+        // Totals of every read through readMounted and readAsset
+        static IoStats getIoStats();
+
+        static uint64_t hashName(const std::string& name);
+
+    private:
+        const Header& header() const { return *reinterpret_cast<const Header*>(file.data()); }
+        const TocEntry* toc() const {
+            return reinterpret_cast<const TocEntry*>(file.data() + header().tocOffset);
+        }
+
+        std::string filepath;
+        LveMappedFile file;
+    };
+
+    // Builds archives, for the lve_pack tool
+    class LveArchiveWriter {
+    public:
+        LveArchiveWriter(uint32_t alignment = LveArchive::DEFAULT_ALIGNMENT);
+
+        // Entries that don't get smaller are stored uncompressed
+        void add(
+            const std::string& name, const void* data, size_t size, LveArchive::Compression compression);
+        void addFile(
+            const std::string& name, const std::string& filepath, LveArchive::Compression compression);
+        void write(const std::string& filepath) const;
+
+        size_t getEntryCount() const { return entries.size(); }
+        uint64_t getTotalSize() const;
+        uint64_t getTotalStoredSize() const;
+
+    private:
+        struct PendingEntry {
+            std::string name;
+            LveArchive::Compression compression;
+            uint64_t size;
+            std::vector<uint8_t> stored;
+        };
+
+        uint32_t alignment;
+        std::vector<PendingEntry> entries;
+    };
+}
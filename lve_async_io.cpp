@@ -0,0 +1,456 @@
+#include "lve_async_io.hpp"
+
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace lve {
+
+    LveIoBuffer::LveIoBuffer(size_t size)
+        : size_{ size }, capacity_{ (std::max<size_t>(size, 1) + ALIGNMENT - 1) & ~(ALIGNMENT - 1) } {
+        data_ = static_cast<unsigned char*>(::operator new(capacity_, std::align_val_t{ ALIGNMENT }));
+    }
+
+    LveIoBuffer::~LveIoBuffer() {
+        ::operator delete(data_, std::align_val_t{ ALIGNMENT });
+    }
+
+#ifdef __linux__
+
+    // Submission and completion rings shared with the kernel, driven through
+    // the raw syscalls so liburing isn't needed. Only used from the polling
+    // thread.
+    class LveAsyncIo::Ring {
+    public:
+        // Returns nullptr when io_uring is unavailable, e.g. on old kernels or
+        // when a seccomp policy blocks it
+        static std::unique_ptr<Ring> create(uint32_t entries) {
+            io_uring_params params{};
+            int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0) {
+                return nullptr;
+            }
+            auto ring = std::unique_ptr<Ring>(new Ring());
+            ring->fd = fd;
+            if (!ring->supportsRead() || !ring->map(params)) {
+                return nullptr;
+            }
+            return ring;
+        }
+
+        ~Ring() {
+            if (sqes != nullptr) munmap(sqes, sqesSize);
+            if (cqRing != nullptr && cqRing != sqRing) munmap(cqRing, cqRingSize);
+            if (sqRing != nullptr) munmap(sqRing, sqRingSize);
+            close(fd);
+        }
+
+        uint32_t getEntries() const { return sqEntries; }
+
+        // The caller keeps at most getEntries() reads in flight, so the
+        // submission ring never overflows
+        void queueRead(int fileFd, void* buffer, uint32_t length, uint64_t offset, uint64_t userData) {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fileFd;
+            sqe.addr = reinterpret_cast<uint64_t>(buffer);
+            sqe.len = length;
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            toSubmit++;
+        }
+
+        // Submits queued reads, optionally blocking until one completes
+        void enter(bool waitForCompletion) {
+            unsigned flags = waitForCompletion ? IORING_ENTER_GETEVENTS : 0;
+            while (toSubmit > 0 || waitForCompletion) {
+                long submitted = syscall(
+                    __NR_io_uring_enter, fd, toSubmit, waitForCompletion ? 1 : 0, flags, nullptr, 0);
+                if (submitted < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EBUSY) {
+                        // Completions have to be reaped first
+                        return;
+                    }
+                    throw std::runtime_error(
+                        std::string("io_uring_enter failed: ") + std::strerror(errno));
+                }
+                toSubmit -= static_cast<unsigned>(submitted);
+                waitForCompletion = false;
+            }
+        }
+
+        template <typename F>
+        void forEachCompletion(F&& fn) {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                fn(cqe.user_data, static_cast<int64_t>(cqe.res));
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+
+    private:
+        Ring() = default;
+
+        // Kernels 5.1 to 5.5 set up rings but fail every IORING_OP_READ with
+        // EINVAL. The opcode probe arrived together with it in 5.6, so those
+        // kernels fail the probe as well.
+        bool supportsRead() const {
+            // io_uring_probe ends in a flexible array of ops
+            std::vector<uint64_t> storage(
+                (sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op) + 7) / 8);
+            auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+                return false;
+            }
+            return probe->last_op >= IORING_OP_READ &&
+                (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+        }
+
+        bool map(const io_uring_params& params) {
+            sqEntries = params.sq_entries;
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMap) {
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            }
+
+            sqRing = mmapRing(sqRingSize, IORING_OFF_SQ_RING);
+            if (sqRing == nullptr) return false;
+            cqRing = singleMap ? sqRing : mmapRing(cqRingSize, IORING_OFF_CQ_RING);
+            if (cqRing == nullptr) return false;
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmapRing(sqesSize, IORING_OFF_SQES));
+            if (sqes == nullptr) return false;
+
+            auto* sq = static_cast<unsigned char*>(sqRing);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            auto* cq = static_cast<unsigned char*>(cqRing);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        void* mmapRing(size_t size, off_t offset) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+
+        int fd = -1;
+        uint32_t sqEntries = 0;
+        unsigned toSubmit = 0;
+
+        void* sqRing = nullptr;
+        void* cqRing = nullptr;
+        size_t sqRingSize = 0;
+        size_t cqRingSize = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqesSize = 0;
+
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+    };
+
+#else
+
+    // Without io_uring every read goes through the thread pool
+    class LveAsyncIo::Ring {
+    public:
+        static std::unique_ptr<Ring> create(uint32_t) { return nullptr; }
+        uint32_t getEntries() const { return 0; }
+        void queueRead(int, void*, uint32_t, uint64_t, uint64_t) {}
+        void enter(bool) {}
+        template <typename F>
+        void forEachCompletion(F&&) {}
+    };
+
+#endif
+
+    LveAsyncIo::LveAsyncIo(LveThreadPool& threadPool, uint32_t queueDepth)
+        : threadPool{ threadPool }, queueDepth{ queueDepth } {
+        // The completion ring holds twice the submission entries
+        ring = Ring::create(queueDepth);
+        if (ring) {
+            this->queueDepth = std::min(queueDepth, ring->getEntries());
+        }
+    }
+
+    LveAsyncIo::~LveAsyncIo() {
+        queuedChunks.clear();
+        while (chunksInFlight > 0) {
+            reapCompletions(true);
+        }
+        for (auto& file : files) {
+#ifndef _WIN32
+            if (file->fd >= 0) {
+                close(file->fd);
+            }
+#endif
+        }
+    }
+
+    void LveAsyncIo::read(const std::string& filepath, Callback callback) {
+        auto file = std::make_unique<FileRead>();
+        file->filepath = filepath;
+        file->callback = std::move(callback);
+
+        size_t size = 0;
+#ifdef _WIN32
+        std::ifstream stream{ filepath, std::ios::ate | std::ios::binary };
+        if (!stream.is_open()) {
+            file->error = "failed to open file: " + filepath;
+        } else {
+            size = static_cast<size_t>(stream.tellg());
+        }
+#else
+        // Not every file system supports O_DIRECT, tmpfs for one
+        int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+        file->fd = open(filepath.c_str(), flags | O_DIRECT);
+#endif
+        if (file->fd < 0) {
+            file->fd = open(filepath.c_str(), flags);
+        }
+
+        struct stat fileStat {};
+        if (file->fd < 0) {
+            file->error = "failed to open file: " + filepath;
+        } else if (fstat(file->fd, &fileStat) != 0) {
+            file->error = "failed to stat file: " + filepath;
+        } else {
+            size = static_cast<size_t>(fileStat.st_size);
+        }
+#endif
+
+        FileRead* fileRead = file.get();
+        files.push_back(std::move(file));
+        if (!fileRead->error.empty()) {
+            finishedFiles.push_back(fileRead);
+            return;
+        }
+
+        // Chunk lengths are whole blocks, the last read just stops at the end
+        fileRead->buffer = std::make_unique<LveIoBuffer>(size);
+        for (uint64_t offset = 0; offset < size; offset += CHUNK_SIZE) {
+            uint64_t length = std::min<uint64_t>(CHUNK_SIZE, fileRead->buffer->capacity() - offset);
+            queuedChunks.push_back({ fileRead, offset, static_cast<uint32_t>(length) });
+            fileRead->chunksLeft++;
+        }
+        if (fileRead->chunksLeft == 0) {
+            finishedFiles.push_back(fileRead);
+        }
+        LveProfiler::addCounter("io.filesQueued", 1);
+    }
+
+    void LveAsyncIo::submitChunks() {
+        while (!queuedChunks.empty() && chunksInFlight < queueDepth) {
+            Chunk chunk = queuedChunks.front();
+            queuedChunks.pop_front();
+            chunksInFlight++;
+
+            if (ring) {
+                // Ownership of the chunk passes to the kernel until it completes
+                auto* inFlight = new Chunk(chunk);
+                ring->queueRead(
+                    chunk.file->fd,
+                    chunk.file->buffer->data() + chunk.offset,
+                    chunk.length,
+                    chunk.offset,
+                    reinterpret_cast<uint64_t>(inFlight));
+                continue;
+            }
+
+            threadPool.submit([this, chunk]() {
+                int64_t result = readChunk(chunk);
+                {
+                    std::lock_guard<std::mutex> lock{ completedMutex };
+                    completed.push_back({ chunk, result });
+                }
+                completedCondition.notify_one();
+            });
+        }
+        if (ring) {
+            ring->enter(false);
+        }
+    }
+
+    int64_t LveAsyncIo::readChunk(const Chunk& chunk) {
+        unsigned char* dst = chunk.file->buffer->data() + chunk.offset;
+#ifdef _WIN32
+        std::ifstream stream{ chunk.file->filepath, std::ios::binary };
+        stream.seekg(static_cast<std::streamoff>(chunk.offset));
+        stream.read(reinterpret_cast<char*>(dst), chunk.length);
+        return stream.bad() ? -EIO : static_cast<int64_t>(stream.gcount());
+#else
+        ssize_t result;
+        do {
+            result = pread(chunk.file->fd, dst, chunk.length, static_cast<off_t>(chunk.offset));
+        } while (result < 0 && errno == EINTR);
+        return result < 0 ? -errno : static_cast<int64_t>(result);
+#endif
+    }
+
+    void LveAsyncIo::reapCompletions(bool wait) {
+        if (ring) {
+            if (wait) {
+                ring->enter(true);
+            }
+            ring->forEachCompletion([this](uint64_t userData, int64_t result) {
+                std::unique_ptr<Chunk> chunk{ reinterpret_cast<Chunk*>(userData) };
+                completeChunk({ *chunk, result });
+            });
+            return;
+        }
+
+        std::vector<Completion> ready;
+        {
+            std::unique_lock<std::mutex> lock{ completedMutex };
+            if (wait) {
+                completedCondition.wait(lock, [this]() { return !completed.empty(); });
+            }
+            ready.swap(completed);
+        }
+        for (const auto& completion : ready) {
+            completeChunk(completion);
+        }
+    }
+
+    void LveAsyncIo::completeChunk(const Completion& completion) {
+        chunksInFlight--;
+        FileRead* file = completion.chunk.file;
+
+        // Short reads only happen at the end of the file
+        uint64_t expected = std::min<uint64_t>(
+            completion.chunk.length, file->buffer->size() - completion.chunk.offset);
+        if (completion.result < 0) {
+            file->error = "failed to read " + file->filepath + ": " +
+                std::strerror(static_cast<int>(-completion.result));
+        } else if (static_cast<uint64_t>(completion.result) < expected) {
+            file->error = "short read of " + file->filepath;
+        } else {
+            bytesRead += expected;
+            LveProfiler::addCounter("io.bytesRead", static_cast<int64_t>(expected));
+        }
+
+        if (--file->chunksLeft == 0) {
+            finishedFiles.push_back(file);
+        }
+    }
+
+    void LveAsyncIo::poll() {
+        submitChunks();
+        reapCompletions(false);
+        // Completions free queue slots
+        submitChunks();
+        updateBusyTime();
+
+        // Callbacks may queue more reads, which go through the next poll
+        std::vector<FileRead*> finished;
+        finished.swap(finishedFiles);
+        for (FileRead* file : finished) {
+#ifndef _WIN32
+            if (file->fd >= 0) {
+                close(file->fd);
+                file->fd = -1;
+            }
+#endif
+            Result result{};
+            result.filepath = file->filepath;
+            if (file->error.empty()) {
+                result.buffer = std::move(file->buffer);
+                filesRead++;
+            } else {
+                result.error = file->error;
+            }
+            Callback callback = std::move(file->callback);
+
+            files.erase(std::find_if(files.begin(), files.end(), [file](const auto& owned) {
+                return owned.get() == file;
+            }));
+            callback(std::move(result));
+        }
+
+        LveProfiler::setGauge("io.chunksInFlight", chunksInFlight);
+        LveProfiler::setGauge("io.chunksQueued", static_cast<int64_t>(queuedChunks.size()));
+    }
+
+    void LveAsyncIo::waitIdle() {
+        poll();
+        while (!files.empty() || !finishedFiles.empty()) {
+            if (chunksInFlight > 0) {
+                reapCompletions(true);
+            }
+            poll();
+        }
+    }
+
+    void LveAsyncIo::updateBusyTime() {
+        auto now = std::chrono::steady_clock::now();
+        if (busy) {
+            busySeconds += std::chrono::duration<double>(now - busySince).count();
+        }
+        busy = chunksInFlight > 0;
+        busySince = now;
+    }
+
+    LveAsyncIo::Stats LveAsyncIo::getStats() const {
+        Stats stats{};
+        stats.backend = ring ? "io_uring" : "thread pool";
+        stats.queueDepth = queueDepth;
+        stats.chunksInFlight = chunksInFlight;
+        stats.chunksQueued = queuedChunks.size();
+        stats.filesRead = filesRead;
+        stats.bytesRead = bytesRead;
+        stats.busySeconds = busySeconds;
+        return stats;
+    }
+
+    void LveAsyncIo::printStats(std::ostream& out) const {
+        Stats stats = getStats();
+        out << "Async I/O (" << stats.backend << ", queue depth " << stats.queueDepth << "): "
+            << stats.filesRead << " files, " << (stats.bytesRead >> 20) << " MB";
+        if (stats.busySeconds > 0.0) {
+            out << " at " << static_cast<uint64_t>((stats.bytesRead >> 20) / stats.busySeconds)
+                << " MB/s while busy";
+        }
+        out << ", " << stats.chunksInFlight << " chunks in flight, " << stats.chunksQueued
+            << " queued" << std::endl;
+    }
+}
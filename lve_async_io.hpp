@@ -0,0 +1,145 @@
+#pragma once
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Heap memory aligned for O_DIRECT reads. The capacity is rounded up to
+    // whole alignment blocks, size is the number of valid bytes.
+    class LveIoBuffer {
+    public:
+        static constexpr size_t ALIGNMENT = 4096;
+
+        LveIoBuffer(size_t size);
+        ~LveIoBuffer();
+
+        LveIoBuffer(const LveIoBuffer&) = delete;
+        LveIoBuffer& operator=(const LveIoBuffer&) = delete;
+
+        unsigned char* data() { return data_; }
+        const unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+
+    private:
+        unsigned char* data_;
+        size_t size_;
+        size_t capacity_;
+    };
+
+    // Reads whole files without blocking the caller. Files are split into
+    // chunks which are kept in flight up to the queue depth, through io_uring
+    // on Linux when the kernel allows it and through pread on the thread pool
+    // otherwise. Files are opened with O_DIRECT where the file system supports
+    // it, so large reads bypass the page cache.
+    //
+    // poll submits queued chunks and runs the callbacks of finished files on
+    // the calling thread, which is expected to hand decoding to the thread
+    // pool and the results to the upload queue.
+    class LveAsyncIo {
+    public:
+        static constexpr uint32_t CHUNK_SIZE = 1024 * 1024;
+
+        struct Result {
+            std::string filepath;
+            // nullptr if the read failed
+            std::unique_ptr<LveIoBuffer> buffer;
+            std::string error;
+        };
+        using Callback = std::function<void(Result result)>;
+
+        struct Stats {
+            const char* backend;
+            uint32_t queueDepth;
+            uint32_t chunksInFlight;
+            size_t chunksQueued;
+            uint64_t filesRead;
+            uint64_t bytesRead;
+            // Time with at least one chunk in flight, measured between polls
+            double busySeconds;
+        };
+
+        LveAsyncIo(LveThreadPool& threadPool, uint32_t queueDepth = 64);
+        // Waits for chunks in flight, whose buffers the kernel still writes;
+        // callbacks of unfinished files are dropped
+        ~LveAsyncIo();
+
+        LveAsyncIo(const LveAsyncIo&) = delete;
+        LveAsyncIo& operator=(const LveAsyncIo&) = delete;
+
+        // Queues a read of the whole file. Open failures are reported through
+        // the callback as well, from the next poll.
+        void read(const std::string& filepath, Callback callback);
+
+        void poll();
+        // Polls until every queued read has finished
+        void waitIdle();
+
+        bool usesIoUring() const { return ring != nullptr; }
+        Stats getStats() const;
+        void printStats(std::ostream& out) const;
+
+    private:
+        struct FileRead {
+            std::string filepath;
+            int fd = -1;
+            std::unique_ptr<LveIoBuffer> buffer;
+            uint32_t chunksLeft = 0;
+            std::string error;
+            Callback callback;
+        };
+
+        struct Chunk {
+            FileRead* file;
+            uint64_t offset;
+            uint32_t length;
+        };
+
+        struct Completion {
+            Chunk chunk;
+            // Bytes read, or a negative errno
+            int64_t result;
+        };
+
+        class Ring;
+
+        void submitChunks();
+        void reapCompletions(bool wait);
+        void completeChunk(const Completion& completion);
+        static int64_t readChunk(const Chunk& chunk);
+        void updateBusyTime();
+
+        LveThreadPool& threadPool;
+        uint32_t queueDepth;
+        std::unique_ptr<Ring> ring;
+
+        std::vector<std::unique_ptr<FileRead>> files;
+        std::deque<Chunk> queuedChunks;
+        std::vector<FileRead*> finishedFiles;
+        uint32_t chunksInFlight = 0;
+
+        // Filled by thread pool reads when io_uring isn't used
+        std::mutex completedMutex;
+        std::condition_variable completedCondition;
+        std::vector<Completion> completed;
+
+        uint64_t filesRead = 0;
+        uint64_t bytesRead = 0;
+        double busySeconds = 0.0;
+        bool busy = false;
+        std::chrono::steady_clock::time_point busySince;
+    };
+}
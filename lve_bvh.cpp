@@ -0,0 +1,659 @@
+#include "lve_bvh.hpp"
+
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <ostream>
+
+namespace lve {
+
+    namespace {
+        constexpr uint32_t SAH_BINS = 16;
+        // Deeper subtrees are halved by count, which bounds the depth by
+        // MAX_DEPTH and with it the query stacks. Inserts never go deeper.
+        constexpr uint32_t MAX_SAH_DEPTH = 48;
+        constexpr uint32_t MAX_DEPTH = MAX_SAH_DEPTH + 32;
+        constexpr uint32_t MAX_STACK = 96;
+        // Queries test pending inserts one by one, so past this many they go into the tree
+        constexpr size_t MAX_PENDING_INSERTS = 64;
+        // commit rebuilds once the tree is this much worse than when it was built
+        constexpr float MAX_COST_RATIO = 1.5f;
+
+        // Empty boxes are inverted, so they fail every test below
+        const LveBvh::BoundingBox EMPTY_BOX{ glm::vec3{ FLT_MAX }, glm::vec3{ -FLT_MAX } };
+
+        void grow(LveBvh::BoundingBox& box, const glm::vec3& min, const glm::vec3& max) {
+            box.min = glm::min(box.min, min);
+            box.max = glm::max(box.max, max);
+        }
+
+        float halfArea(const glm::vec3& min, const glm::vec3& max) {
+            glm::vec3 d = max - min;
+            if (d.x < 0.f || d.y < 0.f || d.z < 0.f) return 0.f;
+            return d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+
+        bool overlaps(const glm::vec3& min, const glm::vec3& max, const LveBvh::BoundingBox& box) {
+            return min.x <= box.max.x && max.x >= box.min.x &&
+                min.y <= box.max.y && max.y >= box.min.y &&
+                min.z <= box.max.z && max.z >= box.min.z;
+        }
+
+        enum class Containment { Outside, Intersecting, Inside };
+
+        Containment classify(const LveBvh::Frustum& frustum, const glm::vec3& min, const glm::vec3& max) {
+            Containment result = Containment::Inside;
+            for (const glm::vec4& plane : frustum.planes) {
+                // The corners furthest along and against the plane normal
+                glm::vec3 positive{
+                    plane.x >= 0.f ? max.x : min.x,
+                    plane.y >= 0.f ? max.y : min.y,
+                    plane.z >= 0.f ? max.z : min.z };
+                glm::vec3 negative{
+                    plane.x >= 0.f ? min.x : max.x,
+                    plane.y >= 0.f ? min.y : max.y,
+                    plane.z >= 0.f ? min.z : max.z };
+                if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) return Containment::Outside;
+                if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.f) result = Containment::Intersecting;
+            }
+            return result;
+        }
+
+        // Slab test picking the near and far planes by direction sign, which
+        // also rejects inverted boxes
+        struct Ray {
+            glm::vec3 origin;
+            glm::vec3 inverseDirection;
+            int negative[3];
+            float maxDistance;
+
+            Ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+                : origin{ origin }, inverseDirection{ 1.f / direction }, maxDistance{ maxDistance } {
+                for (int i = 0; i < 3; i++) {
+                    negative[i] = inverseDirection[i] < 0.f;
+                }
+            }
+
+            // Entry distance, clamped to 0 when the origin is inside, or FLT_MAX for a miss
+            float intersect(const glm::vec3& min, const glm::vec3& max) const {
+                const glm::vec3* bounds[2] = { &min, &max };
+                float tNear = 0.f;
+                float tFar = maxDistance;
+                for (int i = 0; i < 3; i++) {
+                    float t0 = ((*bounds[negative[i]])[i] - origin[i]) * inverseDirection[i];
+                    float t1 = ((*bounds[1 - negative[i]])[i] - origin[i]) * inverseDirection[i];
+                    tNear = t0 > tNear ? t0 : tNear;
+                    tFar = t1 < tFar ? t1 : tFar;
+                }
+                return tNear <= tFar ? tNear : FLT_MAX;
+            }
+        };
+    }
+
+    LveBvh::Frustum LveBvh::Frustum::fromViewProjection(const glm::mat4& m) {
+        // Gribb and Hartmann, from the rows of the matrix. Depth is zero to
+        // one, so the near plane is the third row alone.
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = { m[0][i], m[1][i], m[2][i], m[3][i] };
+        }
+        Frustum frustum{};
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    LveBvh::BoundingBox LveBvh::computeWorldBounds(LveGameObject& gameObject) {
+        if (gameObject.model == nullptr) {
+            return { gameObject.transform.translation, gameObject.transform.translation };
+        }
+        // From the transformed center and extents
+        const auto& bounds = gameObject.model->getBoundingBox();
+        glm::mat4 modelMatrix = gameObject.transform.mat4();
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * .5f, 1.f));
+        glm::vec3 extent = (bounds.max - bounds.min) * .5f;
+        glm::vec3 worldExtent{ 0.f };
+        for (int i = 0; i < 3; i++) {
+            worldExtent += glm::abs(glm::vec3(modelMatrix[i])) * extent[i];
+        }
+        return { center - worldExtent, center + worldExtent };
+    }
+
+    void LveBvh::insert(id_t id, const BoundingBox& bounds) {
+        if (locations.count(id) > 0) {
+            update(id, bounds);
+            return;
+        }
+        locations.emplace(id, PENDING | static_cast<uint32_t>(pendingItems.size()));
+        pendingItems.push_back({ bounds, id, 1 });
+        // Until the first build they wait for commit
+        if (pendingItems.size() >= MAX_PENDING_INSERTS && !nodes.empty()) {
+            insertPending();
+        }
+    }
+
+    void LveBvh::update(id_t id, const BoundingBox& bounds) {
+        auto it = locations.find(id);
+        if (it == locations.end()) return;
+        if (it->second & PENDING) {
+            pendingItems[it->second & ~PENDING].bounds = bounds;
+            return;
+        }
+        items[it->second].bounds = bounds;
+        movedItems.push_back(it->second);
+    }
+
+    void LveBvh::remove(id_t id) {
+        auto it = locations.find(id);
+        if (it == locations.end()) return;
+        if (it->second & PENDING) {
+            uint32_t index = it->second & ~PENDING;
+            if (index + 1 < pendingItems.size()) {
+                pendingItems[index] = pendingItems.back();
+                locations[pendingItems[index].id] = PENDING | index;
+            }
+            pendingItems.pop_back();
+        } else {
+            // Refit so the leaf shrinks without it
+            items[it->second].alive = 0;
+            removedCount++;
+            movedItems.push_back(it->second);
+        }
+        locations.erase(it);
+    }
+
+    void LveBvh::clear() {
+        nodes.clear();
+        parents.clear();
+        items.clear();
+        itemLeaves.clear();
+        pendingItems.clear();
+        locations.clear();
+        movedItems.clear();
+        removedCount = 0;
+        insertedCount = 0;
+        builtCost = currentCost = 0.f;
+    }
+
+    void LveBvh::commit() {
+        LveProfiler::ScopedTimer timer{ "bvh.commit" };
+        uint32_t liveCount = static_cast<uint32_t>(locations.size());
+        if (insertedCount + pendingItems.size() > std::max<size_t>(64, liveCount / 8) ||
+            removedCount > std::max<uint32_t>(64, liveCount / 4) ||
+            (nodes.empty() && !pendingItems.empty())) {
+            rebuild();
+            return;
+        }
+        insertPending();
+
+        if (movedItems.size() > nodes.size() / 16) {
+            refitAll();
+        } else {
+            // Walk up from each moved object until a node's box stops changing
+            for (uint32_t item : movedItems) {
+                for (uint32_t node = itemLeaves[item]; node != INVALID; node = parents[node]) {
+                    Node before = nodes[node];
+                    refitNode(node);
+                    if (before.min == nodes[node].min && before.max == nodes[node].max) break;
+                }
+            }
+        }
+        movedItems.clear();
+
+        if (builtCost > 0.f && currentCost > builtCost * MAX_COST_RATIO) {
+            rebuild();
+        }
+    }
+
+    void LveBvh::insertPending() {
+        for (size_t pending = 0; pending < pendingItems.size(); pending++) {
+            const Item item = pendingItems[pending];
+            // Descend to the leaf whose box grows least, by area
+            uint32_t leaf = 0;
+            uint32_t depth = 0;
+            while (nodes[leaf].count == 0) {
+                uint32_t best = nodes[leaf].first;
+                float bestGrowth = FLT_MAX;
+                for (uint32_t child = best; child < nodes[leaf].first + 2; child++) {
+                    BoundingBox box{ nodes[child].min, nodes[child].max };
+                    grow(box, item.bounds.min, item.bounds.max);
+                    float growth = halfArea(box.min, box.max) - halfArea(nodes[child].min, nodes[child].max);
+                    if (growth < bestGrowth) {
+                        bestGrowth = growth;
+                        best = child;
+                    }
+                }
+                leaf = best;
+                depth++;
+            }
+            if (depth >= MAX_DEPTH) {
+                // The query stacks only hold so much, build the rest in instead
+                pendingItems.erase(pendingItems.begin(), pendingItems.begin() + pending);
+                rebuild();
+                return;
+            }
+
+            // The leaf moves to a new slot and its old one becomes the parent
+            // of it and a new leaf holding just the item
+            uint32_t children = static_cast<uint32_t>(nodes.size());
+            uint32_t index = static_cast<uint32_t>(items.size());
+            nodes.push_back(nodes[leaf]);
+            nodes.push_back({ item.bounds.min, index, item.bounds.max, 1 });
+            parents.push_back(leaf);
+            parents.push_back(leaf);
+            for (uint32_t i = nodes[leaf].first; i < nodes[leaf].first + nodes[leaf].count; i++) {
+                itemLeaves[i] = children;
+            }
+            items.push_back(item);
+            itemLeaves.push_back(children + 1);
+            locations[item.id] = index;
+            insertedCount++;
+
+            // The moved leaf keeps its share of the cost
+            Node& parent = nodes[leaf];
+            parent.first = children;
+            parent.count = 0;
+            parent.min = glm::min(parent.min, item.bounds.min);
+            parent.max = glm::max(parent.max, item.bounds.max);
+            currentCost += halfArea(item.bounds.min, item.bounds.max) + halfArea(parent.min, parent.max);
+            for (uint32_t node = parents[leaf]; node != INVALID; node = parents[node]) {
+                Node before = nodes[node];
+                refitNode(node);
+                if (before.min == nodes[node].min && before.max == nodes[node].max) break;
+            }
+        }
+        pendingItems.clear();
+    }
+
+    void LveBvh::refitNode(uint32_t node) {
+        Node& n = nodes[node];
+        BoundingBox box = EMPTY_BOX;
+        if (n.count > 0) {
+            for (uint32_t i = n.first; i < n.first + n.count; i++) {
+                if (items[i].alive) {
+                    grow(box, items[i].bounds.min, items[i].bounds.max);
+                }
+            }
+        } else {
+            grow(box, nodes[n.first].min, nodes[n.first].max);
+            grow(box, nodes[n.first + 1].min, nodes[n.first + 1].max);
+        }
+        float weight = n.count > 0 ? static_cast<float>(n.count) : 1.f;
+        currentCost += (halfArea(box.min, box.max) - halfArea(n.min, n.max)) * weight;
+        n.min = box.min;
+        n.max = box.max;
+    }
+
+    void LveBvh::refitAll() {
+        // Children always come after their parent
+        for (size_t i = nodes.size(); i-- > 0;) {
+            refitNode(static_cast<uint32_t>(i));
+        }
+    }
+
+    float LveBvh::computeCost() const {
+        float cost = 0.f;
+        for (const Node& node : nodes) {
+            cost += halfArea(node.min, node.max) * (node.count > 0 ? static_cast<float>(node.count) : 1.f);
+        }
+        return cost;
+    }
+
+    void LveBvh::rebuild() {
+        LveProfiler::ScopedTimer timer{ "bvh.rebuild" };
+
+        items.erase(
+            std::remove_if(items.begin(), items.end(), [](const Item& item) { return !item.alive; }),
+            items.end());
+        items.insert(items.end(), pendingItems.begin(), pendingItems.end());
+        std::vector<glm::vec3> centers(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            centers[i] = (items[i].bounds.min + items[i].bounds.max) * .5f;
+        }
+        nodes.clear();
+        parents.clear();
+        itemLeaves.assign(items.size(), INVALID);
+        pendingItems.clear();
+        movedItems.clear();
+        removedCount = 0;
+        insertedCount = 0;
+        rebuildCount++;
+
+        if (!items.empty()) {
+            buildNodes(centers);
+        }
+        for (uint32_t i = 0; i < items.size(); i++) {
+            locations[items[i].id] = i;
+        }
+        builtCost = currentCost = computeCost();
+    }
+
+    void LveBvh::buildNodes(std::vector<glm::vec3>& centers) {
+        // Each task's box comes from its parent's split
+        struct Task {
+            uint32_t node;
+            uint32_t begin;
+            uint32_t end;
+            uint32_t depth;
+            BoundingBox box;
+        };
+        BoundingBox rootBox = EMPTY_BOX;
+        for (const Item& item : items) {
+            grow(rootBox, item.bounds.min, item.bounds.max);
+        }
+        nodes.reserve(items.size());
+        parents.reserve(items.size());
+        nodes.push_back({});
+        parents.push_back(INVALID);
+        std::vector<Task> tasks{ { 0, 0, static_cast<uint32_t>(items.size()), 0, rootBox } };
+
+        while (!tasks.empty()) {
+            Task task = tasks.back();
+            tasks.pop_back();
+            nodes[task.node].min = task.box.min;
+            nodes[task.node].max = task.box.max;
+
+            uint32_t count = task.end - task.begin;
+            if (count <= MAX_LEAF_SIZE) {
+                nodes[task.node].first = task.begin;
+                nodes[task.node].count = count;
+                std::fill(itemLeaves.begin() + task.begin, itemLeaves.begin() + task.end, task.node);
+                continue;
+            }
+
+            BoundingBox centerBox = EMPTY_BOX;
+            for (uint32_t i = task.begin; i < task.end; i++) {
+                grow(centerBox, centers[i], centers[i]);
+            }
+
+            // Binned SAH over the centers, all three axes in one pass
+            int bestAxis = -1;
+            uint32_t bestBin = 0;
+            BoundingBox leftBox = EMPTY_BOX;
+            BoundingBox rightBox = EMPTY_BOX;
+            glm::vec3 centerExtent = centerBox.max - centerBox.min;
+            glm::vec3 binScale{ 0.f };
+            // Small nodes don't need as many bins as they have objects
+            uint32_t binCount = std::min(SAH_BINS, count);
+            if (task.depth < MAX_SAH_DEPTH) {
+                for (int axis = 0; axis < 3; axis++) {
+                    binScale[axis] = centerExtent[axis] > 0.f ? binCount / centerExtent[axis] : 0.f;
+                }
+                BoundingBox bins[3][SAH_BINS];
+                uint32_t binCounts[3][SAH_BINS] = {};
+                for (auto& axisBins : bins) {
+                    std::fill(axisBins, axisBins + binCount, EMPTY_BOX);
+                }
+                for (uint32_t i = task.begin; i < task.end; i++) {
+                    for (int axis = 0; axis < 3; axis++) {
+                        uint32_t bin = std::min(binCount - 1,
+                            static_cast<uint32_t>((centers[i][axis] - centerBox.min[axis]) * binScale[axis]));
+                        grow(bins[axis][bin], items[i].bounds.min, items[i].bounds.max);
+                        binCounts[axis][bin]++;
+                    }
+                }
+
+                float bestCost = FLT_MAX;
+                for (int axis = 0; axis < 3; axis++) {
+                    if (binScale[axis] == 0.f) continue;
+                    // Sweep from the right, then evaluate each split from the left
+                    BoundingBox rightBoxes[SAH_BINS];
+                    uint32_t rightCounts[SAH_BINS];
+                    BoundingBox right = EMPTY_BOX;
+                    uint32_t rightCount = 0;
+                    for (uint32_t bin = binCount; bin-- > 1;) {
+                        grow(right, bins[axis][bin].min, bins[axis][bin].max);
+                        rightCount += binCounts[axis][bin];
+                        rightBoxes[bin] = right;
+                        rightCounts[bin] = rightCount;
+                    }
+                    BoundingBox left = EMPTY_BOX;
+                    uint32_t leftCount = 0;
+                    for (uint32_t bin = 0; bin < binCount - 1; bin++) {
+                        grow(left, bins[axis][bin].min, bins[axis][bin].max);
+                        leftCount += binCounts[axis][bin];
+                        if (leftCount == 0 || rightCounts[bin + 1] == 0) continue;
+                        float cost = halfArea(left.min, left.max) * leftCount +
+                            halfArea(rightBoxes[bin + 1].min, rightBoxes[bin + 1].max) * rightCounts[bin + 1];
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = bin;
+                            leftBox = left;
+                            rightBox = rightBoxes[bin + 1];
+                        }
+                    }
+                }
+            }
+
+            uint32_t middle = task.begin;
+            if (bestAxis >= 0) {
+                for (uint32_t i = task.begin; i < task.end; i++) {
+                    uint32_t bin = std::min(binCount - 1,
+                        static_cast<uint32_t>((centers[i][bestAxis] - centerBox.min[bestAxis]) * binScale[bestAxis]));
+                    if (bin <= bestBin) {
+                        std::swap(items[i], items[middle]);
+                        std::swap(centers[i], centers[middle]);
+                        middle++;
+                    }
+                }
+            } else {
+                // Coincident centers or too deep: halve by count on the widest axis
+                int axis = centerExtent.x >= centerExtent.y && centerExtent.x >= centerExtent.z ? 0
+                    : centerExtent.y >= centerExtent.z ? 1 : 2;
+                middle = task.begin + count / 2;
+                std::vector<uint32_t> order(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    order[i] = task.begin + i;
+                }
+                std::nth_element(order.begin(), order.begin() + count / 2, order.end(), [&](uint32_t a, uint32_t b) {
+                    return centers[a][axis] < centers[b][axis];
+                });
+                std::vector<Item> sortedItems(count);
+                std::vector<glm::vec3> sortedCenters(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    sortedItems[i] = items[order[i]];
+                    sortedCenters[i] = centers[order[i]];
+                }
+                std::copy(sortedItems.begin(), sortedItems.end(), items.begin() + task.begin);
+                std::copy(sortedCenters.begin(), sortedCenters.end(), centers.begin() + task.begin);
+                for (uint32_t i = task.begin; i < task.end; i++) {
+                    grow(i < middle ? leftBox : rightBox, items[i].bounds.min, items[i].bounds.max);
+                }
+            }
+
+            uint32_t children = static_cast<uint32_t>(nodes.size());
+            nodes[task.node].first = children;
+            nodes[task.node].count = 0;
+            nodes.push_back({});
+            nodes.push_back({});
+            parents.push_back(task.node);
+            parents.push_back(task.node);
+            tasks.push_back({ children, task.begin, middle, task.depth + 1, leftBox });
+            tasks.push_back({ children + 1, middle, task.end, task.depth + 1, rightBox });
+        }
+    }
+
+    void LveBvh::queryFrustum(const Frustum& frustum, std::vector<id_t>& results) const {
+        uint32_t stack[MAX_STACK];
+        uint32_t stackSize = 0;
+        if (!nodes.empty()) stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            Containment containment = classify(frustum, node.min, node.max);
+            if (containment == Containment::Outside) continue;
+
+            if (node.count == 0) {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Item& item = items[i];
+                if (!item.alive) continue;
+                // Leaves inside the frustum have every box inside as well
+                if (containment == Containment::Inside ||
+                    classify(frustum, item.bounds.min, item.bounds.max) != Containment::Outside) {
+                    results.push_back(item.id);
+                }
+            }
+        }
+
+        for (const Item& item : pendingItems) {
+            if (classify(frustum, item.bounds.min, item.bounds.max) != Containment::Outside) {
+                results.push_back(item.id);
+            }
+        }
+    }
+
+    void LveBvh::queryOverlap(const BoundingBox& bounds, std::vector<id_t>& results) const {
+        uint32_t stack[MAX_STACK];
+        uint32_t stackSize = 0;
+        if (!nodes.empty()) stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (!overlaps(node.min, node.max, bounds)) continue;
+
+            if (node.count == 0) {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Item& item = items[i];
+                if (item.alive && overlaps(item.bounds.min, item.bounds.max, bounds)) {
+                    results.push_back(item.id);
+                }
+            }
+        }
+
+        for (const Item& item : pendingItems) {
+            if (overlaps(item.bounds.min, item.bounds.max, bounds)) {
+                results.push_back(item.id);
+            }
+        }
+    }
+
+    void LveBvh::queryRay(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        std::vector<id_t>& results) const {
+        Ray ray{ origin, direction, maxDistance };
+        uint32_t stack[MAX_STACK];
+        uint32_t stackSize = 0;
+        if (!nodes.empty()) stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (ray.intersect(node.min, node.max) == FLT_MAX) continue;
+
+            if (node.count == 0) {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Item& item = items[i];
+                if (item.alive && ray.intersect(item.bounds.min, item.bounds.max) != FLT_MAX) {
+                    results.push_back(item.id);
+                }
+            }
+        }
+
+        for (const Item& item : pendingItems) {
+            if (ray.intersect(item.bounds.min, item.bounds.max) != FLT_MAX) {
+                results.push_back(item.id);
+            }
+        }
+    }
+
+    bool LveBvh::raycast(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        RayHit& hit,
+        const RayIntersector& intersect) const {
+        Ray ray{ origin, direction, maxDistance };
+        bool found = false;
+        auto testItem = [&](const Item& item) {
+            float boxDistance = ray.intersect(item.bounds.min, item.bounds.max);
+            if (boxDistance == FLT_MAX) return;
+            float distance = intersect ? intersect(item.id, boxDistance) : boxDistance;
+            if (distance >= 0.f && distance <= ray.maxDistance) {
+                // Later boxes only need testing up to this hit
+                ray.maxDistance = distance;
+                hit = { item.id, distance };
+                found = true;
+            }
+        };
+
+        // Pending objects first, so the tree walk can prune against them
+        for (const Item& item : pendingItems) {
+            testItem(item);
+        }
+
+        struct Entry {
+            uint32_t node;
+            float distance;
+        };
+        Entry stack[MAX_STACK];
+        uint32_t stackSize = 0;
+        if (!nodes.empty()) {
+            float distance = ray.intersect(nodes[0].min, nodes[0].max);
+            if (distance != FLT_MAX) stack[stackSize++] = { 0, distance };
+        }
+
+        while (stackSize > 0) {
+            Entry entry = stack[--stackSize];
+            if (entry.distance > ray.maxDistance) continue;
+            const Node& node = nodes[entry.node];
+
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (items[i].alive) {
+                        testItem(items[i]);
+                    }
+                }
+                continue;
+            }
+
+            // Push the far child first so the near one is visited next
+            Entry near{ node.first, ray.intersect(nodes[node.first].min, nodes[node.first].max) };
+            Entry far{ node.first + 1, ray.intersect(nodes[node.first + 1].min, nodes[node.first + 1].max) };
+            if (far.distance < near.distance) std::swap(near, far);
+            if (far.distance != FLT_MAX) stack[stackSize++] = far;
+            if (near.distance != FLT_MAX) stack[stackSize++] = near;
+        }
+        return found;
+    }
+
+    LveBvh::Stats LveBvh::getStats() const {
+        Stats stats{};
+        stats.objects = static_cast<uint32_t>(locations.size());
+        stats.nodes = static_cast<uint32_t>(nodes.size());
+        stats.pendingInserts = static_cast<uint32_t>(pendingItems.size());
+        stats.pendingRemovals = removedCount;
+        stats.rebuilds = rebuildCount;
+        stats.costRatio = builtCost > 0.f ? currentCost / builtCost : 1.f;
+        return stats;
+    }
+
+    void LveBvh::printStats(std::ostream& out) const {
+        Stats stats = getStats();
+        out << "Spatial index: " << stats.objects << " objects, " << stats.nodes << " nodes, "
+            << stats.pendingInserts << " pending inserts, " << stats.pendingRemovals << " pending removals, "
+            << stats.rebuilds << " rebuilds, cost " << stats.costRatio << "x of built" << std::endl;
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "lve_game_object.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Spatial index over game objects, keyed by id, holding world space AABBs.
+    //
+    // The tree is built top down with binned SAH. Objects that move have
+    // their boxes changed in place and the nodes above them refit, which
+    // keeps queries correct but lets the tree loosen. Inserted objects wait in
+    // a short flat list that every query tests. commit, or the list filling
+    // up, moves each into the tree as a new leaf beside the leaf it grows
+    // least. Removed objects are skipped until the next build. commit applies
+    // the pending changes and rebuilds once refits, inserts or removals have
+    // cost too much.
+    class LveBvh {
+    public:
+        using BoundingBox = LveModel::BoundingBox;
+        using id_t = LveGameObject::id_t;
+
+        // Planes point inwards, xyz is the normal and w the distance
+        struct Frustum {
+            glm::vec4 planes[6];
+
+            // From a zero to one depth projection, as LveCamera builds
+            static Frustum fromViewProjection(const glm::mat4& viewProjection);
+        };
+
+        struct RayHit {
+            id_t id;
+            float distance;
+        };
+
+        // Refines a box hit into the object's own hit distance, e.g. against
+        // its triangles. Returns a negative distance for a miss.
+        using RayIntersector = std::function<float(id_t id, float boxDistance)>;
+
+        struct Stats {
+            uint32_t objects;
+            uint32_t nodes;
+            uint32_t pendingInserts;
+            uint32_t pendingRemovals;
+            uint32_t rebuilds;
+            // SAH cost of the current tree relative to when it was built
+            float costRatio;
+        };
+
+        // Model bounds through the object's transform. Objects without a
+        // model get an empty box at their translation.
+        static BoundingBox computeWorldBounds(LveGameObject& gameObject);
+
+        LveBvh() = default;
+
+        LveBvh(const LveBvh&) = delete;
+        LveBvh& operator=(const LveBvh&) = delete;
+
+        void insert(id_t id, const BoundingBox& bounds);
+        void insert(LveGameObject& gameObject) { insert(gameObject.getId(), computeWorldBounds(gameObject)); }
+        // Changes the box of an object that moved, applied by the next commit
+        void update(id_t id, const BoundingBox& bounds);
+        void remove(id_t id);
+        bool contains(id_t id) const { return locations.count(id) > 0; }
+        void clear();
+
+        // Refits the nodes above moved objects, then rebuilds if the tree has
+        // degraded. Call once per frame after the changes, before querying.
+        void commit();
+        // Builds the tree over every live object from scratch
+        void rebuild();
+
+        // Append the ids of objects whose boxes intersect. Results are in no
+        // particular order.
+        void queryFrustum(const Frustum& frustum, std::vector<id_t>& results) const;
+        void queryOverlap(const BoundingBox& bounds, std::vector<id_t>& results) const;
+        void queryRay(
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            float maxDistance,
+            std::vector<id_t>& results) const;
+        // Nearest hit along the ray, visiting nodes front to back so the
+        // intersector is only called for boxes closer than the best hit so
+        // far. Without an intersector the box entry distance is the hit.
+        bool raycast(
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            float maxDistance,
+            RayHit& hit,
+            const RayIntersector& intersect = nullptr) const;
+
+        Stats getStats() const;
+        void printStats(std::ostream& out) const;
+
+    private:
+        static constexpr uint32_t INVALID = ~0u;
+        static constexpr uint32_t PENDING = 1u << 31;
+        static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+        // Leaves have count > 0 and hold items [first, first + count). Inner
+        // nodes have count == 0 and their children at first and first + 1.
+        struct Node {
+            glm::vec3 min;
+            uint32_t first;
+            glm::vec3 max;
+            uint32_t count;
+        };
+
+        struct Item {
+            BoundingBox bounds;
+            id_t id;
+            // Removed items stay in their leaf until the next build
+            uint32_t alive;
+        };
+
+        void buildNodes(std::vector<glm::vec3>& centers);
+        // Pairs each pending item with the leaf it grows least and refits
+        // above, rebuilding instead if the tree would get too deep
+        void insertPending();
+        void refitNode(uint32_t node);
+        void refitAll();
+        float computeCost() const;
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> parents;
+        // In leaf order, leaves reference ranges of this
+        std::vector<Item> items;
+        std::vector<uint32_t> itemLeaves;
+        std::vector<Item> pendingItems;
+        // Index into items, or PENDING | index into pendingItems
+        std::unordered_map<id_t, uint32_t> locations;
+
+        std::vector<uint32_t> movedItems;
+        uint32_t removedCount = 0;
+        // Moved from pending into the tree since the last build
+        uint32_t insertedCount = 0;
+        uint32_t rebuildCount = 0;
+        float builtCost = 0.f;
+        float currentCost = 0.f;
+    };
+}
@@ -16,6 +16,8 @@ namespace lve {
         projectionMatrix[3][0] = -(right + left) / (right - left);
         projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
         projectionMatrix[3][2] = -near / (far - near);
+        nearPlane = near;
+        farPlane = far;
     }
 
     void LveCamera::setPerspectiveProjection(
@@ -37,6 +39,8 @@ namespace lve {
         projectionMatrix[2][2] = far / (far - near);
         projectionMatrix[2][3] = 1.f;
         projectionMatrix[3][2] = -(far * near) / (far - near);
+        nearPlane = near;
+        farPlane = far;
     }
 
     void LveCamera::setViewDirection(glm::vec3 position, glm::vec3 direction,
@@ -97,4 +101,24 @@ namespace lve {
         viewMatrix[3][1] = -glm::dot(v, position);
         viewMatrix[3][2] = -glm::dot(w, position);
     }
+
+    void LveCamera::getRay(glm::vec2 ndc, glm::vec3& origin, glm::vec3& direction) const {
+        // The rows of the view rotation are the camera axes in world space
+        const glm::vec3 u{ viewMatrix[0][0], viewMatrix[1][0], viewMatrix[2][0] };
+        const glm::vec3 v{ viewMatrix[0][1], viewMatrix[1][1], viewMatrix[2][1] };
+        const glm::vec3 w{ viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2] };
+        const glm::vec3 position = -(u * viewMatrix[3][0] + v * viewMatrix[3][1] + w * viewMatrix[3][2]);
+
+        // Undo the projection's x and y scale and offset
+        const float x = (ndc.x - projectionMatrix[3][0]) / projectionMatrix[0][0];
+        const float y = (ndc.y - projectionMatrix[3][1]) / projectionMatrix[1][1];
+        if (projectionMatrix[2][3] != 0.f) {
+            // Perspective, x and y are per unit of view depth
+            origin = position;
+            direction = glm::normalize(u * x + v * y + w);
+        } else {
+            origin = position + u * x + v * y + w * nearPlane;
+            direction = w;
+        }
+    }
 }
\ No newline at end of file
@@ -26,12 +26,20 @@ namespace lve {
 
 			void setViewYXZ(glm::vec3 position, glm::vec3 rotation);
 
+			// World space ray through a point in normalized device coordinates,
+			// -1 to 1 with y down as on screen. The direction is normalized.
+			void getRay(glm::vec2 ndc, glm::vec3& origin, glm::vec3& direction) const;
+
 			const glm::mat4& getProjection() const { return projectionMatrix; }
 			const glm::mat4& getView() const { return viewMatrix; }
+			float getNear() const { return nearPlane; }
+			float getFar() const { return farPlane; }
 
 		private:
 
 			glm::mat4 projectionMatrix{ 1.f };
 			glm::mat4 viewMatrix{ 1.f };
+			float nearPlane{ 0.1f };
+			float farPlane{ 1000.f };
 	};
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include "lve_descriptors.hpp"
 
+#include "lve_layout_cache.hpp"
+#include "lve_profiler.hpp"
+#include "lve_swap_chain.hpp"
+
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 namespace lve {
@@ -24,37 +30,38 @@ namespace lve {
     }
 
 
+    LveDescriptorSetLayout::Builder& LveDescriptorSetLayout::Builder::setBindingFlags(
+        uint32_t binding, VkDescriptorBindingFlagsEXT flags) {
+        assert(bindings.count(binding) == 1 && "Binding has not been added");
+        bindingFlags[binding] = flags;
+        return *this;
+    }
+
     std::unique_ptr<LveDescriptorSetLayout> LveDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<LveDescriptorSetLayout>(lveDevice, bindings);
+        return std::make_unique<LveDescriptorSetLayout>(lveDevice, bindings, bindingFlags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     LveDescriptorSetLayout::LveDescriptorSetLayout(
-        LveDevice& lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+        LveDevice& lveDevice,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT>& bindingFlags)
         : lveDevice{ lveDevice }, bindings{ bindings } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlagsEXT> setLayoutBindingFlags{};
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
-        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
-        descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-        descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
-
-        if (vkCreateDescriptorSetLayout(
-            lveDevice.device(),
-            &descriptorSetLayoutInfo,
-            nullptr,
-            &descriptorSetLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create descriptor set layout!");
-        }
+        // Shared with every identical layout, owned by the device's layout cache
+        descriptorSetLayout = lveDevice.layoutCache().getDescriptorSetLayout(
+            setLayoutBindings, setLayoutBindingFlags);
     }
 
-    LveDescriptorSetLayout::~LveDescriptorSetLayout() {
-        vkDestroyDescriptorSetLayout(lveDevice.device(), descriptorSetLayout, nullptr);
-    }
+    LveDescriptorSetLayout::~LveDescriptorSetLayout() {}
 
     // *************** Descriptor Pool Builder *********************
 
@@ -130,10 +137,136 @@ namespace lve {
         vkResetDescriptorPool(lveDevice.device(), descriptorPool, 0);
     }
 
+    // *************** Descriptor Allocator Builder *********************
+
+    LveDescriptorAllocator::Builder& LveDescriptorAllocator::Builder::addPoolSize(
+        VkDescriptorType descriptorType, float countPerSet) {
+        poolRatios.push_back({ descriptorType, countPerSet });
+        return *this;
+    }
+
+    LveDescriptorAllocator::Builder& LveDescriptorAllocator::Builder::setSetsPerPool(uint32_t count) {
+        setsPerPool = count;
+        return *this;
+    }
+
+    LveDescriptorAllocator::Builder& LveDescriptorAllocator::Builder::setFrameCount(uint32_t count) {
+        frameCount = count;
+        return *this;
+    }
+
+    std::unique_ptr<LveDescriptorAllocator> LveDescriptorAllocator::Builder::build() const {
+        uint32_t frames = frameCount != 0 ? frameCount : LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+        return std::make_unique<LveDescriptorAllocator>(lveDevice, frames, setsPerPool, poolRatios);
+    }
+
+    // *************** Descriptor Allocator *********************
+
+    LveDescriptorAllocator::LveDescriptorAllocator(
+        LveDevice& lveDevice,
+        uint32_t frameCount,
+        uint32_t setsPerPool,
+        const std::vector<std::pair<VkDescriptorType, float>>& poolRatios)
+        : lveDevice{ lveDevice }, poolRatios{ poolRatios }, setsPerPool{ setsPerPool } {
+        frames.resize(frameCount);
+        for (auto& frame : frames) {
+            frame.pools.push_back(createPool(setsPerPool));
+        }
+    }
+
+    LveDescriptorAllocator::~LveDescriptorAllocator() {
+        for (auto& frame : frames) {
+            for (auto pool : frame.pools) {
+                vkDestroyDescriptorPool(lveDevice.device(), pool, nullptr);
+            }
+        }
+    }
+
+    VkDescriptorPool LveDescriptorAllocator::createPool(uint32_t maxSets) {
+        std::vector<VkDescriptorPoolSize> poolSizes{};
+        for (auto& ratio : poolRatios) {
+            uint32_t count = static_cast<uint32_t>(std::ceil(ratio.second * maxSets));
+            poolSizes.push_back({ ratio.first, std::max(count, 1u) });
+        }
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolInfo.pPoolSizes = poolSizes.data();
+        descriptorPoolInfo.maxSets = maxSets;
+        descriptorPoolInfo.flags = 0;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(lveDevice.device(), &descriptorPoolInfo, nullptr, &pool) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        LveProfiler::addCounter("descriptors.poolsCreated", 1);
+        return pool;
+    }
+
+    void LveDescriptorAllocator::beginFrame(int frameIndex) {
+        this->frameIndex = frameIndex;
+        auto& frame = frames[frameIndex];
+        for (auto pool : frame.pools) {
+            vkResetDescriptorPool(lveDevice.device(), pool, 0);
+        }
+        frame.current = 0;
+
+        LveProfiler::setGauge("descriptors.allocated", allocationCount);
+        LveProfiler::setGauge("descriptors.pools", getPoolCount());
+        allocationCount = 0;
+    }
+
+    bool LveDescriptorAllocator::allocateDescriptor(
+        const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) {
+        auto& frame = frames[frameIndex];
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+        allocInfo.descriptorSetCount = 1;
+
+        bool freshPool = false;
+        while (true) {
+            allocInfo.descriptorPool = frame.pools[frame.current];
+            VkResult result = vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptor);
+            if (result == VK_SUCCESS) {
+                allocationCount++;
+                return true;
+            }
+            // A set that doesn't fit into a new pool never will
+            if (freshPool ||
+                (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+                return false;
+            }
+
+            frame.current++;
+            if (frame.current == frame.pools.size()) {
+                uint32_t maxSets = std::min(
+                    setsPerPool << std::min<size_t>(frame.pools.size(), 6), MAX_SETS_PER_POOL);
+                frame.pools.push_back(createPool(maxSets));
+                freshPool = true;
+            }
+        }
+    }
+
+    uint32_t LveDescriptorAllocator::getPoolCount() const {
+        size_t count = 0;
+        for (auto& frame : frames) {
+            count += frame.pools.size();
+        }
+        return static_cast<uint32_t>(count);
+    }
+
     // *************** Descriptor Writer *********************
 
     LveDescriptorWriter::LveDescriptorWriter(LveDescriptorSetLayout& setLayout, LveDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+        : setLayout{ setLayout }, pool{ &pool } {}
+
+    LveDescriptorWriter::LveDescriptorWriter(
+        LveDescriptorSetLayout& setLayout, LveDescriptorAllocator& allocator)
+        : setLayout{ setLayout }, allocator{ &allocator } {}
 
     LveDescriptorWriter& LveDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -177,8 +310,32 @@ namespace lve {
         return *this;
     }
 
+    LveDescriptorWriter& LveDescriptorWriter::writeImage(
+        uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement) {
+        assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+        auto& bindingDescription = setLayout.bindings[binding];
+
+        assert(
+            arrayElement < bindingDescription.descriptorCount &&
+            "Array element out of range of the binding");
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorType = bindingDescription.descriptorType;
+        write.dstBinding = binding;
+        write.dstArrayElement = arrayElement;
+        write.pImageInfo = imageInfo;
+        write.descriptorCount = 1;
+
+        writes.push_back(write);
+        return *this;
+    }
+
     bool LveDescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
+        bool success = pool != nullptr
+            ? pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)
+            : allocator->allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
         if (!success) {
             return false;
         }
@@ -190,7 +347,7 @@ namespace lve {
         for (auto& write : writes) {
             write.dstSet = set;
         }
-        vkUpdateDescriptorSets(pool.lveDevice.device(), writes.size(), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(setLayout.lveDevice.device(), writes.size(), writes.data(), 0, nullptr);
     }
 
 }
\ No newline at end of file
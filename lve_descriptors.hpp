@@ -20,15 +20,20 @@ namespace lve {
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
                 uint32_t count = 1);
+            // E.g. partially bound or update-after-bind, for descriptor arrays
+            Builder& setBindingFlags(uint32_t binding, VkDescriptorBindingFlagsEXT flags);
             std::unique_ptr<LveDescriptorSetLayout> build() const;
 
         private:
             LveDevice& lveDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags{};
         };
 
         LveDescriptorSetLayout(
-            LveDevice& lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            LveDevice& lveDevice,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT>& bindingFlags = {});
         ~LveDescriptorSetLayout();
         LveDescriptorSetLayout(const LveDescriptorSetLayout&) = delete;
         LveDescriptorSetLayout& operator=(const LveDescriptorSetLayout&) = delete;
@@ -85,19 +90,85 @@ namespace lve {
         friend class LveDescriptorWriter;
     };
 
+    // Linear allocator for descriptor sets that only live for one frame. Each
+    // frame in flight has its own list of pools; when the current one runs
+    // out another is added, with twice as many sets up to a cap. Sets are
+    // never freed one by one: beginFrame resets all pools of that frame.
+    class LveDescriptorAllocator {
+    public:
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        class Builder {
+        public:
+            Builder(LveDevice& lveDevice) : lveDevice{ lveDevice } {}
+
+            // Descriptors of this type reserved per set in each pool
+            Builder& addPoolSize(VkDescriptorType descriptorType, float countPerSet);
+            Builder& setSetsPerPool(uint32_t count);
+            Builder& setFrameCount(uint32_t count);
+            std::unique_ptr<LveDescriptorAllocator> build() const;
+
+        private:
+            LveDevice& lveDevice;
+            std::vector<std::pair<VkDescriptorType, float>> poolRatios{};
+            uint32_t setsPerPool = 64;
+            uint32_t frameCount = 0;
+        };
+
+        LveDescriptorAllocator(
+            LveDevice& lveDevice,
+            uint32_t frameCount,
+            uint32_t setsPerPool,
+            const std::vector<std::pair<VkDescriptorType, float>>& poolRatios);
+        ~LveDescriptorAllocator();
+        LveDescriptorAllocator(const LveDescriptorAllocator&) = delete;
+        LveDescriptorAllocator& operator=(const LveDescriptorAllocator&) = delete;
+
+        // Resets the pools of this frame slot, once its fence has been waited on
+        void beginFrame(int frameIndex);
+
+        bool allocateDescriptor(
+            const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor);
+
+        uint32_t getPoolCount() const;
+        // Sets allocated since the last beginFrame
+        uint32_t getAllocationCount() const { return allocationCount; }
+
+    private:
+        struct FramePools {
+            std::vector<VkDescriptorPool> pools{};
+            size_t current = 0;
+        };
+
+        VkDescriptorPool createPool(uint32_t maxSets);
+
+        LveDevice& lveDevice;
+        std::vector<std::pair<VkDescriptorType, float>> poolRatios;
+        uint32_t setsPerPool;
+        std::vector<FramePools> frames;
+        int frameIndex = 0;
+        uint32_t allocationCount = 0;
+    };
+
     class LveDescriptorWriter {
     public:
         LveDescriptorWriter(LveDescriptorSetLayout& setLayout, LveDescriptorPool& pool);
+        LveDescriptorWriter(LveDescriptorSetLayout& setLayout, LveDescriptorAllocator& allocator);
 
         LveDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         LveDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+        // Writes one element of a descriptor array
+        LveDescriptorWriter& writeImage(
+            uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement);
 
         bool build(VkDescriptorSet& set);
         void overwrite(VkDescriptorSet& set);
 
     private:
         LveDescriptorSetLayout& setLayout;
-        LveDescriptorPool& pool;
+        // Exactly one of these is set
+        LveDescriptorPool* pool = nullptr;
+        LveDescriptorAllocator* allocator = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
     };
 
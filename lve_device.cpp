@@ -1,6 +1,11 @@
 #include "lve_device.hpp"
 
+#include "lve_layout_cache.hpp"
+#include "lve_pipeline_cache.hpp"
+#include "lve_shader_module_cache.hpp"
+
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -56,10 +61,16 @@ namespace lve {
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        shaderModuleCache_ = std::make_unique<LveShaderModuleCache>(device_);
+        pipelineCache_ = std::make_unique<LvePipelineCache>(device_, properties);
+        layoutCache_ = std::make_unique<LveLayoutCache>(device_);
         createCommandPool();
     }
 
     LveDevice::~LveDevice() {
+        pipelineCache_.reset();
+        shaderModuleCache_.reset();
+        layoutCache_.reset();
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -93,6 +104,11 @@ namespace lve {
         createInfo.pApplicationInfo = &appInfo;
 
         auto extensions = getRequiredExtensions();
+        // Needed to query descriptor indexing and dynamic rendering on a 1.0 instance
+        if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            hasPhysicalDeviceProperties2 = true;
+        }
         createInfo.enabledExtensionCount =
             static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames =
@@ -147,6 +163,26 @@ namespace lve {
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+
+        auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceProperties2KHR");
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties{};
+        descriptorIndexingProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties2.pNext = &descriptorIndexingProperties;
+        getProperties2(physicalDevice, &properties2);
+        maxBindlessSampledImages_ = std::min(
+            descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+
+        dynamicRenderingEnabled_ = checkDynamicRenderingSupport(physicalDevice);
+        std::cout << "Dynamic rendering: "
+            << (dynamicRenderingEnabled_ ? "enabled" : "disabled") << std::endl;
+
+        memoryBudgetEnabled_ = isDeviceExtensionAvailable(
+            physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
     }
 
     void LveDevice::createLogicalDevice() {
@@ -169,6 +205,13 @@ namespace lve {
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+        // Block compressed texture formats, whichever families the device has
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+        deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -177,9 +220,36 @@ namespace lve {
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
+
+        // What the bindless texture array needs, checked in isDeviceSuitable
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+        descriptorIndexingFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        createInfo.pNext = &descriptorIndexingFeatures;
+
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        if (dynamicRenderingEnabled_) {
+            enabledExtensions.insert(
+                enabledExtensions.end(),
+                dynamicRenderingExtensions.begin(),
+                dynamicRenderingExtensions.end());
+            descriptorIndexingFeatures.pNext = &dynamicRenderingFeatures;
+        }
+        if (memoryBudgetEnabled_) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
         createInfo.enabledExtensionCount =
-            static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+            static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // Might not really be necessary anymore because device specific validation layers have been deprecated
         if (enableValidationLayers) {
@@ -201,6 +271,16 @@ namespace lve {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+        if (dynamicRenderingEnabled_) {
+            vkCmdBeginRenderingKHR_ = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(
+                device_, "vkCmdBeginRenderingKHR");
+            vkCmdEndRenderingKHR_ = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(
+                device_, "vkCmdEndRenderingKHR");
+            if (vkCmdBeginRenderingKHR_ == nullptr || vkCmdEndRenderingKHR_ == nullptr) {
+                throw std::runtime_error("Failed to load dynamic rendering functions!");
+            }
+        }
     }
 
     // Command pools are opaque objects that command buffer memory is allocated
@@ -249,7 +329,8 @@ namespace lve {
         return indices.isComplete() &&
             extensionsSupported &&
             swapChainAdequate &&
-            supportedFeatures.samplerAnisotropy;
+            supportedFeatures.samplerAnisotropy &&
+            checkDescriptorIndexingSupport(device);
     }
 
     void LveDevice::populateDebugMessengerCreateInfo(
@@ -381,6 +462,126 @@ namespace lve {
         return requiredExtensions.empty();
     }
 
+    bool LveDevice::checkDynamicRenderingSupport(VkPhysicalDevice device) {
+        if (!preferDynamicRendering || !hasPhysicalDeviceProperties2) {
+            return false;
+        }
+
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+            device, nullptr, &extensionCount, availableExtensions.data());
+
+        std::set<std::string> requiredExtensions(
+            dynamicRenderingExtensions.begin(), dynamicRenderingExtensions.end());
+        for (const auto& extension : availableExtensions) {
+            requiredExtensions.erase(extension.extensionName);
+        }
+        if (!requiredExtensions.empty()) {
+            return false;
+        }
+
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (getFeatures2 == nullptr) {
+            return false;
+        }
+
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &dynamicRenderingFeatures;
+        getFeatures2(device, &features2);
+
+        return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    }
+
+    bool LveDevice::checkDescriptorIndexingSupport(VkPhysicalDevice device) {
+        if (!hasPhysicalDeviceProperties2) {
+            return false;
+        }
+
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (getFeatures2 == nullptr) {
+            return false;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+        descriptorIndexingFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &descriptorIndexingFeatures;
+        getFeatures2(device, &features2);
+
+        return descriptorIndexingFeatures.runtimeDescriptorArray &&
+            descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+            descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+            descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+    }
+
+    bool LveDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+        for (const auto& extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool LveDevice::queryDeviceLocalBudget(VkDeviceSize& budget, VkDeviceSize& usage) {
+        if (!memoryBudgetEnabled_) {
+            return false;
+        }
+
+        auto getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        if (getMemoryProperties2 == nullptr) {
+            return false;
+        }
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2KHR memoryProperties2{};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+        memoryProperties2.pNext = &budgetProperties;
+        getMemoryProperties2(physicalDevice, &memoryProperties2);
+
+        budget = 0;
+        usage = 0;
+        const auto& memoryProperties = memoryProperties2.memoryProperties;
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                budget += budgetProperties.heapBudget[i];
+                usage += budgetProperties.heapUsage[i];
+            }
+        }
+        return true;
+    }
+
+    bool LveDevice::isInstanceExtensionAvailable(const char* extensionName) {
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+        for (const auto& extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -490,6 +691,21 @@ namespace lve {
         throw std::runtime_error("Failed to find suitable memory type!");
     }
 
+    bool LveDevice::findMemoryTypeIndex(
+        uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                typeIndex = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
     void LveDevice::createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
@@ -572,16 +788,25 @@ namespace lve {
 
     void LveDevice::copyBufferToImage(
         VkBuffer buffer, VkImage image, uint32_t width,
-        uint32_t height, uint32_t layerCount) {
+        uint32_t height, uint32_t layerCount,
+        uint32_t mipLevel, VkDeviceSize bufferOffset) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        recordCopyBufferToImage(
+            commandBuffer, buffer, image, width, height, layerCount, mipLevel, bufferOffset);
+        endSingleTimeCommands(commandBuffer);
+    }
 
+    void LveDevice::recordCopyBufferToImage(
+        VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image,
+        uint32_t width, uint32_t height, uint32_t layerCount,
+        uint32_t mipLevel, VkDeviceSize bufferOffset) {
         VkBufferImageCopy region{};
-        region.bufferOffset = 0;
+        region.bufferOffset = bufferOffset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
 
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.mipLevel = mipLevel;
         region.imageSubresource.baseArrayLayer = 0;
         region.imageSubresource.layerCount = layerCount;
 
@@ -595,7 +820,12 @@ namespace lve {
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             1,
             &region);
-        endSingleTimeCommands(commandBuffer);
+    }
+
+    bool LveDevice::isFormatSupported(VkFormat format, VkFormatFeatureFlags features) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        return (props.optimalTilingFeatures & features) == features;
     }
 
     void LveDevice::createImageWithInfo(
@@ -611,11 +841,47 @@ namespace lve {
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
+        allocateImageMemory(
+            image,
+            findMemoryType(memRequirements.memoryTypeBits, properties),
+            memRequirements.size,
+            imageMemory);
+    }
+
+    VkMemoryPropertyFlags LveDevice::createImageWithInfo(
+        const VkImageCreateInfo& imageInfo,
+        VkMemoryPropertyFlags preferredProperties,
+        VkMemoryPropertyFlags fallbackProperties,
+        VkImage& image,
+        VkDeviceMemory& imageMemory) {
+        if (vkCreateImage(device_, &imageInfo, nullptr, &image) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device_, image, &memRequirements);
+
+        VkMemoryPropertyFlags properties = preferredProperties;
+        uint32_t memoryTypeIndex;
+        if (!findMemoryTypeIndex(memRequirements.memoryTypeBits, properties, memoryTypeIndex)) {
+            properties = fallbackProperties;
+            memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        }
+
+        allocateImageMemory(image, memoryTypeIndex, memRequirements.size, imageMemory);
+        return properties;
+    }
+
+    void LveDevice::allocateImageMemory(
+        VkImage image,
+        uint32_t memoryTypeIndex,
+        VkDeviceSize size,
+        VkDeviceMemory& imageMemory) {
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex =
-            findMemoryType(memRequirements.memoryTypeBits, properties);
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
 
         if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) !=
             VK_SUCCESS) {
@@ -3,11 +3,16 @@
 #include "lve_window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+    class LveLayoutCache;
+    class LvePipelineCache;
+    class LveShaderModuleCache;
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
@@ -30,6 +35,11 @@ namespace lve {
 #else
         const bool enableValidationLayers = true;
 #endif
+#ifdef LVE_NO_DYNAMIC_RENDERING
+        const bool preferDynamicRendering = false;
+#else
+        const bool preferDynamicRendering = true;
+#endif
 
         LveDevice(LveWindow& window);
         ~LveDevice();
@@ -45,6 +55,25 @@ namespace lve {
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        LveShaderModuleCache& shaderModuleCache() { return *shaderModuleCache_; }
+        LvePipelineCache& pipelineCache() { return *pipelineCache_; }
+        LveLayoutCache& layoutCache() { return *layoutCache_; }
+
+        // Size limit of an update-after-bind sampled image array, per stage and set
+        uint32_t maxBindlessSampledImages() const { return maxBindlessSampledImages_; }
+
+        // Sums the budget and current usage of the device local heaps, as
+        // reported by VK_EXT_memory_budget. False when it isn't available.
+        bool memoryBudgetEnabled() const { return memoryBudgetEnabled_; }
+        bool queryDeviceLocalBudget(VkDeviceSize& budget, VkDeviceSize& usage);
+
+        // True when VK_KHR_dynamic_rendering is enabled, in which case the swap
+        // chain has no render pass and rendering begins directly on image views
+        bool dynamicRenderingEnabled() const { return dynamicRenderingEnabled_; }
+        void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* renderingInfo) {
+            vkCmdBeginRenderingKHR_(commandBuffer, renderingInfo); }
+        void cmdEndRendering(VkCommandBuffer commandBuffer) {
+            vkCmdEndRenderingKHR_(commandBuffer); }
 
         SwapChainSupportDetails getSwapChainSupport() {
             return querySwapChainSupport(physicalDevice); }
@@ -57,6 +86,8 @@ namespace lve {
             const std::vector<VkFormat>& candidates,
             VkImageTiling tiling,
             VkFormatFeatureFlags features);
+        // With optimal tiling
+        bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
         void createBuffer(
@@ -73,13 +104,27 @@ namespace lve {
             VkDeviceSize size);
         void copyBufferToImage(
             VkBuffer buffer, VkImage image, uint32_t width,
-            uint32_t height, uint32_t layerCount);
+            uint32_t height, uint32_t layerCount,
+            uint32_t mipLevel = 0, VkDeviceSize bufferOffset = 0);
+        // Same copy recorded into a command buffer, image in TRANSFER_DST_OPTIMAL
+        void recordCopyBufferToImage(
+            VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image,
+            uint32_t width, uint32_t height, uint32_t layerCount,
+            uint32_t mipLevel = 0, VkDeviceSize bufferOffset = 0);
 
         void createImageWithInfo(
             const VkImageCreateInfo& imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage& image,
             VkDeviceMemory& imageMemory);
+        // Uses fallbackProperties when no memory type the image supports has
+        // the preferred ones. Returns the properties that were used.
+        VkMemoryPropertyFlags createImageWithInfo(
+            const VkImageCreateInfo& imageInfo,
+            VkMemoryPropertyFlags preferredProperties,
+            VkMemoryPropertyFlags fallbackProperties,
+            VkImage& image,
+            VkDeviceMemory& imageMemory);
 
         VkPhysicalDeviceProperties properties;
 
@@ -100,7 +145,20 @@ namespace lve {
             VkDebugUtilsMessengerCreateInfoEXT& createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool checkDynamicRenderingSupport(VkPhysicalDevice device);
+        bool checkDescriptorIndexingSupport(VkPhysicalDevice device);
+        bool isInstanceExtensionAvailable(const char* extensionName);
+        bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+        bool findMemoryTypeIndex(
+            uint32_t typeFilter,
+            VkMemoryPropertyFlags properties,
+            uint32_t& typeIndex);
+        void allocateImageMemory(
+            VkImage image,
+            uint32_t memoryTypeIndex,
+            VkDeviceSize size,
+            VkDeviceMemory& imageMemory);
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
@@ -112,10 +170,31 @@ namespace lve {
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        std::unique_ptr<LveShaderModuleCache> shaderModuleCache_;
+        std::unique_ptr<LvePipelineCache> pipelineCache_;
+        std::unique_ptr<LveLayoutCache> layoutCache_;
+
+        bool hasPhysicalDeviceProperties2 = false;
+        bool dynamicRenderingEnabled_ = false;
+        uint32_t maxBindlessSampledImages_ = 0;
+        bool memoryBudgetEnabled_ = false;
+        PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR_ = nullptr;
+        PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR_ = nullptr;
 
         const std::vector<const char*> validationLayers = {
             "VK_LAYER_KHRONOS_validation" };
+        // Descriptor indexing backs the bindless material system and needs
+        // maintenance3 under Vulkan 1.0
         const std::vector<const char*> deviceExtensions = {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+            VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+            VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
+        // VK_KHR_dynamic_rendering and the extensions it depends on under Vulkan 1.0
+        const std::vector<const char*> dynamicRenderingExtensions = {
+            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+            VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+            VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+            VK_KHR_MULTIVIEW_EXTENSION_NAME,
+            VK_KHR_MAINTENANCE2_EXTENSION_NAME };
     };
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "lve_file_watcher.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+#ifdef __linux__
+
+    LveFileWatcher::LveFileWatcher(const std::string& directory) : directory{ directory } {
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0) {
+            throw std::runtime_error("failed to initialize inotify");
+        }
+
+        // Editors often save by writing a new file and renaming it over the old one
+        watchDescriptor = inotify_add_watch(
+            inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watchDescriptor < 0) {
+            close(inotifyFd);
+            throw std::runtime_error("failed to watch directory: " + directory);
+        }
+    }
+
+    LveFileWatcher::~LveFileWatcher() {
+        inotify_rm_watch(inotifyFd, watchDescriptor);
+        close(inotifyFd);
+    }
+
+    std::vector<std::string> LveFileWatcher::pollChanges() {
+        std::vector<std::string> changes;
+
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) break;
+
+            for (char* p = buffer; p < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                    std::string path = directory + "/" + event->name;
+                    if (std::find(changes.begin(), changes.end(), path) == changes.end()) {
+                        changes.push_back(std::move(path));
+                    }
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changes;
+    }
+
+#else
+
+    LveFileWatcher::LveFileWatcher(const std::string& directory) : directory{ directory } {
+        // Record the current state so the first poll only reports new writes
+        pollChanges();
+    }
+
+    LveFileWatcher::~LveFileWatcher() {}
+
+    std::vector<std::string> LveFileWatcher::pollChanges() {
+        std::vector<std::string> changes;
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator{ directory, error }) {
+            if (!entry.is_regular_file(error)) continue;
+
+            std::string path = directory + "/" + entry.path().filename().string();
+            auto writeTime = entry.last_write_time(error);
+            auto it = writeTimes.find(path);
+            if (it == writeTimes.end()) {
+                writeTimes.emplace(path, writeTime);
+            } else if (it->second != writeTime) {
+                it->second = writeTime;
+                changes.push_back(path);
+            }
+        }
+        return changes;
+    }
+
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// std
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Reports files in a directory that were written since the last poll.
+    // Uses inotify on Linux, where polling is a single non-blocking read.
+    // Elsewhere it compares modification times, which is slower but only
+    // meant for development builds.
+    class LveFileWatcher {
+    public:
+        LveFileWatcher(const std::string& directory);
+        ~LveFileWatcher();
+
+        LveFileWatcher(const LveFileWatcher&) = delete;
+        LveFileWatcher& operator=(const LveFileWatcher&) = delete;
+
+        // Paths of changed files, each reported once per poll
+        std::vector<std::string> pollChanges();
+
+        const std::string& getDirectory() const { return directory; }
+
+    private:
+        std::string directory;
+#ifdef __linux__
+        int inotifyFd = -1;
+        int watchDescriptor = -1;
+#else
+        std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+#endif
+    };
+}
@@ -6,8 +6,28 @@
 // lib
 #include <vulkan/vulkan.h>
 
+// std
+#include <unordered_set>
+#include <vector>
+
 
 namespace lve {
+	class LveDescriptorAllocator;
+
+	// Matches the PointLight struct read from the light storage buffer
+	struct PointLight {
+		glm::vec4 position{};  // w is range
+		glm::vec4 color{};     // w is intensity
+	};
+
+	struct GlobalUbo {
+		glm::mat4 projection{ 1.f };
+		glm::mat4 view{ 1.f };
+		glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f, 0.01f };  // w is intensity
+		glm::uvec4 clusterGrid{};   // xyz cluster counts, w light count
+		glm::vec4 clusterParams{};  // xy tile size in pixels, z slice scale, w slice bias
+	};
+
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
@@ -15,5 +35,29 @@ namespace lve {
 		LveCamera& camera;
 		VkDescriptorSet globalDescriptionSet;
 		LveGameObject::Map& gameObjects;
+		// Filled in by the occlusion cullers before any draws are recorded
+		std::unordered_set<LveGameObject::id_t>* occludedObjects = nullptr;
+		// Descriptor sets that are only used while recording this frame
+		LveDescriptorAllocator* descriptorAllocator = nullptr;
+		// Objects whose bounds intersect the view frustum, from the scene's
+		// spatial index. Without it every object is a candidate.
+		const std::vector<LveGameObject::id_t>* visibleObjects = nullptr;
+
+		// Calls visit(id, gameObject) for every object that may be on screen
+		template <typename F>
+		void forEachVisibleObject(F&& visit) {
+			if (visibleObjects == nullptr) {
+				for (auto& kv : gameObjects) {
+					visit(kv.first, kv.second);
+				}
+				return;
+			}
+			for (LveGameObject::id_t id : *visibleObjects) {
+				auto it = gameObjects.find(id);
+				if (it != gameObjects.end()) {
+					visit(id, it->second);
+				}
+			}
+		}
 	};
-}
\ No newline at end of file
+}
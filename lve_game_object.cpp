@@ -57,4 +57,16 @@ namespace lve {
             },
         };
     }
+
+    LveGameObject LveGameObject::makePointLight(
+        float intensity, float radius, glm::vec3 color) {
+        LveGameObject gameObj = LveGameObject::createGameObject();
+        gameObj.color = color;
+        gameObj.transform.scale.x = radius;
+        gameObj.pointLight = std::make_unique<PointLightComponent>();
+        gameObj.pointLight->lightIntensity = intensity;
+        // Range where intensity / d^2 drops below 1% of a unit light
+        gameObj.pointLight->range = 10.f * glm::sqrt(intensity);
+        return gameObj;
+    }
 }
\ No newline at end of file
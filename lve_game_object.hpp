@@ -8,6 +8,7 @@
 // std
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace lve {
 
@@ -37,6 +38,20 @@ namespace lve {
     };
     */
 
+    struct PointLightComponent {
+        float lightIntensity{ 1.0f };
+        // Distance at which the light's contribution is windowed to zero.
+        // Used to bin the light into view clusters, so keep it tight.
+        float range{ 10.f };
+    };
+
+    // Object space triangle list rasterized by the CPU occlusion culler.
+    // Usually a simplified stand-in for the render model, so it is shared.
+    struct OccluderComponent {
+        std::vector<glm::vec3> positions{};
+        std::vector<uint32_t> indices{};
+    };
+
     struct RigidBody2d {
         glm::vec2 velocity;
         float mass{ 1.0f };
@@ -56,6 +71,9 @@ namespace lve {
             return LveGameObject{ currentId++ };
         }
 
+        static LveGameObject makePointLight(
+            float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+
         LveGameObject(const LveGameObject&) = delete;
         LveGameObject& operator=(const LveGameObject&) = delete;
         LveGameObject(LveGameObject&&) = default;
@@ -65,9 +83,15 @@ namespace lve {
 
         std::shared_ptr<LveModel> model{};
         glm::vec3 color{};
+        // Index into the material system's materials, 0 is plain white
+        uint32_t materialIndex = 0;
         TransformComponent transform{};
         RigidBody2d rigidBody2d{};
 
+        // Optional pointer components
+        std::unique_ptr<PointLightComponent> pointLight = nullptr;
+        std::shared_ptr<OccluderComponent> occluder = nullptr;
+
     private:
         LveGameObject(id_t objId) : id{ objId } {}
 
@@ -0,0 +1,756 @@
+#include "lve_gltf.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// std
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        constexpr uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+        constexpr uint32_t GLB_VERSION = 2;
+        constexpr uint32_t CHUNK_JSON = 0x4E4F534A;
+        constexpr uint32_t CHUNK_BIN = 0x004E4942;
+
+        constexpr uint32_t COMPONENT_BYTE = 5120;
+        constexpr uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+        constexpr uint32_t COMPONENT_SHORT = 5122;
+        constexpr uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+        constexpr uint32_t COMPONENT_UNSIGNED_INT = 5125;
+        constexpr uint32_t COMPONENT_FLOAT = 5126;
+
+        constexpr uint32_t MODE_TRIANGLES = 4;
+
+        // Enough JSON for glTF: the whole document is parsed into a tree up
+        // front, it is small next to the BIN chunk
+        struct JsonValue {
+            enum class Type { Null, Bool, Number, String, Array, Object };
+
+            Type type = Type::Null;
+            bool boolean = false;
+            double number = 0.0;
+            std::string string;
+            // Array elements, or object values in the order of keys
+            std::vector<JsonValue> values;
+            std::vector<std::string> keys;
+
+            const JsonValue* find(const char* key) const {
+                for (size_t i = 0; i < keys.size(); i++) {
+                    if (keys[i] == key) return &values[i];
+                }
+                return nullptr;
+            }
+        };
+
+        class JsonParser {
+        public:
+            JsonParser(const char* begin, const char* end, const std::string& name)
+                : p{ begin }, end{ end }, name{ name } {}
+
+            JsonValue parseDocument() {
+                JsonValue value = parseValue(0);
+                skipSpaces();
+                if (p != end) error("trailing characters");
+                return value;
+            }
+
+        private:
+            static constexpr int MAX_DEPTH = 64;
+
+            [[noreturn]] void error(const char* message) const {
+                throw std::runtime_error(name + ": invalid glTF JSON: " + message);
+            }
+
+            void skipSpaces() {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+            }
+
+            void expect(char c) {
+                skipSpaces();
+                if (p >= end || *p != c) error("unexpected character");
+                p++;
+            }
+
+            bool consumeLiteral(const char* literal) {
+                size_t length = std::strlen(literal);
+                if (static_cast<size_t>(end - p) < length || std::memcmp(p, literal, length) != 0) {
+                    return false;
+                }
+                p += length;
+                return true;
+            }
+
+            JsonValue parseValue(int depth) {
+                if (depth > MAX_DEPTH) error("nested too deeply");
+                skipSpaces();
+                if (p >= end) error("unexpected end");
+
+                JsonValue value{};
+                if (*p == '{') {
+                    value.type = JsonValue::Type::Object;
+                    p++;
+                    skipSpaces();
+                    if (p < end && *p == '}') {
+                        p++;
+                        return value;
+                    }
+                    while (true) {
+                        skipSpaces();
+                        value.keys.push_back(parseString());
+                        expect(':');
+                        value.values.push_back(parseValue(depth + 1));
+                        skipSpaces();
+                        if (p >= end || *p != ',') break;
+                        p++;
+                    }
+                    expect('}');
+                } else if (*p == '[') {
+                    value.type = JsonValue::Type::Array;
+                    p++;
+                    skipSpaces();
+                    if (p < end && *p == ']') {
+                        p++;
+                        return value;
+                    }
+                    while (true) {
+                        value.values.push_back(parseValue(depth + 1));
+                        skipSpaces();
+                        if (p >= end || *p != ',') break;
+                        p++;
+                    }
+                    expect(']');
+                } else if (*p == '"') {
+                    value.type = JsonValue::Type::String;
+                    value.string = parseString();
+                } else if (consumeLiteral("true")) {
+                    value.type = JsonValue::Type::Bool;
+                    value.boolean = true;
+                } else if (consumeLiteral("false")) {
+                    value.type = JsonValue::Type::Bool;
+                } else if (consumeLiteral("null")) {
+                    value.type = JsonValue::Type::Null;
+                } else {
+                    value.type = JsonValue::Type::Number;
+                    // from_chars also accepts nan and inf, which JSON doesn't have
+                    auto result = std::from_chars(p, end, value.number);
+                    if (result.ec != std::errc{} || !std::isfinite(value.number)) error("invalid number");
+                    p = result.ptr;
+                }
+                return value;
+            }
+
+            uint32_t parseHexDigits() {
+                if (end - p < 4) error("invalid escape");
+                uint32_t codePoint = 0;
+                auto result = std::from_chars(p, p + 4, codePoint, 16);
+                if (result.ptr != p + 4) error("invalid escape");
+                p += 4;
+                return codePoint;
+            }
+
+            std::string parseString() {
+                if (p >= end || *p != '"') error("expected a string");
+                p++;
+                std::string result;
+                while (true) {
+                    const char* start = p;
+                    while (p < end && *p != '"' && *p != '\\') p++;
+                    result.append(start, p);
+                    if (p >= end) error("unterminated string");
+                    if (*p++ == '"') return result;
+
+                    if (p >= end) error("unterminated string");
+                    char escape = *p++;
+                    switch (escape) {
+                    case '"': result += '"'; break;
+                    case '\\': result += '\\'; break;
+                    case '/': result += '/'; break;
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'n': result += '\n'; break;
+                    case 'r': result += '\r'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': {
+                        uint32_t codePoint = parseHexDigits();
+                        if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - p >= 6 && p[0] == '\\' &&
+                            p[1] == 'u') {
+                            p += 2;
+                            uint32_t low = parseHexDigits();
+                            if (low < 0xDC00 || low > 0xDFFF) error("invalid surrogate pair");
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(result, codePoint);
+                        break;
+                    }
+                    default:
+                        error("invalid escape");
+                    }
+                }
+            }
+
+            static void appendUtf8(std::string& out, uint32_t codePoint) {
+                if (codePoint < 0x80) {
+                    out += static_cast<char>(codePoint);
+                } else if (codePoint < 0x800) {
+                    out += static_cast<char>(0xC0 | (codePoint >> 6));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                } else if (codePoint < 0x10000) {
+                    out += static_cast<char>(0xE0 | (codePoint >> 12));
+                    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | (codePoint >> 18));
+                    out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+            }
+
+            const char* p;
+            const char* end;
+            const std::string& name;
+        };
+
+        struct BufferView {
+            size_t byteOffset;
+            size_t byteLength;
+            uint32_t byteStride;
+        };
+
+        const std::vector<JsonValue>& arrayOf(const JsonValue& object, const char* key) {
+            static const std::vector<JsonValue> empty;
+            const JsonValue* value = object.find(key);
+            return value != nullptr && value->type == JsonValue::Type::Array ? value->values : empty;
+        }
+
+        // Indices and sizes; negative, fractional and huge values are errors
+        // rather than being wrapped
+        uint64_t integerOf(
+            const JsonValue& object,
+            const char* key,
+            uint64_t fallback,
+            const std::string& name) {
+            const JsonValue* value = object.find(key);
+            if (value == nullptr) {
+                return fallback;
+            }
+            double number = value->number;
+            if (value->type != JsonValue::Type::Number || !std::isfinite(number) ||
+                number < 0.0 || number > 9007199254740992.0 ||
+                number != static_cast<double>(static_cast<uint64_t>(number))) {
+                throw std::runtime_error(name + ": invalid glTF " + key);
+            }
+            return static_cast<uint64_t>(number);
+        }
+
+        int32_t optionalIndex(const JsonValue& object, const char* key, size_t count, const std::string& name) {
+            if (object.find(key) == nullptr) {
+                return -1;
+            }
+            uint64_t index = integerOf(object, key, 0, name);
+            if (index >= count) {
+                throw std::runtime_error(name + ": glTF " + key + " index out of range");
+            }
+            return static_cast<int32_t>(index);
+        }
+
+        uint32_t componentSize(uint32_t componentType) {
+            switch (componentType) {
+            case COMPONENT_BYTE:
+            case COMPONENT_UNSIGNED_BYTE: return 1;
+            case COMPONENT_SHORT:
+            case COMPONENT_UNSIGNED_SHORT: return 2;
+            case COMPONENT_UNSIGNED_INT:
+            case COMPONENT_FLOAT: return 4;
+            default: return 0;
+            }
+        }
+
+        uint32_t componentCountOf(const std::string& type) {
+            if (type == "SCALAR") return 1;
+            if (type == "VEC2") return 2;
+            if (type == "VEC3") return 3;
+            if (type == "VEC4") return 4;
+            if (type == "MAT2") return 4;
+            if (type == "MAT3") return 9;
+            if (type == "MAT4") return 16;
+            return 0;
+        }
+
+        glm::vec3 vec3Of(const JsonValue& array) {
+            glm::vec3 result{ 0.f };
+            for (size_t i = 0; i < 3 && i < array.values.size(); i++) {
+                result[static_cast<int>(i)] = static_cast<float>(array.values[i].number);
+            }
+            return result;
+        }
+
+        // Unsigned normalized or float, which is all glTF allows for uvs and
+        // colors
+        float readComponent(const unsigned char* data, uint32_t componentType) {
+            switch (componentType) {
+            case COMPONENT_UNSIGNED_BYTE:
+                return *data / 255.f;
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t value;
+                std::memcpy(&value, data, sizeof(value));
+                return value / 65535.f;
+            }
+            default: {
+                float value;
+                std::memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            }
+        }
+
+        glm::mat4 nodeTransform(const JsonValue& node) {
+            if (const JsonValue* matrix = node.find("matrix")) {
+                glm::mat4 result{ 1.f };
+                for (size_t i = 0; i < 16 && i < matrix->values.size(); i++) {
+                    result[static_cast<int>(i / 4)][static_cast<int>(i % 4)] =
+                        static_cast<float>(matrix->values[i].number);
+                }
+                return result;
+            }
+
+            glm::vec3 translation{ 0.f };
+            glm::quat rotation{ 1.f, 0.f, 0.f, 0.f };
+            glm::vec3 scale{ 1.f };
+            if (const JsonValue* value = node.find("translation")) {
+                translation = vec3Of(*value);
+            }
+            if (const JsonValue* value = node.find("rotation")) {
+                if (value->values.size() == 4) {
+                    // Stored x, y, z, w
+                    rotation = glm::quat{
+                        static_cast<float>(value->values[3].number),
+                        static_cast<float>(value->values[0].number),
+                        static_cast<float>(value->values[1].number),
+                        static_cast<float>(value->values[2].number) };
+                }
+            }
+            if (const JsonValue* value = node.find("scale")) {
+                scale = vec3Of(*value);
+            }
+            glm::mat4 result = glm::translate(glm::mat4{ 1.f }, translation) * glm::mat4_cast(rotation);
+            return glm::scale(result, scale);
+        }
+    }
+
+    LveGltfFile::LveGltfFile(const std::string& filepath)
+        : filepath{ filepath }, file{ LveArchive::readAsset(filepath) } {
+        struct GlbHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t length;
+        };
+        struct ChunkHeader {
+            uint32_t length;
+            uint32_t type;
+        };
+
+        const unsigned char* data = file->data();
+        size_t size = file->size();
+        GlbHeader header{};
+        ChunkHeader jsonChunk{};
+        if (size < sizeof(header) + sizeof(jsonChunk)) {
+            throw std::runtime_error(filepath + ": too small to be a .glb file");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        std::memcpy(&jsonChunk, data + sizeof(header), sizeof(jsonChunk));
+        if (header.magic != GLB_MAGIC || header.version != GLB_VERSION) {
+            throw std::runtime_error(filepath + ": not a glTF 2.0 binary file");
+        }
+        size_t jsonOffset = sizeof(header) + sizeof(jsonChunk);
+        if (header.length < jsonOffset || header.length > size) {
+            throw std::runtime_error(filepath + ": invalid .glb length");
+        }
+        size = header.length;
+        if (jsonChunk.type != CHUNK_JSON || jsonChunk.length > size - jsonOffset) {
+            throw std::runtime_error(filepath + ": invalid JSON chunk");
+        }
+
+        // The BIN chunk is optional and follows the 4 byte aligned JSON
+        const unsigned char* bin = nullptr;
+        size_t binSize = 0;
+        size_t binOffset = jsonOffset + ((jsonChunk.length + 3) & ~size_t{ 3 });
+        ChunkHeader binChunk{};
+        if (binOffset + sizeof(binChunk) <= size) {
+            std::memcpy(&binChunk, data + binOffset, sizeof(binChunk));
+            binOffset += sizeof(binChunk);
+            if (binChunk.type != CHUNK_BIN || binChunk.length > size - binOffset) {
+                throw std::runtime_error(filepath + ": invalid BIN chunk");
+            }
+            bin = data + binOffset;
+            binSize = binChunk.length;
+        }
+
+        const char* json = reinterpret_cast<const char*>(data + jsonOffset);
+        JsonValue document = JsonParser{ json, json + jsonChunk.length, filepath }.parseDocument();
+        if (document.type != JsonValue::Type::Object) {
+            throw std::runtime_error(filepath + ": glTF JSON is not an object");
+        }
+
+        const auto& buffers = arrayOf(document, "buffers");
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (i > 0 || buffers[i].find("uri") != nullptr) {
+                throw std::runtime_error(filepath + ": only the embedded glTF buffer is supported");
+            }
+            if (integerOf(buffers[i], "byteLength", 0, filepath) > binSize) {
+                throw std::runtime_error(filepath + ": glTF buffer is larger than the BIN chunk");
+            }
+        }
+
+        std::vector<BufferView> bufferViews;
+        for (const auto& view : arrayOf(document, "bufferViews")) {
+            if (integerOf(view, "buffer", 0, filepath) != 0) {
+                throw std::runtime_error(filepath + ": only the embedded glTF buffer is supported");
+            }
+            BufferView bufferView{};
+            uint64_t byteOffset = integerOf(view, "byteOffset", 0, filepath);
+            uint64_t byteLength = integerOf(view, "byteLength", 0, filepath);
+            uint64_t byteStride = integerOf(view, "byteStride", 0, filepath);
+            if (byteOffset > binSize || byteLength > binSize - byteOffset || byteStride > 252) {
+                throw std::runtime_error(filepath + ": glTF buffer view out of range");
+            }
+            bufferView.byteOffset = static_cast<size_t>(byteOffset);
+            bufferView.byteLength = static_cast<size_t>(byteLength);
+            bufferView.byteStride = static_cast<uint32_t>(byteStride);
+            bufferViews.push_back(bufferView);
+        }
+
+        for (const auto& value : arrayOf(document, "accessors")) {
+            if (value.find("sparse") != nullptr) {
+                throw std::runtime_error(filepath + ": sparse glTF accessors are not supported");
+            }
+            int32_t viewIndex = optionalIndex(value, "bufferView", bufferViews.size(), filepath);
+            if (viewIndex < 0) {
+                throw std::runtime_error(filepath + ": glTF accessors without a buffer view are not supported");
+            }
+            const BufferView& view = bufferViews[viewIndex];
+            const JsonValue* type = value.find("type");
+
+            Accessor accessor{};
+            accessor.componentType = static_cast<uint32_t>(integerOf(value, "componentType", 0, filepath));
+            accessor.componentCount = type != nullptr ? componentCountOf(type->string) : 0;
+            accessor.normalized = value.find("normalized") != nullptr && value.find("normalized")->boolean;
+            accessor.bufferView = static_cast<uint32_t>(viewIndex);
+            uint64_t byteOffset = integerOf(value, "byteOffset", 0, filepath);
+            uint64_t count = integerOf(value, "count", 0, filepath);
+            uint32_t elementSize = componentSize(accessor.componentType) * accessor.componentCount;
+            if (elementSize == 0) {
+                throw std::runtime_error(filepath + ": invalid glTF accessor type");
+            }
+            accessor.stride = view.byteStride != 0 ? view.byteStride : elementSize;
+            if (count > UINT32_MAX || byteOffset > view.byteLength ||
+                (count > 0 && (count - 1) * accessor.stride + elementSize > view.byteLength - byteOffset)) {
+                throw std::runtime_error(filepath + ": glTF accessor out of range");
+            }
+            accessor.count = static_cast<uint32_t>(count);
+            accessor.byteOffset = static_cast<size_t>(byteOffset);
+            accessor.data = bin + view.byteOffset + accessor.byteOffset;
+
+            const JsonValue* min = value.find("min");
+            const JsonValue* max = value.find("max");
+            accessor.hasBounds = min != nullptr && max != nullptr && min->values.size() >= 3 &&
+                max->values.size() >= 3;
+            if (accessor.hasBounds) {
+                accessor.min = vec3Of(*min);
+                accessor.max = vec3Of(*max);
+            }
+            accessors.push_back(accessor);
+        }
+
+        for (const auto& value : arrayOf(document, "materials")) {
+            MaterialInfo material{};
+            if (const JsonValue* pbr = value.find("pbrMetallicRoughness")) {
+                if (const JsonValue* factor = pbr->find("baseColorFactor")) {
+                    for (size_t i = 0; i < 4 && i < factor->values.size(); i++) {
+                        material.baseColorFactor[static_cast<int>(i)] =
+                            static_cast<float>(factor->values[i].number);
+                    }
+                }
+            }
+            materials.push_back(material);
+        }
+
+        static const char* attributeNames[ATTRIBUTE_COUNT] = { "POSITION", "NORMAL", "TEXCOORD_0", "COLOR_0" };
+        for (const auto& value : arrayOf(document, "meshes")) {
+            Mesh mesh{};
+            if (const JsonValue* name = value.find("name")) {
+                mesh.name = name->string;
+            }
+            for (const auto& primitiveValue : arrayOf(value, "primitives")) {
+                if (integerOf(primitiveValue, "mode", MODE_TRIANGLES, filepath) != MODE_TRIANGLES) {
+                    throw std::runtime_error(filepath + ": only triangle list glTF primitives are supported");
+                }
+
+                Primitive primitive{};
+                const JsonValue* attributes = primitiveValue.find("attributes");
+                for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+                    primitive.attributes[i] = attributes != nullptr ?
+                        optionalIndex(*attributes, attributeNames[i], accessors.size(), filepath) : -1;
+                }
+                primitive.indices = optionalIndex(primitiveValue, "indices", accessors.size(), filepath);
+                primitive.material = optionalIndex(primitiveValue, "material", materials.size(), filepath);
+
+                if (primitive.attributes[POSITION] < 0) {
+                    throw std::runtime_error(filepath + ": glTF primitive without positions");
+                }
+                const Accessor& position = accessors[primitive.attributes[POSITION]];
+                auto check = [&](int32_t index, uint32_t minComponents, uint32_t maxComponents, bool allowUnorm) {
+                    if (index < 0) {
+                        return;
+                    }
+                    const Accessor& accessor = accessors[index];
+                    bool unorm = accessor.normalized && (accessor.componentType == COMPONENT_UNSIGNED_BYTE ||
+                        accessor.componentType == COMPONENT_UNSIGNED_SHORT);
+                    if (accessor.componentCount < minComponents || accessor.componentCount > maxComponents ||
+                        !(accessor.componentType == COMPONENT_FLOAT || (allowUnorm && unorm)) ||
+                        accessor.count != position.count) {
+                        throw std::runtime_error(filepath + ": unsupported glTF vertex attribute format");
+                    }
+                };
+                check(primitive.attributes[POSITION], 3, 3, false);
+                check(primitive.attributes[NORMAL], 3, 3, false);
+                check(primitive.attributes[TEXCOORD_0], 2, 2, true);
+                check(primitive.attributes[COLOR_0], 3, 4, true);
+                if (primitive.indices >= 0) {
+                    const Accessor& indices = accessors[primitive.indices];
+                    if (indices.componentCount != 1 || (indices.componentType != COMPONENT_UNSIGNED_BYTE &&
+                        indices.componentType != COMPONENT_UNSIGNED_SHORT &&
+                        indices.componentType != COMPONENT_UNSIGNED_INT)) {
+                        throw std::runtime_error(filepath + ": invalid glTF index format");
+                    }
+                }
+                mesh.primitives.push_back(primitive);
+            }
+            meshes.push_back(std::move(mesh));
+        }
+
+        const auto& nodeValues = arrayOf(document, "nodes");
+        std::vector<bool> isChild(nodeValues.size(), false);
+        for (const auto& value : nodeValues) {
+            Node node{};
+            if (const JsonValue* name = value.find("name")) {
+                node.name = name->string;
+            }
+            node.localTransform = nodeTransform(value);
+            node.mesh = optionalIndex(value, "mesh", meshes.size(), filepath);
+            for (const auto& child : arrayOf(value, "children")) {
+                if (child.type != JsonValue::Type::Number || child.number < 0.0 ||
+                    child.number >= static_cast<double>(nodeValues.size())) {
+                    throw std::runtime_error(filepath + ": glTF node child out of range");
+                }
+                uint32_t index = static_cast<uint32_t>(child.number);
+                // With one parent per node and parentless roots, walking
+                // down from the roots can't loop
+                if (isChild[index]) {
+                    throw std::runtime_error(filepath + ": glTF node has several parents");
+                }
+                isChild[index] = true;
+                node.children.push_back(index);
+            }
+            nodes.push_back(std::move(node));
+        }
+
+        const auto& scenes = arrayOf(document, "scenes");
+        if (!scenes.empty()) {
+            int32_t sceneIndex = optionalIndex(document, "scene", scenes.size(), filepath);
+            const JsonValue& scene = scenes[sceneIndex < 0 ? 0 : sceneIndex];
+            for (const auto& root : arrayOf(scene, "nodes")) {
+                if (root.type != JsonValue::Type::Number || root.number < 0.0 ||
+                    root.number >= static_cast<double>(nodes.size())) {
+                    throw std::runtime_error(filepath + ": glTF scene node out of range");
+                }
+                uint32_t index = static_cast<uint32_t>(root.number);
+                if (isChild[index]) {
+                    throw std::runtime_error(filepath + ": glTF scene root is a child node");
+                }
+                rootNodes.push_back(index);
+            }
+        } else {
+            for (uint32_t i = 0; i < nodes.size(); i++) {
+                if (!isChild[i]) rootNodes.push_back(i);
+            }
+        }
+    }
+
+    bool LveGltfFile::hasGlbExtension(const std::string& filepath) {
+        return filepath.size() >= 4 && filepath.compare(filepath.size() - 4, 4, ".glb") == 0;
+    }
+
+    uint32_t LveGltfFile::getVertexCount(const Primitive& primitive) const {
+        return accessors[primitive.attributes[POSITION]].count;
+    }
+
+    uint32_t LveGltfFile::getIndexCount(const Primitive& primitive) const {
+        return primitive.indices >= 0 ? accessors[primitive.indices].count : 0;
+    }
+
+    LveModel::BoundingBox LveGltfFile::getBoundingBox(const Primitive& primitive) const {
+        // glTF requires bounds on positions, scan the source if they are missing
+        const Accessor& position = accessors[primitive.attributes[POSITION]];
+        LveModel::BoundingBox box{};
+        if (position.hasBounds) {
+            box.min = position.min;
+            box.max = position.max;
+            return box;
+        }
+        for (uint32_t i = 0; i < position.count; i++) {
+            glm::vec3 value;
+            std::memcpy(&value, position.data + static_cast<size_t>(i) * position.stride, sizeof(value));
+            box.min = i == 0 ? value : glm::min(box.min, value);
+            box.max = i == 0 ? value : glm::max(box.max, value);
+        }
+        return box;
+    }
+
+    bool LveGltfFile::hasVertexLayout(const Primitive& primitive) const {
+        using Vertex = LveModel::Vertex;
+        const size_t offsets[ATTRIBUTE_COUNT] = {
+            offsetof(Vertex, position), offsetof(Vertex, normal), offsetof(Vertex, uv), offsetof(Vertex, color) };
+        const Accessor& position = accessors[primitive.attributes[POSITION]];
+        for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+            if (primitive.attributes[i] < 0) {
+                return false;
+            }
+            const Accessor& accessor = accessors[primitive.attributes[i]];
+            if (accessor.bufferView != position.bufferView || accessor.stride != sizeof(Vertex) ||
+                accessor.componentType != COMPONENT_FLOAT || (i == COLOR_0 && accessor.componentCount != 3) ||
+                accessor.byteOffset != position.byteOffset + offsets[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void LveGltfFile::writeVertices(const Primitive& primitive, LveModel::Vertex* vertices) const {
+        const Accessor& position = accessors[primitive.attributes[POSITION]];
+        if (hasVertexLayout(primitive)) {
+            std::memcpy(vertices, position.data, static_cast<size_t>(position.count) * sizeof(LveModel::Vertex));
+            return;
+        }
+
+        // One attribute at a time, so each pass reads one source stream and
+        // only the common float case stays a plain strided copy
+        auto copyFloats = [&](int32_t index, size_t fieldOffset, size_t fieldSize) {
+            const Accessor& accessor = accessors[index];
+            unsigned char* out = reinterpret_cast<unsigned char*>(vertices) + fieldOffset;
+            for (uint32_t i = 0; i < accessor.count; i++) {
+                const unsigned char* in = accessor.data + static_cast<size_t>(i) * accessor.stride;
+                std::memcpy(out + i * sizeof(LveModel::Vertex), in, fieldSize);
+            }
+        };
+        auto fill = [&](size_t fieldOffset, const void* value, size_t fieldSize) {
+            unsigned char* out = reinterpret_cast<unsigned char*>(vertices) + fieldOffset;
+            for (uint32_t i = 0; i < position.count; i++) {
+                std::memcpy(out + i * sizeof(LveModel::Vertex), value, fieldSize);
+            }
+        };
+        auto convert = [&](int32_t index, size_t fieldOffset, uint32_t components) {
+            const Accessor& accessor = accessors[index];
+            uint32_t size = componentSize(accessor.componentType);
+            unsigned char* out = reinterpret_cast<unsigned char*>(vertices) + fieldOffset;
+            for (uint32_t i = 0; i < accessor.count; i++) {
+                const unsigned char* in = accessor.data + static_cast<size_t>(i) * accessor.stride;
+                float value[3];
+                for (uint32_t c = 0; c < components; c++) {
+                    value[c] = readComponent(in + c * size, accessor.componentType);
+                }
+                std::memcpy(out + i * sizeof(LveModel::Vertex), value, components * sizeof(float));
+            }
+        };
+
+        copyFloats(primitive.attributes[POSITION], offsetof(LveModel::Vertex, position), sizeof(glm::vec3));
+
+        const glm::vec3 zero3{ 0.f };
+        const glm::vec3 white{ 1.f };
+        const glm::vec2 zero2{ 0.f };
+        if (primitive.attributes[NORMAL] >= 0) {
+            copyFloats(primitive.attributes[NORMAL], offsetof(LveModel::Vertex, normal), sizeof(glm::vec3));
+        } else {
+            fill(offsetof(LveModel::Vertex, normal), &zero3, sizeof(zero3));
+        }
+
+        int32_t color = primitive.attributes[COLOR_0];
+        if (color >= 0 && accessors[color].componentType == COMPONENT_FLOAT) {
+            // Alpha of vec4 colors is dropped
+            copyFloats(color, offsetof(LveModel::Vertex, color), sizeof(glm::vec3));
+        } else if (color >= 0) {
+            convert(color, offsetof(LveModel::Vertex, color), 3);
+        } else {
+            fill(offsetof(LveModel::Vertex, color), &white, sizeof(white));
+        }
+
+        int32_t uv = primitive.attributes[TEXCOORD_0];
+        if (uv >= 0 && accessors[uv].componentType == COMPONENT_FLOAT) {
+            copyFloats(uv, offsetof(LveModel::Vertex, uv), sizeof(glm::vec2));
+        } else if (uv >= 0) {
+            convert(uv, offsetof(LveModel::Vertex, uv), 2);
+        } else {
+            fill(offsetof(LveModel::Vertex, uv), &zero2, sizeof(zero2));
+        }
+    }
+
+    void LveGltfFile::writeIndices(const Primitive& primitive, uint32_t* indices) const {
+        if (primitive.indices < 0) {
+            return;
+        }
+        const Accessor& accessor = accessors[primitive.indices];
+        uint32_t vertexCount = getVertexCount(primitive);
+        // Checked on the source before anything is written, reading back
+        // staging memory is slow
+        auto readIndex = [&accessor](uint32_t i) {
+            const unsigned char* in = accessor.data + static_cast<size_t>(i) * accessor.stride;
+            if (accessor.componentType == COMPONENT_UNSIGNED_BYTE) {
+                return static_cast<uint32_t>(*in);
+            }
+            if (accessor.componentType == COMPONENT_UNSIGNED_SHORT) {
+                uint16_t value;
+                std::memcpy(&value, in, sizeof(value));
+                return static_cast<uint32_t>(value);
+            }
+            uint32_t value;
+            std::memcpy(&value, in, sizeof(value));
+            return value;
+        };
+        uint32_t maxIndex = 0;
+        for (uint32_t i = 0; i < accessor.count; i++) {
+            maxIndex = std::max(maxIndex, readIndex(i));
+        }
+        if (accessor.count > 0 && maxIndex >= vertexCount) {
+            throw std::runtime_error(filepath + ": glTF index out of range");
+        }
+
+        if (accessor.componentType == COMPONENT_UNSIGNED_INT && accessor.stride == sizeof(uint32_t)) {
+            std::memcpy(indices, accessor.data, static_cast<size_t>(accessor.count) * sizeof(uint32_t));
+        } else {
+            // Widened, the index buffers are always 32 bit
+            for (uint32_t i = 0; i < accessor.count; i++) {
+                indices[i] = readIndex(i);
+            }
+        }
+    }
+
+    LveMeshBvh::Geometry LveGltfFile::getGeometry(const Primitive& primitive) const {
+        const Accessor& position = accessors[primitive.attributes[POSITION]];
+        LveMeshBvh::Geometry geometry{ position.data, position.stride, position.count, nullptr, 0, 0, 0 };
+        if (primitive.indices >= 0) {
+            const Accessor& indices = accessors[primitive.indices];
+            geometry.indices = indices.data;
+            geometry.indexStride = indices.stride;
+            geometry.indexSize = componentSize(indices.componentType);
+            geometry.indexCount = indices.count;
+        }
+        return geometry;
+    }
+}
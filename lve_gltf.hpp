@@ -0,0 +1,106 @@
+#pragma once
+
+#include "lve_archive.hpp"
+#include "lve_mesh_bvh.hpp"
+#include "lve_model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Binary glTF 2.0 (.glb) reader. The JSON chunk is parsed into the tables
+    // below and accessors point straight into the BIN chunk of the mapped file
+    // (or archive entry), so vertex and index data is read in place when it
+    // is written into staging memory. Only the embedded BIN buffer is
+    // supported; external and data URI buffers, sparse accessors, and
+    // primitives other than triangle lists are rejected with an error.
+    class LveGltfFile {
+    public:
+        enum Attribute { POSITION, NORMAL, TEXCOORD_0, COLOR_0, ATTRIBUTE_COUNT };
+
+        struct Accessor {
+            const unsigned char* data;
+            uint32_t count;
+            uint32_t stride;
+            uint32_t componentType;
+            uint32_t componentCount;
+            bool normalized;
+            uint32_t bufferView;
+            // From the start of the buffer view
+            size_t byteOffset;
+            bool hasBounds;
+            glm::vec3 min;
+            glm::vec3 max;
+        };
+
+        struct Primitive {
+            // Accessor indices, -1 when absent
+            int32_t attributes[ATTRIBUTE_COUNT];
+            int32_t indices;
+            int32_t material;
+        };
+
+        struct Mesh {
+            std::string name;
+            std::vector<Primitive> primitives;
+        };
+
+        struct Node {
+            std::string name;
+            glm::mat4 localTransform{ 1.f };
+            int32_t mesh = -1;
+            std::vector<uint32_t> children;
+        };
+
+        struct MaterialInfo {
+            glm::vec4 baseColorFactor{ 1.f };
+        };
+
+        LveGltfFile(const std::string& filepath);
+
+        LveGltfFile(const LveGltfFile&) = delete;
+        LveGltfFile& operator=(const LveGltfFile&) = delete;
+
+        static bool hasGlbExtension(const std::string& filepath);
+
+        const std::vector<Mesh>& getMeshes() const { return meshes; }
+        const std::vector<Node>& getNodes() const { return nodes; }
+        const std::vector<MaterialInfo>& getMaterials() const { return materials; }
+        // Roots of the default scene
+        const std::vector<uint32_t>& getRootNodes() const { return rootNodes; }
+
+        uint32_t getVertexCount(const Primitive& primitive) const;
+        // 0 for primitives without indices, which are drawn unindexed
+        uint32_t getIndexCount(const Primitive& primitive) const;
+        LveModel::BoundingBox getBoundingBox(const Primitive& primitive) const;
+
+        // True when position, color, normal and uv are interleaved in one
+        // buffer view exactly like LveModel::Vertex, so writeVertices is a
+        // single copy
+        bool hasVertexLayout(const Primitive& primitive) const;
+
+        // Write getVertexCount vertices and getIndexCount indices, typically
+        // into mapped staging memory. Every field is written, missing
+        // attributes get the OBJ loader's defaults. Indices are range checked
+        // before any are written, and throw if one is out of range.
+        void writeVertices(const Primitive& primitive, LveModel::Vertex* vertices) const;
+        void writeIndices(const Primitive& primitive, uint32_t* indices) const;
+        // Positions and indices in the mapped file, for building a triangle
+        // BVH without decoding the vertices. Valid while the file is open.
+        LveMeshBvh::Geometry getGeometry(const Primitive& primitive) const;
+
+    private:
+        std::string filepath;
+        std::unique_ptr<LveArchive::Data> file;
+        std::vector<Accessor> accessors;
+        std::vector<Mesh> meshes;
+        std::vector<Node> nodes;
+        std::vector<MaterialInfo> materials;
+        std::vector<uint32_t> rootNodes;
+    };
+}
@@ -0,0 +1,121 @@
+#include "lve_gltf_scene.hpp"
+
+#include "lve_gltf.hpp"
+#include "lve_mesh_bvh.hpp"
+
+// std
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+namespace lve {
+
+    std::vector<LveGameObject> LveGltfScene::load(
+        LveDevice& device,
+        LveMaterialSystem& materialSystem,
+        const std::string& filepath,
+        const glm::mat4& root) {
+        auto start = std::chrono::high_resolution_clock::now();
+        LveGltfFile file{ filepath };
+
+        std::vector<std::vector<std::shared_ptr<LveModel>>> models(file.getMeshes().size());
+        std::vector<uint32_t> materialIndices(file.getMaterials().size(), 0);
+        std::vector<bool> materialAdded(file.getMaterials().size(), false);
+        std::vector<LveGameObject> gameObjects;
+        uint64_t vertexCount = 0;
+
+        auto instantiate = [&](uint32_t meshIndex, const glm::mat4& transform) {
+            const auto& mesh = file.getMeshes()[meshIndex];
+            auto& meshModels = models[meshIndex];
+            if (meshModels.empty()) {
+                for (const auto& primitive : mesh.primitives) {
+                    // The triangle BVH reads positions and indices from the
+                    // mapped file too, staging is write only
+                    meshModels.push_back(std::make_shared<LveModel>(
+                        device,
+                        file.getVertexCount(primitive),
+                        file.getIndexCount(primitive),
+                        file.getBoundingBox(primitive),
+                        [&](LveModel::Vertex* vertices) { file.writeVertices(primitive, vertices); },
+                        [&](uint32_t* indices) { file.writeIndices(primitive, indices); },
+                        std::make_shared<LveMeshBvh>(file.getGeometry(primitive))));
+                    vertexCount += file.getVertexCount(primitive);
+                }
+            }
+
+            TransformComponent transformComponent = decompose(transform);
+            for (size_t i = 0; i < mesh.primitives.size(); i++) {
+                auto gameObject = LveGameObject::createGameObject();
+                gameObject.model = meshModels[i];
+                gameObject.transform = transformComponent;
+
+                int32_t material = mesh.primitives[i].material;
+                if (material >= 0) {
+                    if (!materialAdded[material]) {
+                        Material info{};
+                        info.baseColorFactor = file.getMaterials()[material].baseColorFactor;
+                        materialIndices[material] = materialSystem.addMaterial(info);
+                        materialAdded[material] = true;
+                    }
+                    gameObject.materialIndex = materialIndices[material];
+                }
+                gameObjects.push_back(std::move(gameObject));
+            }
+        };
+
+        // The file guarantees a single parent per node, so this terminates
+        std::vector<std::pair<uint32_t, glm::mat4>> stack;
+        for (uint32_t rootNode : file.getRootNodes()) {
+            stack.emplace_back(rootNode, root);
+        }
+        while (!stack.empty()) {
+            auto [nodeIndex, parentTransform] = stack.back();
+            stack.pop_back();
+            const auto& node = file.getNodes()[nodeIndex];
+            glm::mat4 transform = parentTransform * node.localTransform;
+            if (node.mesh >= 0) {
+                instantiate(static_cast<uint32_t>(node.mesh), transform);
+            }
+            for (uint32_t child : node.children) {
+                stack.emplace_back(child, transform);
+            }
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Loaded " << filepath << ": " << gameObjects.size() << " objects, " << vertexCount
+            << " vertices in " << milliseconds << " ms\n";
+        return gameObjects;
+    }
+
+    TransformComponent LveGltfScene::decompose(const glm::mat4& matrix) {
+        TransformComponent transform{};
+        transform.translation = glm::vec3{ matrix[3] };
+
+        glm::vec3 columns[3] = { glm::vec3{ matrix[0] }, glm::vec3{ matrix[1] }, glm::vec3{ matrix[2] } };
+        for (int i = 0; i < 3; i++) {
+            transform.scale[i] = glm::length(columns[i]);
+            if (transform.scale[i] > 0.f) columns[i] /= transform.scale[i];
+        }
+        // A mirroring transform keeps its handedness through a negative x scale
+        if (glm::dot(glm::cross(columns[0], columns[1]), columns[2]) < 0.f) {
+            transform.scale.x = -transform.scale.x;
+            columns[0] = -columns[0];
+        }
+
+        // The rotation is Ry * Rx * Rz, see TransformComponent::mat4. The
+        // third column is (c2 s1, -s2, c1 c2).
+        float s2 = glm::clamp(-columns[2].y, -1.f, 1.f);
+        transform.rotation.x = glm::asin(s2);
+        if (glm::abs(s2) < 0.9999f) {
+            transform.rotation.y = glm::atan(columns[2].x, columns[2].z);
+            transform.rotation.z = glm::atan(columns[0].y, columns[1].y);
+        } else {
+            // Gimbal lock, only y - z or y + z is determined; put it all in y
+            transform.rotation.y = glm::atan(-columns[0].z, columns[0].x);
+            transform.rotation.z = 0.f;
+        }
+        return transform;
+    }
+}
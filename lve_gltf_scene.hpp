@@ -0,0 +1,33 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_game_object.hpp"
+#include "lve_material_system.hpp"
+
+// std
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Instantiates the default scene of a .glb file. Every primitive becomes
+    // an LveModel, created once and shared by all nodes that use its mesh,
+    // and every mesh node gets one game object per primitive with the node's
+    // world transform. Base color factors become materials; textures aren't
+    // loaded.
+    class LveGltfScene {
+    public:
+        // root is applied on top of the scene's own transforms, e.g. to flip
+        // glTF's +Y up into the engine's -Y up
+        static std::vector<LveGameObject> load(
+            LveDevice& device,
+            LveMaterialSystem& materialSystem,
+            const std::string& filepath,
+            const glm::mat4& root = glm::mat4{ 1.f });
+
+        // Splits into the translate * Ry * Rx * Rz * scale form of
+        // TransformComponent. Shear, which only nonuniform scales under
+        // rotated parents produce, is lost.
+        static TransformComponent decompose(const glm::mat4& matrix);
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lve {
+
+    // 64-bit FNV-1a. Structs are fed one field at a time so padding never
+    // gets hashed, and strings carry their length so fields can't run together.
+    class LveHasher {
+    public:
+        void bytes(const void* data, size_t size) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash ^= p[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        template <typename T>
+        void add(const T& value) { bytes(&value, sizeof(T)); }
+
+        void add(const std::string& value) {
+            add(value.size());
+            bytes(value.data(), value.size());
+        }
+
+        uint64_t get() const { return hash; }
+
+        static uint64_t hash64(const void* data, size_t size) {
+            LveHasher hasher{};
+            hasher.bytes(data, size);
+            return hasher.get();
+        }
+
+    private:
+        uint64_t hash = 14695981039346656037ull;
+    };
+}
@@ -0,0 +1,475 @@
+#include "lve_hiz_culler.hpp"
+
+#include "lve_profiler.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+    struct HiZPushConstants {
+        glm::ivec2 srcSize;
+        glm::ivec2 dstSize;
+    };
+
+    LveHiZCuller::LveHiZCuller(LveDevice& device) : lveDevice{ device } {
+        createDescriptors();
+        createPipelineLayout();
+        createPipeline();
+        createSampler();
+    }
+
+    LveHiZCuller::~LveHiZCuller() {
+        for (auto& frame : frames) {
+            destroyPyramid(frame);
+        }
+        vkDestroySampler(lveDevice.device(), sampler, nullptr);
+        vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+    }
+
+    void LveHiZCuller::createDescriptors() {
+        // Level 0 samples the depth buffer and gets a new set every frame
+        const uint32_t setCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT * (MAX_LEVELS - 1);
+        descriptorPool = LveDescriptorPool::Builder(lveDevice)
+            .setMaxSets(setCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+            .build();
+
+        setLayout = LveDescriptorSetLayout::Builder(lveDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        // One set per pyramid level below the first, allocated up front and
+        // rewritten whenever the pyramid of a frame slot is recreated.
+        frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : frames) {
+            frame.levelSets.resize(MAX_LEVELS, VK_NULL_HANDLE);
+            for (uint32_t i = 1; i < MAX_LEVELS; i++) {
+                auto& set = frame.levelSets[i];
+                if (!descriptorPool->allocateDescriptor(setLayout->getDescriptorSetLayout(), set)) {
+                    throw std::runtime_error("Failed to allocate Hi-Z descriptor set!");
+                }
+            }
+        }
+    }
+
+    void LveHiZCuller::createPipelineLayout() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(HiZPushConstants);
+
+        VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(
+            lveDevice.device(), &pipelineLayoutInfo,
+            nullptr, &pipelineLayout) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout!");
+        }
+    }
+
+    void LveHiZCuller::createPipeline() {
+        assert(pipelineLayout != nullptr &&
+            "Cannot create pipeline before pipeline layout");
+
+        downsamplePipeline = std::make_unique<LveComputePipeline>(
+            lveDevice,
+            "hiz_downsample.comp.spv",
+            pipelineLayout);
+    }
+
+    void LveHiZCuller::createSampler() {
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.f;
+
+        if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create Hi-Z sampler!");
+        }
+    }
+
+    void LveHiZCuller::setEnabled(bool enable) {
+        enabled = enable;
+        if (!enabled) {
+            // Stale pyramids must not be used once culling is switched back on
+            for (auto& frame : frames) {
+                frame.valid = false;
+            }
+            testedCount = 0;
+            culledCount = 0;
+        }
+    }
+
+    void LveHiZCuller::createPyramid(PyramidFrame& frame, VkExtent2D depthExtent) {
+        destroyPyramid(frame);
+
+        uint32_t width = std::max(depthExtent.width / 2, 1u);
+        uint32_t height = std::max(depthExtent.height / 2, 1u);
+        uint32_t levelCount = static_cast<uint32_t>(
+            std::floor(std::log2(std::max(width, height)))) + 1;
+        levelCount = std::min(levelCount, MAX_LEVELS);
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage =
+            VK_IMAGE_USAGE_STORAGE_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
+
+        lveDevice.createImageWithInfo(
+            imageInfo,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            frame.image,
+            frame.imageMemory);
+
+        frame.levelViews.resize(levelCount);
+        frame.levelExtents.resize(levelCount);
+        frame.readbackLevel = levelCount - 1;
+        for (uint32_t i = 0; i < levelCount; i++) {
+            frame.levelExtents[i] = {
+                std::max(width >> i, 1u),
+                std::max(height >> i, 1u) };
+            if (frame.readbackLevel == levelCount - 1 &&
+                frame.levelExtents[i].width <= READBACK_MAX_WIDTH) {
+                frame.readbackLevel = i;
+            }
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = frame.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R32_SFLOAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = i;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(lveDevice.device(), &viewInfo,
+                nullptr, &frame.levelViews[i]) != VK_SUCCESS) {
+                throw std::runtime_error(
+                    "Failed to create Hi-Z level image view!");
+            }
+        }
+
+        // Level 0 reads the depth buffer, which is written at build time
+        for (uint32_t i = 1; i < levelCount; i++) {
+            VkDescriptorImageInfo srcInfo{ sampler, frame.levelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL };
+            VkDescriptorImageInfo dstInfo{ VK_NULL_HANDLE, frame.levelViews[i], VK_IMAGE_LAYOUT_GENERAL };
+            LveDescriptorWriter(*setLayout, *descriptorPool)
+                .writeImage(0, &srcInfo)
+                .writeImage(1, &dstInfo)
+                .overwrite(frame.levelSets[i]);
+        }
+
+        const VkExtent2D readbackExtent = frame.levelExtents[frame.readbackLevel];
+        frame.readbackBuffer = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(float),
+            readbackExtent.width * readbackExtent.height,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.readbackBuffer->map();
+
+        frame.depthExtent = depthExtent;
+        frame.valid = false;
+    }
+
+    void LveHiZCuller::destroyPyramid(PyramidFrame& frame) {
+        for (auto view : frame.levelViews) {
+            vkDestroyImageView(lveDevice.device(), view, nullptr);
+        }
+        frame.levelViews.clear();
+        frame.levelExtents.clear();
+
+        if (frame.image != VK_NULL_HANDLE) {
+            vkDestroyImage(lveDevice.device(), frame.image, nullptr);
+            vkFreeMemory(lveDevice.device(), frame.imageMemory, nullptr);
+            frame.image = VK_NULL_HANDLE;
+            frame.imageMemory = VK_NULL_HANDLE;
+        }
+
+        frame.readbackBuffer = nullptr;
+        frame.depthExtent = { 0, 0 };
+        frame.valid = false;
+    }
+
+    void LveHiZCuller::buildPyramid(
+        FrameInfo& frameInfo,
+        VkImage depthImage,
+        VkImageView depthImageView,
+        VkFormat depthFormat,
+        VkExtent2D depthExtent) {
+        if (!enabled) return;
+
+        // This slot's fence was waited on in beginFrame, so nothing of it is in use
+        auto& frame = frames[frameInfo.frameIndex];
+        if (frame.depthExtent.width != depthExtent.width ||
+            frame.depthExtent.height != depthExtent.height) {
+            createPyramid(frame, depthExtent);
+        }
+
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        const uint32_t levelCount = static_cast<uint32_t>(frame.levelViews.size());
+
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+            depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        std::array<VkImageMemoryBarrier, 2> toCompute{};
+        toCompute[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toCompute[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        toCompute[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toCompute[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        toCompute[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        toCompute[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toCompute[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toCompute[0].image = depthImage;
+        toCompute[0].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+
+        toCompute[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toCompute[1].srcAccessMask = 0;
+        toCompute[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+        toCompute[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        toCompute[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toCompute[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toCompute[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toCompute[1].image = frame.image;
+        toCompute[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            static_cast<uint32_t>(toCompute.size()), toCompute.data());
+
+        VkDescriptorImageInfo depthInfo{
+            sampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo level0Info{ VK_NULL_HANDLE, frame.levelViews[0], VK_IMAGE_LAYOUT_GENERAL };
+        if (frameInfo.descriptorAllocator == nullptr ||
+            !LveDescriptorWriter(*setLayout, *frameInfo.descriptorAllocator)
+                .writeImage(0, &depthInfo)
+                .writeImage(1, &level0Info)
+                .build(frame.levelSets[0])) {
+            throw std::runtime_error("Failed to allocate Hi-Z depth descriptor set!");
+        }
+
+        downsamplePipeline->bind(commandBuffer);
+
+        VkExtent2D srcExtent = depthExtent;
+        for (uint32_t i = 0; i < levelCount; i++) {
+            const VkExtent2D dstExtent = frame.levelExtents[i];
+
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                0,
+                1,
+                &frame.levelSets[i],
+                0,
+                nullptr);
+
+            HiZPushConstants push{};
+            push.srcSize = glm::ivec2(srcExtent.width, srcExtent.height);
+            push.dstSize = glm::ivec2(dstExtent.width, dstExtent.height);
+            vkCmdPushConstants(
+                commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(HiZPushConstants),
+                &push);
+
+            vkCmdDispatch(commandBuffer, (dstExtent.width + 7) / 8, (dstExtent.height + 7) / 8, 1);
+
+            // The next level samples this one, and the readback level is copied out
+            VkImageMemoryBarrier levelBarrier{};
+            levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.image = frame.image;
+            levelBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &levelBarrier);
+
+            srcExtent = dstExtent;
+        }
+
+        const VkExtent2D readbackExtent = frame.levelExtents[frame.readbackLevel];
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, frame.readbackLevel, 0, 1 };
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { readbackExtent.width, readbackExtent.height, 1 };
+        vkCmdCopyImageToBuffer(
+            commandBuffer,
+            frame.image,
+            VK_IMAGE_LAYOUT_GENERAL,
+            frame.readbackBuffer->getBuffer(),
+            1,
+            &region);
+
+        VkBufferMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.buffer = frame.readbackBuffer->getBuffer();
+        hostBarrier.offset = 0;
+        hostBarrier.size = VK_WHOLE_SIZE;
+
+        // Hand the depth buffer back to the render pass once the reads are done
+        VkImageMemoryBarrier toAttachment = toCompute[0];
+        toAttachment.srcAccessMask = 0;
+        toAttachment.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        toAttachment.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        toAttachment.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            0,
+            0, nullptr,
+            1, &hostBarrier,
+            1, &toAttachment);
+
+        frame.viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        frame.valid = true;
+    }
+
+    void LveHiZCuller::cullObjects(
+        FrameInfo& frameInfo, std::unordered_set<LveGameObject::id_t>& occluded) {
+        testedCount = 0;
+        culledCount = 0;
+        if (!enabled) return;
+
+        auto& frame = frames[frameInfo.frameIndex];
+        if (!frame.valid) return;
+
+        LveProfiler::ScopedTimer timer{ "hiz.cull" };
+
+        frame.readbackBuffer->invalidate();
+        const float* depth = static_cast<const float*>(frame.readbackBuffer->getMappedMemory());
+
+        frameInfo.forEachVisibleObject([&](LveGameObject::id_t id, LveGameObject& obj) {
+            if (obj.model == nullptr) return;
+
+            testedCount++;
+            if (isOccluded(frame, depth, obj)) {
+                occluded.insert(id);
+                culledCount++;
+            }
+        });
+
+        LveProfiler::addCounter("hiz.tested", testedCount);
+        LveProfiler::addCounter("hiz.culled", culledCount);
+    }
+
+    bool LveHiZCuller::isOccluded(
+        const PyramidFrame& frame, const float* depth, LveGameObject& obj) const {
+        const auto& bounds = obj.model->getBoundingBox();
+        const glm::mat4 mvp = frame.viewProjection * obj.transform.mat4();
+
+        glm::vec3 ndcMin{ std::numeric_limits<float>::max() };
+        glm::vec3 ndcMax{ -std::numeric_limits<float>::max() };
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 corner{
+                (i & 1) ? bounds.max.x : bounds.min.x,
+                (i & 2) ? bounds.max.y : bounds.min.y,
+                (i & 4) ? bounds.max.z : bounds.min.z,
+                1.f };
+            glm::vec4 clip = mvp * corner;
+
+            // Boxes crossing the near plane have no finite screen rect, keep them
+            if (clip.w <= std::numeric_limits<float>::epsilon()) return false;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+
+        if (ndcMin.z < 0.f) return false;
+        // Frustum culling is not the job of this test, off screen boxes are kept
+        if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f) return false;
+
+        const VkExtent2D extent = frame.levelExtents[frame.readbackLevel];
+        const int width = static_cast<int>(extent.width);
+        const int height = static_cast<int>(extent.height);
+        auto toTexel = [](float ndc, int size) {
+            int texel = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * size));
+            return std::clamp(texel, 0, size - 1);
+        };
+        const int x0 = toTexel(ndcMin.x, width);
+        const int x1 = toTexel(ndcMax.x, width);
+        const int y0 = toTexel(ndcMin.y, height);
+        const int y1 = toTexel(ndcMax.y, height);
+
+        float farthest = 0.f;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                farthest = std::max(farthest, depth[y * width + x]);
+            }
+        }
+
+        return ndcMin.z > farthest;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace lve {
+
+    // Hierarchical-Z occlusion culling. After the scene pass the depth buffer is
+    // reduced into a farthest-depth pyramid by a compute shader and one coarse
+    // level is copied back to the host. Once that frame slot comes around again
+    // its fence has signaled, and object bounds are reprojected with the
+    // view-projection that produced the depth and tested against the pyramid.
+    class LveHiZCuller {
+    public:
+        static constexpr uint32_t MAX_LEVELS = 16;
+        // The first level at most this wide is read back for the object tests
+        static constexpr uint32_t READBACK_MAX_WIDTH = 160;
+
+        LveHiZCuller(LveDevice& device);
+        ~LveHiZCuller();
+
+        LveHiZCuller(const LveHiZCuller&) = delete;
+        LveHiZCuller& operator=(const LveHiZCuller&) = delete;
+
+        void setEnabled(bool enable);
+        bool isEnabled() const { return enabled; }
+
+        // Adds the ids of objects hidden in the pyramid last built for this frame slot
+        void cullObjects(FrameInfo& frameInfo, std::unordered_set<LveGameObject::id_t>& occluded);
+
+        // Records the pyramid build from the depth that was just rendered.
+        // Must be called after the render pass has ended.
+        void buildPyramid(
+            FrameInfo& frameInfo,
+            VkImage depthImage,
+            VkImageView depthImageView,
+            VkFormat depthFormat,
+            VkExtent2D depthExtent);
+
+        uint32_t getTestedCount() const { return testedCount; }
+        uint32_t getCulledCount() const { return culledCount; }
+
+    private:
+        struct PyramidFrame {
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+            std::vector<VkImageView> levelViews{};
+            std::vector<VkExtent2D> levelExtents{};
+            std::vector<VkDescriptorSet> levelSets{};
+            VkExtent2D depthExtent{ 0, 0 };
+
+            std::unique_ptr<LveBuffer> readbackBuffer{};
+            uint32_t readbackLevel = 0;
+            glm::mat4 viewProjection{ 1.f };
+            bool valid = false;
+        };
+
+        void createDescriptors();
+        void createPipelineLayout();
+        void createPipeline();
+        void createSampler();
+        void createPyramid(PyramidFrame& frame, VkExtent2D depthExtent);
+        void destroyPyramid(PyramidFrame& frame);
+        bool isOccluded(const PyramidFrame& frame, const float* depth, LveGameObject& obj) const;
+
+        LveDevice& lveDevice;
+
+        std::unique_ptr<LveDescriptorPool> descriptorPool;
+        std::unique_ptr<LveDescriptorSetLayout> setLayout;
+        VkPipelineLayout pipelineLayout;
+        std::unique_ptr<LveComputePipeline> downsamplePipeline;
+        VkSampler sampler;
+        std::vector<PyramidFrame> frames;
+
+        bool enabled = true;
+        uint32_t testedCount = 0;
+        uint32_t culledCount = 0;
+    };
+}
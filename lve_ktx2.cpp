@@ -0,0 +1,104 @@
+#include "lve_ktx2.hpp"
+
+#include "lve_texture.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        const unsigned char KTX2_IDENTIFIER[12] = {
+            0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+        // Identifier, nine u32 header fields, then the dfd/kvd (u32) and sgd
+        // (u64) offset and length pairs
+        const size_t HEADER_SIZE = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+        const size_t LEVEL_INDEX_ENTRY_SIZE = 3 * 8;
+
+        // KTX2 is little endian, like every platform this runs on
+        template <typename T>
+        T readValue(const unsigned char* data, size_t offset) {
+            T value;
+            std::memcpy(&value, data + offset, sizeof(T));
+            return value;
+        }
+    }
+
+    LveKtx2File::LveKtx2File(const std::string& filepath)
+        : file{ std::make_unique<LveMappedFile>(filepath) }, data{ file->data() }, size{ file->size() } {
+        parse(filepath);
+    }
+
+    LveKtx2File::LveKtx2File(
+        const std::string& name,
+        const unsigned char* data,
+        size_t size,
+        std::shared_ptr<const void> owner)
+        : owner{ std::move(owner) }, data{ data }, size{ size } {
+        parse(name);
+    }
+
+    void LveKtx2File::parse(const std::string& filepath) {
+        if (size < HEADER_SIZE ||
+            std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            throw std::runtime_error("not a KTX2 file: " + filepath);
+        }
+
+        auto vkFormat = readValue<uint32_t>(data, 12);
+        width = readValue<uint32_t>(data, 20);
+        height = readValue<uint32_t>(data, 24);
+        auto pixelDepth = readValue<uint32_t>(data, 28);
+        auto layerCount = readValue<uint32_t>(data, 32);
+        auto faceCount = readValue<uint32_t>(data, 36);
+        auto levelCount = readValue<uint32_t>(data, 40);
+        auto supercompressionScheme = readValue<uint32_t>(data, 44);
+
+        if (vkFormat == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("KTX2 files that need transcoding are not supported: " + filepath);
+        }
+        if (supercompressionScheme != 0) {
+            throw std::runtime_error("supercompressed KTX2 files are not supported: " + filepath);
+        }
+        if (width == 0 || height == 0 || pixelDepth != 0 || layerCount != 0 || faceCount != 1) {
+            throw std::runtime_error("only 2D KTX2 textures are supported: " + filepath);
+        }
+        format = static_cast<VkFormat>(vkFormat);
+
+        // A level count of 0 asks the loader to generate the chain below level 0
+        generateMips = levelCount == 0;
+        if (generateMips) {
+            levelCount = 1;
+        }
+        if (levelCount > LveTexture::fullMipLevels(width, height)) {
+            throw std::runtime_error("too many levels in KTX2 file: " + filepath);
+        }
+        if (size < HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE) {
+            throw std::runtime_error("truncated KTX2 level index: " + filepath);
+        }
+
+        levels.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+            auto byteOffset = readValue<uint64_t>(data, entry);
+            auto byteLength = readValue<uint64_t>(data, entry + 8);
+
+            // Also rejects formats the texture code has no block size for
+            if (byteLength != LveTexture::mipSize(format, width, height, level)) {
+                throw std::runtime_error(
+                    "unexpected size of level " + std::to_string(level) + " in KTX2 file " + filepath);
+            }
+            if (byteOffset > size || byteLength > size - byteOffset) {
+                throw std::runtime_error("truncated KTX2 level data: " + filepath);
+            }
+            levels[level] = { static_cast<size_t>(byteOffset), static_cast<size_t>(byteLength) };
+        }
+    }
+
+    bool LveKtx2File::hasKtx2Extension(const std::string& filepath) {
+        const std::string extension = ".ktx2";
+        return filepath.size() >= extension.size() &&
+            filepath.compare(filepath.size() - extension.size(), extension.size(), extension) == 0;
+    }
+}
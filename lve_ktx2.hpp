@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lve_mapped_file.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Reads the mip levels of a KTX2 container straight out of the mapped
+    // file or a buffer it was read into, so block compressed data reaches the
+    // staging buffer without being decoded. Only single layer 2D textures without supercompression
+    // are supported; anything else is rejected with an error.
+    class LveKtx2File {
+    public:
+        LveKtx2File(const std::string& filepath);
+        // Parses contents already in memory, which owner keeps alive
+        LveKtx2File(
+            const std::string& name,
+            const unsigned char* data,
+            size_t size,
+            std::shared_ptr<const void> owner);
+
+        LveKtx2File(const LveKtx2File&) = delete;
+        LveKtx2File& operator=(const LveKtx2File&) = delete;
+
+        static bool hasKtx2Extension(const std::string& filepath);
+
+        VkFormat getFormat() const { return format; }
+        uint32_t getWidth() const { return width; }
+        uint32_t getHeight() const { return height; }
+        // The levels stored in the file, level 0 is the largest. When
+        // generateMips is set the file holds level 0 only and asks for the
+        // rest of the chain to be generated on load.
+        uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+        bool getGenerateMips() const { return generateMips; }
+
+        const unsigned char* levelData(uint32_t level) const { return data + levels[level].offset; }
+        size_t levelSize(uint32_t level) const { return levels[level].size; }
+
+    private:
+        struct Level {
+            size_t offset;
+            size_t size;
+        };
+
+        void parse(const std::string& name);
+
+        std::unique_ptr<LveMappedFile> file;
+        std::shared_ptr<const void> owner;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool generateMips = false;
+        std::vector<Level> levels;
+    };
+}
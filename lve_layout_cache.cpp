@@ -0,0 +1,278 @@
+#include "lve_layout_cache.hpp"
+
+#include "lve_hash.hpp"
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace lve {
+
+    namespace {
+        bool sameBindings(
+            const std::vector<VkDescriptorSetLayoutBinding>& a,
+            const std::vector<VkDescriptorSetLayoutBinding>& b) {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y) {
+                    return x.binding == y.binding &&
+                        x.descriptorType == y.descriptorType &&
+                        x.descriptorCount == y.descriptorCount &&
+                        x.stageFlags == y.stageFlags;
+                });
+        }
+
+        bool sameRanges(
+            const std::vector<VkPushConstantRange>& a,
+            const std::vector<VkPushConstantRange>& b) {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                [](const VkPushConstantRange& x, const VkPushConstantRange& y) {
+                    return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+                });
+        }
+
+        // Shaders can't tell dynamic buffers apart, reflection reports the plain type
+        bool providesType(VkDescriptorType layoutType, VkDescriptorType shaderType) {
+            if (layoutType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+                return shaderType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            }
+            if (layoutType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+                return shaderType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+            return layoutType == shaderType;
+        }
+
+        std::string bindingName(uint32_t set, uint32_t binding) {
+            return "set " + std::to_string(set) + " binding " + std::to_string(binding);
+        }
+    }
+
+    LveLayoutCache::LveLayoutCache(VkDevice device) : device{ device } {}
+
+    LveLayoutCache::~LveLayoutCache() {
+        for (auto& kv : pipelineLayoutKeys) {
+            vkDestroyPipelineLayout(device, kv.first, nullptr);
+        }
+        for (auto& kv : setLayoutBindings) {
+            vkDestroyDescriptorSetLayout(device, kv.first, nullptr);
+        }
+    }
+
+    VkDescriptorSetLayout LveLayoutCache::getDescriptorSetLayout(
+        std::vector<VkDescriptorSetLayoutBinding> bindings,
+        std::vector<VkDescriptorBindingFlagsEXT> bindingFlags) {
+        if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+            throw std::runtime_error("binding flags must be given for every binding");
+        }
+        if (std::all_of(bindingFlags.begin(), bindingFlags.end(),
+            [](VkDescriptorBindingFlagsEXT flags) { return flags == 0; })) {
+            bindingFlags.clear();
+        }
+
+        // Binding order doesn't change the layout, the flags follow their binding
+        std::vector<size_t> order(bindings.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+        std::vector<VkDescriptorSetLayoutBinding> sortedBindings;
+        std::vector<VkDescriptorBindingFlagsEXT> sortedFlags;
+        for (size_t i : order) {
+            sortedBindings.push_back(bindings[i]);
+            if (!bindingFlags.empty()) {
+                sortedFlags.push_back(bindingFlags[i]);
+            }
+        }
+        bindings = std::move(sortedBindings);
+        bindingFlags = std::move(sortedFlags);
+
+        LveHasher hasher{};
+        for (const auto& binding : bindings) {
+            if (binding.pImmutableSamplers != nullptr) {
+                throw std::runtime_error("immutable samplers are not supported by the layout cache");
+            }
+            hasher.add(binding.binding);
+            hasher.add(binding.descriptorType);
+            hasher.add(binding.descriptorCount);
+            hasher.add(binding.stageFlags);
+        }
+        for (auto flags : bindingFlags) {
+            hasher.add(flags);
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto it = setLayoutsByHash.find(hasher.get());
+        if (it != setLayoutsByHash.end() &&
+            sameBindings(setLayoutBindings[it->second], bindings) &&
+            setLayoutBindingFlags[it->second] == bindingFlags) {
+            LveProfiler::addCounter("layouts.setLayoutHits", 1);
+            return it->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+            layoutInfo.pNext = &bindingFlagsInfo;
+            for (auto flags : bindingFlags) {
+                if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT) {
+                    layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+                }
+            }
+        }
+
+        VkDescriptorSetLayout setLayout;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        // On a hash collision the new layout is kept but not made findable
+        setLayoutsByHash.emplace(hasher.get(), setLayout);
+        setLayoutBindings.emplace(setLayout, std::move(bindings));
+        setLayoutBindingFlags.emplace(setLayout, std::move(bindingFlags));
+        return setLayout;
+    }
+
+    VkPipelineLayout LveLayoutCache::getPipelineLayout(
+        const std::vector<VkDescriptorSetLayout>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges) {
+        LveHasher hasher{};
+        for (auto setLayout : setLayouts) {
+            hasher.add(setLayout);
+        }
+        for (const auto& range : pushConstantRanges) {
+            hasher.add(range.stageFlags);
+            hasher.add(range.offset);
+            hasher.add(range.size);
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto it = pipelineLayoutsByHash.find(hasher.get());
+        if (it != pipelineLayoutsByHash.end()) {
+            const auto& key = pipelineLayoutKeys[it->second];
+            if (key.setLayouts == setLayouts && sameRanges(key.pushConstantRanges, pushConstantRanges)) {
+                LveProfiler::addCounter("layouts.pipelineLayoutHits", 1);
+                return it->second;
+            }
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+        VkPipelineLayout pipelineLayout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout!");
+        }
+
+        pipelineLayoutsByHash.emplace(hasher.get(), pipelineLayout);
+        pipelineLayoutKeys.emplace(pipelineLayout, PipelineLayoutKey{ setLayouts, pushConstantRanges });
+        return pipelineLayout;
+    }
+
+    VkPipelineLayout LveLayoutCache::getPipelineLayout(
+        const std::vector<const LveShaderReflection*>& shaders,
+        const std::vector<VkDescriptorSetLayout>& sharedSetLayouts) {
+        // Merge the bindings of all stages, per set
+        std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets(sharedSetLayouts.size());
+        VkShaderStageFlags allStages = 0;
+        uint32_t pushConstantSize = 0;
+
+        for (const LveShaderReflection* shader : shaders) {
+            VkShaderStageFlags stage = shader->getStage();
+            allStages |= stage;
+            pushConstantSize = std::max(pushConstantSize, shader->getPushConstantSize());
+
+            for (const auto& binding : shader->getBindings()) {
+                if (binding.set >= sets.size()) {
+                    sets.resize(binding.set + 1);
+                }
+                auto& set = sets[binding.set];
+                auto it = std::find_if(set.begin(), set.end(),
+                    [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+                if (it == set.end()) {
+                    VkDescriptorSetLayoutBinding layoutBinding{};
+                    layoutBinding.binding = binding.binding;
+                    layoutBinding.descriptorType = binding.descriptorType;
+                    layoutBinding.descriptorCount = binding.descriptorCount;
+                    layoutBinding.stageFlags = stage;
+                    set.push_back(layoutBinding);
+                    continue;
+                }
+                if (it->descriptorType != binding.descriptorType) {
+                    throw std::runtime_error(
+                        "shader stages disagree on the type of " + bindingName(binding.set, binding.binding));
+                }
+                it->descriptorCount = std::max(it->descriptorCount, binding.descriptorCount);
+                it->stageFlags |= stage;
+            }
+        }
+
+        std::vector<VkDescriptorSetLayout> setLayouts(sets.size());
+        for (uint32_t setIndex = 0; setIndex < sets.size(); setIndex++) {
+            if (setIndex >= sharedSetLayouts.size()) {
+                for (const auto& binding : sets[setIndex]) {
+                    if (binding.descriptorCount == 0) {
+                        throw std::runtime_error(
+                            "runtime sized " + bindingName(setIndex, binding.binding) +
+                            " needs a shared set layout");
+                    }
+                }
+                setLayouts[setIndex] = getDescriptorSetLayout(sets[setIndex]);
+                continue;
+            }
+
+            setLayouts[setIndex] = sharedSetLayouts[setIndex];
+            std::lock_guard<std::mutex> lock{ mutex };
+            auto known = setLayoutBindings.find(sharedSetLayouts[setIndex]);
+            if (known == setLayoutBindings.end()) continue;
+
+            for (const auto& binding : sets[setIndex]) {
+                auto it = std::find_if(known->second.begin(), known->second.end(),
+                    [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+                if (it == known->second.end() ||
+                    !providesType(it->descriptorType, binding.descriptorType) ||
+                    it->descriptorCount < binding.descriptorCount ||
+                    (it->stageFlags & binding.stageFlags) != binding.stageFlags) {
+                    throw std::runtime_error(
+                        "shared set layout does not provide " + bindingName(setIndex, binding.binding));
+                }
+            }
+        }
+
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        if (pushConstantSize > 0) {
+            pushConstantRanges.push_back(pushConstantRange(allStages, pushConstantSize));
+        }
+        return getPipelineLayout(setLayouts, pushConstantRanges);
+    }
+
+    VkPushConstantRange LveLayoutCache::pushConstantRange(VkShaderStageFlags stages, uint32_t size) {
+        VkPushConstantRange range{};
+        range.stageFlags = stages;
+        range.offset = 0;
+        range.size = std::max((size + 3) & ~3u, MIN_PUSH_CONSTANT_SIZE);
+        return range;
+    }
+
+    size_t LveLayoutCache::getDescriptorSetLayoutCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return setLayoutBindings.size();
+    }
+
+    size_t LveLayoutCache::getPipelineLayoutCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return pipelineLayoutKeys.size();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lve_shader_reflection.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Hash-consed descriptor set layouts and pipeline layouts. Identical
+    // layouts are created once and shared, so they stay valid until the device
+    // is destroyed and must not be destroyed by their users. Sharing also
+    // keeps pipeline layouts compatible across render systems, so descriptor
+    // sets bound for one system stay bound for the next.
+    class LveLayoutCache {
+    public:
+        // Push constant ranges are padded to the size every device supports,
+        // so systems with different push constant blocks get compatible layouts
+        static constexpr uint32_t MIN_PUSH_CONSTANT_SIZE = 128;
+
+        LveLayoutCache(VkDevice device);
+        ~LveLayoutCache();
+
+        LveLayoutCache(const LveLayoutCache&) = delete;
+        LveLayoutCache& operator=(const LveLayoutCache&) = delete;
+
+        // bindingFlags is empty or has one entry per binding. Layouts with
+        // update-after-bind bindings must be allocated from pools with the
+        // matching flag.
+        VkDescriptorSetLayout getDescriptorSetLayout(
+            std::vector<VkDescriptorSetLayoutBinding> bindings,
+            std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {});
+        VkPipelineLayout getPipelineLayout(
+            const std::vector<VkDescriptorSetLayout>& setLayouts,
+            const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+        // Derives a pipeline layout from the shaders of a pipeline. Sets given
+        // in sharedSetLayouts (set 0 first) are used as is, after checking
+        // that they provide every binding the shaders use; the remaining sets
+        // and the push constant range come from reflection.
+        VkPipelineLayout getPipelineLayout(
+            const std::vector<const LveShaderReflection*>& shaders,
+            const std::vector<VkDescriptorSetLayout>& sharedSetLayouts = {});
+
+        static VkPushConstantRange pushConstantRange(VkShaderStageFlags stages, uint32_t size);
+
+        size_t getDescriptorSetLayoutCount();
+        size_t getPipelineLayoutCount();
+
+    private:
+        struct PipelineLayoutKey {
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            std::vector<VkPushConstantRange> pushConstantRanges;
+        };
+
+        VkDevice device;
+        std::mutex mutex;
+
+        std::unordered_map<uint64_t, VkDescriptorSetLayout> setLayoutsByHash;
+        std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> setLayoutBindings;
+        std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorBindingFlagsEXT>> setLayoutBindingFlags;
+
+        std::unordered_map<uint64_t, VkPipelineLayout> pipelineLayoutsByHash;
+        std::unordered_map<VkPipelineLayout, PipelineLayoutKey> pipelineLayoutKeys;
+    };
+}
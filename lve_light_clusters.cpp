@@ -0,0 +1,251 @@
+#include "lve_light_clusters.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LVE_CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace lve {
+
+    LveLightClusters::LveLightClusters(LveDevice& device) : lveDevice{ device } {
+        lightBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+        clusterBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+        lightIndexBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+        for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            lightBuffers[i] = std::make_unique<LveBuffer>(
+                lveDevice,
+                sizeof(PointLight),
+                MAX_LIGHTS,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            lightBuffers[i]->map();
+
+            clusterBuffers[i] = std::make_unique<LveBuffer>(
+                lveDevice,
+                sizeof(glm::uvec2),
+                CLUSTER_COUNT,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            clusterBuffers[i]->map();
+
+            lightIndexBuffers[i] = std::make_unique<LveBuffer>(
+                lveDevice,
+                sizeof(uint32_t),
+                MAX_LIGHT_INDICES,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            lightIndexBuffers[i]->map();
+        }
+
+        clusterRanges.resize(CLUSTER_COUNT);
+        clusterFill.resize(CLUSTER_COUNT);
+        lightIndices.resize(MAX_LIGHT_INDICES);
+
+        for (uint32_t x = 0; x < CLUSTER_X; x++) {
+            tileMinX[x] = -1.f + 2.f * x / CLUSTER_X;
+            tileMaxX[x] = -1.f + 2.f * (x + 1) / CLUSTER_X;
+        }
+    }
+
+    LveLightClusters::~LveLightClusters() {}
+
+    void LveLightClusters::update(FrameInfo& frameInfo, VkExtent2D extent, GlobalUbo& ubo) {
+        gatherLights(frameInfo);
+        assignLights(frameInfo.camera);
+
+        auto& lightBuffer = *lightBuffers[frameInfo.frameIndex];
+        auto& clusterBuffer = *clusterBuffers[frameInfo.frameIndex];
+        auto& lightIndexBuffer = *lightIndexBuffers[frameInfo.frameIndex];
+
+        if (!lights.empty()) {
+            lightBuffer.writeToBuffer(lights.data(), sizeof(PointLight) * lights.size());
+            lightBuffer.flush();
+        }
+        clusterBuffer.writeToBuffer(clusterRanges.data(), sizeof(glm::uvec2) * CLUSTER_COUNT);
+        clusterBuffer.flush();
+        if (lightIndexCount > 0) {
+            lightIndexBuffer.writeToBuffer(lightIndices.data(), sizeof(uint32_t) * lightIndexCount);
+            lightIndexBuffer.flush();
+        }
+
+        ubo.clusterGrid = {
+            CLUSTER_X, CLUSTER_Y, CLUSTER_Z, static_cast<uint32_t>(lights.size()) };
+        ubo.clusterParams = {
+            static_cast<float>(extent.width) / CLUSTER_X,
+            static_cast<float>(extent.height) / CLUSTER_Y,
+            sliceScale,
+            sliceBias };
+    }
+
+    void LveLightClusters::gatherLights(FrameInfo& frameInfo) {
+        lights.clear();
+        for (auto& kv : frameInfo.gameObjects) {
+            auto& obj = kv.second;
+            if (obj.pointLight == nullptr) continue;
+            if (lights.size() >= MAX_LIGHTS) break;
+
+            PointLight light{};
+            light.position = glm::vec4(obj.transform.translation, obj.pointLight->range);
+            light.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+            lights.push_back(light);
+        }
+    }
+
+    void LveLightClusters::assignLights(const LveCamera& camera) {
+        const glm::mat4& view = camera.getView();
+        const glm::mat4& projection = camera.getProjection();
+        projScaleX = projection[0][0];
+        projScaleY = projection[1][1];
+
+        // Slice k spans [near * (far/near)^(k/Z), near * (far/near)^((k+1)/Z)],
+        // so slice = log(z) * scale + bias, which the shader evaluates per fragment.
+        const float nearZ = camera.getNear();
+        const float farZ = camera.getFar();
+        const float logRatio = std::log(farZ / nearZ);
+        sliceScale = CLUSTER_Z / logRatio;
+        sliceBias = -(CLUSTER_Z * std::log(nearZ)) / logRatio;
+        for (uint32_t k = 0; k <= CLUSTER_Z; k++) {
+            sliceDepths[k] = nearZ * std::pow(farZ / nearZ, static_cast<float>(k) / CLUSTER_Z);
+        }
+
+        clusterRefs.clear();
+        for (uint32_t i = 0; i < lights.size(); i++) {
+            glm::vec3 viewPos = view * glm::vec4(glm::vec3(lights[i].position), 1.f);
+            binLight(i, glm::vec4(viewPos, lights[i].position.w));
+        }
+
+        // Count per cluster, prefix sum into offsets, then scatter the light indices
+        std::fill(clusterRanges.begin(), clusterRanges.end(), glm::uvec2{ 0 });
+        std::fill(clusterFill.begin(), clusterFill.end(), 0);
+        for (auto& ref : clusterRefs) {
+            clusterRanges[ref.cluster].y++;
+        }
+
+        uint32_t offset = 0;
+        for (auto& range : clusterRanges) {
+            range.x = offset;
+            range.y = std::min(range.y, MAX_LIGHT_INDICES - offset);
+            offset += range.y;
+        }
+        lightIndexCount = offset;
+
+        for (auto& ref : clusterRefs) {
+            auto& range = clusterRanges[ref.cluster];
+            auto& fill = clusterFill[ref.cluster];
+            if (fill < range.y) {
+                lightIndices[range.x + fill++] = ref.light;
+            }
+        }
+    }
+
+    static uint32_t tileIndex(float ndc, uint32_t tileCount) {
+        int tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tileCount));
+        return static_cast<uint32_t>(std::clamp(tile, 0, static_cast<int>(tileCount) - 1));
+    }
+
+    uint32_t LveLightClusters::depthSlice(float viewZ) const {
+        int slice = static_cast<int>(std::floor(std::log(viewZ) * sliceScale + sliceBias));
+        return static_cast<uint32_t>(std::clamp(slice, 0, static_cast<int>(CLUSTER_Z) - 1));
+    }
+
+    void LveLightClusters::binLight(uint32_t lightIndex, const glm::vec4& viewSphere) {
+        const float nearZ = sliceDepths[0];
+        const float farZ = sliceDepths[CLUSTER_Z];
+        const float r = viewSphere.w;
+
+        if (viewSphere.z + r < nearZ || viewSphere.z - r > farZ) return;
+
+        uint32_t z0 = depthSlice(std::max(viewSphere.z - r, nearZ));
+        uint32_t z1 = depthSlice(std::min(viewSphere.z + r, farZ));
+
+        uint32_t x0 = 0, x1 = CLUSTER_X - 1;
+        uint32_t y0 = 0, y1 = CLUSTER_Y - 1;
+
+        // Lights straddling the near plane cover the whole screen, otherwise
+        // project the sphere's view space bounding box for a conservative rect.
+        if (viewSphere.z - r > nearZ) {
+            const float zn = viewSphere.z - r;
+            const float zf = viewSphere.z + r;
+            float minX = projScaleX * std::min((viewSphere.x - r) / zn, (viewSphere.x - r) / zf);
+            float maxX = projScaleX * std::max((viewSphere.x + r) / zn, (viewSphere.x + r) / zf);
+            float minY = projScaleY * std::min((viewSphere.y - r) / zn, (viewSphere.y - r) / zf);
+            float maxY = projScaleY * std::max((viewSphere.y + r) / zn, (viewSphere.y + r) / zf);
+
+            if (maxX < -1.f || minX > 1.f || maxY < -1.f || minY > 1.f) return;
+
+            x0 = tileIndex(minX, CLUSTER_X);
+            x1 = tileIndex(maxX, CLUSTER_X);
+            y0 = tileIndex(minY, CLUSTER_Y);
+            y1 = tileIndex(maxY, CLUSTER_Y);
+        }
+
+        const float radiusSq = r * r;
+        for (uint32_t z = z0; z <= z1; z++) {
+            const float sliceNear = sliceDepths[z];
+            const float sliceFar = sliceDepths[z + 1];
+            const float dz = std::max({ sliceNear - viewSphere.z, viewSphere.z - sliceFar, 0.f });
+
+            for (uint32_t y = y0; y <= y1; y++) {
+                const float ndcMinY = -1.f + 2.f * y / CLUSTER_Y;
+                const float ndcMaxY = -1.f + 2.f * (y + 1) / CLUSTER_Y;
+                const float minY = std::min(ndcMinY * sliceNear, ndcMinY * sliceFar) / projScaleY;
+                const float maxY = std::max(ndcMaxY * sliceNear, ndcMaxY * sliceFar) / projScaleY;
+                const float dy = std::max({ minY - viewSphere.y, viewSphere.y - maxY, 0.f });
+
+                if (dy * dy + dz * dz > radiusSq) continue;
+
+                for (uint32_t block = x0 & ~3u; block <= x1; block += 4) {
+                    uint32_t mask = rowOverlapMask(
+                        block, viewSphere, sliceNear, sliceFar, dy * dy, dz * dz);
+
+                    for (uint32_t lane = 0; lane < 4; lane++) {
+                        uint32_t x = block + lane;
+                        if (x < x0 || x > x1 || !(mask & (1u << lane))) continue;
+                        clusterRefs.push_back({ x + CLUSTER_X * (y + CLUSTER_Y * z), lightIndex });
+                    }
+                }
+            }
+        }
+    }
+
+    // Sphere vs cluster box test for 4 neighbouring tiles of one row and slice.
+    // Returns one bit per tile that the sphere overlaps.
+    uint32_t LveLightClusters::rowOverlapMask(
+        uint32_t firstTile, const glm::vec4& viewSphere,
+        float sliceNear, float sliceFar, float yDistSq, float zDistSq) const {
+#ifdef LVE_CLUSTERS_SSE
+        const __m128 ndcMin = _mm_load_ps(tileMinX + firstTile);
+        const __m128 ndcMax = _mm_load_ps(tileMaxX + firstTile);
+        const __m128 zn = _mm_set1_ps(sliceNear / projScaleX);
+        const __m128 zf = _mm_set1_ps(sliceFar / projScaleX);
+
+        const __m128 minX = _mm_min_ps(_mm_mul_ps(ndcMin, zn), _mm_mul_ps(ndcMin, zf));
+        const __m128 maxX = _mm_max_ps(_mm_mul_ps(ndcMax, zn), _mm_mul_ps(ndcMax, zf));
+
+        const __m128 cx = _mm_set1_ps(viewSphere.x);
+        const __m128 dx = _mm_max_ps(
+            _mm_max_ps(_mm_sub_ps(minX, cx), _mm_sub_ps(cx, maxX)), _mm_setzero_ps());
+        const __m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_set1_ps(yDistSq + zDistSq));
+        const __m128 inside = _mm_cmple_ps(distSq, _mm_set1_ps(viewSphere.w * viewSphere.w));
+        return static_cast<uint32_t>(_mm_movemask_ps(inside));
+#else
+        uint32_t mask = 0;
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            const float ndcMin = tileMinX[firstTile + lane];
+            const float ndcMax = tileMaxX[firstTile + lane];
+            const float minX = std::min(ndcMin * sliceNear, ndcMin * sliceFar) / projScaleX;
+            const float maxX = std::max(ndcMax * sliceNear, ndcMax * sliceFar) / projScaleX;
+            const float dx = std::max({ minX - viewSphere.x, viewSphere.x - maxX, 0.f });
+            if (dx * dx + yDistSq + zDistSq <= viewSphere.w * viewSphere.w) {
+                mask |= 1u << lane;
+            }
+        }
+        return mask;
+#endif
+    }
+}
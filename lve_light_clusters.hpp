@@ -0,0 +1,86 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+    // Clustered forward lighting. The view frustum is split into screen tiles
+    // times exponential depth slices, and every frame each point light is binned
+    // into the clusters its sphere of influence overlaps. The fragment shader
+    // then only walks the compact light index list of its own cluster.
+    class LveLightClusters {
+    public:
+        static constexpr uint32_t CLUSTER_X = 16;
+        static constexpr uint32_t CLUSTER_Y = 9;
+        static constexpr uint32_t CLUSTER_Z = 24;
+        static constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+        static constexpr uint32_t MAX_LIGHTS = 4096;
+        static constexpr uint32_t MAX_LIGHT_INDICES = CLUSTER_COUNT * 64;
+
+        LveLightClusters(LveDevice& device);
+        ~LveLightClusters();
+
+        LveLightClusters(const LveLightClusters&) = delete;
+        LveLightClusters& operator=(const LveLightClusters&) = delete;
+
+        // Gathers the point lights of the scene, assigns them to clusters and
+        // uploads the result into this frame's buffers. Also fills in the
+        // cluster fields of the ubo.
+        void update(FrameInfo& frameInfo, VkExtent2D extent, GlobalUbo& ubo);
+
+        VkDescriptorBufferInfo lightBufferInfo(int frameIndex) {
+            return lightBuffers[frameIndex]->descriptorInfo(); }
+        VkDescriptorBufferInfo clusterBufferInfo(int frameIndex) {
+            return clusterBuffers[frameIndex]->descriptorInfo(); }
+        VkDescriptorBufferInfo lightIndexBufferInfo(int frameIndex) {
+            return lightIndexBuffers[frameIndex]->descriptorInfo(); }
+
+        uint32_t getLightCount() const { return static_cast<uint32_t>(lights.size()); }
+        uint32_t getLightIndexCount() const { return lightIndexCount; }
+
+    private:
+        struct ClusterRef {
+            uint32_t cluster;
+            uint32_t light;
+        };
+
+        void gatherLights(FrameInfo& frameInfo);
+        void assignLights(const LveCamera& camera);
+        void binLight(uint32_t lightIndex, const glm::vec4& viewSphere);
+        uint32_t rowOverlapMask(
+            uint32_t firstTile, const glm::vec4& viewSphere,
+            float sliceNear, float sliceFar, float yDistSq, float zDistSq) const;
+        uint32_t depthSlice(float viewZ) const;
+
+        LveDevice& lveDevice;
+
+        std::vector<std::unique_ptr<LveBuffer>> lightBuffers;
+        std::vector<std::unique_ptr<LveBuffer>> clusterBuffers;
+        std::vector<std::unique_ptr<LveBuffer>> lightIndexBuffers;
+
+        std::vector<PointLight> lights;
+        std::vector<ClusterRef> clusterRefs;
+        std::vector<glm::uvec2> clusterRanges;  // x offset, y count
+        std::vector<uint32_t> clusterFill;
+        std::vector<uint32_t> lightIndices;
+        uint32_t lightIndexCount = 0;
+
+        static_assert(CLUSTER_X % 4 == 0, "Cluster rows are tested 4 tiles at a time");
+
+        // Per tile ndc bounds along x, for 4 wide row tests
+        alignas(16) float tileMinX[CLUSTER_X];
+        alignas(16) float tileMaxX[CLUSTER_X];
+        float sliceDepths[CLUSTER_Z + 1];
+        float sliceScale = 0.f;
+        float sliceBias = 0.f;
+        float projScaleX = 1.f;
+        float projScaleY = 1.f;
+    };
+}
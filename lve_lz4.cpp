@@ -0,0 +1,158 @@
+#include "lve_lz4.hpp"
+
+// std
+#include <cstring>
+#include <vector>
+
+namespace lve {
+
+    namespace {
+        const size_t MIN_MATCH = 4;
+        // The format requires the last 5 bytes to be literals and the last
+        // match to start at least 12 bytes before the end
+        const size_t LAST_LITERALS = 5;
+        const size_t MF_LIMIT = 12;
+        const size_t MAX_OFFSET = 65535;
+        const uint32_t HASH_BITS = 16;
+        const uint32_t NO_POSITION = 0xffffffff;
+
+        uint32_t read32(const uint8_t* p) {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t hashSequence(uint32_t sequence) {
+            return (sequence * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        // Lengths of 15 and more continue in bytes of 255 and a remainder
+        bool writeLength(size_t length, uint8_t* dst, size_t& op, size_t dstCapacity) {
+            for (; length >= 255; length -= 255) {
+                if (op == dstCapacity) return false;
+                dst[op++] = 255;
+            }
+            if (op == dstCapacity) return false;
+            dst[op++] = static_cast<uint8_t>(length);
+            return true;
+        }
+
+        bool readLength(const uint8_t* src, size_t srcSize, size_t& ip, size_t& length) {
+            uint8_t byte;
+            do {
+                if (ip == srcSize) return false;
+                byte = src[ip++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+
+        // A sequence is a token, its literals and, except for the last, a match
+        bool writeSequence(
+            const uint8_t* literals,
+            size_t literalLength,
+            size_t offset,
+            size_t matchLength,
+            uint8_t* dst,
+            size_t& op,
+            size_t dstCapacity) {
+            if (op == dstCapacity) return false;
+            size_t token = op++;
+            dst[token] = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+            if (literalLength >= 15 && !writeLength(literalLength - 15, dst, op, dstCapacity)) {
+                return false;
+            }
+            if (literalLength > dstCapacity - op) return false;
+            std::memcpy(dst + op, literals, literalLength);
+            op += literalLength;
+
+            if (matchLength == 0) return true;
+            if (dstCapacity - op < 2) return false;
+            dst[op++] = static_cast<uint8_t>(offset);
+            dst[op++] = static_cast<uint8_t>(offset >> 8);
+            size_t length = matchLength - MIN_MATCH;
+            dst[token] |= static_cast<uint8_t>(length < 15 ? length : 15);
+            return length < 15 || writeLength(length - 15, dst, op, dstCapacity);
+        }
+    }
+
+    size_t LveLz4::compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+        size_t op = 0;
+        size_t anchor = 0;
+
+        if (srcSize > MF_LIMIT) {
+            std::vector<uint32_t> table(size_t{ 1 } << HASH_BITS, NO_POSITION);
+            const size_t matchLimit = srcSize - LAST_LITERALS;
+            size_t ip = 0;
+            while (ip < srcSize - MF_LIMIT) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t& slot = table[hashSequence(sequence)];
+                size_t candidate = slot;
+                slot = static_cast<uint32_t>(ip);
+
+                if (candidate == NO_POSITION || ip - candidate > MAX_OFFSET ||
+                    read32(src + candidate) != sequence) {
+                    ip++;
+                    continue;
+                }
+
+                size_t matchLength = MIN_MATCH;
+                while (ip + matchLength < matchLimit &&
+                    src[candidate + matchLength] == src[ip + matchLength]) {
+                    matchLength++;
+                }
+                if (!writeSequence(
+                    src + anchor, ip - anchor, ip - candidate, matchLength, dst, op, dstCapacity)) {
+                    return 0;
+                }
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        if (!writeSequence(src + anchor, srcSize - anchor, 0, 0, dst, op, dstCapacity)) {
+            return 0;
+        }
+        return op;
+    }
+
+    bool LveLz4::decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        size_t ip = 0;
+        size_t op = 0;
+        while (ip < srcSize) {
+            uint8_t token = src[ip++];
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(src, srcSize, ip, literalLength)) return false;
+            if (literalLength > srcSize - ip || literalLength > dstSize - op) return false;
+            std::memcpy(dst + op, src + ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // The last sequence has no match
+            if (ip == srcSize) break;
+
+            if (srcSize - ip < 2) return false;
+            size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > op) return false;
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(src, srcSize, ip, matchLength)) return false;
+            matchLength += MIN_MATCH;
+            if (matchLength > dstSize - op) return false;
+
+            // Matches may overlap their own output, e.g. runs with offset 1
+            const uint8_t* match = dst + op - offset;
+            if (offset >= matchLength) {
+                std::memcpy(dst + op, match, matchLength);
+            } else {
+                for (size_t i = 0; i < matchLength; i++) {
+                    dst[op + i] = match[i];
+                }
+            }
+            op += matchLength;
+        }
+        return op == dstSize;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+namespace lve {
+
+    // Raw LZ4 blocks, compatible with the reference LZ4_compress_default and
+    // LZ4_decompress_safe, without the frame format around them. The
+    // compressor is a single pass greedy matcher, which is fast enough to pack
+    // assets offline; decompression is what runs at load time.
+    class LveLz4 {
+    public:
+        // Worst case compressed size of srcSize bytes
+        static size_t compressBound(size_t srcSize) { return srcSize + srcSize / 255 + 16; }
+
+        // Returns the compressed size, or 0 if it doesn't fit in dstCapacity
+        static size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+        // Fails on malformed input and unless exactly dstSize bytes are produced
+        static bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+    };
+}
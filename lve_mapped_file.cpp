@@ -0,0 +1,70 @@
+#include "lve_mapped_file.hpp"
+
+// std
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+#ifdef _WIN32
+
+    LveMappedFile::LveMappedFile(const std::string& filepath) {
+        std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + filepath);
+        }
+
+        size_ = static_cast<size_t>(file.tellg());
+        fallbackBuffer.resize((size_ + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(fallbackBuffer.data()), size_);
+        data_ = reinterpret_cast<const unsigned char*>(fallbackBuffer.data());
+    }
+
+    LveMappedFile::~LveMappedFile() {}
+
+#else
+
+    LveMappedFile::LveMappedFile(const std::string& filepath) {
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open file: " + filepath);
+        }
+
+        struct stat fileStat {};
+        if (fstat(fd, &fileStat) != 0) {
+            close(fd);
+            throw std::runtime_error("failed to stat file: " + filepath);
+        }
+
+        size_ = static_cast<size_t>(fileStat.st_size);
+        if (size_ > 0) {
+            void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("failed to map file: " + filepath);
+            }
+            data_ = static_cast<const unsigned char*>(mapping);
+            mapped = true;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    LveMappedFile::~LveMappedFile() {
+        if (mapped) {
+            munmap(const_cast<unsigned char*>(data_), size_);
+        }
+    }
+
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Read-only view of a whole file. Uses mmap where available so the
+    // contents are paged in on demand instead of copied; on Windows the file
+    // is read into memory instead. The data is at least 4 byte aligned, which
+    // SPIR-V requires.
+    class LveMappedFile {
+    public:
+        LveMappedFile(const std::string& filepath);
+        ~LveMappedFile();
+
+        LveMappedFile(const LveMappedFile&) = delete;
+        LveMappedFile& operator=(const LveMappedFile&) = delete;
+
+        const unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+        bool mapped = false;
+        std::vector<uint32_t> fallbackBuffer;
+    };
+}
@@ -0,0 +1,293 @@
+#include "lve_masked_occlusion_culler.hpp"
+
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LVE_MOC_SSE
+#include <emmintrin.h>
+#endif
+
+namespace lve {
+
+    LveMaskedOcclusionCuller::LveMaskedOcclusionCuller(LveThreadPool& threadPool)
+        : threadPool{ threadPool } {
+        tileDepth.resize(TILES_X * TILES_Y);
+        tileWorkingDepth.resize(TILES_X * TILES_Y);
+        tileMask.resize(TILES_X * TILES_Y);
+        clear();
+    }
+
+    std::shared_ptr<OccluderComponent> LveMaskedOcclusionCuller::createOccluder(
+        const LveModel::Builder& builder) {
+        auto occluder = std::make_shared<OccluderComponent>();
+        occluder->positions.reserve(builder.vertices.size());
+        for (const auto& vertex : builder.vertices) {
+            occluder->positions.push_back(vertex.position);
+        }
+
+        if (builder.indices.empty()) {
+            occluder->indices.resize(builder.vertices.size());
+            for (uint32_t i = 0; i < occluder->indices.size(); i++) {
+                occluder->indices[i] = i;
+            }
+        } else {
+            occluder->indices = builder.indices;
+        }
+        return occluder;
+    }
+
+    void LveMaskedOcclusionCuller::clear() {
+        std::fill(tileDepth.begin(), tileDepth.end(), 1.f);
+        std::fill(tileWorkingDepth.begin(), tileWorkingDepth.end(), 0.f);
+        std::fill(tileMask.begin(), tileMask.end(), 0u);
+    }
+
+    void LveMaskedOcclusionCuller::cullObjects(
+        FrameInfo& frameInfo, std::unordered_set<LveGameObject::id_t>& occluded) {
+        testedCount = 0;
+        culledCount = 0;
+        if (!enabled) return;
+
+        const glm::mat4 viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+
+        {
+            LveProfiler::ScopedTimer timer{ "moc.setup" };
+            clear();
+            setupTriangles(frameInfo, viewProjection);
+        }
+        if (triangles.empty()) return;
+
+        {
+            LveProfiler::ScopedTimer timer{ "moc.rasterize" };
+            // Frame priority jobs, and the bands no worker picks up are
+            // rasterized here, so loading work on the pool can't stall this
+            const uint32_t bandCount = std::min(threadPool.getThreadCount() + 1, TILES_Y);
+            threadPool.parallelFor(bandCount, [this, bandCount](uint32_t band) {
+                rasterizeBand(band * TILES_Y / bandCount, (band + 1) * TILES_Y / bandCount);
+            });
+        }
+
+        {
+            LveProfiler::ScopedTimer timer{ "moc.test" };
+            frameInfo.forEachVisibleObject([&](LveGameObject::id_t id, LveGameObject& obj) {
+                if (obj.model == nullptr) return;
+
+                testedCount++;
+                if (isOccluded(obj, viewProjection)) {
+                    occluded.insert(id);
+                    culledCount++;
+                }
+            });
+        }
+
+        LveProfiler::addCounter("moc.triangles", static_cast<int64_t>(triangles.size()));
+        LveProfiler::addCounter("moc.tested", testedCount);
+        LveProfiler::addCounter("moc.culled", culledCount);
+    }
+
+    void LveMaskedOcclusionCuller::setupTriangles(FrameInfo& frameInfo, const glm::mat4& viewProjection) {
+        triangles.clear();
+
+        for (auto& kv : frameInfo.gameObjects) {
+            auto& obj = kv.second;
+            if (obj.occluder == nullptr) continue;
+
+            const auto& positions = obj.occluder->positions;
+            const auto& indices = obj.occluder->indices;
+            const glm::mat4 mvp = viewProjection * obj.transform.mat4();
+
+            clipScratch.resize(positions.size());
+            for (size_t i = 0; i < positions.size(); i++) {
+                clipScratch[i] = mvp * glm::vec4(positions[i], 1.f);
+            }
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const glm::vec4* clip[3] = {
+                    &clipScratch[indices[i]], &clipScratch[indices[i + 1]], &clipScratch[indices[i + 2]] };
+
+                // Dropping occluder triangles is always conservative, so anything
+                // crossing the near plane is skipped instead of clipped
+                if (clip[0]->w <= std::numeric_limits<float>::epsilon() ||
+                    clip[1]->w <= std::numeric_limits<float>::epsilon() ||
+                    clip[2]->w <= std::numeric_limits<float>::epsilon()) {
+                    continue;
+                }
+
+                float x[3], y[3], zMax = 0.f;
+                for (int v = 0; v < 3; v++) {
+                    float invW = 1.f / clip[v]->w;
+                    x[v] = (clip[v]->x * invW * 0.5f + 0.5f) * WIDTH;
+                    y[v] = (clip[v]->y * invW * 0.5f + 0.5f) * HEIGHT;
+                    zMax = std::max(zMax, clip[v]->z * invW);
+                }
+                if (zMax >= 1.f) continue;
+
+                float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+                if (std::abs(area) < 1e-6f) continue;
+                if (area < 0.f) {
+                    std::swap(x[1], x[2]);
+                    std::swap(y[1], y[2]);
+                }
+
+                float minX = std::min({ x[0], x[1], x[2] });
+                float maxX = std::max({ x[0], x[1], x[2] });
+                float minY = std::min({ y[0], y[1], y[2] });
+                float maxY = std::max({ y[0], y[1], y[2] });
+                if (maxX < 0.f || minX >= WIDTH || maxY < 0.f || minY >= HEIGHT) continue;
+
+                ScreenTriangle tri{};
+                for (int e = 0; e < 3; e++) {
+                    int a = e;
+                    int b = (e + 1) % 3;
+                    // E(p) = (b - a) x (p - a), positive inside a counter clockwise triangle
+                    tri.edgeA[e] = -(y[b] - y[a]);
+                    tri.edgeB[e] = x[b] - x[a];
+                    tri.edgeC[e] = -(tri.edgeA[e] * x[a] + tri.edgeB[e] * y[a]);
+                }
+                tri.zMax = zMax;
+                tri.tileX0 = std::max(static_cast<int>(minX) / static_cast<int>(TILE_WIDTH), 0);
+                tri.tileX1 = std::min(static_cast<int>(maxX) / static_cast<int>(TILE_WIDTH),
+                    static_cast<int>(TILES_X) - 1);
+                tri.tileY0 = std::max(static_cast<int>(minY) / static_cast<int>(TILE_HEIGHT), 0);
+                tri.tileY1 = std::min(static_cast<int>(maxY) / static_cast<int>(TILE_HEIGHT),
+                    static_cast<int>(TILES_Y) - 1);
+                triangles.push_back(tri);
+            }
+        }
+    }
+
+    void LveMaskedOcclusionCuller::rasterizeBand(uint32_t tileRowBegin, uint32_t tileRowEnd) {
+        const int rowBegin = static_cast<int>(tileRowBegin);
+        const int rowEnd = static_cast<int>(tileRowEnd);
+
+        // Each band owns its tile rows, so no synchronization is needed
+        for (const auto& tri : triangles) {
+            int y0 = std::max(tri.tileY0, rowBegin);
+            int y1 = std::min(tri.tileY1, rowEnd - 1);
+            for (int tileY = y0; tileY <= y1; tileY++) {
+                for (int tileX = tri.tileX0; tileX <= tri.tileX1; tileX++) {
+                    uint32_t tileIndex = tileY * TILES_X + tileX;
+                    if (tri.zMax >= tileDepth[tileIndex]) continue;
+
+                    uint32_t mask = coverageMask(tri, tileX, tileY);
+                    if (mask != 0) {
+                        updateTile(tileIndex, mask, tri.zMax);
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t LveMaskedOcclusionCuller::coverageMask(
+        const ScreenTriangle& tri, uint32_t tileX, uint32_t tileY) const {
+        const float originX = static_cast<float>(tileX * TILE_WIDTH) + 0.5f;
+        const float originY = static_cast<float>(tileY * TILE_HEIGHT) + 0.5f;
+        uint32_t mask = 0;
+
+#ifdef LVE_MOC_SSE
+        const __m128 left = _mm_add_ps(_mm_set1_ps(originX), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+        const __m128 right = _mm_add_ps(left, _mm_set1_ps(4.f));
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 edgeXLeft[3];
+        __m128 edgeXRight[3];
+        for (int e = 0; e < 3; e++) {
+            __m128 a = _mm_set1_ps(tri.edgeA[e]);
+            edgeXLeft[e] = _mm_mul_ps(a, left);
+            edgeXRight[e] = _mm_mul_ps(a, right);
+        }
+
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+            const float py = originY + static_cast<float>(row);
+            __m128 insideLeft = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            __m128 insideRight = insideLeft;
+            for (int e = 0; e < 3; e++) {
+                __m128 rowTerm = _mm_set1_ps(tri.edgeB[e] * py + tri.edgeC[e]);
+                insideLeft = _mm_and_ps(insideLeft, _mm_cmpgt_ps(_mm_add_ps(edgeXLeft[e], rowTerm), zero));
+                insideRight = _mm_and_ps(insideRight, _mm_cmpgt_ps(_mm_add_ps(edgeXRight[e], rowTerm), zero));
+            }
+            uint32_t rowBits = static_cast<uint32_t>(_mm_movemask_ps(insideLeft)) |
+                (static_cast<uint32_t>(_mm_movemask_ps(insideRight)) << 4);
+            mask |= rowBits << (row * TILE_WIDTH);
+        }
+#else
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+            const float py = originY + static_cast<float>(row);
+            for (uint32_t col = 0; col < TILE_WIDTH; col++) {
+                const float px = originX + static_cast<float>(col);
+                bool inside = true;
+                for (int e = 0; e < 3; e++) {
+                    inside = inside && tri.edgeA[e] * px + tri.edgeB[e] * py + tri.edgeC[e] > 0.f;
+                }
+                if (inside) mask |= 1u << (row * TILE_WIDTH + col);
+            }
+        }
+#endif
+
+        return mask;
+    }
+
+    void LveMaskedOcclusionCuller::updateTile(uint32_t tileIndex, uint32_t mask, float zMax) {
+        uint32_t oldMask = tileMask[tileIndex];
+        uint32_t newMask = oldMask | mask;
+        float working = oldMask != 0 ? std::max(tileWorkingDepth[tileIndex], zMax) : zMax;
+
+        if (newMask == ~0u) {
+            // Every pixel is now at or in front of the working depth
+            tileDepth[tileIndex] = std::min(tileDepth[tileIndex], working);
+            tileMask[tileIndex] = 0;
+            tileWorkingDepth[tileIndex] = 0.f;
+        } else {
+            tileMask[tileIndex] = newMask;
+            tileWorkingDepth[tileIndex] = working;
+        }
+    }
+
+    bool LveMaskedOcclusionCuller::isOccluded(LveGameObject& obj, const glm::mat4& viewProjection) const {
+        const auto& bounds = obj.model->getBoundingBox();
+        const glm::mat4 mvp = viewProjection * obj.transform.mat4();
+
+        glm::vec3 ndcMin{ std::numeric_limits<float>::max() };
+        glm::vec3 ndcMax{ -std::numeric_limits<float>::max() };
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 corner{
+                (i & 1) ? bounds.max.x : bounds.min.x,
+                (i & 2) ? bounds.max.y : bounds.min.y,
+                (i & 4) ? bounds.max.z : bounds.min.z,
+                1.f };
+            glm::vec4 clip = mvp * corner;
+
+            // Boxes crossing the near plane have no finite screen rect, keep them
+            if (clip.w <= std::numeric_limits<float>::epsilon()) return false;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+
+        if (ndcMin.z < 0.f) return false;
+        // Frustum culling is not the job of this test, off screen boxes are kept
+        if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f) return false;
+
+        auto toTile = [](float ndc, uint32_t pixels, uint32_t tileSize) {
+            int pixel = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * pixels));
+            return std::clamp(pixel, 0, static_cast<int>(pixels) - 1) / static_cast<int>(tileSize);
+        };
+        const int x0 = toTile(ndcMin.x, WIDTH, TILE_WIDTH);
+        const int x1 = toTile(ndcMax.x, WIDTH, TILE_WIDTH);
+        const int y0 = toTile(ndcMin.y, HEIGHT, TILE_HEIGHT);
+        const int y1 = toTile(ndcMax.y, HEIGHT, TILE_HEIGHT);
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                if (ndcMin.z <= tileDepth[y * TILES_X + x]) return false;
+            }
+        }
+        return true;
+    }
+}
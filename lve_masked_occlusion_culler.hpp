@@ -0,0 +1,89 @@
+#pragma once
+
+#include "lve_frame_info.hpp"
+#include "lve_game_object.hpp"
+#include "lve_thread_pool.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace lve {
+
+    // CPU occlusion culling against a low resolution masked depth buffer.
+    // Objects with an occluder component are rasterized into tiles of 8x4
+    // pixels, each holding a 32 bit coverage mask and two conservative far
+    // depths: a reference depth that bounds the whole tile and a working depth
+    // for the pixels covered so far. Once the mask fills up the working layer
+    // is folded into the reference. Tile rows are split into bands that the
+    // thread pool rasterizes in parallel, then object bounds are tested
+    // against the reference depths of the tiles they overlap. Nothing here
+    // touches the GPU, so the result is ready before any draws are recorded.
+    class LveMaskedOcclusionCuller {
+    public:
+        static constexpr uint32_t WIDTH = 320;
+        static constexpr uint32_t HEIGHT = 192;
+        static constexpr uint32_t TILE_WIDTH = 8;
+        static constexpr uint32_t TILE_HEIGHT = 4;
+        static constexpr uint32_t TILES_X = WIDTH / TILE_WIDTH;
+        static constexpr uint32_t TILES_Y = HEIGHT / TILE_HEIGHT;
+
+        LveMaskedOcclusionCuller(LveThreadPool& threadPool);
+
+        LveMaskedOcclusionCuller(const LveMaskedOcclusionCuller&) = delete;
+        LveMaskedOcclusionCuller& operator=(const LveMaskedOcclusionCuller&) = delete;
+
+        // Copies the triangle list of a model so it can be used as an occluder
+        static std::shared_ptr<OccluderComponent> createOccluder(const LveModel::Builder& builder);
+
+        void setEnabled(bool enable) { enabled = enable; }
+        bool isEnabled() const { return enabled; }
+
+        // Rasterizes this frame's occluders and adds the ids of hidden objects
+        void cullObjects(FrameInfo& frameInfo, std::unordered_set<LveGameObject::id_t>& occluded);
+
+        // Far depth bounding the given tile, 1 where nothing has been drawn
+        float getTileDepth(uint32_t tileX, uint32_t tileY) const {
+            return tileDepth[tileY * TILES_X + tileX];
+        }
+
+        uint32_t getTriangleCount() const { return static_cast<uint32_t>(triangles.size()); }
+        uint32_t getTestedCount() const { return testedCount; }
+        uint32_t getCulledCount() const { return culledCount; }
+
+    private:
+        // Edge equations are set up so covered pixel centers are positive
+        struct ScreenTriangle {
+            float edgeA[3];
+            float edgeB[3];
+            float edgeC[3];
+            float zMax;
+            int tileX0, tileX1, tileY0, tileY1;
+        };
+
+        void clear();
+        void setupTriangles(FrameInfo& frameInfo, const glm::mat4& viewProjection);
+        void rasterizeBand(uint32_t tileRowBegin, uint32_t tileRowEnd);
+        uint32_t coverageMask(const ScreenTriangle& tri, uint32_t tileX, uint32_t tileY) const;
+        void updateTile(uint32_t tileIndex, uint32_t mask, float zMax);
+        bool isOccluded(LveGameObject& obj, const glm::mat4& viewProjection) const;
+
+        LveThreadPool& threadPool;
+
+        // Structure of arrays, one entry per tile
+        std::vector<float> tileDepth;
+        std::vector<float> tileWorkingDepth;
+        std::vector<uint32_t> tileMask;
+
+        std::vector<ScreenTriangle> triangles;
+        std::vector<glm::vec4> clipScratch;
+
+        bool enabled = true;
+        uint32_t testedCount = 0;
+        uint32_t culledCount = 0;
+    };
+}
@@ -0,0 +1,170 @@
+#include "lve_material_system.hpp"
+
+#include "lve_profiler.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+    LveMaterialSystem::LveMaterialSystem(LveDevice& device) : lveDevice{ device } {
+        maxTextures = std::min(MAX_TEXTURES, lveDevice.maxBindlessSampledImages());
+
+        // Unwritten slots are never read, so the array doesn't have to be full
+        setLayout = LveDescriptorSetLayout::Builder(lveDevice)
+            .addBinding(
+                0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, maxTextures)
+            .setBindingFlags(
+                0,
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+
+        descriptorPool = LveDescriptorPool::Builder(lveDevice)
+            .setMaxSets(1)
+            .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1)
+            .build();
+
+        materialBuffer = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(Material),
+            MAX_MATERIALS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        materialBuffer->map();
+
+        // One table per frame in flight
+        textureTableBuffer = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(uint32_t) * MAX_TEXTURES,
+            LveSwapChain::MAX_FRAMES_IN_FLIGHT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            lveDevice.properties.limits.minStorageBufferOffsetAlignment);
+        textureTableBuffer->map();
+
+        auto materialInfo = materialBuffer->descriptorInfo();
+        auto textureTableInfo = textureTableBuffer->descriptorInfo(sizeof(uint32_t) * MAX_TEXTURES);
+        if (!LveDescriptorWriter(*setLayout, *descriptorPool)
+            .writeBuffer(1, &materialInfo)
+            .writeBuffer(2, &textureTableInfo)
+            .build(descriptorSet)) {
+            throw std::runtime_error("failed to allocate material descriptor set!");
+        }
+
+        slotTextures.resize(maxTextures);
+        for (uint32_t slot = maxTextures; slot > 0; slot--) {
+            freeSlots.push_back(slot - 1);
+        }
+
+        const uint32_t white = 0xffffffff;
+        addTexture(std::make_unique<LveTexture>(lveDevice, 1, 1, &white));
+        addMaterial(Material{});
+    }
+
+    LveMaterialSystem::~LveMaterialSystem() {}
+
+    uint32_t LveMaterialSystem::writeSlot(std::unique_ptr<LveTexture> texture) {
+        if (freeSlots.empty()) {
+            throw std::runtime_error("bindless texture array is full!");
+        }
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+
+        // Free slots aren't used by any frame in flight, so this is allowed
+        // while the set is bound
+        auto imageInfo = texture->descriptorInfo();
+        LveDescriptorWriter(*setLayout, *descriptorPool)
+            .writeImage(0, &imageInfo, slot)
+            .overwrite(descriptorSet);
+
+        slotTextures[slot] = std::move(texture);
+        return slot;
+    }
+
+    uint32_t LveMaterialSystem::addTexture(std::unique_ptr<LveTexture> texture) {
+        if (textureSlots.size() >= MAX_TEXTURES) {
+            throw std::runtime_error("too many texture ids!");
+        }
+        textureSlots.push_back(writeSlot(std::move(texture)));
+        LveProfiler::setGauge("materials.textures", textureSlots.size());
+        return static_cast<uint32_t>(textureSlots.size() - 1);
+    }
+
+    uint32_t LveMaterialSystem::loadTexture(const std::string& filepath) {
+        auto it = texturesByPath.find(filepath);
+        if (it != texturesByPath.end()) {
+            return it->second;
+        }
+
+        uint32_t textureId = addTexture(LveTexture::createTextureFromFile(lveDevice, filepath));
+        texturesByPath.emplace(filepath, textureId);
+        return textureId;
+    }
+
+    uint32_t LveMaterialSystem::reserveTexture() {
+        if (textureSlots.size() >= MAX_TEXTURES) {
+            throw std::runtime_error("too many texture ids!");
+        }
+        textureSlots.push_back(textureSlots[DEFAULT_TEXTURE]);
+        LveProfiler::setGauge("materials.textures", textureSlots.size());
+        return static_cast<uint32_t>(textureSlots.size() - 1);
+    }
+
+    void LveMaterialSystem::replaceTexture(uint32_t textureId, std::unique_ptr<LveTexture> texture) {
+        uint32_t oldSlot = textureSlots[textureId];
+        textureSlots[textureId] = writeSlot(std::move(texture));
+
+        // The default texture's slot is shared by reserved ids
+        if (oldSlot != textureSlots[DEFAULT_TEXTURE]) {
+            retiredSlots.push_back({ oldSlot, LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+        }
+    }
+
+    uint32_t LveMaterialSystem::addMaterial(const Material& material) {
+        if (materials.size() >= MAX_MATERIALS) {
+            throw std::runtime_error("material buffer is full!");
+        }
+        if (material.baseColorTexture >= textureSlots.size()) {
+            throw std::runtime_error("material uses a texture that was never added!");
+        }
+
+        Material copy = material;
+        materialBuffer->writeToIndex(&copy, static_cast<int>(materials.size()));
+        materials.push_back(material);
+        LveProfiler::setGauge("materials.materials", materials.size());
+        return static_cast<uint32_t>(materials.size() - 1);
+    }
+
+    void LveMaterialSystem::beginFrame(int frameIndex) {
+        for (auto& retired : retiredSlots) {
+            if (--retired.framesLeft <= 0) {
+                slotTextures[retired.slot] = nullptr;
+                freeSlots.push_back(retired.slot);
+            }
+        }
+        retiredSlots.erase(
+            std::remove_if(
+                retiredSlots.begin(),
+                retiredSlots.end(),
+                [](const RetiredSlot& retired) { return retired.framesLeft <= 0; }),
+            retiredSlots.end());
+
+        textureTableBuffer->writeToBuffer(
+            textureSlots.data(),
+            sizeof(uint32_t) * textureSlots.size(),
+            getDynamicOffset(frameIndex));
+    }
+
+    uint32_t LveMaterialSystem::getDynamicOffset(int frameIndex) const {
+        return static_cast<uint32_t>(frameIndex * textureTableBuffer->getAlignmentSize());
+    }
+}
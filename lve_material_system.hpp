@@ -0,0 +1,104 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_texture.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Matches the Material struct read from the material storage buffer
+    struct Material {
+        glm::vec4 baseColorFactor{ 1.f };
+        glm::vec2 uvScale{ 1.f };
+        uint32_t baseColorTexture = 0;
+        uint32_t padding = 0;
+    };
+
+    // Bindless textures and materials. Every texture is written into one
+    // partially bound, update-after-bind array of combined image samplers and
+    // every material into one storage buffer, both in a single descriptor set
+    // that is bound once per frame. Objects select their material by index,
+    // so switching materials between draws costs no descriptor binds.
+    //
+    // Materials refer to texture ids, which a per-frame table maps to array
+    // slots. Replacing a texture writes a free slot and changes the table of
+    // later frames, so frames in flight keep sampling the old one.
+    class LveMaterialSystem {
+    public:
+        static constexpr uint32_t MAX_TEXTURES = 4096;
+        static constexpr uint32_t MAX_MATERIALS = 1024;
+        // A 1x1 white texture and a plain white material using it
+        static constexpr uint32_t DEFAULT_TEXTURE = 0;
+        static constexpr uint32_t DEFAULT_MATERIAL = 0;
+
+        LveMaterialSystem(LveDevice& device);
+        ~LveMaterialSystem();
+
+        LveMaterialSystem(const LveMaterialSystem&) = delete;
+        LveMaterialSystem& operator=(const LveMaterialSystem&) = delete;
+
+        // Returns the new texture's id. Ids are never reused.
+        uint32_t addTexture(std::unique_ptr<LveTexture> texture);
+        // Loads each file once, later calls return the same id
+        uint32_t loadTexture(const std::string& filepath);
+        // An id that shows the default texture until it is replaced
+        uint32_t reserveTexture();
+        // Takes effect from the next beginFrame. The old texture is destroyed
+        // once no frame in flight can sample it.
+        void replaceTexture(uint32_t textureId, std::unique_ptr<LveTexture> texture);
+
+        // Materials can't be changed once added, frames in flight may read them
+        uint32_t addMaterial(const Material& material);
+        const Material& getMaterial(uint32_t materialIndex) const { return materials[materialIndex]; }
+
+        // Retires replaced textures and publishes this frame's texture table.
+        // Call after the frame's fence has been waited on.
+        void beginFrame(int frameIndex);
+
+        VkDescriptorSetLayout getSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+        VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+        // For the texture table, which is a dynamic storage buffer
+        uint32_t getDynamicOffset(int frameIndex) const;
+
+        uint32_t getTextureCount() const { return static_cast<uint32_t>(textureSlots.size()); }
+        uint32_t getMaterialCount() const { return static_cast<uint32_t>(materials.size()); }
+
+    private:
+        struct RetiredSlot {
+            uint32_t slot;
+            int framesLeft;
+        };
+
+        uint32_t writeSlot(std::unique_ptr<LveTexture> texture);
+
+        LveDevice& lveDevice;
+        uint32_t maxTextures;
+
+        std::unique_ptr<LveDescriptorSetLayout> setLayout;
+        std::unique_ptr<LveDescriptorPool> descriptorPool;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+        // Indexed by array slot
+        std::vector<std::unique_ptr<LveTexture>> slotTextures;
+        std::vector<uint32_t> freeSlots;
+        std::vector<RetiredSlot> retiredSlots;
+
+        // Indexed by texture id, copied into textureTableBuffer every frame
+        std::vector<uint32_t> textureSlots;
+        std::unordered_map<std::string, uint32_t> texturesByPath;
+        std::unique_ptr<LveBuffer> textureTableBuffer;
+
+        std::vector<Material> materials;
+        std::unique_ptr<LveBuffer> materialBuffer;
+    };
+}
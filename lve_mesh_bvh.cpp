@@ -0,0 +1,382 @@
+#include "lve_mesh_bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LVE_MESH_BVH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace lve {
+
+    namespace {
+        using BoundingBox = LveModel::BoundingBox;
+
+        constexpr uint32_t SAH_BINS = 16;
+        // Deeper ranges are halved by count, which bounds the binary depth by
+        // MAX_SAH_DEPTH + 32. Every four wide level splits at least once and
+        // pushes at most three siblings, so the traversal stack fits in 3 * 80.
+        constexpr uint32_t MAX_SAH_DEPTH = 48;
+        constexpr uint32_t MAX_STACK = 256;
+
+        const BoundingBox EMPTY_BOX{ glm::vec3{ FLT_MAX }, glm::vec3{ -FLT_MAX } };
+
+        struct Primitive {
+            BoundingBox bounds;
+            glm::vec3 center;
+            uint32_t index;
+        };
+
+        // Triangles [begin, end) of the primitive array, with their bounds
+        struct Range {
+            uint32_t begin;
+            uint32_t end;
+            uint32_t depth;
+            BoundingBox box;
+
+            uint32_t count() const { return end - begin; }
+        };
+
+        void grow(BoundingBox& box, const glm::vec3& min, const glm::vec3& max) {
+            box.min = glm::min(box.min, min);
+            box.max = glm::max(box.max, max);
+        }
+
+        float halfArea(const BoundingBox& box) {
+            glm::vec3 d = box.max - box.min;
+            if (d.x < 0.f || d.y < 0.f || d.z < 0.f) return 0.f;
+            return d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+
+        // Binned SAH split of a range in two, as LveBvh builds. range is a
+        // copy since left is usually the same Range.
+        void split(std::vector<Primitive>& primitives, Range range, Range& left, Range& right) {
+            uint32_t count = range.count();
+            BoundingBox centerBox = EMPTY_BOX;
+            for (uint32_t i = range.begin; i < range.end; i++) {
+                grow(centerBox, primitives[i].center, primitives[i].center);
+            }
+
+            int bestAxis = -1;
+            uint32_t bestBin = 0;
+            BoundingBox leftBox = EMPTY_BOX;
+            BoundingBox rightBox = EMPTY_BOX;
+            glm::vec3 centerExtent = centerBox.max - centerBox.min;
+            glm::vec3 binScale{ 0.f };
+            uint32_t binCount = std::min(SAH_BINS, count);
+            if (range.depth < MAX_SAH_DEPTH) {
+                for (int axis = 0; axis < 3; axis++) {
+                    binScale[axis] = centerExtent[axis] > 0.f ? binCount / centerExtent[axis] : 0.f;
+                }
+                BoundingBox bins[3][SAH_BINS];
+                uint32_t binCounts[3][SAH_BINS] = {};
+                for (auto& axisBins : bins) {
+                    std::fill(axisBins, axisBins + binCount, EMPTY_BOX);
+                }
+                for (uint32_t i = range.begin; i < range.end; i++) {
+                    const Primitive& primitive = primitives[i];
+                    for (int axis = 0; axis < 3; axis++) {
+                        uint32_t bin = std::min(binCount - 1,
+                            static_cast<uint32_t>((primitive.center[axis] - centerBox.min[axis]) * binScale[axis]));
+                        grow(bins[axis][bin], primitive.bounds.min, primitive.bounds.max);
+                        binCounts[axis][bin]++;
+                    }
+                }
+
+                float bestCost = FLT_MAX;
+                for (int axis = 0; axis < 3; axis++) {
+                    if (binScale[axis] == 0.f) continue;
+                    BoundingBox rightBoxes[SAH_BINS];
+                    uint32_t rightCounts[SAH_BINS];
+                    BoundingBox sweep = EMPTY_BOX;
+                    uint32_t sweepCount = 0;
+                    for (uint32_t bin = binCount; bin-- > 1;) {
+                        grow(sweep, bins[axis][bin].min, bins[axis][bin].max);
+                        sweepCount += binCounts[axis][bin];
+                        rightBoxes[bin] = sweep;
+                        rightCounts[bin] = sweepCount;
+                    }
+                    sweep = EMPTY_BOX;
+                    sweepCount = 0;
+                    for (uint32_t bin = 0; bin < binCount - 1; bin++) {
+                        grow(sweep, bins[axis][bin].min, bins[axis][bin].max);
+                        sweepCount += binCounts[axis][bin];
+                        if (sweepCount == 0 || rightCounts[bin + 1] == 0) continue;
+                        float cost = halfArea(sweep) * sweepCount +
+                            halfArea(rightBoxes[bin + 1]) * rightCounts[bin + 1];
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = bin;
+                            leftBox = sweep;
+                            rightBox = rightBoxes[bin + 1];
+                        }
+                    }
+                }
+            }
+
+            uint32_t middle = range.begin;
+            if (bestAxis >= 0) {
+                for (uint32_t i = range.begin; i < range.end; i++) {
+                    uint32_t bin = std::min(binCount - 1, static_cast<uint32_t>(
+                        (primitives[i].center[bestAxis] - centerBox.min[bestAxis]) * binScale[bestAxis]));
+                    if (bin <= bestBin) {
+                        std::swap(primitives[i], primitives[middle++]);
+                    }
+                }
+            } else {
+                // Coincident centers or too deep: halve by count on the widest axis
+                int axis = centerExtent.x >= centerExtent.y && centerExtent.x >= centerExtent.z ? 0
+                    : centerExtent.y >= centerExtent.z ? 1 : 2;
+                middle = range.begin + count / 2;
+                std::nth_element(primitives.begin() + range.begin, primitives.begin() + middle,
+                    primitives.begin() + range.end, [axis](const Primitive& a, const Primitive& b) {
+                        return a.center[axis] < b.center[axis];
+                    });
+                for (uint32_t i = range.begin; i < range.end; i++) {
+                    grow(i < middle ? leftBox : rightBox, primitives[i].bounds.min, primitives[i].bounds.max);
+                }
+            }
+
+            left = { range.begin, middle, range.depth + 1, leftBox };
+            right = { middle, range.end, range.depth + 1, rightBox };
+        }
+    }
+
+    LveMeshBvh::LveMeshBvh(const std::vector<LveModel::Vertex>& vertices, const std::vector<uint32_t>& indices)
+        : LveMeshBvh{ Geometry{
+            vertices.empty() ? nullptr : &vertices[0].position,
+            sizeof(LveModel::Vertex),
+            static_cast<uint32_t>(vertices.size()),
+            indices.empty() ? nullptr : indices.data(),
+            sizeof(uint32_t),
+            sizeof(uint32_t),
+            static_cast<uint32_t>(indices.size()) } } {}
+
+    LveMeshBvh::LveMeshBvh(const Geometry& geometry) {
+        uint32_t triangleCount = (geometry.indices == nullptr ? geometry.vertexCount : geometry.indexCount) / 3;
+        if (triangleCount >= (1u << 28)) {
+            throw std::runtime_error("too many triangles for a mesh BVH");
+        }
+        const unsigned char* positions = static_cast<const unsigned char*>(geometry.positions);
+        const unsigned char* indices = static_cast<const unsigned char*>(geometry.indices);
+        auto position = [&](uint32_t triangle, uint32_t corner) {
+            uint32_t i = triangle * 3 + corner;
+            uint32_t index = i;
+            if (indices != nullptr) {
+                const unsigned char* in = indices + i * geometry.indexStride;
+                if (geometry.indexSize == 1) {
+                    index = *in;
+                } else if (geometry.indexSize == 2) {
+                    uint16_t value;
+                    std::memcpy(&value, in, sizeof(value));
+                    index = value;
+                } else {
+                    std::memcpy(&index, in, sizeof(index));
+                }
+            }
+            if (index >= geometry.vertexCount) {
+                throw std::runtime_error("mesh BVH index out of range");
+            }
+            glm::vec3 value;
+            std::memcpy(&value, positions + index * geometry.positionStride, sizeof(value));
+            return value;
+        };
+
+        std::vector<Primitive> primitives(triangleCount);
+        BoundingBox rootBox = EMPTY_BOX;
+        for (uint32_t i = 0; i < triangleCount; i++) {
+            glm::vec3 a = position(i, 0);
+            glm::vec3 b = position(i, 1);
+            glm::vec3 c = position(i, 2);
+            Primitive& primitive = primitives[i];
+            primitive.bounds = { glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) };
+            primitive.center = (primitive.bounds.min + primitive.bounds.max) * .5f;
+            primitive.index = i;
+            grow(rootBox, primitive.bounds.min, primitive.bounds.max);
+        }
+        if (triangleCount == 0) return;
+
+        // Each node splits its range into up to four, always splitting the
+        // largest remaining child, then recurses into those too big for a leaf
+        struct Task {
+            uint32_t node;
+            Range range;
+        };
+        nodes.reserve(triangleCount / 8 + 1);
+        nodes.push_back({});
+        std::vector<Task> tasks{ { 0, { 0, triangleCount, 0, rootBox } } };
+        while (!tasks.empty()) {
+            Task task = tasks.back();
+            tasks.pop_back();
+
+            Range children[4] = { task.range };
+            uint32_t childCount = 1;
+            while (childCount < 4) {
+                int largest = -1;
+                for (uint32_t i = 0; i < childCount; i++) {
+                    if (children[i].count() > MAX_LEAF_SIZE &&
+                        (largest < 0 || halfArea(children[i].box) > halfArea(children[largest].box))) {
+                        largest = static_cast<int>(i);
+                    }
+                }
+                if (largest < 0) break;
+                split(primitives, children[largest], children[largest], children[childCount]);
+                childCount++;
+            }
+
+            for (uint32_t i = 0; i < 4; i++) {
+                const BoundingBox& box = i < childCount ? children[i].box : EMPTY_BOX;
+                Node& node = nodes[task.node];
+                node.minX[i] = box.min.x;
+                node.minY[i] = box.min.y;
+                node.minZ[i] = box.min.z;
+                node.maxX[i] = box.max.x;
+                node.maxY[i] = box.max.y;
+                node.maxZ[i] = box.max.z;
+                if (i >= childCount) {
+                    node.children[i] = EMPTY;
+                } else if (children[i].count() <= MAX_LEAF_SIZE) {
+                    node.children[i] = LEAF | children[i].begin << 3 | children[i].count();
+                } else {
+                    // May reallocate, so node is not used past here
+                    uint32_t child = static_cast<uint32_t>(nodes.size());
+                    nodes.push_back({});
+                    nodes[task.node].children[i] = child;
+                    tasks.push_back({ child, children[i] });
+                }
+            }
+        }
+
+        triangles.resize(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; i++) {
+            uint32_t index = primitives[i].index;
+            glm::vec3 a = position(index, 0);
+            triangles[i] = { a, position(index, 1) - a, position(index, 2) - a, index };
+        }
+    }
+
+    bool LveMeshBvh::intersect(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        Hit& hit) const {
+        if (nodes.empty()) return false;
+
+        glm::vec3 inverse = 1.f / direction;
+        // Slab distances are (bound - origin) * inverse, which stays infinite
+        // rather than NaN along axis aligned rays. The near bound of each axis
+        // is picked by the direction's sign, so inverted boxes of unused
+        // children are missed without a separate test.
+        bool negative[3] = { inverse.x < 0.f, inverse.y < 0.f, inverse.z < 0.f };
+#ifdef LVE_MESH_BVH_SSE
+        const __m128 inverseX = _mm_set1_ps(inverse.x);
+        const __m128 inverseY = _mm_set1_ps(inverse.y);
+        const __m128 inverseZ = _mm_set1_ps(inverse.z);
+        const __m128 originX = _mm_set1_ps(origin.x);
+        const __m128 originY = _mm_set1_ps(origin.y);
+        const __m128 originZ = _mm_set1_ps(origin.z);
+        const __m128 zero = _mm_setzero_ps();
+#endif
+
+        struct Entry {
+            uint32_t child;
+            float distance;
+        };
+        Entry stack[MAX_STACK];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = { 0, 0.f };
+        float best = maxDistance;
+        bool found = false;
+
+        while (stackSize > 0) {
+            Entry entry = stack[--stackSize];
+            if (entry.distance > best) continue;
+
+            if (entry.child & LEAF) {
+                uint32_t first = (entry.child & ~LEAF) >> 3;
+                uint32_t count = entry.child & 7;
+                for (uint32_t i = first; i < first + count; i++) {
+                    // Moller-Trumbore, without culling back faces
+                    const Triangle& triangle = triangles[i];
+                    glm::vec3 p = glm::cross(direction, triangle.edge2);
+                    float determinant = glm::dot(triangle.edge1, p);
+                    if (determinant == 0.f) continue;
+                    float inverseDeterminant = 1.f / determinant;
+                    glm::vec3 s = origin - triangle.v0;
+                    float u = glm::dot(s, p) * inverseDeterminant;
+                    if (u < 0.f || u > 1.f) continue;
+                    glm::vec3 q = glm::cross(s, triangle.edge1);
+                    float v = glm::dot(direction, q) * inverseDeterminant;
+                    if (v < 0.f || u + v > 1.f) continue;
+                    float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+                    if (t >= 0.f && t <= best) {
+                        best = t;
+                        hit = { triangle.index, t, u, v };
+                        found = true;
+                    }
+                }
+                continue;
+            }
+
+            const Node& node = nodes[entry.child];
+            const float* nearX = negative[0] ? node.maxX : node.minX;
+            const float* nearY = negative[1] ? node.maxY : node.minY;
+            const float* nearZ = negative[2] ? node.maxZ : node.minZ;
+            const float* farX = negative[0] ? node.minX : node.maxX;
+            const float* farY = negative[1] ? node.minY : node.maxY;
+            const float* farZ = negative[2] ? node.minZ : node.maxZ;
+            alignas(16) float distances[4];
+            int hitMask = 0;
+#ifdef LVE_MESH_BVH_SSE
+            __m128 tNear = _mm_max_ps(
+                _mm_max_ps(
+                    _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), originX), inverseX),
+                    _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), originY), inverseY)),
+                _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), originZ), inverseZ), zero));
+            __m128 tFar = _mm_min_ps(
+                _mm_min_ps(
+                    _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), originX), inverseX),
+                    _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), originY), inverseY)),
+                _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), originZ), inverseZ), _mm_set1_ps(best)));
+            hitMask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+            _mm_store_ps(distances, tNear);
+#else
+            for (int i = 0; i < 4; i++) {
+                float tNear = std::max({ 0.f,
+                    (nearX[i] - origin.x) * inverse.x,
+                    (nearY[i] - origin.y) * inverse.y,
+                    (nearZ[i] - origin.z) * inverse.z });
+                float tFar = std::min({ best,
+                    (farX[i] - origin.x) * inverse.x,
+                    (farY[i] - origin.y) * inverse.y,
+                    (farZ[i] - origin.z) * inverse.z });
+                distances[i] = tNear;
+                hitMask |= (tNear <= tFar) << i;
+            }
+#endif
+            if (hitMask == 0) continue;
+
+            // Push the hit children farthest first so the nearest is popped next
+            Entry hits[4];
+            uint32_t hitCount = 0;
+            for (uint32_t i = 0; i < 4; i++) {
+                if (!(hitMask & (1 << i))) continue;
+                Entry child{ node.children[i], distances[i] };
+                uint32_t j = hitCount++;
+                for (; j > 0 && hits[j - 1].distance < child.distance; j--) {
+                    hits[j] = hits[j - 1];
+                }
+                hits[j] = child;
+            }
+            for (uint32_t i = 0; i < hitCount; i++) {
+                stack[stackSize++] = hits[i];
+            }
+        }
+        return found;
+    }
+}
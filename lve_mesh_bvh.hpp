@@ -0,0 +1,90 @@
+#pragma once
+
+#include "lve_model.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+    // Object space triangle BVH of a model, for ray queries such as picking.
+    //
+    // Built top down with binned SAH and stored four wide: each node holds
+    // the boxes of up to four children as structure of arrays, so one ray is
+    // tested against all four with a few SIMD instructions, and children are
+    // visited nearest first. Triangles are copied in leaf order with their
+    // edges precomputed, so leaves don't touch the vertex array.
+    class LveMeshBvh {
+    public:
+        struct Hit {
+            // Index of the triangle in the model's triangle list
+            uint32_t triangle;
+            // In multiples of the ray direction
+            float distance;
+            // Barycentrics of the second and third vertex
+            float u;
+            float v;
+        };
+
+        // Positions and indices read in place, so a BVH can be built straight
+        // from e.g. a mapped file. Both are strided and need not be aligned.
+        // Positions are three floats, indices are indexSize (1, 2 or 4) byte
+        // unsigned integers, and indices is null for consecutive triples.
+        struct Geometry {
+            const void* positions;
+            size_t positionStride;
+            uint32_t vertexCount;
+            const void* indices;
+            size_t indexStride;
+            uint32_t indexSize;
+            uint32_t indexCount;
+        };
+
+        // Triangles are indices[3 * i] to indices[3 * i + 2], or consecutive
+        // vertex triples when indices is empty, as LveModel draws them
+        LveMeshBvh(const std::vector<LveModel::Vertex>& vertices, const std::vector<uint32_t>& indices);
+        explicit LveMeshBvh(const Geometry& geometry);
+
+        LveMeshBvh(const LveMeshBvh&) = delete;
+        LveMeshBvh& operator=(const LveMeshBvh&) = delete;
+
+        // Nearest triangle closer than maxDistance, hit from either side
+        bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const;
+
+        uint32_t getTriangleCount() const { return static_cast<uint32_t>(triangles.size()); }
+        uint32_t getNodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+        size_t getMemorySize() const { return nodes.size() * sizeof(Node) + triangles.size() * sizeof(Triangle); }
+
+    private:
+        static constexpr uint32_t MAX_LEAF_SIZE = 4;
+        // Leaf children are LEAF | first triangle << 3 | triangle count
+        static constexpr uint32_t LEAF = 1u << 31;
+        static constexpr uint32_t EMPTY = LEAF;
+
+        // 112 bytes. Unused children have inverted boxes, which every ray misses.
+        struct alignas(16) Node {
+            float minX[4];
+            float minY[4];
+            float minZ[4];
+            float maxX[4];
+            float maxY[4];
+            float maxZ[4];
+            uint32_t children[4];
+        };
+
+        struct Triangle {
+            glm::vec3 v0;
+            glm::vec3 edge1;
+            glm::vec3 edge2;
+            uint32_t index;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<Triangle> triangles;
+    };
+}
@@ -1,8 +1,8 @@
 #include "lve_model.hpp"
 
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.hpp>
+#include "lve_archive.hpp"
+#include "lve_mesh_bvh.hpp"
+#include "lve_obj_parser.hpp"
 
 #include <cassert>
 #include <cstring>
@@ -11,9 +11,54 @@
 namespace lve {
 	LveModel::LveModel(
 		LveDevice &device,
-		const LveModel::Builder &builder) : lveDevice{ device } {
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+		const LveModel::Builder &builder)
+		: lveDevice{ device },
+		boundingBox{ builder.boundingBox ? *builder.boundingBox : computeBoundingBox(builder.vertices) } {
+		meshBvh = builder.meshBvh ? builder.meshBvh : std::make_shared<LveMeshBvh>(builder.vertices, builder.indices);
+		createVertexBuffers(static_cast<uint32_t>(builder.vertices.size()), [&](Vertex* vertices) {
+			std::memcpy(vertices, builder.vertices.data(), builder.vertices.size() * sizeof(Vertex));
+		});
+		createIndexBuffers(static_cast<uint32_t>(builder.indices.size()), [&](uint32_t* indices) {
+			std::memcpy(indices, builder.indices.data(), builder.indices.size() * sizeof(uint32_t));
+		});
+	}
+
+	LveModel::LveModel(
+		LveDevice& device,
+		uint32_t vertexCount,
+		uint32_t indexCount,
+		const BoundingBox& boundingBox,
+		const std::function<void(Vertex*)>& writeVertices,
+		const std::function<void(uint32_t*)>& writeIndices,
+		std::shared_ptr<const LveMeshBvh> meshBvh)
+		: lveDevice{ device }, boundingBox{ boundingBox }, meshBvh{ std::move(meshBvh) } {
+		createVertexBuffers(vertexCount, writeVertices);
+		createIndexBuffers(indexCount, writeIndices);
+	}
+
+	LveModel::LveModel(
+		LveDevice& device,
+		uint32_t vertexCount,
+		uint32_t indexCount,
+		const BoundingBox& boundingBox)
+		: lveDevice{ device }, boundingBox{ boundingBox }, vertexCount{ vertexCount }, indexCount{ indexCount } {
+		assert(vertexCount >= 3 && "Vertex count must be at least 3");
+		vertexBuffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			sizeof(Vertex),
+			vertexCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		hasIndexBuffer = indexCount > 0;
+		if (hasIndexBuffer) {
+			indexBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(uint32_t),
+				indexCount,
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
 	}
 
 	LveModel::~LveModel() {
@@ -29,11 +74,75 @@ namespace lve {
 		return std::make_unique<LveModel>(device, builder);
 	}
 
-	void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-		vertexCount = static_cast<uint32_t>(vertices.size());
+	std::shared_ptr<LveModel> LveModel::createWithUploadQueue(
+		LveDevice& device,
+		LveUploadQueue& uploadQueue,
+		std::shared_ptr<const Builder> builder,
+		std::function<void()> onUploaded) {
+		std::shared_ptr<LveModel> model{ new LveModel{
+			device,
+			static_cast<uint32_t>(builder->vertices.size()),
+			static_cast<uint32_t>(builder->indices.size()),
+			builder->boundingBox ? *builder->boundingBox : computeBoundingBox(builder->vertices) } };
+		model->meshBvh = builder->meshBvh ? builder->meshBvh
+			: std::make_shared<LveMeshBvh>(builder->vertices, builder->indices);
+
+		// Vertex sizes are multiples of 4, so the indices stay aligned
+		VkDeviceSize vertexBytes = model->getVertexBufferSize();
+		VkDeviceSize indexBytes = model->getIndexBufferSize();
+		LveUploadQueue::Upload upload{};
+		upload.size = vertexBytes + indexBytes;
+		upload.write = [builder, vertexBytes, indexBytes](void* dst) {
+			std::memcpy(dst, builder->vertices.data(), vertexBytes);
+			if (indexBytes > 0) {
+				std::memcpy(static_cast<char*>(dst) + vertexBytes, builder->indices.data(), indexBytes);
+			}
+		};
+		LveModel* target = model.get();
+		upload.record = [target, vertexBytes, indexBytes](
+			VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize offset) {
+			VkBufferCopy copy{ offset, 0, vertexBytes };
+			vkCmdCopyBuffer(commandBuffer, srcBuffer, target->vertexBuffer->getBuffer(), 1, &copy);
+			if (indexBytes > 0) {
+				copy = { offset + vertexBytes, 0, indexBytes };
+				vkCmdCopyBuffer(commandBuffer, srcBuffer, target->indexBuffer->getBuffer(), 1, &copy);
+			}
+
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		};
+		// Holding the model here keeps its buffers alive while the copy runs
+		upload.complete = [model, onUploaded = std::move(onUploaded)]() {
+			if (onUploaded) onUploaded();
+		};
+		uploadQueue.enqueue(std::move(upload));
+		return model;
+	}
+
+	LveModel::BoundingBox LveModel::computeBoundingBox(const std::vector<Vertex>& vertices) {
+		BoundingBox boundingBox{};
+		if (!vertices.empty()) {
+			boundingBox.min = boundingBox.max = vertices[0].position;
+			for (const auto& vertex : vertices) {
+				boundingBox.min = glm::min(boundingBox.min, vertex.position);
+				boundingBox.max = glm::max(boundingBox.max, vertex.position);
+			}
+		}
+		return boundingBox;
+	}
+
+	void LveModel::createVertexBuffers(uint32_t vertexCount, const std::function<void(Vertex*)>& write) {
+		this->vertexCount = vertexCount;
 		assert(vertexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-		uint32_t vertexSize = sizeof(vertices[0]);
+		VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
+		uint32_t vertexSize = sizeof(Vertex);
 
 		LveBuffer stagingBuffer{
 			lveDevice,
@@ -44,7 +153,7 @@ namespace lve {
 		};
 
 		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		write(static_cast<Vertex*>(stagingBuffer.getMappedMemory()));
 	
 		vertexBuffer = std::make_unique<LveBuffer>(
 			lveDevice,
@@ -56,16 +165,16 @@ namespace lve {
 		lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
 	}
 
-	void LveModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
-		indexCount = static_cast<uint32_t>(indices.size());
+	void LveModel::createIndexBuffers(uint32_t indexCount, const std::function<void(uint32_t*)>& write) {
+		this->indexCount = indexCount;
 		hasIndexBuffer = indexCount > 0;
 
 		if (!hasIndexBuffer) {
 			return;
 		}
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-		uint32_t indexSize = sizeof(indices[0]);
+		VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+		uint32_t indexSize = sizeof(uint32_t);
 
 		LveBuffer stagingBuffer{
 			lveDevice,
@@ -76,7 +185,7 @@ namespace lve {
 		};
 
 		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+		write(static_cast<uint32_t*>(stagingBuffer.getMappedMemory()));
 
 		indexBuffer = std::make_unique<LveBuffer>(
 			lveDevice,
@@ -130,54 +239,14 @@ namespace lve {
 	}
 
 	void LveModel::Builder::loadModel(const std::string& filepath) {
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
-
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-			throw std::runtime_error(warn + err);
-		}
-
 		vertices.clear();
 		indices.clear();
 
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex{};
-
-				if (index.vertex_index >= 0) {
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2],
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2],
-					};
-				}
-
-				if (index.normal_index >= 0) {
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2],
-					};
-				}
-
-				if (index.texcoord_index >= 0) {
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1],
-					};
-				}
-
-				vertices.push_back(vertex);
-			}
-		}
+		// Parsed in place from the mapped file or a mounted asset archive
+		auto data = LveArchive::readAsset(filepath);
+		LveObjParser::parse(data->data(), data->size(), filepath, vertices);
+		meshBvh = std::make_shared<LveMeshBvh>(vertices, indices);
+		boundingBox = computeBoundingBox(vertices);
 	}
 
 	/* ALTERNATIVE TO THIS^^
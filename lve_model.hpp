@@ -2,6 +2,7 @@
 
 #include "lve_buffer.hpp"
 #include "lve_device.hpp"
+#include "lve_upload_queue.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -9,10 +10,14 @@
 #include <glm/glm.hpp>
 
 // std
+#include <functional>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace lve {
+    class LveMeshBvh;
+
     class LveModel {
     public:
         struct Vertex {
@@ -30,14 +35,38 @@ namespace lve {
             }
         };
 
+        struct BoundingBox {
+            glm::vec3 min{};
+            glm::vec3 max{};
+        };
+
         struct Builder {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            // Triangle BVH for ray queries, built by loadModel so that it is
+            // built on whichever thread loads the model. Models built from a
+            // Builder without one build it themselves.
+            std::shared_ptr<const LveMeshBvh> meshBvh{};
+            // Bounds of the vertex positions, likewise computed by loadModel
+            std::optional<BoundingBox> boundingBox{};
 
             void loadModel(const std::string& filepath);
         };
 
         LveModel(LveDevice& device, const LveModel::Builder& builder);
+        // For loaders that copy their data straight into the mapped staging
+        // buffers instead of filling a Builder. writeVertices must write
+        // every field of vertexCount vertices, writeIndices indexCount
+        // indices; it isn't called when indexCount is 0. Without a meshBvh the
+        // model can't be ray cast against its triangles.
+        LveModel(
+            LveDevice& device,
+            uint32_t vertexCount,
+            uint32_t indexCount,
+            const BoundingBox& boundingBox,
+            const std::function<void(Vertex*)>& writeVertices,
+            const std::function<void(uint32_t*)>& writeIndices,
+            std::shared_ptr<const LveMeshBvh> meshBvh = nullptr);
         ~LveModel();
 
         LveModel(const LveModel&) = delete;
@@ -45,15 +74,37 @@ namespace lve {
 
         static std::unique_ptr<LveModel> createModelFromFile(
             LveDevice& device, const std::string& filepath);
+        // Queues the contents on the upload queue instead of copying them
+        // synchronously. The model must not be drawn before onUploaded runs,
+        // from the queue's poll; until then the queue keeps it alive.
+        static std::shared_ptr<LveModel> createWithUploadQueue(
+            LveDevice& device,
+            LveUploadQueue& uploadQueue,
+            std::shared_ptr<const Builder> builder,
+            std::function<void()> onUploaded);
 
         void bind(VkCommandBuffer commandBuffer);
         void draw(VkCommandBuffer commandBuffer);
 
+        // Object space bounds of the vertex positions
+        const BoundingBox& getBoundingBox() const { return boundingBox; }
+        // Object space triangles for ray casts, may be null
+        const LveMeshBvh* getMeshBvh() const { return meshBvh.get(); }
+
+        VkDeviceSize getVertexBufferSize() const { return sizeof(Vertex) * vertexCount; }
+        VkDeviceSize getIndexBufferSize() const { return sizeof(uint32_t) * indexCount; }
+
     private:
-        void createVertexBuffers(const std::vector<Vertex>& vertices);
-        void createIndexBuffers(const std::vector<uint32_t>& indices);
+        // Device local buffers only, filled by createWithUploadQueue
+        LveModel(LveDevice& device, uint32_t vertexCount, uint32_t indexCount, const BoundingBox& boundingBox);
+
+        static BoundingBox computeBoundingBox(const std::vector<Vertex>& vertices);
+        void createVertexBuffers(uint32_t vertexCount, const std::function<void(Vertex*)>& write);
+        void createIndexBuffers(uint32_t indexCount, const std::function<void(uint32_t*)>& write);
 
         LveDevice& lveDevice;
+        BoundingBox boundingBox{};
+        std::shared_ptr<const LveMeshBvh> meshBvh;
 
         std::unique_ptr<LveBuffer> vertexBuffer;
         uint32_t vertexCount;
@@ -0,0 +1,225 @@
+#include "lve_obj_parser.hpp"
+
+// std
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LVE_OBJ_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace lve {
+
+    namespace {
+        struct FaceCorner {
+            int position;
+            int uv;
+            int normal;
+        };
+
+        struct ParseState {
+            std::vector<glm::vec3> positions;
+            std::vector<glm::vec3> colors;
+            std::vector<glm::vec2> uvs;
+            std::vector<glm::vec3> normals;
+            std::vector<FaceCorner> face;
+        };
+
+#ifdef LVE_OBJ_SSE2
+        uint32_t countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+        }
+#endif
+
+        // Returns end if the last line has no newline
+        const char* findNewline(const char* p, const char* end) {
+#ifdef LVE_OBJ_SSE2
+            const __m128i newline = _mm_set1_epi8('\n');
+            while (end - p >= 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+                if (mask != 0) {
+                    return p + countTrailingZeros(mask);
+                }
+                p += 16;
+            }
+#endif
+            const void* found = std::memchr(p, '\n', static_cast<size_t>(end - p));
+            return found != nullptr ? static_cast<const char*>(found) : end;
+        }
+
+        bool isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        const char* skipSpaces(const char* p, const char* end) {
+            while (p < end && isSpace(*p)) p++;
+            return p;
+        }
+
+        // Leaves value unchanged when the line has no more numbers
+        bool parseFloat(const char*& p, const char* end, float& value) {
+            p = skipSpaces(p, end);
+            // from_chars doesn't accept a leading plus
+            if (p < end && *p == '+') p++;
+            auto result = std::from_chars(p, end, value);
+            if (result.ec == std::errc::result_out_of_range) {
+                // Underflow in practice; tinyobj flushes those to zero too
+                value = 0.f;
+            } else if (result.ec != std::errc{}) {
+                return false;
+            }
+            p = result.ptr;
+            return true;
+        }
+
+        bool parseInt(const char*& p, const char* end, int& value) {
+            if (p < end && *p == '+') p++;
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc{}) {
+                return false;
+            }
+            p = result.ptr;
+            return true;
+        }
+
+        // 1 based, or negative relative to the attributes read so far. Absent
+        // indices are -1.
+        int resolveIndex(int index, size_t count) {
+            return index > 0 ? index - 1 : static_cast<int>(count) + index;
+        }
+
+        [[noreturn]] void parseError(const std::string& name, uint32_t line, const char* message) {
+            throw std::runtime_error(name + ":" + std::to_string(line) + ": " + message);
+        }
+    }
+
+    void LveObjParser::parse(
+        const unsigned char* data,
+        size_t size,
+        const std::string& name,
+        std::vector<LveModel::Vertex>& vertices) {
+        ParseState state{};
+        const char* p = reinterpret_cast<const char*>(data);
+        const char* end = p + size;
+        uint32_t lineNumber = 0;
+
+        auto emit = [&](const FaceCorner& corner) {
+            LveModel::Vertex vertex{};
+            vertex.position = state.positions[corner.position];
+            vertex.color = state.colors[corner.position];
+            if (corner.normal >= 0) vertex.normal = state.normals[corner.normal];
+            if (corner.uv >= 0) vertex.uv = state.uvs[corner.uv];
+            vertices.push_back(vertex);
+        };
+
+        while (p < end) {
+            const char* lineEnd = findNewline(p, end);
+            lineNumber++;
+            const char* q = skipSpaces(p, lineEnd);
+            p = lineEnd < end ? lineEnd + 1 : end;
+            if (lineEnd - q < 2) {
+                continue;
+            }
+
+            if (q[0] == 'v') {
+                if (isSpace(q[1])) {
+                    // "v x y z" with optional "r g b"; a w component is read
+                    // as red, the way tinyobj does
+                    q += 2;
+                    glm::vec3 position{ 0.f };
+                    glm::vec3 color{ 1.f };
+                    for (int i = 0; i < 3; i++) parseFloat(q, lineEnd, position[i]);
+                    for (int i = 0; i < 3; i++) parseFloat(q, lineEnd, color[i]);
+                    state.positions.push_back(position);
+                    state.colors.push_back(color);
+                } else if (q[1] == 'n' && lineEnd - q > 2 && isSpace(q[2])) {
+                    q += 3;
+                    glm::vec3 normal{ 0.f };
+                    for (int i = 0; i < 3; i++) parseFloat(q, lineEnd, normal[i]);
+                    state.normals.push_back(normal);
+                } else if (q[1] == 't' && lineEnd - q > 2 && isSpace(q[2])) {
+                    q += 3;
+                    glm::vec2 uv{ 0.f };
+                    for (int i = 0; i < 2; i++) parseFloat(q, lineEnd, uv[i]);
+                    state.uvs.push_back(uv);
+                }
+                continue;
+            }
+
+            if (q[0] != 'f' || !isSpace(q[1])) {
+                continue;
+            }
+
+            // "f v", "f v/vt", "f v//vn" or "f v/vt/vn" per corner
+            q += 2;
+            state.face.clear();
+            for (q = skipSpaces(q, lineEnd); q < lineEnd; q = skipSpaces(q, lineEnd)) {
+                FaceCorner corner{ -1, -1, -1 };
+                int index;
+                if (!parseInt(q, lineEnd, index) || index == 0) {
+                    parseError(name, lineNumber, "invalid face vertex index");
+                }
+                corner.position = resolveIndex(index, state.positions.size());
+                if (q < lineEnd && *q == '/') {
+                    q++;
+                    if (q < lineEnd && *q != '/' && parseInt(q, lineEnd, index) && index != 0) {
+                        corner.uv = resolveIndex(index, state.uvs.size());
+                    }
+                    if (q < lineEnd && *q == '/') {
+                        q++;
+                        if (parseInt(q, lineEnd, index) && index != 0) {
+                            corner.normal = resolveIndex(index, state.normals.size());
+                        }
+                    }
+                }
+                if (q < lineEnd && !isSpace(*q)) {
+                    parseError(name, lineNumber, "malformed face");
+                }
+
+                // Forward references aren't supported, they would need a
+                // second pass
+                if (corner.position < 0 ||
+                    static_cast<size_t>(corner.position) >= state.positions.size() ||
+                    corner.uv < -1 || corner.uv >= static_cast<int>(state.uvs.size()) ||
+                    corner.normal < -1 || corner.normal >= static_cast<int>(state.normals.size())) {
+                    parseError(name, lineNumber, "face index out of range");
+                }
+                state.face.push_back(corner);
+            }
+
+            const auto& face = state.face;
+            if (face.size() < 3) {
+                continue;
+            }
+            if (face.size() == 4) {
+                glm::vec3 e02 = state.positions[face[2].position] - state.positions[face[0].position];
+                glm::vec3 e13 = state.positions[face[3].position] - state.positions[face[1].position];
+                const bool splitAt02 = glm::dot(e02, e02) < glm::dot(e13, e13);
+                const int quadCorners[2][6] = { { 0, 1, 3, 1, 2, 3 }, { 0, 1, 2, 0, 2, 3 } };
+                for (int corner : quadCorners[splitAt02 ? 1 : 0]) {
+                    emit(face[corner]);
+                }
+                continue;
+            }
+            for (size_t i = 1; i + 1 < face.size(); i++) {
+                emit(face[0]);
+                emit(face[i]);
+                emit(face[i + 1]);
+            }
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "lve_model.hpp"
+
+// std
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Wavefront OBJ reader that writes straight into the model's vertex array
+    // in one pass over the file contents, typically a mapped file. Lines are
+    // found with SSE2 where available and numbers parsed with std::from_chars.
+    //
+    // The output matches what tinyobj produced for Builder::loadModel: one
+    // vertex per triangle corner, vertex colors defaulting to white, missing
+    // normals and uvs left zero. Quads are split along the shorter diagonal
+    // like tinyobj does; larger polygons are fan triangulated, which matches
+    // tinyobj for convex polygons up to triangle order. Materials, groups and
+    // smoothing groups are ignored.
+    class LveObjParser {
+    public:
+        // Appends to vertices. name is only used in error messages.
+        static void parse(
+            const unsigned char* data,
+            size_t size,
+            const std::string& name,
+            std::vector<LveModel::Vertex>& vertices);
+    };
+}
@@ -0,0 +1,91 @@
+#include "lve_picker.hpp"
+
+#include "lve_mesh_bvh.hpp"
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+
+namespace lve {
+
+    LvePicker::LvePicker(LveBvh& sceneBvh, LveGameObject::Map& gameObjects)
+        : sceneBvh{ sceneBvh }, gameObjects{ gameObjects } {}
+
+    bool LvePicker::pick(const LveCamera& camera, glm::vec2 cursor, glm::vec2 viewportSize, Hit& hit) const {
+        if (viewportSize.x <= 0.f || viewportSize.y <= 0.f) return false;
+        glm::vec2 ndc = (cursor + .5f) / viewportSize * 2.f - 1.f;
+        glm::vec3 origin;
+        glm::vec3 direction;
+        camera.getRay(ndc, origin, direction);
+        return raycast(origin, direction, camera.getFar(), hit);
+    }
+
+    bool LvePicker::raycast(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        Hit& hit,
+        LveGameObject::id_t ignore) const {
+        LveProfiler::ScopedTimer timer{ "picker.raycast" };
+        glm::vec3 worldDirection = glm::normalize(direction);
+
+        // raycast only calls this for boxes closer than the best hit, and
+        // keeps any distance up to it, so best follows its own maxDistance
+        float best = maxDistance;
+        uint32_t bestTriangle = NO_TRIANGLE;
+        auto intersect = [&](LveGameObject::id_t id, float boxDistance) {
+            auto it = gameObjects.find(id);
+            if (id == ignore || it == gameObjects.end() || it->second.model == nullptr) return -1.f;
+
+            const LveMeshBvh* meshBvh = it->second.model->getMeshBvh();
+            if (meshBvh == nullptr) {
+                best = boxDistance;
+                bestTriangle = NO_TRIANGLE;
+                return boxDistance;
+            }
+            // The direction isn't renormalized, so object space distances
+            // are world space ones
+            glm::mat4 inverse = glm::inverse(it->second.transform.mat4());
+            glm::vec3 objectOrigin = glm::vec3(inverse * glm::vec4(origin, 1.f));
+            glm::vec3 objectDirection = glm::vec3(inverse * glm::vec4(worldDirection, 0.f));
+            LveMeshBvh::Hit meshHit{};
+            if (!meshBvh->intersect(objectOrigin, objectDirection, best, meshHit)) return -1.f;
+            best = meshHit.distance;
+            bestTriangle = meshHit.triangle;
+            return meshHit.distance;
+        };
+
+        LveBvh::RayHit sceneHit{};
+        if (!sceneBvh.raycast(origin, worldDirection, maxDistance, sceneHit, intersect)) return false;
+        hit = { sceneHit.id, bestTriangle, sceneHit.distance, origin + worldDirection * sceneHit.distance };
+        return true;
+    }
+
+    bool LvePicker::dropToGround(LveGameObject::id_t id, float maxDistance) {
+        auto it = gameObjects.find(id);
+        if (it == gameObjects.end()) return false;
+        LveGameObject& gameObject = it->second;
+
+        // Down from the center and near the corners of the bottom of the
+        // bounds, resting on whichever surface is closest
+        LveBvh::BoundingBox bounds = LveBvh::computeWorldBounds(gameObject);
+        glm::vec3 center = (bounds.min + bounds.max) * .5f;
+        glm::vec3 extent = (bounds.max - bounds.min) * .45f;
+        const glm::vec2 corners[5] = { { 0.f, 0.f }, { -1.f, -1.f }, { 1.f, -1.f }, { -1.f, 1.f }, { 1.f, 1.f } };
+        float drop = maxDistance;
+        bool found = false;
+        for (const glm::vec2& corner : corners) {
+            glm::vec3 origin{ center.x + corner.x * extent.x, bounds.max.y, center.z + corner.y * extent.z };
+            Hit hit{};
+            if (raycast(origin, { 0.f, 1.f, 0.f }, drop, hit, id)) {
+                drop = hit.distance;
+                found = true;
+            }
+        }
+        if (!found) return false;
+
+        gameObject.transform.translation.y += drop;
+        sceneBvh.update(id, LveBvh::computeWorldBounds(gameObject));
+        return true;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "lve_bvh.hpp"
+#include "lve_camera.hpp"
+#include "lve_game_object.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+
+namespace lve {
+
+    // Ray queries against the triangles of the scene's game objects. The
+    // scene BVH finds the objects whose boxes the ray enters, nearest first,
+    // and each is refined against its model's LveMeshBvh in object space,
+    // which stops as soon as no remaining box is closer than the best hit.
+    class LvePicker {
+    public:
+        static constexpr uint32_t NO_TRIANGLE = ~0u;
+        static constexpr LveGameObject::id_t NO_OBJECT = ~0u;
+
+        struct Hit {
+            LveGameObject::id_t id;
+            // NO_TRIANGLE for a model without a mesh BVH, which is hit at its bounds
+            uint32_t triangle;
+            // World units along the ray
+            float distance;
+            glm::vec3 position;
+        };
+
+        // Both must outlive the picker. Objects that move must have been
+        // updated in sceneBvh and committed before they are picked.
+        LvePicker(LveBvh& sceneBvh, LveGameObject::Map& gameObjects);
+
+        LvePicker(const LvePicker&) = delete;
+        LvePicker& operator=(const LvePicker&) = delete;
+
+        // Nearest object under a cursor position in pixels from the top left
+        // of a viewport of the given size
+        bool pick(const LveCamera& camera, glm::vec2 cursor, glm::vec2 viewportSize, Hit& hit) const;
+        // Nearest object along a world space ray, except ignore. Objects
+        // without a model, such as point lights, are never hit.
+        bool raycast(
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            float maxDistance,
+            Hit& hit,
+            LveGameObject::id_t ignore = NO_OBJECT) const;
+
+        // Moves an object along +y, which is down, until it rests on the
+        // nearest surface below its bounds, and updates its box in the scene
+        // BVH. Returns false when nothing is within maxDistance below it.
+        bool dropToGround(LveGameObject::id_t id, float maxDistance = 1000.f);
+
+    private:
+        LveBvh& sceneBvh;
+        LveGameObject::Map& gameObjects;
+    };
+}
@@ -1,10 +1,11 @@
 #include "lve_pipeline.hpp"
 
 #include "lve_model.hpp"
+#include "lve_pipeline_cache.hpp"
+#include "lve_shader_module_cache.hpp"
 
 // std
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 
@@ -16,64 +17,70 @@ namespace lve {
         const std::string& fragFilepath,
         const PipelineConfigInfo& configInfo)
         : lveDevice{ device } {
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+        // Shared with other pipelines, and released once none of them needs it to build
+        auto& cache = lveDevice.shaderModuleCache();
+        auto vertShaderModule = cache.loadPermutation(vertFilepath, configInfo.shaderDefines);
+        auto fragShaderModule = cache.loadPermutation(fragFilepath, configInfo.shaderDefines);
+        createGraphicsPipeline(*vertShaderModule, *fragShaderModule, configInfo);
     }
 
-    LvePipeline::~LvePipeline() {
-        vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
+    LvePipeline::LvePipeline(
+        LveDevice& device,
+        const ShaderCode& vertCode,
+        const ShaderCode& fragCode,
+        const PipelineConfigInfo& configInfo)
+        : lveDevice{ device } {
+        auto vertShaderModule =
+            lveDevice.shaderModuleCache().loadFromMemory(vertCode.code, vertCode.codeSize);
+        auto fragShaderModule =
+            lveDevice.shaderModuleCache().loadFromMemory(fragCode.code, fragCode.codeSize);
+        createGraphicsPipeline(*vertShaderModule, *fragShaderModule, configInfo);
     }
 
-    std::vector<char> LvePipeline::readFile(const std::string& filepath) {
-        std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file: " + filepath);
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-        return buffer;
+    LvePipeline::LvePipeline(
+        LveDevice& device,
+        const LveShaderModule& vertShaderModule,
+        const LveShaderModule& fragShaderModule,
+        const PipelineConfigInfo& configInfo)
+        : lveDevice{ device } {
+        createGraphicsPipeline(vertShaderModule, fragShaderModule, configInfo);
     }
 
     void LvePipeline::createGraphicsPipeline(
-        const std::string& vertFilepath,
-        const std::string& fragFilepath,
+        const LveShaderModule& vertShaderModule,
+        const LveShaderModule& fragShaderModule,
         const PipelineConfigInfo& configInfo) {
         assert(
             configInfo.pipelineLayout != VK_NULL_HANDLE &&
             "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
         assert(
-            configInfo.renderPass != VK_NULL_HANDLE &&
+            (configInfo.renderPass != VK_NULL_HANDLE || lveDevice.dynamicRenderingEnabled()) &&
             "Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-        auto vertCode = readFile(vertFilepath);
-        auto fragCode = readFile(fragFilepath);
-
-        createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount =
+            static_cast<uint32_t>(configInfo.specializationEntries.size());
+        specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+        specializationInfo.dataSize = configInfo.specializationData.size();
+        specializationInfo.pData = configInfo.specializationData.data();
+        const VkSpecializationInfo* pSpecializationInfo =
+            configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
 
         VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].module = vertShaderModule.getShaderModule();
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = pSpecializationInfo;
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].module = fragShaderModule.getShaderModule();
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
         auto bindingDescriptions = configInfo.bindingDescriptions;
         auto attributeDescriptions = configInfo.attributeDescriptions;
@@ -102,35 +109,51 @@ namespace lve {
         pipelineInfo.renderPass = configInfo.renderPass;
         pipelineInfo.subpass = configInfo.subpass;
 
-        pipelineInfo.basePipelineIndex = -1;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-        if (vkCreateGraphicsPipelines(
-            lveDevice.device(),
-            VK_NULL_HANDLE,
-            1,
-            &pipelineInfo,
-            nullptr,
-            &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline");
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        if (configInfo.renderPass == VK_NULL_HANDLE) {
+            renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            renderingInfo.colorAttachmentCount =
+                configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+            renderingInfo.pColorAttachmentFormats = &configInfo.colorAttachmentFormat;
+            renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+            renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+            pipelineInfo.pNext = &renderingInfo;
+            pipelineInfo.subpass = 0;
         }
-    }
 
-    void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module");
-        }
+        LvePipelineCache::Key key =
+            LvePipelineCache::graphicsPipelineKey(configInfo, vertShaderModule, fragShaderModule);
+        cachedPipeline = lveDevice.pipelineCache().getOrCreate(
+            key, [&](VkPipelineCache pipelineCache) {
+                VkPipeline pipeline;
+                if (vkCreateGraphicsPipelines(
+                    lveDevice.device(),
+                    pipelineCache,
+                    1,
+                    &pipelineInfo,
+                    nullptr,
+                    &pipeline) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create graphics pipeline");
+                }
+                return pipeline;
+            });
+        graphicsPipeline = cachedPipeline->getPipeline();
     }
 
     void LvePipeline::bind(VkCommandBuffer commandBuffer) {
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }
 
+    void LvePipeline::setRenderTarget(
+        PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget) {
+        configInfo.renderPass = renderTarget.renderPass;
+        configInfo.colorAttachmentFormat = renderTarget.colorFormat;
+        configInfo.depthAttachmentFormat = renderTarget.depthFormat;
+    }
+
     void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -205,4 +228,47 @@ namespace lve {
         configInfo.attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
     }
 
+    LveComputePipeline::LveComputePipeline(
+        LveDevice& device,
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout)
+        : lveDevice{ device } {
+        assert(
+            pipelineLayout != VK_NULL_HANDLE &&
+            "Cannot create compute pipeline: no pipelineLayout provided");
+
+        auto compShaderModule = lveDevice.shaderModuleCache().load(compFilepath);
+
+        VkPipelineShaderStageCreateInfo shaderStage{};
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStage.module = compShaderModule->getShaderModule();
+        shaderStage.pName = "main";
+        shaderStage.pSpecializationInfo = nullptr;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = shaderStage;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(
+            lveDevice.device(),
+            lveDevice.pipelineCache().getPipelineCache(),
+            1,
+            &pipelineInfo,
+            nullptr,
+            &computePipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+
+    LveComputePipeline::~LveComputePipeline() {
+        vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+    }
+
+    void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
 }
\ No newline at end of file
@@ -1,13 +1,25 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_pipeline_cache.hpp"
+#include "lve_shader_compiler.hpp"
 
 // std
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace lve {
 
+    // What a graphics pipeline renders into. With dynamic rendering the render
+    // pass is VK_NULL_HANDLE and pipelines are built against the formats alone.
+    struct RenderTargetInfo {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    };
+
     struct PipelineConfigInfo {
         PipelineConfigInfo() = default;
         PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -27,16 +39,43 @@ namespace lve {
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // Only used when renderPass is VK_NULL_HANDLE
+        VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+        // Specialization constants for both stages, see setSpecializationConstant
+        std::vector<VkSpecializationMapEntry> specializationEntries{};
+        std::vector<uint8_t> specializationData{};
+        // Preprocessor defines selecting a shader permutation
+        LveShaderCompiler::Defines shaderDefines{};
     };
 
+    // SPIR-V already in memory, codeSize is in bytes
+    struct ShaderCode {
+        const uint32_t* code = nullptr;
+        size_t codeSize = 0;
+    };
+
+    class LveShaderModule;
+
     class LvePipeline {
     public:
+        // Shaders are resolved by name through the device's shader module cache
         LvePipeline(
             LveDevice& device,
             const std::string& vertFilepath,
             const std::string& fragFilepath,
             const PipelineConfigInfo& configInfo);
-        ~LvePipeline();
+        LvePipeline(
+            LveDevice& device,
+            const ShaderCode& vertCode,
+            const ShaderCode& fragCode,
+            const PipelineConfigInfo& configInfo);
+        LvePipeline(
+            LveDevice& device,
+            const LveShaderModule& vertShaderModule,
+            const LveShaderModule& fragShaderModule,
+            const PipelineConfigInfo& configInfo);
 
         LvePipeline(const LvePipeline&) = delete;
         LvePipeline& operator=(const LvePipeline&) = delete;
@@ -44,20 +83,69 @@ namespace lve {
         void bind(VkCommandBuffer commandBuffer);
 
         static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+        static void setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget);
 
-    private:
-        static std::vector<char> readFile(const std::string& filepath);
+        // Sets a constant_id in both stages, replacing an earlier value for it.
+        // An earlier value of another size has its bytes removed, so each id
+        // has one entry and the data stays packed.
+        template <typename T>
+        static void setSpecializationConstant(
+            PipelineConfigInfo& configInfo, uint32_t constantId, const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "constant must be plain data");
+            auto& entries = configInfo.specializationEntries;
+            auto& data = configInfo.specializationData;
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->constantID != constantId) continue;
+                if (it->size == sizeof(T)) {
+                    std::memcpy(&data[it->offset], &value, sizeof(T));
+                    return;
+                }
+                uint32_t offset = it->offset;
+                uint32_t size = static_cast<uint32_t>(it->size);
+                data.erase(data.begin() + offset, data.begin() + offset + size);
+                entries.erase(it);
+                for (auto& entry : entries) {
+                    if (entry.offset > offset) entry.offset -= size;
+                }
+                break;
+            }
+
+            VkSpecializationMapEntry entry{};
+            entry.constantID = constantId;
+            entry.offset = static_cast<uint32_t>(data.size());
+            entry.size = sizeof(T);
+            entries.push_back(entry);
+            data.resize(entry.offset + sizeof(T));
+            std::memcpy(&data[entry.offset], &value, sizeof(T));
+        }
 
+    private:
         void createGraphicsPipeline(
-            const std::string& vertFilepath,
-            const std::string& fragFilepath,
+            const LveShaderModule& vertShaderModule,
+            const LveShaderModule& fragShaderModule,
             const PipelineConfigInfo& configInfo);
 
-        void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
         LveDevice& lveDevice;
+        // Shared with every LvePipeline built from an identical description
+        std::shared_ptr<LvePipelineCache::CachedPipeline> cachedPipeline;
         VkPipeline graphicsPipeline;
-        VkShaderModule vertShaderModule;
-        VkShaderModule fragShaderModule;
+    };
+
+    class LveComputePipeline {
+    public:
+        LveComputePipeline(
+            LveDevice& device,
+            const std::string& compFilepath,
+            VkPipelineLayout pipelineLayout);
+        ~LveComputePipeline();
+
+        LveComputePipeline(const LveComputePipeline&) = delete;
+        LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+    private:
+        LveDevice& lveDevice;
+        VkPipeline computePipeline;
     };
 }
\ No newline at end of file
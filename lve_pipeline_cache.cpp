@@ -0,0 +1,236 @@
+#include "lve_pipeline_cache.hpp"
+
+#include "lve_pipeline.hpp"
+#include "lve_profiler.hpp"
+#include "lve_shader_module_cache.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace lve {
+
+    LvePipelineCache::LvePipelineCache(
+        VkDevice device,
+        const VkPhysicalDeviceProperties& properties,
+        const std::string& filepath)
+        : device{ device }, properties{ properties }, filepath{ filepath } {
+        std::vector<char> data;
+        std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if (!file || !isCompatible(data)) {
+                data.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache");
+        }
+        LveProfiler::setGauge("pipelines.cacheLoadedKB", static_cast<int64_t>(data.size() / 1024));
+    }
+
+    LvePipelineCache::~LvePipelineCache() {
+        save();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    }
+
+    bool LvePipelineCache::isCompatible(const std::vector<char>& data) const {
+        // Data from another driver or GPU is ignored rather than handed to the driver
+        if (data.size() < 16 + VK_UUID_SIZE) return false;
+
+        uint32_t header[4];
+        std::memcpy(header, data.data(), sizeof(header));
+        return header[0] >= 16 + VK_UUID_SIZE &&
+            header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header[2] == properties.vendorID &&
+            header[3] == properties.deviceID &&
+            std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void LvePipelineCache::save() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return;
+        }
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::ofstream file{ filepath, std::ios::binary | std::ios::trunc };
+        if (!file.is_open()) {
+            std::cerr << "Could not write pipeline cache to " << filepath << std::endl;
+            return;
+        }
+        file.write(data.data(), size);
+    }
+
+    std::shared_ptr<LvePipelineCache::CachedPipeline> LvePipelineCache::getOrCreate(
+        const Key& key, const std::function<VkPipeline(VkPipelineCache)>& create) {
+        std::shared_ptr<Slot> slot;
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            auto& entry = slots[key];
+            if (entry == nullptr) {
+                entry = std::make_shared<Slot>();
+            }
+            slot = entry;
+            if (slots.size() >= pruneThreshold) {
+                pruneSlots();
+            }
+        }
+
+        std::lock_guard<std::mutex> slotLock{ slot->mutex };
+        if (auto pipeline = slot->pipeline.lock()) {
+            LveProfiler::addCounter("pipelines.cacheHits", 1);
+            return pipeline;
+        }
+
+        auto pipeline = std::make_shared<CachedPipeline>(device, create(pipelineCache));
+        slot->pipeline = pipeline;
+        LveProfiler::addCounter("pipelines.created", 1);
+        return pipeline;
+    }
+
+    void LvePipelineCache::pruneSlots() {
+        // A slot only the map holds can't be mid creation, since slots are
+        // only handed out under the lock. Runs when the map has doubled.
+        for (auto it = slots.begin(); it != slots.end();) {
+            bool unused = it->second.use_count() == 1 && it->second->pipeline.expired();
+            it = unused ? slots.erase(it) : std::next(it);
+        }
+        pruneThreshold = std::max<size_t>(64, slots.size() * 2);
+    }
+
+    void LvePipelineCache::describeConfigInfo(const PipelineConfigInfo& configInfo, Key& h) {
+
+        h.add(configInfo.bindingDescriptions.size());
+        for (const auto& binding : configInfo.bindingDescriptions) {
+            h.add(binding.binding);
+            h.add(binding.stride);
+            h.add(binding.inputRate);
+        }
+        h.add(configInfo.attributeDescriptions.size());
+        for (const auto& attribute : configInfo.attributeDescriptions) {
+            h.add(attribute.location);
+            h.add(attribute.binding);
+            h.add(attribute.format);
+            h.add(attribute.offset);
+        }
+
+        h.add(configInfo.viewportInfo.viewportCount);
+        h.add(configInfo.viewportInfo.scissorCount);
+
+        h.add(configInfo.inputAssemblyInfo.topology);
+        h.add(configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+        const auto& raster = configInfo.rasterizationInfo;
+        h.add(raster.depthClampEnable);
+        h.add(raster.rasterizerDiscardEnable);
+        h.add(raster.polygonMode);
+        h.add(raster.cullMode);
+        h.add(raster.frontFace);
+        h.add(raster.depthBiasEnable);
+        h.add(raster.depthBiasConstantFactor);
+        h.add(raster.depthBiasClamp);
+        h.add(raster.depthBiasSlopeFactor);
+        h.add(raster.lineWidth);
+
+        const auto& multisample = configInfo.multisampleInfo;
+        h.add(multisample.rasterizationSamples);
+        h.add(multisample.sampleShadingEnable);
+        h.add(multisample.minSampleShading);
+        h.add(multisample.alphaToCoverageEnable);
+        h.add(multisample.alphaToOneEnable);
+        h.add(multisample.pSampleMask != nullptr);
+        if (multisample.pSampleMask != nullptr) {
+            uint32_t maskWords = (static_cast<uint32_t>(multisample.rasterizationSamples) + 31) / 32;
+            h.bytes(multisample.pSampleMask, maskWords * sizeof(VkSampleMask));
+        }
+
+        const auto& blend = configInfo.colorBlendAttachment;
+        h.add(blend.blendEnable);
+        h.add(blend.srcColorBlendFactor);
+        h.add(blend.dstColorBlendFactor);
+        h.add(blend.colorBlendOp);
+        h.add(blend.srcAlphaBlendFactor);
+        h.add(blend.dstAlphaBlendFactor);
+        h.add(blend.alphaBlendOp);
+        h.add(blend.colorWriteMask);
+        h.add(configInfo.colorBlendInfo.logicOpEnable);
+        h.add(configInfo.colorBlendInfo.logicOp);
+        h.add(configInfo.colorBlendInfo.attachmentCount);
+        h.add(configInfo.colorBlendInfo.blendConstants);
+
+        const auto& depth = configInfo.depthStencilInfo;
+        h.add(depth.depthTestEnable);
+        h.add(depth.depthWriteEnable);
+        h.add(depth.depthCompareOp);
+        h.add(depth.depthBoundsTestEnable);
+        h.add(depth.stencilTestEnable);
+        for (const VkStencilOpState* stencil : { &depth.front, &depth.back }) {
+            h.add(stencil->failOp);
+            h.add(stencil->passOp);
+            h.add(stencil->depthFailOp);
+            h.add(stencil->compareOp);
+            h.add(stencil->compareMask);
+            h.add(stencil->writeMask);
+            h.add(stencil->reference);
+        }
+        h.add(depth.minDepthBounds);
+        h.add(depth.maxDepthBounds);
+
+        h.add(configInfo.dynamicStateEnables.size());
+        for (auto state : configInfo.dynamicStateEnables) {
+            h.add(state);
+        }
+
+        // Layouts are deduplicated by the layout cache, so equal layouts
+        // share a handle
+        h.add(configInfo.pipelineLayout);
+        h.add(configInfo.renderPass != VK_NULL_HANDLE);
+        h.add(configInfo.subpass);
+        h.add(configInfo.colorAttachmentFormat);
+        h.add(configInfo.depthAttachmentFormat);
+
+        h.add(configInfo.specializationEntries.size());
+        for (const auto& entry : configInfo.specializationEntries) {
+            h.add(entry.constantID);
+            h.add(entry.offset);
+            h.add(entry.size);
+        }
+        h.add(configInfo.specializationData.size());
+        h.bytes(configInfo.specializationData.data(), configInfo.specializationData.size());
+        h.add(configInfo.shaderDefines.size());
+        for (const auto& define : configInfo.shaderDefines) {
+            h.add(define.first);
+            h.add(define.second);
+        }
+    }
+
+    LvePipelineCache::Key LvePipelineCache::graphicsPipelineKey(
+        const PipelineConfigInfo& configInfo,
+        const LveShaderModule& vertShaderModule,
+        const LveShaderModule& fragShaderModule) {
+        Key key{};
+        describeConfigInfo(configInfo, key);
+        for (const LveShaderModule* module : { &vertShaderModule, &fragShaderModule }) {
+            const std::vector<uint32_t>& code = module->getCode();
+            key.add(code.size());
+            key.bytes(code.data(), code.size() * sizeof(uint32_t));
+        }
+        return key;
+    }
+}
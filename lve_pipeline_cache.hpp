@@ -0,0 +1,122 @@
+#pragma once
+
+#include "lve_hash.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    struct PipelineConfigInfo;
+    class LveShaderModule;
+
+    // Device wide pipeline deduplication. Pipelines are keyed by a canonical
+    // description: the shader modules' SPIR-V, vertex layout, fixed function
+    // state and render target formats. Identical descriptions share one
+    // VkPipeline, which lives as long as any LvePipeline uses it.
+    // New pipelines are created through a VkPipelineCache that is saved to
+    // disk, so driver compilation is also skipped on later runs.
+    class LvePipelineCache {
+    public:
+        // Canonical description of everything that affects a created
+        // pipeline. Lookups hash it and then compare it in full, so two
+        // descriptions never share a pipeline through a hash collision.
+        class Key {
+        public:
+            void bytes(const void* data, size_t size) {
+                const uint8_t* p = static_cast<const uint8_t*>(data);
+                description.insert(description.end(), p, p + size);
+            }
+
+            template <typename T>
+            void add(const T& value) { bytes(&value, sizeof(T)); }
+
+            void add(const std::string& value) {
+                add(value.size());
+                bytes(value.data(), value.size());
+            }
+
+            uint64_t hash() const { return LveHasher::hash64(description.data(), description.size()); }
+            bool operator==(const Key& other) const { return description == other.description; }
+
+        private:
+            std::vector<uint8_t> description;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash()); }
+        };
+
+        class CachedPipeline {
+        public:
+            CachedPipeline(VkDevice device, VkPipeline pipeline)
+                : device{ device }, pipeline{ pipeline } {}
+            ~CachedPipeline() { vkDestroyPipeline(device, pipeline, nullptr); }
+
+            CachedPipeline(const CachedPipeline&) = delete;
+            CachedPipeline& operator=(const CachedPipeline&) = delete;
+
+            VkPipeline getPipeline() const { return pipeline; }
+
+        private:
+            VkDevice device;
+            VkPipeline pipeline;
+        };
+
+        LvePipelineCache(
+            VkDevice device,
+            const VkPhysicalDeviceProperties& properties,
+            const std::string& filepath = "pipeline_cache.bin");
+        ~LvePipelineCache();
+
+        LvePipelineCache(const LvePipelineCache&) = delete;
+        LvePipelineCache& operator=(const LvePipelineCache&) = delete;
+
+        // Returns the live pipeline for this key, or calls create to make one.
+        // Concurrent requests for the same key wait for a single creation,
+        // different keys are created in parallel.
+        std::shared_ptr<CachedPipeline> getOrCreate(
+            const Key& key, const std::function<VkPipeline(VkPipelineCache)>& create);
+
+        // Passed to every vkCreate*Pipelines call, it is internally synchronized
+        VkPipelineCache getPipelineCache() const { return pipelineCache; }
+
+        // Appends everything in the config that affects the created pipeline.
+        // The render pass is described by its formats rather than its handle,
+        // since a pipeline works with any compatible render pass.
+        static void describeConfigInfo(const PipelineConfigInfo& configInfo, Key& key);
+        // Canonical key of a graphics pipeline, shaders identified by content
+        static Key graphicsPipelineKey(
+            const PipelineConfigInfo& configInfo,
+            const LveShaderModule& vertShaderModule,
+            const LveShaderModule& fragShaderModule);
+
+    private:
+        struct Slot {
+            std::mutex mutex;
+            std::weak_ptr<CachedPipeline> pipeline;
+        };
+
+        bool isCompatible(const std::vector<char>& data) const;
+        void pruneSlots();
+        void save();
+
+        VkDevice device;
+        VkPhysicalDeviceProperties properties;
+        std::string filepath;
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+        std::mutex mutex;
+        std::unordered_map<Key, std::shared_ptr<Slot>, KeyHash> slots;
+        size_t pruneThreshold = 64;
+    };
+}
@@ -0,0 +1,279 @@
+#include "lve_pipeline_manager.hpp"
+
+#include "lve_pipeline_cache.hpp"
+#include "lve_profiler.hpp"
+#include "lve_shader_module_cache.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace lve {
+
+    bool LvePipelineManager::Handle::isReady() const {
+        return entry != nullptr &&
+            entry->built.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    LvePipeline& LvePipelineManager::Handle::get() const {
+        if (entry == nullptr) {
+            throw std::runtime_error("Pipeline handle is empty!");
+        }
+        if (!isReady() && fallback != nullptr) {
+            if (fallback->built.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                fallback->built.get();
+                return *fallback->pipeline;
+            }
+        }
+
+        // Rethrows if the build failed
+        entry->built.get();
+        return *entry->pipeline;
+    }
+
+    LvePipelineManager::LvePipelineManager(LveDevice& device, LveThreadPool& threadPool)
+        : lveDevice{ device }, threadPool{ threadPool } {}
+
+    LvePipelineManager::~LvePipelineManager() {
+        // Builds in flight reference entries and the device
+        for (auto& kv : entries) {
+            kv.second->built.wait();
+        }
+        for (auto& reload : reloads) {
+            reload->built.wait();
+        }
+    }
+
+    LvePipelineManager::Handle LvePipelineManager::request(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const PipelineConfigInfo& configInfo,
+        const Handle& fallback) {
+        LvePipelineCache::Key key{};
+        LvePipelineCache::describeConfigInfo(configInfo, key);
+        key.add(vertFilepath);
+        key.add(fragFilepath);
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            LveProfiler::addCounter("pipelines.deduplicated", 1);
+            return Handle{ it->second, fallback.entry };
+        }
+
+        auto entry = std::make_shared<Entry>();
+        entry->vertFilepath = vertFilepath;
+        entry->fragFilepath = fragFilepath;
+        copyConfigInfo(configInfo, entry->configInfo);
+
+        beginBuild();
+        Entry* buildEntry = entry.get();
+        entry->built = threadPool.submit([this, buildEntry]() {
+            BuildGuard guard{ this };
+            LveProfiler::ScopedTimer timer{ "pipelines.build" };
+            buildEntry->pipeline = std::make_unique<LvePipeline>(
+                lveDevice,
+                buildEntry->vertFilepath,
+                buildEntry->fragFilepath,
+                buildEntry->configInfo);
+        }).share();
+
+        entries.emplace(std::move(key), entry);
+        LveProfiler::addCounter("pipelines.requested", 1);
+        return Handle{ entry, fallback.entry };
+    }
+
+    void LvePipelineManager::beginBuild() {
+        // Shader modules stay loaded until the last queued build has finished
+        if (buildsInFlight++ == 0) {
+            lveDevice.shaderModuleCache().setRetainModules(true);
+        }
+    }
+
+    void LvePipelineManager::finishBuild() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (--buildsInFlight == 0) {
+            lveDevice.shaderModuleCache().setRetainModules(false);
+        }
+    }
+
+    void LvePipelineManager::waitIdle() {
+        LveProfiler::ScopedTimer timer{ "pipelines.waitIdle" };
+
+        std::vector<std::shared_future<void>> pending;
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            for (auto& kv : entries) {
+                pending.push_back(kv.second->built);
+            }
+        }
+        for (auto& future : pending) {
+            future.get();
+        }
+    }
+
+    void LvePipelineManager::reloadShader(
+        const std::string& shaderFilepath, ShaderCodePtr code) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        for (auto& kv : entries) {
+            auto& entry = kv.second;
+            bool vertMatches =
+                matchShader(*entry, entry->vertFilepath, shaderFilepath, code, entry->vertCode);
+            bool fragMatches =
+                matchShader(*entry, entry->fragFilepath, shaderFilepath, code, entry->fragCode);
+            if (!vertMatches && !fragMatches) continue;
+
+            auto reload = std::make_unique<Reload>();
+            reload->entry = entry;
+            reload->generation = ++entry->reloadGeneration;
+
+            beginBuild();
+            Reload* buildReload = reload.get();
+            // The code is captured here, the entry's copy may change before the job runs
+            reload->built = threadPool.submit(
+                [this, buildReload, vertCode = entry->vertCode, fragCode = entry->fragCode]() {
+                    BuildGuard guard{ this };
+                    LveProfiler::ScopedTimer timer{ "pipelines.rebuild" };
+                    const Entry& buildEntry = *buildReload->entry;
+                    buildReload->pipeline = buildPipeline(
+                        buildEntry.vertFilepath,
+                        buildEntry.fragFilepath,
+                        vertCode,
+                        fragCode,
+                        buildEntry.configInfo);
+                });
+            reloads.push_back(std::move(reload));
+        }
+    }
+
+    bool LvePipelineManager::matchShader(
+        const Entry& entry,
+        const std::string& stageFilepath,
+        const std::string& shaderFilepath,
+        const ShaderCodePtr& code,
+        ShaderCodePtr& stageCode) {
+        const auto& defines = entry.configInfo.shaderDefines;
+        if (defines.empty()) {
+            if (stageFilepath != shaderFilepath) return false;
+            stageCode = code;
+            return true;
+        }
+
+        // A rebuilt precompiled permutation
+        if (LveShaderModuleCache::permutationName(stageFilepath, defines) == shaderFilepath) {
+            stageCode = code;
+            return true;
+        }
+        // The new code lacks the defines, but the rebuild compiles the changed source again
+        return LveShaderCompiler::isAvailable() && stageFilepath == shaderFilepath;
+    }
+
+    std::unique_ptr<LvePipeline> LvePipelineManager::buildPipeline(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const ShaderCodePtr& vertCode,
+        const ShaderCodePtr& fragCode,
+        const PipelineConfigInfo& configInfo) {
+        auto& cache = lveDevice.shaderModuleCache();
+        const auto& defines = configInfo.shaderDefines;
+        auto vertShaderModule = vertCode != nullptr
+            ? cache.loadFromMemory(vertCode->data(), vertCode->size() * sizeof(uint32_t))
+            : cache.loadPermutation(vertFilepath, defines);
+        auto fragShaderModule = fragCode != nullptr
+            ? cache.loadFromMemory(fragCode->data(), fragCode->size() * sizeof(uint32_t))
+            : cache.loadPermutation(fragFilepath, defines);
+        return std::make_unique<LvePipeline>(
+            lveDevice, *vertShaderModule, *fragShaderModule, configInfo);
+    }
+
+    void LvePipelineManager::applyReloads() {
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        for (auto& retired : retiredPipelines) {
+            retired.framesLeft--;
+        }
+        retiredPipelines.erase(
+            std::remove_if(
+                retiredPipelines.begin(),
+                retiredPipelines.end(),
+                [](const RetiredPipeline& retired) { return retired.framesLeft <= 0; }),
+            retiredPipelines.end());
+
+        for (auto it = reloads.begin(); it != reloads.end();) {
+            Reload& reload = **it;
+            Entry& entry = *reload.entry;
+            bool entryBuilt =
+                entry.built.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            if (!entryBuilt ||
+                reload.built.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+
+            try {
+                reload.built.get();
+                // A newer reload may have finished first
+                if (reload.generation > entry.appliedGeneration) {
+                    // Frames in flight may still be drawing with the old one
+                    retiredPipelines.push_back(
+                        { std::move(entry.pipeline), LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+                    entry.pipeline = std::move(reload.pipeline);
+                    entry.appliedGeneration = reload.generation;
+                    LveProfiler::addCounter("pipelines.reloaded", 1);
+                }
+            } catch (const std::exception& e) {
+                // Keep drawing with the current pipeline until the shader is fixed
+                std::cerr << "Pipeline rebuild failed: " << e.what() << std::endl;
+            }
+            it = reloads.erase(it);
+        }
+    }
+
+    size_t LvePipelineManager::getPipelineCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return entries.size();
+    }
+
+    size_t LvePipelineManager::getPendingCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        size_t pending = 0;
+        for (auto& kv : entries) {
+            if (kv.second->built.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                pending++;
+            }
+        }
+        return pending;
+    }
+
+    void LvePipelineManager::copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst) {
+        dst.bindingDescriptions = src.bindingDescriptions;
+        dst.attributeDescriptions = src.attributeDescriptions;
+        dst.viewportInfo = src.viewportInfo;
+        dst.inputAssemblyInfo = src.inputAssemblyInfo;
+        dst.rasterizationInfo = src.rasterizationInfo;
+        dst.multisampleInfo = src.multisampleInfo;
+        dst.colorBlendAttachment = src.colorBlendAttachment;
+        dst.colorBlendInfo = src.colorBlendInfo;
+        dst.depthStencilInfo = src.depthStencilInfo;
+        dst.dynamicStateEnables = src.dynamicStateEnables;
+        dst.dynamicStateInfo = src.dynamicStateInfo;
+        dst.pipelineLayout = src.pipelineLayout;
+        dst.renderPass = src.renderPass;
+        dst.subpass = src.subpass;
+        dst.colorAttachmentFormat = src.colorAttachmentFormat;
+        dst.depthAttachmentFormat = src.depthAttachmentFormat;
+        dst.specializationEntries = src.specializationEntries;
+        dst.specializationData = src.specializationData;
+        dst.shaderDefines = src.shaderDefines;
+
+        // Repoint the create infos at the copy's own storage
+        dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+        dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+        dst.dynamicStateInfo.dynamicStateCount =
+            static_cast<uint32_t>(dst.dynamicStateEnables.size());
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Builds graphics pipelines on the thread pool. Requests are keyed by the
+    // pipeline config's description and shader files, so asking for the same variant
+    // twice shares one build. Handles return a fallback variant until their own
+    // pipeline is ready, and only block if neither one has been built yet.
+    class LvePipelineManager {
+        struct Entry;
+
+    public:
+        class Handle {
+        public:
+            Handle() = default;
+
+            bool isValid() const { return entry != nullptr; }
+            bool isReady() const;
+
+            // The requested pipeline, or the fallback while it is still building
+            LvePipeline& get() const;
+            void bind(VkCommandBuffer commandBuffer) const { get().bind(commandBuffer); }
+
+        private:
+            Handle(std::shared_ptr<Entry> entry, std::shared_ptr<Entry> fallback)
+                : entry{ std::move(entry) }, fallback{ std::move(fallback) } {}
+
+            std::shared_ptr<Entry> entry;
+            std::shared_ptr<Entry> fallback;
+
+            friend class LvePipelineManager;
+        };
+
+        LvePipelineManager(LveDevice& device, LveThreadPool& threadPool);
+        ~LvePipelineManager();
+
+        LvePipelineManager(const LvePipelineManager&) = delete;
+        LvePipelineManager& operator=(const LvePipelineManager&) = delete;
+
+        // Queues a build unless an identical one was already requested.
+        // configInfo is copied, so it does not need to outlive the call.
+        Handle request(
+            const std::string& vertFilepath,
+            const std::string& fragFilepath,
+            const PipelineConfigInfo& configInfo,
+            const Handle& fallback = Handle{});
+
+        // Blocks until every requested pipeline has been built
+        void waitIdle();
+
+        // Rebuilds every pipeline that uses the given shader file with new
+        // SPIR-V for it in the background. The other stage keeps its code.
+        void reloadShader(
+            const std::string& shaderFilepath,
+            std::shared_ptr<const std::vector<uint32_t>> code);
+
+        // Swaps finished rebuilds in. Call once per frame after beginFrame, so
+        // replaced pipelines are destroyed once no frame in flight uses them.
+        void applyReloads();
+
+        size_t getPipelineCount();
+        size_t getPendingCount();
+
+        static void copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
+
+    private:
+        using ShaderCodePtr = std::shared_ptr<const std::vector<uint32_t>>;
+
+        // Keeps shader modules shared while any build is queued or running
+        void beginBuild();
+        void finishBuild();
+
+        struct BuildGuard {
+            LvePipelineManager* manager;
+            ~BuildGuard() { manager->finishBuild(); }
+        };
+        // Whether a reloaded shader file affects one stage of an entry. Takes
+        // the new code as the stage's code when it can be used as is.
+        static bool matchShader(
+            const Entry& entry,
+            const std::string& stageFilepath,
+            const std::string& shaderFilepath,
+            const ShaderCodePtr& code,
+            ShaderCodePtr& stageCode);
+        std::unique_ptr<LvePipeline> buildPipeline(
+            const std::string& vertFilepath,
+            const std::string& fragFilepath,
+            const ShaderCodePtr& vertCode,
+            const ShaderCodePtr& fragCode,
+            const PipelineConfigInfo& configInfo);
+
+        struct Entry {
+            std::string vertFilepath;
+            std::string fragFilepath;
+            PipelineConfigInfo configInfo{};
+            std::unique_ptr<LvePipeline> pipeline;
+            std::shared_future<void> built;
+
+            // Reloaded code, used instead of resolving the file by name
+            ShaderCodePtr vertCode;
+            ShaderCodePtr fragCode;
+            uint64_t reloadGeneration = 0;
+            uint64_t appliedGeneration = 0;
+        };
+
+        struct Reload {
+            std::shared_ptr<Entry> entry;
+            uint64_t generation;
+            std::unique_ptr<LvePipeline> pipeline;
+            std::future<void> built;
+        };
+
+        struct RetiredPipeline {
+            std::unique_ptr<LvePipeline> pipeline;
+            int framesLeft;
+        };
+
+        LveDevice& lveDevice;
+        LveThreadPool& threadPool;
+
+        std::mutex mutex;
+        std::unordered_map<LvePipelineCache::Key, std::shared_ptr<Entry>, LvePipelineCache::KeyHash> entries;
+        size_t buildsInFlight = 0;
+
+        std::vector<std::unique_ptr<Reload>> reloads;
+        std::vector<RetiredPipeline> retiredPipelines;
+    };
+}
@@ -0,0 +1,109 @@
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace lve {
+
+    namespace {
+        struct TimerStats {
+            double totalMs = 0.0;
+            double maxMs = 0.0;
+            uint32_t samples = 0;
+        };
+
+        struct ProfilerState {
+            std::mutex mutex;
+            std::map<std::string, TimerStats> timers;
+            std::map<std::string, int64_t> counters;
+            std::map<std::string, int64_t> gauges;
+            // Off until setReportInterval
+            float reportInterval = 0.f;
+            float elapsed = 0.f;
+            float maxFrameTime = 0.f;
+            uint32_t frames = 0;
+        };
+
+        ProfilerState& state() {
+            static ProfilerState profilerState{};
+            return profilerState;
+        }
+    }
+
+    LveProfiler::ScopedTimer::ScopedTimer(const char* name)
+        : name{ name }, start{ std::chrono::high_resolution_clock::now() } {}
+
+    LveProfiler::ScopedTimer::~ScopedTimer() {
+        auto end = std::chrono::high_resolution_clock::now();
+        addTime(name, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    void LveProfiler::addTime(const std::string& name, double milliseconds) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{ s.mutex };
+        auto& timer = s.timers[name];
+        timer.totalMs += milliseconds;
+        timer.maxMs = std::max(timer.maxMs, milliseconds);
+        timer.samples++;
+    }
+
+    void LveProfiler::addCounter(const std::string& name, int64_t value) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{ s.mutex };
+        s.counters[name] += value;
+    }
+
+    void LveProfiler::setGauge(const std::string& name, int64_t value) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{ s.mutex };
+        s.gauges[name] = value;
+    }
+
+    void LveProfiler::setReportInterval(float seconds) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{ s.mutex };
+        s.reportInterval = seconds;
+    }
+
+    void LveProfiler::endFrame(float frameTime) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{ s.mutex };
+        s.frames++;
+        s.elapsed += frameTime;
+        s.maxFrameTime = std::max(s.maxFrameTime, frameTime);
+
+        if (s.reportInterval <= 0.f || s.elapsed < s.reportInterval) return;
+
+        std::cout << std::fixed << std::setprecision(3)
+            << "[profile] " << s.frames << " frames, frame avg "
+            << 1000.f * s.elapsed / s.frames << " ms, max "
+            << 1000.f * s.maxFrameTime << " ms\n";
+
+        for (auto& kv : s.timers) {
+            if (kv.second.samples == 0) continue;
+            std::cout << "  " << std::left << std::setw(28) << kv.first << std::right
+                << " avg " << kv.second.totalMs / kv.second.samples << " ms"
+                << ", max " << kv.second.maxMs << " ms"
+                << ", " << kv.second.samples << " samples\n";
+            kv.second = TimerStats{};
+        }
+        for (auto& kv : s.counters) {
+            std::cout << "  " << std::left << std::setw(28) << kv.first << std::right
+                << " " << static_cast<double>(kv.second) / s.frames << " / frame\n";
+            kv.second = 0;
+        }
+        for (auto& kv : s.gauges) {
+            std::cout << "  " << std::left << std::setw(28) << kv.first << std::right
+                << " " << kv.second << "\n";
+        }
+        std::cout << std::defaultfloat;
+
+        s.frames = 0;
+        s.elapsed = 0.f;
+        s.maxFrameTime = 0.f;
+    }
+}
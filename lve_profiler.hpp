@@ -0,0 +1,40 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace lve {
+
+    // Lightweight CPU profiler. Scoped timers and counters are accumulated
+    // between reports and printed once per reporting interval from endFrame.
+    // Reports are off until a positive interval is set.
+    // All functions are safe to call from worker threads.
+    class LveProfiler {
+    public:
+        class ScopedTimer {
+        public:
+            ScopedTimer(const char* name);
+            ~ScopedTimer();
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        private:
+            const char* name;
+            std::chrono::high_resolution_clock::time_point start;
+        };
+
+        // Adds one sample to the named timer
+        static void addTime(const std::string& name, double milliseconds);
+        // Adds to a counter that is reported as a per frame average
+        static void addCounter(const std::string& name, int64_t value);
+        // Sets a value that is reported as is, e.g. a resident count
+        static void setGauge(const std::string& name, int64_t value);
+
+        static void endFrame(float frameTime);
+        // 0 turns periodic reports off again
+        static void setReportInterval(float seconds);
+    };
+}
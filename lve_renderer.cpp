@@ -1,6 +1,9 @@
 #include "lve_renderer.hpp"
 
+#include "lve_profiler.hpp"
+
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
@@ -9,31 +12,68 @@ namespace lve {
 
     LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
         : lveWindow{ window }, lveDevice{ device } {
+        auto extent = lveWindow.getExtent();
+        while (extent.width == 0 || extent.height == 0) {
+            extent = lveWindow.getExtent();
+            glfwWaitEvents();
+        }
         recreateSwapChain();
         createCommandBuffers();
     }
 
     LveRenderer::~LveRenderer() { freeCommandBuffers(); }
 
-    void LveRenderer::recreateSwapChain() {
+    // Returns false while the window has no area, e.g. when minimized. The
+    // caller skips the frame and tries again on the next one.
+    bool LveRenderer::recreateSwapChain() {
         auto extent = lveWindow.getExtent();
-        while (extent.width == 0 || extent.height == 0) {
-            extent = lveWindow.getExtent();
-            glfwWaitEvents();
+        if (extent.width == 0 || extent.height == 0) {
+            swapChainOutOfDate = true;
+            return false;
         }
-        vkDeviceWaitIdle(lveDevice.device());
 
+        LveProfiler::ScopedTimer timer{ "renderer.recreateSwapChain" };
         if (lveSwapChain == nullptr) {
-            lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+            lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, depthSampled);
         }
         else {
+            if (waitIdleOnRecreate) {
+                vkDeviceWaitIdle(lveDevice.device());
+            }
             std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapChain);
-            lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain);
+            lveSwapChain = std::make_unique<LveSwapChain>(
+                lveDevice, extent, oldSwapChain, depthSampled);
 
             if (!oldSwapChain->compareSwapFormats(*lveSwapChain.get())) {
                 throw std::runtime_error("Swap chain image(or depth) format has changed!");
             }
+
+            // Up to MAX_FRAMES_IN_FLIGHT submitted frames may still read or present
+            // the old images. Each later acquire waits on the fence of one of them.
+            retiredSwapChains.push_back({ oldSwapChain, LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+            LveProfiler::addCounter("renderer.swapChainRecreations", 1);
         }
+
+        swapChainOutOfDate = false;
+        return true;
+    }
+
+    void LveRenderer::setDepthSampled(bool sampled) {
+        if (sampled == depthSampled) return;
+        depthSampled = sampled;
+        swapChainOutOfDate = true;
+    }
+
+    void LveRenderer::releaseRetiredSwapChains() {
+        for (auto& retired : retiredSwapChains) {
+            retired.framesLeft--;
+        }
+        retiredSwapChains.erase(
+            std::remove_if(
+                retiredSwapChains.begin(),
+                retiredSwapChains.end(),
+                [](const RetiredSwapChain& retired) { return retired.framesLeft <= 0; }),
+            retiredSwapChains.end());
     }
 
     void LveRenderer::createCommandBuffers() {
@@ -63,6 +103,10 @@ namespace lve {
     VkCommandBuffer LveRenderer::beginFrame() {
         assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+        if (swapChainOutOfDate && !recreateSwapChain()) {
+            return nullptr;
+        }
+
         auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
@@ -73,6 +117,10 @@ namespace lve {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
+        // The acquire waited on this frame slot's fence, and the slot advances
+        // once the frame is submitted
+        releaseRetiredSwapChains();
+
         isFrameStarted = true;
 
         auto commandBuffer = getCurrentCommandBuffer();
@@ -112,21 +160,26 @@ namespace lve {
             commandBuffer == getCurrentCommandBuffer() &&
             "Can't begin render pass on command buffer from a different frame");
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = lveSwapChain->getRenderPass();
-        renderPassInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
+        if (lveDevice.dynamicRenderingEnabled()) {
+            beginDynamicRendering(commandBuffer);
+        }
+        else {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = lveSwapChain->getRenderPass();
+            renderPassInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
 
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-        clearValues[1].depthStencil = { 1.0f, 0 };
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+            std::array<VkClearValue, 2> clearValues{};
+            clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
+            clearValues[1].depthStencil = { 1.0f, 0 };
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+            renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -145,7 +198,111 @@ namespace lve {
         assert(
             commandBuffer == getCurrentCommandBuffer() &&
             "Can't end render pass on command buffer from a different frame");
-        vkCmdEndRenderPass(commandBuffer);
+
+        if (lveDevice.dynamicRenderingEnabled()) {
+            endDynamicRendering(commandBuffer);
+        }
+        else {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+
+    // Does the work of the render pass's initial layout transitions and load ops
+    void LveRenderer::beginDynamicRendering(VkCommandBuffer commandBuffer) {
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = lveSwapChain->getImage(currentImageIndex);
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = lveSwapChain->getDepthImage();
+        // Combined formats need both aspects, there is no separate stencil layout
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        VkFormat depthFormat = lveSwapChain->getSwapChainDepthFormat();
+        if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+            depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        barriers[1].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        VkRenderingAttachmentInfoKHR colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        colorAttachment.imageView = lveSwapChain->getImageView(currentImageIndex);
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = { 0.01f, 0.01f, 0.01f, 1.0f };
+
+        VkRenderingAttachmentInfoKHR depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depthAttachment.imageView = lveSwapChain->getDepthImageView();
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = lveSwapChain->isDepthSampled() ?
+            VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+        VkRenderingInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        lveDevice.cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void LveRenderer::endDynamicRendering(VkCommandBuffer commandBuffer) {
+        lveDevice.cmdEndRendering(commandBuffer);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = lveSwapChain->getImage(currentImageIndex);
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
     }
 
 }
\ No newline at end of file
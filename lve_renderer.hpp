@@ -20,16 +20,46 @@ namespace lve {
 
         VkRenderPass getSwapChainRenderPass() const {
             return lveSwapChain->getRenderPass(); }
+        RenderTargetInfo getSwapChainRenderTarget() const {
+            return lveSwapChain->getRenderTarget(); }
         float getAspectRatio() const {
             return lveSwapChain->extentAspectRatio(); }
+        VkExtent2D getSwapChainExtent() const {
+            return lveSwapChain->getSwapChainExtent(); }
+        VkFormat getSwapChainDepthFormat() const {
+            return lveSwapChain->getSwapChainDepthFormat(); }
         bool isFrameInProgress() const { return isFrameStarted; }
 
+        // Whether depth is kept after the pass for sampling. Changing it
+        // recreates the swap chain at the start of the next frame.
+        void setDepthSampled(bool sampled);
+        bool isDepthSampled() const { return depthSampled; }
+
+        // Recreates the swap chain at the start of the next frame, e.g. to
+        // measure renderer.recreateSwapChain without resizing by hand
+        void requestSwapChainRecreation() { swapChainOutOfDate = true; }
+        // Waits for the device to go idle before each recreation, as the
+        // renderer used to, for comparing frame times against it
+        void setWaitIdleOnRecreate(bool wait) { waitIdleOnRecreate = wait; }
+
         VkCommandBuffer getCurrentCommandBuffer() const {
             assert(isFrameStarted
                 && "Cannot get command buffer when frame not in progress");
             return commandBuffers[currentFrameIndex];
         }
 
+        VkImage getCurrentDepthImage() const {
+            assert(isFrameStarted
+                && "Cannot get depth image when frame not in progress");
+            return lveSwapChain->getDepthImage();
+        }
+
+        VkImageView getCurrentDepthImageView() const {
+            assert(isFrameStarted
+                && "Cannot get depth image view when frame not in progress");
+            return lveSwapChain->getDepthImageView();
+        }
+
         int getFrameIndex() const {
             assert(isFrameStarted
                 && "Cannot get frame index when frame not in progress");
@@ -44,13 +74,27 @@ namespace lve {
     private:
         void createCommandBuffers();
         void freeCommandBuffers();
-        void recreateSwapChain();
+        bool recreateSwapChain();
+        void releaseRetiredSwapChains();
+        void beginDynamicRendering(VkCommandBuffer commandBuffer);
+        void endDynamicRendering(VkCommandBuffer commandBuffer);
 
         LveWindow& lveWindow;
         LveDevice& lveDevice;
         std::unique_ptr<LveSwapChain> lveSwapChain;
         std::vector<VkCommandBuffer> commandBuffers;
 
+        // Replaced swap chains are kept until every frame that may still use
+        // their images has passed its fence wait
+        struct RetiredSwapChain {
+            std::shared_ptr<LveSwapChain> swapChain;
+            int framesLeft;
+        };
+        std::vector<RetiredSwapChain> retiredSwapChains;
+        bool swapChainOutOfDate{ false };
+        bool depthSampled{ true };
+        bool waitIdleOnRecreate{ false };
+
         uint32_t currentImageIndex;
         int currentFrameIndex{ 0 };
         bool isFrameStarted{ false };
@@ -0,0 +1,227 @@
+#include "lve_scene_file.hpp"
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace lve {
+
+    namespace {
+        const char SCENE_MAGIC[8] = { 'L', 'V', 'E', 'S', 'C', 'E', 'N', 'E' };
+        constexpr uint64_t ARRAY_ALIGNMENT = 16;
+
+        static_assert(sizeof(LveSceneFile::Header) == 96, "scene header must not be padded");
+        static_assert(sizeof(LveSceneFile::ModelEntry) == 16, "scene model entries must not be padded");
+        // The component arrays are the in-memory structs, copied as is
+        static_assert(std::is_trivially_copyable<TransformComponent>::value &&
+            sizeof(TransformComponent) == 36, "TransformComponent layout is part of the scene format");
+        static_assert(std::is_trivially_copyable<RigidBody2d>::value &&
+            sizeof(RigidBody2d) == 12, "RigidBody2d layout is part of the scene format");
+        static_assert(std::is_trivially_copyable<PointLightComponent>::value &&
+            sizeof(PointLightComponent) == 8, "PointLightComponent layout is part of the scene format");
+
+        uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    LveSceneFile::LveSceneFile(const std::string& filepath)
+        : filepath{ filepath }, data{ LveArchive::readAsset(filepath) } {
+        if (data->size() < sizeof(Header) || std::memcmp(header().magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0) {
+            throw std::runtime_error("not a scene file: " + filepath);
+        }
+        if (header().version != VERSION) {
+            throw std::runtime_error("unsupported scene file version: " + filepath);
+        }
+
+        const Header& h = header();
+        uint64_t size = data->size();
+        auto inRange = [&](uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t alignment) {
+            return offset % alignment == 0 && offset <= size && count <= (size - offset) / elementSize;
+        };
+        if (!inRange(h.modelsOffset, h.modelCount, sizeof(ModelEntry), alignof(ModelEntry)) ||
+            !inRange(h.namesOffset, h.namesSize, 1, 1) ||
+            !inRange(h.transformsOffset, h.objectCount, sizeof(TransformComponent), alignof(TransformComponent)) ||
+            !inRange(h.colorsOffset, h.objectCount, sizeof(glm::vec3), alignof(glm::vec3)) ||
+            !inRange(h.modelIndicesOffset, h.objectCount, sizeof(uint32_t), alignof(uint32_t)) ||
+            !inRange(h.rigidBodiesOffset, h.objectCount, sizeof(RigidBody2d), alignof(RigidBody2d)) ||
+            !inRange(h.flagsOffset, h.objectCount, sizeof(uint32_t), alignof(uint32_t)) ||
+            !inRange(h.pointLightsOffset, h.objectCount, sizeof(PointLightComponent), alignof(PointLightComponent))) {
+            throw std::runtime_error("corrupt scene file layout: " + filepath);
+        }
+
+        // Checked once so the accessors can trust the tables
+        for (uint32_t i = 0; i < h.modelCount; i++) {
+            if (static_cast<uint64_t>(models()[i].nameOffset) + models()[i].nameLength > h.namesSize) {
+                throw std::runtime_error("corrupt scene model table in " + filepath);
+            }
+        }
+        const uint32_t* indices = modelIndices();
+        for (uint32_t i = 0; i < h.objectCount; i++) {
+            if (indices[i] >= h.modelCount && indices[i] != NO_MODEL) {
+                throw std::runtime_error("scene object references a missing model in " + filepath);
+            }
+        }
+    }
+
+    std::string LveSceneFile::getModelName(uint32_t model) const {
+        const ModelEntry& entry = models()[model];
+        const char* names = reinterpret_cast<const char*>(data->data() + header().namesOffset);
+        return std::string{ names + entry.nameOffset, entry.nameLength };
+    }
+
+    LveGameObject LveSceneFile::createGameObject(uint32_t object, std::shared_ptr<LveModel> model) const {
+        auto gameObject = LveGameObject::createGameObject();
+        gameObject.transform = transforms()[object];
+        gameObject.color = colors()[object];
+        gameObject.rigidBody2d = rigidBodies()[object];
+        gameObject.model = std::move(model);
+        if (flags()[object] & FLAG_POINT_LIGHT) {
+            gameObject.pointLight = std::make_unique<PointLightComponent>(pointLights()[object]);
+        }
+        return gameObject;
+    }
+
+    void LveSceneFile::instantiate(LveGameObject::Map& gameObjects, const ModelLoader& loadModel) const {
+        std::vector<std::shared_ptr<LveModel>> loadedModels(getModelCount());
+        std::vector<bool> modelLoaded(getModelCount(), false);
+        const uint32_t* objectModels = modelIndices();
+
+        gameObjects.reserve(gameObjects.size() + getObjectCount());
+        for (uint32_t i = 0; i < getObjectCount(); i++) {
+            uint32_t model = objectModels[i];
+            if (model != NO_MODEL && !modelLoaded[model]) {
+                loadedModels[model] = loadModel(getModelName(model));
+                modelLoaded[model] = true;
+            }
+            auto gameObject = createGameObject(i, model != NO_MODEL ? loadedModels[model] : nullptr);
+            gameObjects.emplace(gameObject.getId(), std::move(gameObject));
+        }
+    }
+
+    void LveSceneFile::exportText(std::ostream& out) const {
+        char line[512];
+        std::snprintf(line, sizeof(line), "scene version %u, %u models, %u objects\n",
+            header().version, getModelCount(), getObjectCount());
+        out << line;
+        for (uint32_t i = 0; i < getModelCount(); i++) {
+            std::snprintf(line, sizeof(line), "model %u %016llx ", i,
+                static_cast<unsigned long long>(getModelAssetId(i)));
+            out << line << getModelName(i) << '\n';
+        }
+
+        // %.9g round trips floats exactly
+        for (uint32_t i = 0; i < getObjectCount(); i++) {
+            const TransformComponent& t = transforms()[i];
+            const glm::vec3& c = colors()[i];
+            const RigidBody2d& r = rigidBodies()[i];
+            int length = std::snprintf(line, sizeof(line),
+                "object %u model %d translation %.9g %.9g %.9g rotation %.9g %.9g %.9g "
+                "scale %.9g %.9g %.9g color %.9g %.9g %.9g velocity %.9g %.9g mass %.9g",
+                i, modelIndices()[i] == NO_MODEL ? -1 : static_cast<int>(modelIndices()[i]),
+                t.translation.x, t.translation.y, t.translation.z,
+                t.rotation.x, t.rotation.y, t.rotation.z,
+                t.scale.x, t.scale.y, t.scale.z,
+                c.x, c.y, c.z,
+                r.velocity.x, r.velocity.y, r.mass);
+            out.write(line, length);
+            if (flags()[i] & FLAG_POINT_LIGHT) {
+                const PointLightComponent& light = pointLights()[i];
+                length = std::snprintf(line, sizeof(line), " light %.9g %.9g", light.lightIntensity, light.range);
+                out.write(line, length);
+            }
+            out << '\n';
+        }
+    }
+
+    uint32_t LveSceneWriter::addModel(const std::string& assetName) {
+        auto it = modelIndices.find(assetName);
+        if (it != modelIndices.end()) {
+            return it->second;
+        }
+        uint32_t index = static_cast<uint32_t>(modelNames.size());
+        modelNames.push_back(assetName);
+        modelIndices.emplace(assetName, index);
+        return index;
+    }
+
+    void LveSceneWriter::addObject(const LveGameObject& gameObject, uint32_t model) {
+        if (model != LveSceneFile::NO_MODEL && model >= modelNames.size()) {
+            throw std::runtime_error("scene object references a model that wasn't added");
+        }
+        transforms.push_back(gameObject.transform);
+        colors.push_back(gameObject.color);
+        objectModels.push_back(model);
+        rigidBodies.push_back(gameObject.rigidBody2d);
+        flags.push_back(gameObject.pointLight != nullptr ? LveSceneFile::FLAG_POINT_LIGHT : 0);
+        pointLights.push_back(gameObject.pointLight != nullptr ? *gameObject.pointLight : PointLightComponent{});
+    }
+
+    void LveSceneWriter::write(const std::string& filepath) const {
+        std::vector<LveSceneFile::ModelEntry> models;
+        std::string names;
+        for (const auto& name : modelNames) {
+            LveSceneFile::ModelEntry entry{};
+            entry.assetId = LveArchive::hashName(name);
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameLength = static_cast<uint32_t>(name.size());
+            models.push_back(entry);
+            names += name;
+        }
+
+        struct Section {
+            const void* data;
+            uint64_t size;
+        };
+        const Section sections[] = {
+            { models.data(), models.size() * sizeof(models[0]) },
+            { names.data(), names.size() },
+            { transforms.data(), transforms.size() * sizeof(TransformComponent) },
+            { colors.data(), colors.size() * sizeof(glm::vec3) },
+            { objectModels.data(), objectModels.size() * sizeof(uint32_t) },
+            { rigidBodies.data(), rigidBodies.size() * sizeof(RigidBody2d) },
+            { flags.data(), flags.size() * sizeof(uint32_t) },
+            { pointLights.data(), pointLights.size() * sizeof(PointLightComponent) },
+        };
+        uint64_t offsets[8];
+        uint64_t offset = sizeof(LveSceneFile::Header);
+        for (size_t i = 0; i < 8; i++) {
+            offsets[i] = alignUp(offset, ARRAY_ALIGNMENT);
+            offset = offsets[i] + sections[i].size;
+        }
+
+        LveSceneFile::Header header{};
+        std::memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+        header.version = LveSceneFile::VERSION;
+        header.objectCount = static_cast<uint32_t>(transforms.size());
+        header.modelCount = static_cast<uint32_t>(models.size());
+        header.modelsOffset = offsets[0];
+        header.namesOffset = offsets[1];
+        header.namesSize = names.size();
+        header.transformsOffset = offsets[2];
+        header.colorsOffset = offsets[3];
+        header.modelIndicesOffset = offsets[4];
+        header.rigidBodiesOffset = offsets[5];
+        header.flagsOffset = offsets[6];
+        header.pointLightsOffset = offsets[7];
+
+        std::ofstream out{ filepath, std::ios::binary | std::ios::trunc };
+        if (!out.is_open()) {
+            throw std::runtime_error("failed to open scene file for writing: " + filepath);
+        }
+        const char zeros[ARRAY_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset = sizeof(header);
+        for (size_t i = 0; i < 8; i++) {
+            out.write(zeros, static_cast<std::streamsize>(offsets[i] - offset));
+            out.write(static_cast<const char*>(sections[i].data), static_cast<std::streamsize>(sections[i].size));
+            offset = offsets[i] + sections[i].size;
+        }
+        if (!out.good()) {
+            throw std::runtime_error("failed to write scene file: " + filepath);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "lve_archive.hpp"
+#include "lve_game_object.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Binary level file, read in place from a mapping or a mounted archive.
+    // Objects are stored as parallel component arrays in the engine's own
+    // in-memory layouts, so nothing is parsed or converted: instantiating an
+    // object copies each of its components as a whole struct. Game objects
+    // live in a map rather than in arrays, so that copy is per object. Models
+    // are referenced through a table of asset IDs (LveArchive::hashName of
+    // the asset name) with the names kept alongside for loading and text
+    // export.
+    //
+    // Layout, little endian: Header, ModelEntry array, names, then one array
+    // per component, each 16 byte aligned.
+    class LveSceneFile {
+    public:
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t NO_MODEL = ~0u;
+        // Objects with this flag have a PointLightComponent
+        static constexpr uint32_t FLAG_POINT_LIGHT = 1u << 0;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t objectCount;
+            uint32_t modelCount;
+            uint32_t reserved;
+            uint64_t modelsOffset;
+            uint64_t namesOffset;
+            uint64_t namesSize;
+            uint64_t transformsOffset;
+            uint64_t colorsOffset;
+            uint64_t modelIndicesOffset;
+            uint64_t rigidBodiesOffset;
+            uint64_t flagsOffset;
+            uint64_t pointLightsOffset;
+        };
+
+        struct ModelEntry {
+            uint64_t assetId;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+
+        // Returns the model for an asset name, called once per model the
+        // scene uses
+        using ModelLoader = std::function<std::shared_ptr<LveModel>(const std::string& name)>;
+
+        LveSceneFile(const std::string& filepath);
+
+        LveSceneFile(const LveSceneFile&) = delete;
+        LveSceneFile& operator=(const LveSceneFile&) = delete;
+
+        uint32_t getObjectCount() const { return header().objectCount; }
+        uint32_t getModelCount() const { return header().modelCount; }
+        uint64_t getModelAssetId(uint32_t model) const { return models()[model].assetId; }
+        std::string getModelName(uint32_t model) const;
+
+        // Component arrays of getObjectCount elements, pointing into the file
+        const TransformComponent* transforms() const { return array<TransformComponent>(header().transformsOffset); }
+        const glm::vec3* colors() const { return array<glm::vec3>(header().colorsOffset); }
+        // Index into the model table, or NO_MODEL
+        const uint32_t* modelIndices() const { return array<uint32_t>(header().modelIndicesOffset); }
+        const RigidBody2d* rigidBodies() const { return array<RigidBody2d>(header().rigidBodiesOffset); }
+        const uint32_t* flags() const { return array<uint32_t>(header().flagsOffset); }
+        // Only meaningful for objects with FLAG_POINT_LIGHT
+        const PointLightComponent* pointLights() const {
+            return array<PointLightComponent>(header().pointLightsOffset);
+        }
+
+        // The stored object's components, with the model its index refers to
+        LveGameObject createGameObject(uint32_t object, std::shared_ptr<LveModel> model) const;
+        // Creates a game object per stored object. Models are shared between
+        // the objects that reference them.
+        void instantiate(LveGameObject::Map& gameObjects, const ModelLoader& loadModel) const;
+
+        // One line per model and object with every value written so it reads
+        // back exactly, for diffing levels
+        void exportText(std::ostream& out) const;
+
+    private:
+        const Header& header() const { return *reinterpret_cast<const Header*>(data->data()); }
+        const ModelEntry* models() const { return array<ModelEntry>(header().modelsOffset); }
+
+        template <typename T>
+        const T* array(uint64_t offset) const { return reinterpret_cast<const T*>(data->data() + offset); }
+
+        std::string filepath;
+        std::unique_ptr<LveArchive::Data> data;
+    };
+
+    // Builds scene files, e.g. to save a level that was built in code
+    class LveSceneWriter {
+    public:
+        // Adding a name again returns the index it already has
+        uint32_t addModel(const std::string& assetName);
+        void addObject(const LveGameObject& gameObject, uint32_t model = LveSceneFile::NO_MODEL);
+        void write(const std::string& filepath) const;
+
+        size_t getObjectCount() const { return transforms.size(); }
+
+    private:
+        std::vector<std::string> modelNames;
+        std::unordered_map<std::string, uint32_t> modelIndices;
+
+        std::vector<TransformComponent> transforms;
+        std::vector<glm::vec3> colors;
+        std::vector<uint32_t> objectModels;
+        std::vector<RigidBody2d> rigidBodies;
+        std::vector<uint32_t> flags;
+        std::vector<PointLightComponent> pointLights;
+    };
+}
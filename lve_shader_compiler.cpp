@@ -0,0 +1,151 @@
+#include "lve_shader_compiler.hpp"
+
+#include "lve_hash.hpp"
+#include "lve_profiler.hpp"
+
+// libs
+#ifdef LVE_ENABLE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+// std
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        // Bump when the compile options or the key layout change so stale cache entries are ignored
+        constexpr uint32_t CACHE_VERSION = 2;
+
+        std::string extensionOf(const std::string& filepath) {
+            auto dot = filepath.find_last_of('.');
+            return dot == std::string::npos ? std::string{} : filepath.substr(dot);
+        }
+
+        uint64_t hashSource(
+            const std::string& source,
+            const std::string& stage,
+            const LveShaderCompiler::Defines& defines) {
+            LveHasher hasher{};
+            hasher.add(CACHE_VERSION);
+            hasher.add(stage);
+            hasher.add(source);
+            for (const auto& define : defines) {
+                hasher.add(define.first);
+                hasher.add(define.second);
+            }
+            return hasher.get();
+        }
+
+        LveShaderCompiler::Code readCacheEntry(const std::string& path) {
+            std::ifstream file{ path, std::ios::ate | std::ios::binary };
+            if (!file.is_open()) return nullptr;
+
+            size_t size = static_cast<size_t>(file.tellg());
+            if (size == 0 || size % sizeof(uint32_t) != 0) return nullptr;
+
+            auto code = std::make_shared<std::vector<uint32_t>>(size / sizeof(uint32_t));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(code->data()), size);
+            return file ? code : nullptr;
+        }
+
+        void writeCacheEntry(const std::string& path, const std::vector<uint32_t>& code) {
+            std::error_code error;
+            std::filesystem::create_directories(std::filesystem::path{ path }.parent_path(), error);
+
+            // Written under a temporary name so other threads or processes
+            // never read a partial entry
+            std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file{ tmpPath, std::ios::binary | std::ios::trunc };
+                if (!file.is_open()) return;
+                file.write(
+                    reinterpret_cast<const char*>(code.data()),
+                    code.size() * sizeof(uint32_t));
+                if (!file) return;
+            }
+            std::filesystem::rename(tmpPath, path, error);
+        }
+    }
+
+    LveShaderCompiler::LveShaderCompiler(const std::string& cacheDirectory)
+        : cacheDirectory{ cacheDirectory } {}
+
+    bool LveShaderCompiler::isAvailable() {
+#ifdef LVE_ENABLE_SHADERC
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool LveShaderCompiler::isShaderSource(const std::string& filepath) {
+        std::string extension = extensionOf(filepath);
+        return extension == ".vert" || extension == ".frag" || extension == ".comp";
+    }
+
+    LveShaderCompiler::Code LveShaderCompiler::compileFile(
+        const std::string& sourcePath, const Defines& defines) {
+        std::ifstream file{ sourcePath, std::ios::binary };
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + sourcePath);
+        }
+        std::stringstream source;
+        source << file.rdbuf();
+        return compile(source.str(), sourcePath, defines);
+    }
+
+    LveShaderCompiler::Code LveShaderCompiler::compile(
+        const std::string& source, const std::string& sourceName, const Defines& defines) {
+        std::string stage = extensionOf(sourceName);
+        if (!isShaderSource(sourceName)) {
+            throw std::runtime_error("unknown shader stage: " + sourceName);
+        }
+
+        char hashName[17];
+        std::snprintf(
+            hashName, sizeof(hashName), "%016llx",
+            static_cast<unsigned long long>(hashSource(source, stage, defines)));
+        std::string cachePath = cacheDirectory + "/" + hashName + ".spv";
+
+        if (auto cached = readCacheEntry(cachePath)) {
+            LveProfiler::addCounter("shaders.compileCacheHits", 1);
+            return cached;
+        }
+
+#ifdef LVE_ENABLE_SHADERC
+        LveProfiler::ScopedTimer timer{ "shaders.compile" };
+
+        shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+        if (stage == ".frag") kind = shaderc_glsl_fragment_shader;
+        if (stage == ".comp") kind = shaderc_glsl_compute_shader;
+
+        shaderc::CompileOptions options;
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        for (const auto& define : defines) {
+            options.AddMacroDefinition(define.first, define.second);
+        }
+
+        // A compiler per call keeps concurrent compiles independent
+        shaderc::Compiler compiler;
+        auto result = compiler.CompileGlslToSpv(source, kind, sourceName.c_str(), options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            throw std::runtime_error(
+                "failed to compile shader " + sourceName + ":\n" + result.GetErrorMessage());
+        }
+
+        auto code = std::make_shared<std::vector<uint32_t>>(result.cbegin(), result.cend());
+        writeCacheEntry(cachePath, *code);
+        LveProfiler::addCounter("shaders.compiled", 1);
+        return code;
+#else
+        throw std::runtime_error(
+            "cannot compile " + sourceName + ": built without LVE_ENABLE_SHADERC");
+#endif
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+    // Compiles GLSL to SPIR-V in-process with shaderc. Results are cached on
+    // disk under a hash of the source, stage and defines, so unchanged shaders
+    // are only compiled once across runs. Compiling is safe from any thread.
+    // Only available when built with LVE_ENABLE_SHADERC.
+    class LveShaderCompiler {
+    public:
+        using Defines = std::vector<std::pair<std::string, std::string>>;
+        using Code = std::shared_ptr<const std::vector<uint32_t>>;
+
+        LveShaderCompiler(const std::string& cacheDirectory = ".shader_cache");
+
+        LveShaderCompiler(const LveShaderCompiler&) = delete;
+        LveShaderCompiler& operator=(const LveShaderCompiler&) = delete;
+
+        // The stage is taken from the extension (.vert, .frag, .comp)
+        Code compileFile(const std::string& sourcePath, const Defines& defines = {});
+        Code compile(
+            const std::string& source,
+            const std::string& sourceName,
+            const Defines& defines = {});
+
+        static bool isAvailable();
+        static bool isShaderSource(const std::string& filepath);
+
+    private:
+        std::string cacheDirectory;
+    };
+}
@@ -0,0 +1,84 @@
+#include "lve_shader_hot_reloader.hpp"
+
+#include "lve_mapped_file.hpp"
+
+// std
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        bool endsWith(const std::string& value, const std::string& suffix) {
+            return value.size() >= suffix.size() &&
+                value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        std::string fileName(const std::string& path) {
+            auto slash = path.find_last_of("/\\");
+            return slash == std::string::npos ? path : path.substr(slash + 1);
+        }
+
+        LveShaderCompiler::Code readSpirv(const std::string& path) {
+            LveMappedFile file{ path };
+            if (file.size() == 0 || file.size() % sizeof(uint32_t) != 0) {
+                throw std::runtime_error("invalid SPIR-V file: " + path);
+            }
+            const uint32_t* words = reinterpret_cast<const uint32_t*>(file.data());
+            return std::make_shared<std::vector<uint32_t>>(
+                words, words + file.size() / sizeof(uint32_t));
+        }
+    }
+
+    LveShaderHotReloader::LveShaderHotReloader(
+        LvePipelineManager& pipelineManager,
+        LveThreadPool& threadPool,
+        const std::string& directory)
+        : pipelineManager{ pipelineManager }, threadPool{ threadPool }, watcher{ directory } {}
+
+    LveShaderHotReloader::~LveShaderHotReloader() {
+        // Compile jobs use the compiler
+        for (auto& shader : pending) {
+            shader.code.wait();
+        }
+    }
+
+    void LveShaderHotReloader::update() {
+        for (const auto& path : watcher.pollChanges()) {
+            queueShader(path);
+        }
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->code.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+
+            try {
+                pipelineManager.reloadShader(it->shaderFilepath, it->code.get());
+                std::cout << "Reloading " << it->shaderFilepath << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+            it = pending.erase(it);
+        }
+    }
+
+    void LveShaderHotReloader::queueShader(const std::string& changedPath) {
+        std::string name = fileName(changedPath);
+
+        if (endsWith(name, ".spv")) {
+            pending.push_back({ name, threadPool.submit([changedPath]() {
+                return readSpirv(changedPath);
+            }) });
+            return;
+        }
+
+        if (LveShaderCompiler::isAvailable() && LveShaderCompiler::isShaderSource(name)) {
+            pending.push_back({ name + ".spv", threadPool.submit([this, changedPath]() {
+                return compiler.compileFile(changedPath);
+            }) });
+        }
+    }
+}
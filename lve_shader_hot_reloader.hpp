@@ -0,0 +1,51 @@
+#pragma once
+
+#include "lve_file_watcher.hpp"
+#include "lve_pipeline_manager.hpp"
+#include "lve_shader_compiler.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <future>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // Watches the shader directory and rebuilds the pipelines that use a
+    // shader when it changes. GLSL sources are compiled on the thread pool
+    // when built with LVE_ENABLE_SHADERC; rewritten .spv files are always
+    // picked up. Nothing here blocks the frame: finished code is handed to the
+    // pipeline manager, which rebuilds in the background and swaps the new
+    // pipelines in from applyReloads.
+    class LveShaderHotReloader {
+    public:
+        LveShaderHotReloader(
+            LvePipelineManager& pipelineManager,
+            LveThreadPool& threadPool,
+            const std::string& directory = ".");
+        ~LveShaderHotReloader();
+
+        LveShaderHotReloader(const LveShaderHotReloader&) = delete;
+        LveShaderHotReloader& operator=(const LveShaderHotReloader&) = delete;
+
+        // Call once per frame
+        void update();
+
+    private:
+        struct PendingShader {
+            // Name the pipelines were requested with, e.g. simple_shader.frag.spv
+            std::string shaderFilepath;
+            std::future<LveShaderCompiler::Code> code;
+        };
+
+        void queueShader(const std::string& changedPath);
+
+        LvePipelineManager& pipelineManager;
+        LveThreadPool& threadPool;
+        LveFileWatcher watcher;
+        LveShaderCompiler compiler{};
+
+        std::vector<PendingShader> pending;
+    };
+}
@@ -0,0 +1,204 @@
+#include "lve_shader_module_cache.hpp"
+
+#include "lve_archive.hpp"
+#include "lve_hash.hpp"
+#include "lve_mapped_file.hpp"
+#include "lve_profiler.hpp"
+
+// std
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__has_include)
+#if __has_include("lve_embedded_shaders.hpp")
+#include "lve_embedded_shaders.hpp"
+#define LVE_HAS_EMBEDDED_SHADERS
+#endif
+#endif
+
+namespace lve {
+
+    LveShaderModule::LveShaderModule(
+        VkDevice device, const uint32_t* code, size_t codeSize, uint64_t contentHash)
+        : device{ device },
+        contentHash{ contentHash },
+        code(code, code + codeSize / sizeof(uint32_t)),
+        reflection{ code, codeSize } {
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = codeSize;
+        createInfo.pCode = code;
+
+        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module");
+        }
+    }
+
+    LveShaderModule::~LveShaderModule() {
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+    }
+
+    bool LveShaderModule::hasCode(const uint32_t* other, size_t codeSize) const {
+        return codeSize == code.size() * sizeof(uint32_t) && std::memcmp(other, code.data(), codeSize) == 0;
+    }
+
+    LveShaderModuleCache::LveShaderModuleCache(VkDevice device) : device{ device } {
+        if (const char* dir = std::getenv("LVE_SHADER_DIR")) {
+            overrideDirectory = dir;
+        }
+    }
+
+    std::shared_ptr<LveShaderModule> LveShaderModuleCache::load(const std::string& name) {
+        if (!overrideDirectory.empty()) {
+            std::string overridePath = overrideDirectory + "/" + name;
+            if (std::ifstream{ overridePath }.good()) {
+                return loadFromFile(overridePath);
+            }
+        }
+
+        if (auto data = LveArchive::readMounted(name)) {
+            if (data->size() == 0 || data->size() % sizeof(uint32_t) != 0) {
+                throw std::runtime_error("invalid SPIR-V in asset archive: " + name);
+            }
+            LveProfiler::addCounter("shaders.archiveLoads", 1);
+            return loadFromMemory(reinterpret_cast<const uint32_t*>(data->data()), data->size());
+        }
+
+#ifdef LVE_HAS_EMBEDDED_SHADERS
+        for (const auto& shader : embedded_shaders::shaders) {
+            if (name == shader.name) {
+                LveProfiler::addCounter("shaders.embeddedLoads", 1);
+                return loadFromMemory(shader.code, shader.codeSize);
+            }
+        }
+#endif
+
+        return loadFromFile(name);
+    }
+
+    void LveShaderModuleCache::setRetainModules(bool retain) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        retainModules = retain;
+        if (!retain) {
+            retainedModules.clear();
+        }
+    }
+
+    uint64_t LveShaderModuleCache::hashCode(const void* code, size_t codeSize) {
+        return LveHasher::hash64(code, codeSize);
+    }
+
+    std::shared_ptr<LveShaderModule> LveShaderModuleCache::loadPermutation(
+        const std::string& name, const LveShaderCompiler::Defines& defines) {
+        if (defines.empty()) {
+            return load(name);
+        }
+
+        const std::string spvExtension = ".spv";
+        bool hasSpvExtension = name.size() > spvExtension.size() &&
+            name.compare(name.size() - spvExtension.size(), spvExtension.size(), spvExtension) == 0;
+        if (LveShaderCompiler::isAvailable() && hasSpvExtension) {
+            std::string sourceName = name.substr(0, name.size() - spvExtension.size());
+            std::string sourcePath = sourceName;
+            if (!overrideDirectory.empty() &&
+                std::ifstream{ overrideDirectory + "/" + sourceName }.good()) {
+                sourcePath = overrideDirectory + "/" + sourceName;
+            }
+            auto code = compiler.compileFile(sourcePath, defines);
+            return loadFromMemory(code->data(), code->size() * sizeof(uint32_t));
+        }
+
+        return load(permutationName(name, defines));
+    }
+
+    std::string LveShaderModuleCache::permutationName(
+        const std::string& name, const LveShaderCompiler::Defines& defines) {
+        std::string suffix;
+        for (const auto& define : defines) {
+            suffix += "." + define.first;
+            if (!define.second.empty()) {
+                suffix += "_" + define.second;
+            }
+        }
+
+        auto dot = name.find_last_of('.');
+        if (dot == std::string::npos) {
+            return name + suffix;
+        }
+        return name.substr(0, dot) + suffix + name.substr(dot);
+    }
+
+    std::shared_ptr<LveShaderModule> LveShaderModuleCache::loadFromFile(const std::string& filepath) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            auto it = modulesByPath.find(filepath);
+            if (it != modulesByPath.end()) {
+                if (auto module = it->second.lock()) {
+                    LveProfiler::addCounter("shaders.pathHits", 1);
+                    return module;
+                }
+            }
+        }
+
+        LveMappedFile file{ filepath };
+        if (file.size() == 0 || file.size() % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("invalid SPIR-V file: " + filepath);
+        }
+
+        auto module = loadFromMemory(reinterpret_cast<const uint32_t*>(file.data()), file.size());
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        modulesByPath[filepath] = module;
+        return module;
+    }
+
+    std::shared_ptr<LveShaderModule> LveShaderModuleCache::loadFromMemory(
+        const uint32_t* code, size_t codeSize) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return findOrCreate(code, codeSize);
+    }
+
+    std::shared_ptr<LveShaderModule> LveShaderModuleCache::findOrCreate(
+        const uint32_t* code, size_t codeSize) {
+        uint64_t hash = hashCode(code, codeSize);
+
+        auto it = modulesByHash.find(hash);
+        bool collision = false;
+        if (it != modulesByHash.end()) {
+            if (auto module = it->second.lock()) {
+                if (module->hasCode(code, codeSize)) {
+                    LveProfiler::addCounter("shaders.contentHits", 1);
+                    return module;
+                }
+                collision = true;
+            }
+        }
+
+        auto module = std::make_shared<LveShaderModule>(device, code, codeSize, hash);
+        if (collision) {
+            // A different shader with the same hash keeps the slot, and this
+            // one gets a module of its own that is never shared
+            LveProfiler::addCounter("shaders.hashCollisions", 1);
+        } else {
+            pruneExpired();
+            modulesByHash[hash] = module;
+        }
+        if (retainModules) {
+            retainedModules.push_back(module);
+        }
+        LveProfiler::addCounter("shaders.modulesCreated", 1);
+        return module;
+    }
+
+    void LveShaderModuleCache::pruneExpired() {
+        // Only on creation, which costs far more than walking the entries
+        for (auto it = modulesByHash.begin(); it != modulesByHash.end();) {
+            it = it->second.expired() ? modulesByHash.erase(it) : std::next(it);
+        }
+        for (auto it = modulesByPath.begin(); it != modulesByPath.end();) {
+            it = it->second.expired() ? modulesByPath.erase(it) : std::next(it);
+        }
+    }
+}
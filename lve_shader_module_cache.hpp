@@ -0,0 +1,92 @@
+#pragma once
+
+#include "lve_shader_compiler.hpp"
+#include "lve_shader_reflection.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    class LveShaderModule {
+    public:
+        LveShaderModule(VkDevice device, const uint32_t* code, size_t codeSize, uint64_t contentHash);
+        ~LveShaderModule();
+
+        LveShaderModule(const LveShaderModule&) = delete;
+        LveShaderModule& operator=(const LveShaderModule&) = delete;
+
+        VkShaderModule getShaderModule() const { return shaderModule; }
+        uint64_t getContentHash() const { return contentHash; }
+        const std::vector<uint32_t>& getCode() const { return code; }
+        // Whether this module was created from exactly this SPIR-V
+        bool hasCode(const uint32_t* code, size_t codeSize) const;
+        const LveShaderReflection& getReflection() const { return reflection; }
+
+    private:
+        VkDevice device;
+        VkShaderModule shaderModule;
+        uint64_t contentHash;
+        std::vector<uint32_t> code;
+        LveShaderReflection reflection;
+    };
+
+    // Device wide registry of shader modules keyed by a hash of their SPIR-V,
+    // with the SPIR-V itself compared on a hit.
+    // The cache only holds weak references: pipelines keep the modules alive
+    // while they are being created, and a module is destroyed as soon as the
+    // last pipeline using it has been built.
+    class LveShaderModuleCache {
+    public:
+        // Reads LVE_SHADER_DIR, which takes priority over embedded shaders
+        LveShaderModuleCache(VkDevice device);
+
+        LveShaderModuleCache(const LveShaderModuleCache&) = delete;
+        LveShaderModuleCache& operator=(const LveShaderModuleCache&) = delete;
+
+        // Resolves a shader by file name: a loose file in the override directory,
+        // then the mounted asset archives, then the SPIR-V embedded by
+        // compile_shaders.sh, then the file itself
+        std::shared_ptr<LveShaderModule> load(const std::string& name);
+
+        // Resolves a #define permutation of a shader. With shaderc the GLSL
+        // source next to the .spv name is compiled, which is cached on disk per
+        // permutation; otherwise the precompiled permutationName is loaded.
+        std::shared_ptr<LveShaderModule> loadPermutation(
+            const std::string& name, const LveShaderCompiler::Defines& defines);
+
+        // simple_shader.frag.spv with {A, ""} and {B, "2"} -> simple_shader.frag.A.B_2.spv
+        static std::string permutationName(
+            const std::string& name, const LveShaderCompiler::Defines& defines);
+
+        // Maps the file, unless a live module was already loaded from this path
+        std::shared_ptr<LveShaderModule> loadFromFile(const std::string& filepath);
+        std::shared_ptr<LveShaderModule> loadFromMemory(const uint32_t* code, size_t codeSize);
+
+        // While set, modules are also held by the cache so a batch of pipeline
+        // builds shares them even if the builds don't overlap in time
+        void setRetainModules(bool retain);
+
+        static uint64_t hashCode(const void* code, size_t codeSize);
+
+    private:
+        std::shared_ptr<LveShaderModule> findOrCreate(const uint32_t* code, size_t codeSize);
+        void pruneExpired();
+
+        VkDevice device;
+        std::string overrideDirectory;
+        LveShaderCompiler compiler{};
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::weak_ptr<LveShaderModule>> modulesByHash;
+        std::unordered_map<std::string, std::weak_ptr<LveShaderModule>> modulesByPath;
+        bool retainModules = false;
+        std::vector<std::shared_ptr<LveShaderModule>> retainedModules;
+    };
+}
@@ -0,0 +1,322 @@
+#include "lve_shader_reflection.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace lve {
+
+    namespace {
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+        enum Op : uint32_t {
+            OpEntryPoint = 15,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+            OpTypeAccelerationStructureKHR = 5341,
+        };
+
+        enum Decoration : uint32_t {
+            DecorationBufferBlock = 3,
+            DecorationArrayStride = 6,
+            DecorationMatrixStride = 7,
+            DecorationBinding = 33,
+            DecorationDescriptorSet = 34,
+            DecorationOffset = 35,
+        };
+
+        enum StorageClass : uint32_t {
+            StorageClassUniformConstant = 0,
+            StorageClassUniform = 2,
+            StorageClassPushConstant = 9,
+            StorageClassStorageBuffer = 12,
+        };
+
+        enum Dim : uint32_t {
+            DimBuffer = 5,
+            DimSubpassData = 6,
+        };
+
+        struct Type {
+            uint32_t opcode = 0;
+            // Operands after the result id
+            std::vector<uint32_t> operands;
+        };
+
+        struct Member {
+            uint32_t offset = 0;
+            uint32_t matrixStride = 0;
+        };
+
+        struct Id {
+            Type type;
+            uint32_t constantValue = 0;
+            uint32_t set = 0;
+            uint32_t binding = 0;
+            bool hasBinding = false;
+            bool bufferBlock = false;
+            uint32_t arrayStride = 0;
+            std::vector<Member> members;
+        };
+
+        // Operands, including the result id, that the instructions read here
+        // must have. Longer ones carry optional operands that are skipped.
+        uint32_t minOperandCount(uint32_t opcode) {
+            switch (opcode) {
+            case OpEntryPoint: return 3;
+            case OpTypeInt: return 3;
+            case OpTypeFloat: return 2;
+            case OpTypeVector: return 3;
+            case OpTypeMatrix: return 3;
+            case OpTypeImage: return 8;
+            case OpTypeSampler: return 1;
+            case OpTypeSampledImage: return 2;
+            case OpTypeArray: return 3;
+            case OpTypeRuntimeArray: return 2;
+            case OpTypeStruct: return 1;
+            case OpTypePointer: return 3;
+            case OpConstant: return 3;
+            case OpVariable: return 3;
+            case OpDecorate: return 2;
+            case OpMemberDecorate: return 3;
+            case OpTypeAccelerationStructureKHR: return 1;
+            default: return 0;
+            }
+        }
+
+        class Parser {
+        public:
+            Parser(const std::vector<Id>& ids) : ids{ ids } {}
+
+            uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+                const Type& type = idAt(typeId).type;
+                switch (type.opcode) {
+                case OpTypeInt:
+                case OpTypeFloat:
+                    return type.operands[0] / 8;
+                case OpTypeVector:
+                    return type.operands[1] * sizeOf(type.operands[0]);
+                case OpTypeMatrix:
+                    return type.operands[1] *
+                        (matrixStride != 0 ? matrixStride : sizeOf(type.operands[0]));
+                case OpTypeArray: {
+                    uint32_t length = idAt(type.operands[1]).constantValue;
+                    uint32_t stride = ids[typeId].arrayStride;
+                    return length * (stride != 0 ? stride : sizeOf(type.operands[0]));
+                }
+                case OpTypeStruct: {
+                    const auto& members = ids[typeId].members;
+                    uint32_t size = 0;
+                    for (size_t i = 0; i < type.operands.size(); i++) {
+                        Member member = i < members.size() ? members[i] : Member{};
+                        size = std::max(
+                            size, member.offset + sizeOf(type.operands[i], member.matrixStride));
+                    }
+                    return size;
+                }
+                default:
+                    return 0;
+                }
+            }
+
+            VkDescriptorType descriptorType(uint32_t storageClass, uint32_t typeId) const {
+                const Id& id = idAt(typeId);
+                if (storageClass == StorageClassStorageBuffer) {
+                    return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                }
+                if (storageClass == StorageClassUniform) {
+                    // Older SPIR-V marks storage buffers with BufferBlock
+                    return id.bufferBlock
+                        ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                        : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                }
+
+                switch (id.type.opcode) {
+                case OpTypeSampler:
+                    return VK_DESCRIPTOR_TYPE_SAMPLER;
+                case OpTypeSampledImage:
+                    return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                case OpTypeImage: {
+                    uint32_t dim = id.type.operands[1];
+                    bool sampled = id.type.operands[5] == 1;
+                    if (dim == DimBuffer) {
+                        return sampled
+                            ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                            : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+                    }
+                    if (dim == DimSubpassData) {
+                        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                    }
+                    return sampled
+                        ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+                        : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                }
+                default:
+                    throw std::runtime_error("unsupported descriptor type in SPIR-V");
+                }
+            }
+
+        private:
+            const Id& idAt(uint32_t id) const {
+                if (id >= ids.size()) throw std::runtime_error("invalid SPIR-V id");
+                return ids[id];
+            }
+
+            const std::vector<Id>& ids;
+        };
+
+        VkShaderStageFlagBits stageOf(uint32_t executionModel) {
+            switch (executionModel) {
+            case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+            case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+            default: return VK_SHADER_STAGE_ALL;
+            }
+        }
+    }
+
+    LveShaderReflection::LveShaderReflection(const uint32_t* code, size_t codeSize) {
+        size_t wordCount = codeSize / sizeof(uint32_t);
+        if (wordCount < 5 || code[0] != SPIRV_MAGIC) {
+            throw std::runtime_error("invalid SPIR-V module");
+        }
+
+        uint32_t bound = code[3];
+        std::vector<Id> ids(bound);
+        struct Variable {
+            uint32_t id;
+            uint32_t pointerType;
+            uint32_t storageClass;
+        };
+        std::vector<Variable> variables;
+
+        auto checkId = [bound](uint32_t id) {
+            if (id >= bound) throw std::runtime_error("invalid SPIR-V id");
+            return id;
+        };
+
+        for (size_t i = 5; i < wordCount;) {
+            uint32_t opcode = code[i] & 0xffff;
+            uint32_t length = code[i] >> 16;
+            if (length == 0 || i + length > wordCount) {
+                throw std::runtime_error("truncated SPIR-V module");
+            }
+            const uint32_t* operands = code + i + 1;
+            uint32_t operandCount = length - 1;
+            if (operandCount < minOperandCount(opcode)) {
+                throw std::runtime_error("truncated SPIR-V instruction");
+            }
+
+            switch (opcode) {
+            case OpEntryPoint:
+                stage = stageOf(operands[0]);
+                break;
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypePointer:
+            case OpTypeAccelerationStructureKHR: {
+                Id& id = ids[checkId(operands[0])];
+                id.type.opcode = opcode;
+                id.type.operands.assign(operands + 1, operands + operandCount);
+                break;
+            }
+            case OpConstant:
+                ids[checkId(operands[1])].constantValue = operands[2];
+                break;
+            case OpVariable:
+                variables.push_back({ checkId(operands[1]), checkId(operands[0]), operands[2] });
+                break;
+            case OpDecorate: {
+                Id& id = ids[checkId(operands[0])];
+                bool hasLiteral = operands[1] == DecorationArrayStride ||
+                    operands[1] == DecorationBinding || operands[1] == DecorationDescriptorSet;
+                if (hasLiteral && operandCount < 3) throw std::runtime_error("truncated SPIR-V instruction");
+                switch (operands[1]) {
+                case DecorationBufferBlock: id.bufferBlock = true; break;
+                case DecorationArrayStride: id.arrayStride = operands[2]; break;
+                case DecorationBinding: id.binding = operands[2]; id.hasBinding = true; break;
+                case DecorationDescriptorSet: id.set = operands[2]; break;
+                }
+                break;
+            }
+            case OpMemberDecorate: {
+                Id& id = ids[checkId(operands[0])];
+                uint32_t member = operands[1];
+                if (operands[2] != DecorationOffset && operands[2] != DecorationMatrixStride) break;
+                if (operandCount < 4) throw std::runtime_error("truncated SPIR-V instruction");
+                if (id.members.size() <= member) id.members.resize(member + 1);
+                if (operands[2] == DecorationOffset) id.members[member].offset = operands[3];
+                if (operands[2] == DecorationMatrixStride) id.members[member].matrixStride = operands[3];
+                break;
+            }
+            }
+            i += length;
+        }
+
+        Parser parser{ ids };
+        for (const auto& variable : variables) {
+            const Type& pointer = ids[variable.pointerType].type;
+            if (pointer.opcode != OpTypePointer) continue;
+            uint32_t typeId = checkId(pointer.operands[1]);
+
+            if (variable.storageClass == StorageClassPushConstant) {
+                pushConstantSize = std::max(pushConstantSize, parser.sizeOf(typeId));
+                continue;
+            }
+            if (variable.storageClass != StorageClassUniformConstant &&
+                variable.storageClass != StorageClassUniform &&
+                variable.storageClass != StorageClassStorageBuffer) {
+                continue;
+            }
+
+            const Id& id = ids[variable.id];
+            if (!id.hasBinding) continue;
+
+            uint32_t count = 1;
+            const Type* type = &ids[typeId].type;
+            if (type->opcode == OpTypeArray) {
+                count = ids[checkId(type->operands[1])].constantValue;
+                typeId = checkId(type->operands[0]);
+            } else if (type->opcode == OpTypeRuntimeArray) {
+                count = 0;
+                typeId = checkId(type->operands[0]);
+            }
+            if (ids[typeId].type.opcode == OpTypeAccelerationStructureKHR) continue;
+
+            bindings.push_back({
+                id.set,
+                id.binding,
+                parser.descriptorType(variable.storageClass, typeId),
+                count });
+        }
+
+        std::sort(bindings.begin(), bindings.end(), [](const auto& a, const auto& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+    // Reads the resource interface of a SPIR-V module: its stage, the
+    // descriptor bindings it declares and the size of its push constant
+    // block. Only walks the declarations, so it is cheap enough to run on
+    // every module that gets loaded.
+    class LveShaderReflection {
+    public:
+        struct DescriptorBinding {
+            uint32_t set;
+            uint32_t binding;
+            VkDescriptorType descriptorType;
+            // 0 for runtime sized arrays
+            uint32_t descriptorCount;
+        };
+
+        LveShaderReflection() = default;
+        LveShaderReflection(const uint32_t* code, size_t codeSize);
+
+        VkShaderStageFlagBits getStage() const { return stage; }
+        const std::vector<DescriptorBinding>& getBindings() const { return bindings; }
+        // 0 when the module has no push constant block
+        uint32_t getPushConstantSize() const { return pushConstantSize; }
+
+    private:
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+        std::vector<DescriptorBinding> bindings;
+        uint32_t pushConstantSize = 0;
+    };
+}
@@ -1,5 +1,7 @@
 #include "lve_swap_chain.hpp"
 
+#include "lve_profiler.hpp"
+
 // std
 #include <array>
 #include <cstdlib>
@@ -11,28 +13,32 @@
 
 namespace lve {
 
-    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent)
-        : device{ deviceRef }, windowExtent{ extent } {
+    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, bool sampledDepth)
+        : device{ deviceRef }, windowExtent{ extent }, sampledDepth{ sampledDepth } {
         init();
     }
 
     LveSwapChain::LveSwapChain(
         LveDevice& deviceRef,
         VkExtent2D extent,
-        std::shared_ptr<LveSwapChain> previous)
-        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{previous} {
+        std::shared_ptr<LveSwapChain> previous,
+        bool sampledDepth)
+        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{previous}, sampledDepth{ sampledDepth } {
         init();
 
-        //Remove old swapchain since it's not being used.
+        // The caller keeps the retired swap chain alive until the frames that
+        // still reference it have finished, so drop our reference right away
         oldSwapChain = nullptr;
     }
 
     void LveSwapChain::init() {
         createSwapChain();
         createImageViews();
-        createRenderPass();
         createDepthResources();
-        createFramebuffers();
+        if (!device.dynamicRenderingEnabled()) {
+            createRenderPass();
+            createFramebuffers();
+        }
         createSyncObjects();
     }
 
@@ -47,20 +53,20 @@ namespace lve {
             swapChain = nullptr;
         }
 
-        for (int i = 0; i < depthImages.size(); i++) {
-            vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-            vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
-        }
+        vkDestroyImageView(device.device(), depthImageView, nullptr);
+        vkDestroyImage(device.device(), depthImage, nullptr);
+        vkFreeMemory(device.device(), depthImageMemory, nullptr);
 
         for (auto framebuffer : swapChainFramebuffers) {
             vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
         }
 
-        vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        if (renderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        }
 
-        // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        // cleanup synchronization objects, unless a newer swap chain took them over
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
             vkDestroySemaphore(
                 device.device(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(
@@ -250,7 +256,9 @@ namespace lve {
             VK_SAMPLE_COUNT_1_BIT;
         depthAttachment.loadOp =
             VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp =
+        // Only stored when something reads it after the pass, e.g. the Hi-Z culler
+        depthAttachment.storeOp = sampledDepth ?
+            VK_ATTACHMENT_STORE_OP_STORE :
             VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.stencilLoadOp =
             VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -295,20 +303,26 @@ namespace lve {
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+        // The depth buffer is shared between frames in flight, so this frame's
+        // depth clear and writes must wait for the previous frame's depth writes
         VkSubpassDependency dependency = {};
 
         dependency.dstSubpass = 0;
         dependency.dstAccessMask =
             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         dependency.dstStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
+        dependency.srcAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         dependency.srcStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 
         std::array<VkAttachmentDescription, 2> attachments =
             { colorAttachment, depthAttachment };
@@ -333,7 +347,7 @@ namespace lve {
         swapChainFramebuffers.resize(imageCount());
         for (size_t i = 0; i < imageCount(); i++) {
             std::array<VkImageView, 2> attachments =
-            { swapChainImageViews[i], depthImageViews[i] };
+            { swapChainImageViews[i], depthImageView };
 
             VkExtent2D swapChainExtent = getSwapChainExtent();
             VkFramebufferCreateInfo framebufferInfo = {};
@@ -361,57 +375,82 @@ namespace lve {
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
-        depthImages.resize(imageCount());
-        depthImageMemorys.resize(imageCount());
-        depthImageViews.resize(imageCount());
-
-        for (int i = 0; i < depthImages.size(); i++) {
-            VkImageCreateInfo imageInfo{};
-            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = swapChainExtent.width;
-            imageInfo.extent.height = swapChainExtent.height;
-            imageInfo.extent.depth = 1;
-            imageInfo.mipLevels = 1;
-            imageInfo.arrayLayers = 1;
-            imageInfo.format = depthFormat;
-            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            imageInfo.flags = 0;
-
-            device.createImageWithInfo(
-                imageInfo,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                depthImages[i],
-                depthImageMemorys[i]);
-
-            VkImageViewCreateInfo viewInfo{};
-            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            viewInfo.image = depthImages[i];
-            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            viewInfo.format = depthFormat;
-            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            viewInfo.subresourceRange.baseMipLevel = 0;
-            viewInfo.subresourceRange.levelCount = 1;
-            viewInfo.subresourceRange.baseArrayLayer = 0;
-            viewInfo.subresourceRange.layerCount = 1;
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = depthFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            (sampledDepth ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
+
+        // Tile based GPUs can keep a transient depth buffer in on-chip memory
+        // and never back it with real allocations
+        VkMemoryPropertyFlags memoryProperties = device.createImageWithInfo(
+            imageInfo,
+            sampledDepth ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            depthImage,
+            depthImageMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = depthImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device.device(), &viewInfo,
+            nullptr, &depthImageView) != VK_SUCCESS) {
+            throw std::runtime_error(
+                "Failed to create texture image view!");
+        }
 
-            if (vkCreateImageView(device.device(), &viewInfo,
-                nullptr, &depthImageViews[i]) != VK_SUCCESS) {
-                throw std::runtime_error(
-                    "Failed to create texture image view!");
-            }
+        // Compare against the one depth image per swap chain image used before
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device.device(), depthImage, &memRequirements);
+        VkDeviceSize residentBytes = memRequirements.size;
+        if (memoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            vkGetDeviceMemoryCommitment(device.device(), depthImageMemory, &residentBytes);
         }
+        VkDeviceSize perImageBytes = memRequirements.size * imageCount();
+        LveProfiler::setGauge("swapchain.depthKB", static_cast<int64_t>(residentBytes / 1024));
+        LveProfiler::setGauge(
+            "swapchain.depthSavedKB", static_cast<int64_t>((perImageBytes - residentBytes) / 1024));
     }
 
     void LveSwapChain::createSyncObjects() {
+        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+
+        // Frames recorded against the old swap chain may still be in flight.
+        // Carrying over its fences and semaphores keeps them ordered with the
+        // frames that follow, with no need to wait for the device to go idle.
+        if (oldSwapChain != nullptr) {
+            imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+            renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+            inFlightFences = std::move(oldSwapChain->inFlightFences);
+            currentFrame = oldSwapChain->currentFrame;
+            oldSwapChain->imageAvailableSemaphores.clear();
+            oldSwapChain->renderFinishedSemaphores.clear();
+            oldSwapChain->inFlightFences.clear();
+            return;
+        }
+
         imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -498,6 +537,7 @@ namespace lve {
             VK_FORMAT_D32_SFLOAT_S8_UINT,
             VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
     }
 }
\ No newline at end of file
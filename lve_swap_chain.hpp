@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_pipeline.hpp"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -16,9 +17,11 @@ namespace lve {
     public:
         static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent);
+        // sampledDepth keeps the depth contents after the pass so they can be
+        // read, otherwise depth is a transient attachment that is never stored
+        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent, bool sampledDepth = true);
         LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent,
-            std::shared_ptr<LveSwapChain> previous);
+            std::shared_ptr<LveSwapChain> previous, bool sampledDepth = true);
         ~LveSwapChain();
 
         LveSwapChain(const LveSwapChain&) = delete;
@@ -28,12 +31,24 @@ namespace lve {
             return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() {
             return renderPass; }
+        RenderTargetInfo getRenderTarget() {
+            return { renderPass, swapChainImageFormat, swapChainDepthFormat }; }
+        VkImage getImage(int index) {
+            return swapChainImages[index]; }
         VkImageView getImageView(int index) {
             return swapChainImageViews[index]; }
+        VkImage getDepthImage() {
+            return depthImage; }
+        VkImageView getDepthImageView() {
+            return depthImageView; }
+        bool isDepthSampled() {
+            return sampledDepth; }
         size_t imageCount() {
             return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() {
             return swapChainImageFormat; }
+        VkFormat getSwapChainDepthFormat() {
+            return swapChainDepthFormat; }
         VkExtent2D getSwapChainExtent() {
             return swapChainExtent; }
         uint32_t width() {
@@ -80,11 +95,14 @@ namespace lve {
         VkExtent2D swapChainExtent;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
-
-        std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImageMemorys;
-        std::vector<VkImageView> depthImageViews;
+        // Left null with dynamic rendering, which needs no framebuffers either
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+
+        // One depth buffer shared by all frames, ordered by the render pass dependency
+        VkImage depthImage;
+        VkDeviceMemory depthImageMemory;
+        VkImageView depthImageView;
+        bool sampledDepth;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
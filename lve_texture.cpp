@@ -0,0 +1,408 @@
+#include "lve_texture.hpp"
+
+#include "lve_buffer.hpp"
+#include "lve_ktx2.hpp"
+
+// libs
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// std
+#include <stdexcept>
+
+namespace lve {
+
+    namespace {
+        // Uploads the given levels through one staging buffer and waits for
+        // the copy; levels after them are generated
+        std::unique_ptr<LveTexture> createTextureWithLevels(
+            LveDevice& device,
+            uint32_t width,
+            uint32_t height,
+            uint32_t mipLevels,
+            VkFormat format,
+            const std::vector<const void*>& levelData) {
+            auto texture = std::make_unique<LveTexture>(device, width, height, mipLevels, format);
+
+            // Offsets must be multiples of the texel block size
+            const VkDeviceSize alignment = 16;
+            std::vector<VkDeviceSize> levelOffsets;
+            VkDeviceSize size = 0;
+            for (uint32_t level = 0; level < levelData.size(); level++) {
+                levelOffsets.push_back(size);
+                size += (LveTexture::mipSize(format, width, height, level) + alignment - 1) &
+                    ~(alignment - 1);
+            }
+
+            LveBuffer stagingBuffer{
+                device,
+                size,
+                1,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            };
+            stagingBuffer.map();
+            for (uint32_t level = 0; level < levelData.size(); level++) {
+                stagingBuffer.writeToBuffer(
+                    const_cast<void*>(levelData[level]),
+                    LveTexture::mipSize(format, width, height, level),
+                    levelOffsets[level]);
+            }
+
+            VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+            texture->recordUpload(commandBuffer, stagingBuffer.getBuffer(), levelOffsets);
+            device.endSingleTimeCommands(commandBuffer);
+            return texture;
+        }
+    }
+
+    LveTexture::LveTexture(
+        LveDevice& device,
+        uint32_t width,
+        uint32_t height,
+        uint32_t mipLevels,
+        VkFormat format)
+        : lveDevice{ device }, width{ width }, height{ height }, mipLevels{ mipLevels }, format{ format } {
+        createImage();
+        createImageView();
+        createSampler();
+    }
+
+    LveTexture::LveTexture(
+        LveDevice& device,
+        uint32_t width,
+        uint32_t height,
+        const void* pixels,
+        VkFormat format)
+        : LveTexture(device, width, height, 1, format) {
+        LveBuffer stagingBuffer{
+            lveDevice,
+            mipSize(format, width, height, 0),
+            1,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        };
+        stagingBuffer.map();
+        stagingBuffer.writeToBuffer(const_cast<void*>(pixels));
+
+        VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+        recordUpload(commandBuffer, stagingBuffer.getBuffer(), { 0 });
+        lveDevice.endSingleTimeCommands(commandBuffer);
+    }
+
+    LveTexture::~LveTexture() {
+        vkDestroySampler(lveDevice.device(), sampler, nullptr);
+        vkDestroyImageView(lveDevice.device(), imageView, nullptr);
+        vkDestroyImage(lveDevice.device(), image, nullptr);
+        vkFreeMemory(lveDevice.device(), imageMemory, nullptr);
+    }
+
+    std::unique_ptr<LveTexture> LveTexture::createTextureFromFile(
+        LveDevice& device, const std::string& filepath) {
+        if (LveKtx2File::hasKtx2Extension(filepath)) {
+            LveKtx2File file{ filepath };
+            VkFormat format = file.getFormat();
+            if (!isSampleable(device, format)) {
+                throw std::runtime_error("device can't sample the format of " + filepath);
+            }
+
+            std::vector<const void*> levelData;
+            for (uint32_t level = 0; level < file.getLevelCount(); level++) {
+                levelData.push_back(file.levelData(level));
+            }
+            uint32_t mipLevels = file.getLevelCount();
+            if (file.getGenerateMips() && canGenerateMips(device, format)) {
+                mipLevels = fullMipLevels(file.getWidth(), file.getHeight());
+            }
+            return createTextureWithLevels(
+                device, file.getWidth(), file.getHeight(), mipLevels, format, levelData);
+        }
+
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            throw std::runtime_error(
+                "failed to load texture " + filepath + ": " + stbi_failure_reason());
+        }
+
+        const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        uint32_t mipLevels = canGenerateMips(device, format)
+            ? fullMipLevels(static_cast<uint32_t>(width), static_cast<uint32_t>(height))
+            : 1;
+        std::unique_ptr<LveTexture> texture;
+        try {
+            texture = createTextureWithLevels(
+                device,
+                static_cast<uint32_t>(width),
+                static_cast<uint32_t>(height),
+                mipLevels,
+                format,
+                { pixels });
+        } catch (...) {
+            stbi_image_free(pixels);
+            throw;
+        }
+        stbi_image_free(pixels);
+        return texture;
+    }
+
+    LveTexture::FormatInfo LveTexture::getFormatInfo(VkFormat format) {
+        // Compressed formats are laid out in families of consecutive enum values
+        if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) {
+            bool eightBytes = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+                format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC4_SNORM_BLOCK;
+            return { 4, 4, eightBytes ? 8u : 16u, true };
+        }
+        if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) {
+            bool sixteenBytes =
+                (format >= VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK && format <= VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) ||
+                format >= VK_FORMAT_EAC_R11G11_UNORM_BLOCK;
+            return { 4, 4, sixteenBytes ? 16u : 8u, true };
+        }
+        if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+            // UNORM and SRGB pairs, in this order of block dimensions
+            static const uint32_t astcBlocks[][2] = {
+                { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+                { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+            const auto& block = astcBlocks[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+            return { block[0], block[1], 16, true };
+        }
+
+        switch (format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            return { 1, 1, 1, false };
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SRGB:
+            return { 1, 1, 2, false };
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+            return { 1, 1, 4, false };
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return { 1, 1, 8, false };
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return { 1, 1, 16, false };
+        default:
+            throw std::runtime_error("unsupported texture format " + std::to_string(format));
+        }
+    }
+
+    VkDeviceSize LveTexture::mipSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+        FormatInfo info = getFormatInfo(format);
+        VkDeviceSize blocksX = (std::max(width >> level, 1u) + info.blockWidth - 1) / info.blockWidth;
+        VkDeviceSize blocksY = (std::max(height >> level, 1u) + info.blockHeight - 1) / info.blockHeight;
+        return blocksX * blocksY * info.blockSize;
+    }
+
+    uint32_t LveTexture::fullMipLevels(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        while ((std::max(width, height) >> levels) > 0) {
+            levels++;
+        }
+        return levels;
+    }
+
+    bool LveTexture::isSampleable(LveDevice& device, VkFormat format) {
+        return device.isFormatSupported(format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    }
+
+    bool LveTexture::canGenerateMips(LveDevice& device, VkFormat format) {
+        return !getFormatInfo(format).compressed &&
+            device.isFormatSupported(
+                format,
+                VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    }
+
+    VkDeviceSize LveTexture::getSize() const {
+        VkDeviceSize size = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            size += mipSize(format, width, height, level);
+        }
+        return size;
+    }
+
+    void LveTexture::createImage() {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = { width, height, 1 };
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage =
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        lveDevice.createImageWithInfo(
+            imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+    }
+
+    void LveTexture::recordUpload(
+        VkCommandBuffer commandBuffer,
+        VkBuffer srcBuffer,
+        const std::vector<VkDeviceSize>& levelOffsets) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        uint32_t uploadedLevels = static_cast<uint32_t>(levelOffsets.size());
+        for (uint32_t level = 0; level < uploadedLevels; level++) {
+            lveDevice.recordCopyBufferToImage(
+                commandBuffer,
+                srcBuffer,
+                image,
+                std::max(width >> level, 1u),
+                std::max(height >> level, 1u),
+                1,
+                level,
+                levelOffsets[level]);
+        }
+
+        if (uploadedLevels < mipLevels) {
+            recordGenerateMips(commandBuffer, uploadedLevels - 1);
+            return;
+        }
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void LveTexture::recordGenerateMips(VkCommandBuffer commandBuffer, uint32_t baseLevel) {
+        // Every level starts in TRANSFER_DST_OPTIMAL. Each level is blitted
+        // from the one above it, which is then done and made shader readable.
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+
+        if (baseLevel > 0) {
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, baseLevel, 0, 1 };
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        for (uint32_t level = baseLevel + 1; level < mipLevels; level++) {
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1 };
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit{};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            blit.srcOffsets[1] = {
+                static_cast<int32_t>(std::max(width >> (level - 1), 1u)),
+                static_cast<int32_t>(std::max(height >> (level - 1), 1u)),
+                1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            blit.dstOffsets[1] = {
+                static_cast<int32_t>(std::max(width >> level, 1u)),
+                static_cast<int32_t>(std::max(height >> level, 1u)),
+                1 };
+            vkCmdBlitImage(
+                commandBuffer,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1,
+                &blit,
+                VK_FILTER_LINEAR);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1, 1, 0, 1 };
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void LveTexture::createImageView() {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+        if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+    }
+
+    void LveTexture::createSampler() {
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.anisotropyEnable = VK_TRUE;
+        samplerInfo.maxAnisotropy = lveDevice.properties.limits.maxSamplerAnisotropy;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = static_cast<float>(mipLevels);
+
+        if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+    }
+}
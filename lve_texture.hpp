@@ -0,0 +1,97 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+    // A sampled 2D image in device local memory, left in
+    // SHADER_READ_ONLY_OPTIMAL layout once its pixels have been uploaded.
+    // Block compressed formats are uploaded as they are; levels that weren't
+    // uploaded are generated on the GPU by blitting, for formats that allow it.
+    class LveTexture {
+    public:
+        static constexpr uint32_t PIXEL_SIZE = 4;
+
+        // Texel block of a format, 1x1 for uncompressed formats
+        struct FormatInfo {
+            uint32_t blockWidth;
+            uint32_t blockHeight;
+            uint32_t blockSize;
+            bool compressed;
+        };
+
+        // Creates the image without contents, for uploads recorded with recordUpload
+        LveTexture(
+            LveDevice& device,
+            uint32_t width,
+            uint32_t height,
+            uint32_t mipLevels,
+            VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+        // Uploads tightly packed RGBA8 pixels and waits for the copy
+        LveTexture(
+            LveDevice& device,
+            uint32_t width,
+            uint32_t height,
+            const void* pixels,
+            VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+        ~LveTexture();
+
+        LveTexture(const LveTexture&) = delete;
+        LveTexture& operator=(const LveTexture&) = delete;
+
+        // Loads the levels of .ktx2 files as stored, and decodes any format
+        // stb_image supports to RGBA8. Missing levels are generated when the
+        // format supports it.
+        static std::unique_ptr<LveTexture> createTextureFromFile(
+            LveDevice& device, const std::string& filepath);
+
+        // Throws for formats without a known block size
+        static FormatInfo getFormatInfo(VkFormat format);
+        static VkDeviceSize mipSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+        static uint32_t fullMipLevels(uint32_t width, uint32_t height);
+        // Whether the device can sample the format, and blit it with linear filtering
+        static bool isSampleable(LveDevice& device, VkFormat format);
+        static bool canGenerateMips(LveDevice& device, VkFormat format);
+
+        // Copies the first levelOffsets.size() levels from srcBuffer, level i
+        // starting at levelOffsets[i], generates any levels after those and
+        // makes the image readable by fragment shaders
+        void recordUpload(
+            VkCommandBuffer commandBuffer,
+            VkBuffer srcBuffer,
+            const std::vector<VkDeviceSize>& levelOffsets);
+
+        VkDescriptorImageInfo descriptorInfo() const {
+            return { sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        }
+
+        uint32_t getWidth() const { return width; }
+        uint32_t getHeight() const { return height; }
+        uint32_t getMipLevels() const { return mipLevels; }
+        // Device memory of all levels
+        VkDeviceSize getSize() const;
+
+    private:
+        void createImage();
+        void createImageView();
+        void createSampler();
+        void recordGenerateMips(VkCommandBuffer commandBuffer, uint32_t baseLevel);
+
+        LveDevice& lveDevice;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        VkFormat format;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkSampler sampler = VK_NULL_HANDLE;
+    };
+}
@@ -0,0 +1,436 @@
+#include "lve_texture_streamer.hpp"
+
+#include "lve_profiler.hpp"
+
+// libs
+#include <stb_image.h>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+    LveTextureStreamer::LveTextureStreamer(
+        LveDevice& device,
+        LveMaterialSystem& materialSystem,
+        LveUploadQueue& uploadQueue,
+        LveThreadPool& threadPool,
+        LveAsyncIo& asyncIo,
+        VkDeviceSize budget)
+        : lveDevice{ device },
+        materialSystem{ materialSystem },
+        uploadQueue{ uploadQueue },
+        threadPool{ threadPool },
+        asyncIo{ asyncIo },
+        budget{ budget } {}
+
+    LveTextureStreamer::~LveTextureStreamer() {
+        // Decode jobs write into the entries
+        for (auto& entry : entries) {
+            if (entry->decoded.valid()) {
+                entry->decoded.wait();
+            }
+        }
+    }
+
+    LveTextureStreamer::Entry& LveTextureStreamer::addEntry(const std::string& name) {
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->textureId = materialSystem.reserveTexture();
+        Entry& result = *entry;
+        entriesByTexture.emplace(entry->textureId, entry.get());
+        entries.push_back(std::move(entry));
+        return result;
+    }
+
+    uint32_t LveTextureStreamer::load(const std::string& filepath) {
+        auto it = texturesByPath.find(filepath);
+        if (it != texturesByPath.end()) {
+            return it->second;
+        }
+
+        // The decoded future becomes valid once the read has completed and
+        // the decode job was queued
+        Entry& entry = addEntry(filepath);
+        Entry* decodeEntry = &entry;
+        asyncIo.read(filepath, [this, decodeEntry](LveAsyncIo::Result result) {
+            std::shared_ptr<const LveIoBuffer> contents = std::move(result.buffer);
+            std::string error = result.error;
+            decodeEntry->decoded = threadPool.submit([decodeEntry, contents, error]() {
+                if (!contents) {
+                    throw std::runtime_error(error);
+                }
+                decode(*decodeEntry, contents);
+            });
+        });
+
+        texturesByPath.emplace(filepath, entry.textureId);
+        return entry.textureId;
+    }
+
+    void LveTextureStreamer::decode(Entry& entry, std::shared_ptr<const LveIoBuffer> contents) {
+        if (LveKtx2File::hasKtx2Extension(entry.name)) {
+            auto file = std::make_unique<LveKtx2File>(
+                entry.name, contents->data(), contents->size(), contents);
+            entry.width = file->getWidth();
+            entry.height = file->getHeight();
+            entry.format = file->getFormat();
+
+            // A lone RGBA8 level gets the same chain as decoded images
+            bool rgba8 = file->getFormat() == VK_FORMAT_R8G8B8A8_SRGB ||
+                file->getFormat() == VK_FORMAT_R8G8B8A8_UNORM;
+            if (file->getGenerateMips() && rgba8) {
+                const uint8_t* data = file->levelData(0);
+                generateMips(entry, std::vector<uint8_t>(data, data + file->levelSize(0)));
+                return;
+            }
+            entry.ktx2 = std::move(file);
+            setLevels(entry, entry.ktx2->getLevelCount());
+            return;
+        }
+
+        int width, height, channels;
+        stbi_uc* data = stbi_load_from_memory(
+            contents->data(),
+            static_cast<int>(contents->size()),
+            &width,
+            &height,
+            &channels,
+            STBI_rgb_alpha);
+        if (data == nullptr) {
+            throw std::runtime_error(
+                "failed to load texture " + entry.name + ": " + stbi_failure_reason());
+        }
+        std::vector<uint8_t> pixels(data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+
+        entry.width = static_cast<uint32_t>(width);
+        entry.height = static_cast<uint32_t>(height);
+        generateMips(entry, std::move(pixels));
+    }
+
+    uint32_t LveTextureStreamer::addTexture(
+        const std::string& name, uint32_t width, uint32_t height, std::vector<uint8_t> pixels) {
+        if (pixels.size() != static_cast<size_t>(width) * height * LveTexture::PIXEL_SIZE) {
+            throw std::runtime_error("texture " + name + " has the wrong number of pixels");
+        }
+
+        Entry& entry = addEntry(name);
+        entry.width = width;
+        entry.height = height;
+        Entry* decodeEntry = &entry;
+        entry.decoded = threadPool.submit([decodeEntry, pixels = std::move(pixels)]() mutable {
+            generateMips(*decodeEntry, std::move(pixels));
+        });
+        return entry.textureId;
+    }
+
+    void LveTextureStreamer::generateMips(Entry& entry, std::vector<uint8_t> pixels) {
+        // 2x2 box filter on the stored values. Averaging sRGB values directly
+        // darkens high contrast detail slightly, which is fine for streaming.
+        entry.mips.push_back(std::move(pixels));
+        uint32_t width = entry.width;
+        uint32_t height = entry.height;
+        while (width > 1 || height > 1) {
+            const std::vector<uint8_t>& src = entry.mips.back();
+            uint32_t dstWidth = std::max(width / 2, 1u);
+            uint32_t dstHeight = std::max(height / 2, 1u);
+            std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+            for (uint32_t y = 0; y < dstHeight; y++) {
+                uint32_t y0 = std::min(y * 2, height - 1);
+                uint32_t y1 = std::min(y * 2 + 1, height - 1);
+                for (uint32_t x = 0; x < dstWidth; x++) {
+                    uint32_t x0 = std::min(x * 2, width - 1);
+                    uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                    for (uint32_t c = 0; c < 4; c++) {
+                        uint32_t sum =
+                            src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+                            src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                        dst[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+
+            entry.mips.push_back(std::move(dst));
+            width = dstWidth;
+            height = dstHeight;
+        }
+        setLevels(entry, static_cast<uint32_t>(entry.mips.size()));
+    }
+
+    void LveTextureStreamer::setLevels(Entry& entry, uint32_t mipLevels) {
+        entry.mipLevels = mipLevels;
+        entry.tailMip = 0;
+        while (entry.tailMip + 1 < mipLevels &&
+            std::max(entry.width >> entry.tailMip, entry.height >> entry.tailMip) > MIN_RESIDENT_SIZE) {
+            entry.tailMip++;
+        }
+        entry.residentMip = mipLevels;
+        entry.targetMip = mipLevels;
+        entry.wantedMip = entry.tailMip;
+    }
+
+    const uint8_t* LveTextureStreamer::levelData(const Entry& entry, uint32_t level) {
+        return entry.ktx2 ? entry.ktx2->levelData(level) : entry.mips[level].data();
+    }
+
+    VkDeviceSize LveTextureStreamer::residentSize(const Entry& entry, uint32_t topMip) {
+        VkDeviceSize size = 0;
+        for (uint32_t level = topMip; level < entry.mipLevels; level++) {
+            size += LveTexture::mipSize(entry.format, entry.width, entry.height, level);
+        }
+        return size;
+    }
+
+    VkDeviceSize LveTextureStreamer::getResidentBytes() const {
+        VkDeviceSize size = 0;
+        for (const auto& entry : entries) {
+            if (entry->loaded) {
+                size += residentSize(*entry, entry->residentMip);
+            }
+        }
+        return size;
+    }
+
+    void LveTextureStreamer::pollDecoded() {
+        for (auto& entry : entries) {
+            if (entry->loaded || !entry->decoded.valid() ||
+                entry->decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+
+            try {
+                entry->decoded.get();
+            } catch (const std::exception& e) {
+                // Keeps showing the default texture
+                std::cerr << "Texture decode failed: " << e.what() << std::endl;
+                continue;
+            }
+            if (!LveTexture::isSampleable(lveDevice, entry->format)) {
+                std::cerr << "Texture format not supported by the device: " << entry->name << std::endl;
+                entry->ktx2 = nullptr;
+                continue;
+            }
+            entry->gpuMips = !entry->ktx2 && LveTexture::canGenerateMips(lveDevice, entry->format);
+            entry->loaded = true;
+            entry->lastUsedFrame = frameCounter;
+            requestResidency(*entry, entry->tailMip);
+        }
+    }
+
+    void LveTextureStreamer::requestResidency(Entry& entry, uint32_t topMip) {
+        uint32_t width = std::max(entry.width >> topMip, 1u);
+        uint32_t height = std::max(entry.height >> topMip, 1u);
+        entry.pendingTexture = std::make_unique<LveTexture>(
+            lveDevice, width, height, entry.mipLevels - topMip, entry.format);
+        entry.targetMip = topMip;
+
+        // Level sizes are multiples of the block size, so packing them keeps
+        // every offset aligned
+        uint32_t endMip = entry.gpuMips ? topMip + 1 : entry.mipLevels;
+        Entry* uploadEntry = &entry;
+        LveTexture* texture = entry.pendingTexture.get();
+        LveUploadQueue::Upload upload{};
+        upload.size = residentSize(entry, topMip) - residentSize(entry, endMip);
+        upload.write = [uploadEntry, topMip, endMip](void* dst) {
+            auto* bytes = static_cast<uint8_t*>(dst);
+            for (uint32_t level = topMip; level < endMip; level++) {
+                VkDeviceSize size = LveTexture::mipSize(
+                    uploadEntry->format, uploadEntry->width, uploadEntry->height, level);
+                std::memcpy(bytes, levelData(*uploadEntry, level), size);
+                bytes += size;
+            }
+        };
+        upload.record = [uploadEntry, topMip, endMip, texture](
+            VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize offset) {
+            std::vector<VkDeviceSize> levelOffsets;
+            for (uint32_t level = topMip; level < endMip; level++) {
+                levelOffsets.push_back(offset);
+                offset += LveTexture::mipSize(
+                    uploadEntry->format, uploadEntry->width, uploadEntry->height, level);
+            }
+            texture->recordUpload(commandBuffer, srcBuffer, levelOffsets);
+        };
+        upload.complete = [this, uploadEntry, topMip]() {
+            materialSystem.replaceTexture(
+                uploadEntry->textureId, std::move(uploadEntry->pendingTexture));
+            uploadEntry->residentMip = topMip;
+        };
+        uploadQueue.enqueue(std::move(upload));
+    }
+
+    void LveTextureStreamer::updateWantedMips(FrameInfo& frameInfo, VkExtent2D extent) {
+        for (auto& entry : entries) {
+            entry->wantedMip = entry->tailMip;
+            entry->priority = 0.f;
+            entry->distance = std::numeric_limits<float>::max();
+        }
+
+        const glm::mat4& view = frameInfo.camera.getView();
+        // Pixels per unit of view space size at distance 1
+        const float pixelScale = frameInfo.camera.getProjection()[1][1] * extent.height * .5f;
+
+        for (auto& keyValue : frameInfo.gameObjects) {
+            auto& obj = keyValue.second;
+            if (obj.model == nullptr) continue;
+
+            const Material& material = materialSystem.getMaterial(obj.materialIndex);
+            auto it = entriesByTexture.find(material.baseColorTexture);
+            if (it == entriesByTexture.end() || !it->second->loaded) continue;
+            Entry& entry = *it->second;
+
+            // Bounding sphere in world space
+            const auto& bounds = obj.model->getBoundingBox();
+            glm::vec3 scale = glm::abs(obj.transform.scale);
+            float radius = glm::length(bounds.max - bounds.min) * .5f *
+                std::max(scale.x, std::max(scale.y, scale.z));
+            glm::vec3 center = glm::vec3(
+                obj.transform.mat4() * glm::vec4((bounds.min + bounds.max) * .5f, 1.f));
+            float distance = glm::length(glm::vec3(view * glm::vec4(center, 1.f)));
+
+            float screenRadius = distance > radius
+                ? radius * pixelScale / (distance - radius)
+                : static_cast<float>(extent.height);
+            screenRadius = std::min(screenRadius, static_cast<float>(extent.height));
+
+            // Pixels covered by one repeat of the texture across the object
+            float uvScale = std::max(material.uvScale.x, material.uvScale.y);
+            float pixels = std::max(2.f * screenRadius / std::max(uvScale, 1e-3f), 1.f);
+            float texels = static_cast<float>(std::max(entry.width, entry.height));
+            uint32_t mip = texels > pixels
+                ? static_cast<uint32_t>(std::floor(std::log2(texels / pixels)))
+                : 0;
+
+            entry.wantedMip = std::min(entry.wantedMip, std::min(mip, entry.tailMip));
+            entry.priority = std::max(entry.priority, screenRadius);
+            entry.distance = std::min(entry.distance, distance);
+            entry.lastUsedFrame = frameCounter;
+        }
+    }
+
+    void LveTextureStreamer::update(FrameInfo& frameInfo, VkExtent2D extent) {
+        frameCounter++;
+        pollDecoded();
+        updateWantedMips(frameInfo, extent);
+
+        // Budget is counted at the target levels, uploads in flight included
+        VkDeviceSize committed = 0;
+        for (auto& entry : entries) {
+            if (entry->loaded) {
+                committed += residentSize(*entry, entry->targetMip);
+            }
+        }
+
+        // Over budget: drop one level of the least recently used textures
+        // that are either off screen or more detailed than needed
+        if (committed > budget) {
+            candidates.clear();
+            for (auto& entry : entries) {
+                if (!entry->loaded || entry->residentMip != entry->targetMip) continue;
+                if (entry->targetMip >= entry->tailMip) continue;
+                if (entry->lastUsedFrame == frameCounter && entry->targetMip >= entry->wantedMip) continue;
+                candidates.push_back(entry.get());
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) {
+                if (a->lastUsedFrame != b->lastUsedFrame) return a->lastUsedFrame < b->lastUsedFrame;
+                return a->priority < b->priority;
+            });
+            for (Entry* entry : candidates) {
+                if (committed <= budget) break;
+                committed -= LveTexture::mipSize(
+                    entry->format, entry->width, entry->height, entry->targetMip);
+                requestResidency(*entry, entry->targetMip + 1);
+                LveProfiler::addCounter("textures.evictions", 1);
+            }
+        }
+
+        // Largest on screen first, the nearer one within the same pixel size
+        candidates.clear();
+        for (auto& entry : entries) {
+            if (!entry->loaded || entry->residentMip != entry->targetMip) continue;
+            if (entry->wantedMip < entry->targetMip) {
+                candidates.push_back(entry.get());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) {
+            float pixelsA = std::floor(a->priority);
+            float pixelsB = std::floor(b->priority);
+            if (pixelsA != pixelsB) return pixelsA > pixelsB;
+            return a->distance < b->distance;
+        });
+        uint32_t requests = 0;
+        for (Entry* entry : candidates) {
+            if (requests == MAX_REQUESTS_PER_FRAME) break;
+            VkDeviceSize levelSize =
+                LveTexture::mipSize(entry->format, entry->width, entry->height, entry->targetMip - 1);
+            if (committed + levelSize > budget) continue;
+            committed += levelSize;
+            requestResidency(*entry, entry->targetMip - 1);
+            requests++;
+        }
+        LveProfiler::addCounter("textures.requests", requests);
+
+        LveProfiler::setGauge("textures.residentKB", static_cast<int64_t>(getResidentBytes() / 1024));
+        LveProfiler::setGauge("textures.budgetKB", static_cast<int64_t>(budget / 1024));
+        VkDeviceSize heapBudget, heapUsage;
+        if (lveDevice.queryDeviceLocalBudget(heapBudget, heapUsage)) {
+            LveProfiler::setGauge("memory.deviceLocalBudgetMB", static_cast<int64_t>(heapBudget >> 20));
+            LveProfiler::setGauge("memory.deviceLocalUsageMB", static_cast<int64_t>(heapUsage >> 20));
+        }
+    }
+
+    std::vector<LveTextureStreamer::TextureStats> LveTextureStreamer::getStats() const {
+        std::vector<TextureStats> stats;
+        for (const auto& entry : entries) {
+            TextureStats stat{};
+            stat.name = entry->name;
+            // The rest is still being written by the decode job
+            if (entry->loaded) {
+                stat.width = entry->width;
+                stat.height = entry->height;
+                stat.mipLevels = entry->mipLevels;
+                stat.residentMip = entry->residentMip;
+                stat.wantedMip = entry->wantedMip;
+                stat.residentBytes = residentSize(*entry, entry->residentMip);
+                stat.framesSinceUse = frameCounter - entry->lastUsedFrame;
+            }
+            stats.push_back(stat);
+        }
+        return stats;
+    }
+
+    void LveTextureStreamer::printStats(std::ostream& out) const {
+        out << "Texture residency: " << getResidentBytes() / 1024 << " KB of "
+            << budget / 1024 << " KB budget";
+        VkDeviceSize heapBudget, heapUsage;
+        if (lveDevice.queryDeviceLocalBudget(heapBudget, heapUsage)) {
+            out << ", device local " << (heapUsage >> 20) << " MB used of "
+                << (heapBudget >> 20) << " MB";
+        }
+        out << std::endl;
+
+        for (const auto& stat : getStats()) {
+            if (stat.mipLevels == 0) {
+                out << "  " << stat.name << ": loading" << std::endl;
+                continue;
+            }
+            if (stat.residentMip == stat.mipLevels) {
+                out << "  " << stat.name << ": uploading" << std::endl;
+                continue;
+            }
+            out << "  " << stat.name << ": " << stat.width << "x" << stat.height
+                << ", resident mip " << stat.residentMip << " ("
+                << std::max(stat.width >> stat.residentMip, 1u) << "x"
+                << std::max(stat.height >> stat.residentMip, 1u) << "), wanted "
+                << stat.wantedMip << ", " << stat.residentBytes / 1024 << " KB, used "
+                << stat.framesSinceUse << " frames ago" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "lve_async_io.hpp"
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_ktx2.hpp"
+#include "lve_material_system.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_queue.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Streams the mip levels of textures under a device memory budget.
+    // Files are read through the async I/O queue; decoding and CPU mip
+    // generation then run on the thread pool, after which
+    // only the small levels are uploaded. Every frame each texture's wanted
+    // level is derived from the screen size of the objects using it, and the
+    // largest on screen get one more level per request through the upload
+    // queue. When the resident levels exceed the budget, the top levels of
+    // the least recently used textures are dropped.
+    //
+    // A residency change uploads a new image holding the resident levels and
+    // swaps it in through the material system, so frames in flight keep the
+    // old one. The whole chain stays in system memory to stream from. When
+    // the format can be blitted only the top level is uploaded and the levels
+    // below it are generated on the GPU. KTX2 files stream their stored
+    // levels from the mapped file, block compressed data included.
+    class LveTextureStreamer {
+    public:
+        // Levels up to this size are resident as soon as a texture is decoded
+        static constexpr uint32_t MIN_RESIDENT_SIZE = 64;
+        static constexpr uint32_t MAX_REQUESTS_PER_FRAME = 4;
+
+        struct TextureStats {
+            std::string name;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;    // 0 while decoding
+            uint32_t residentMip;  // mipLevels until the first upload completes
+            uint32_t wantedMip;
+            VkDeviceSize residentBytes;
+            uint64_t framesSinceUse;
+        };
+
+        LveTextureStreamer(
+            LveDevice& device,
+            LveMaterialSystem& materialSystem,
+            LveUploadQueue& uploadQueue,
+            LveThreadPool& threadPool,
+            LveAsyncIo& asyncIo,
+            VkDeviceSize budget = 256 * 1024 * 1024);
+        ~LveTextureStreamer();
+
+        LveTextureStreamer(const LveTextureStreamer&) = delete;
+        LveTextureStreamer& operator=(const LveTextureStreamer&) = delete;
+
+        // Return a texture id of the material system, which shows the default
+        // texture until the first levels are resident. Files are loaded once;
+        // .ktx2 files are used as stored, anything else is decoded to RGBA8.
+        uint32_t load(const std::string& filepath);
+        // Tightly packed RGBA8 pixels
+        uint32_t addTexture(
+            const std::string& name, uint32_t width, uint32_t height, std::vector<uint8_t> pixels);
+
+        void setBudget(VkDeviceSize bytes) { budget = bytes; }
+        VkDeviceSize getBudget() const { return budget; }
+        VkDeviceSize getResidentBytes() const;
+
+        // Updates wanted levels from the frame's objects, then evicts and
+        // requests levels. Call before the upload queue is flushed.
+        void update(FrameInfo& frameInfo, VkExtent2D extent);
+
+        std::vector<TextureStats> getStats() const;
+        void printStats(std::ostream& out) const;
+
+    private:
+        struct Entry {
+            std::string name;
+            uint32_t textureId;
+            std::future<void> decoded;
+            bool loaded = false;
+
+            // Written by the decode job, read once decoded is ready. The
+            // levels are either in mips or in the ktx2 file.
+            uint32_t width = 0;
+            uint32_t height = 0;
+            VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+            uint32_t mipLevels = 0;
+            std::vector<std::vector<uint8_t>> mips;
+            std::unique_ptr<LveKtx2File> ktx2;
+            uint32_t tailMip = 0;
+            // Upload only the top level and blit the rest
+            bool gpuMips = false;
+
+            // Top levels of the uploaded image, and of the one being uploaded
+            uint32_t residentMip = 0;
+            uint32_t targetMip = 0;
+            std::unique_ptr<LveTexture> pendingTexture;
+
+            uint32_t wantedMip = 0;
+            float priority = 0.f;
+            float distance = 0.f;
+            uint64_t lastUsedFrame = 0;
+        };
+
+        Entry& addEntry(const std::string& name);
+        static void decode(Entry& entry, std::shared_ptr<const LveIoBuffer> contents);
+        static void generateMips(Entry& entry, std::vector<uint8_t> pixels);
+        static void setLevels(Entry& entry, uint32_t mipLevels);
+        static const uint8_t* levelData(const Entry& entry, uint32_t level);
+        void pollDecoded();
+        void updateWantedMips(FrameInfo& frameInfo, VkExtent2D extent);
+        void requestResidency(Entry& entry, uint32_t topMip);
+        static VkDeviceSize residentSize(const Entry& entry, uint32_t topMip);
+
+        LveDevice& lveDevice;
+        LveMaterialSystem& materialSystem;
+        LveUploadQueue& uploadQueue;
+        LveThreadPool& threadPool;
+        LveAsyncIo& asyncIo;
+        VkDeviceSize budget;
+
+        std::vector<std::unique_ptr<Entry>> entries;
+        std::unordered_map<uint32_t, Entry*> entriesByTexture;
+        std::unordered_map<std::string, uint32_t> texturesByPath;
+        uint64_t frameCounter = 0;
+
+        // Scratch for sorting eviction and request candidates
+        std::vector<Entry*> candidates;
+    };
+}
@@ -0,0 +1,94 @@
+#include "lve_thread_pool.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace lve {
+
+    LveThreadPool::LveThreadPool(uint32_t threadCount) {
+        workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    LveThreadPool::~LveThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    uint32_t LveThreadPool::defaultThreadCount() {
+        // Leave one core for the main thread
+        uint32_t cores = std::thread::hardware_concurrency();
+        return std::max(cores, 2u) - 1;
+    }
+
+    void LveThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock{ mutex };
+                condition.wait(lock, [this]() { return stopping || !frameJobs.empty() || !jobs.empty(); });
+                if (stopping && frameJobs.empty() && jobs.empty()) return;
+                auto& queue = !frameJobs.empty() ? frameJobs : jobs;
+                job = std::move(queue.front());
+                queue.pop();
+            }
+            job();
+        }
+    }
+
+    void LveThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn) {
+        if (count == 0) return;
+
+        // Shared with helper jobs that may only start after this returned;
+        // they find no index left and never touch fn
+        struct State {
+            std::atomic<uint32_t> next{ 0 };
+            std::atomic<uint32_t> finished{ 0 };
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+        auto claim = [state, &fn, count]() {
+            for (uint32_t i = state->next++; i < count; i = state->next++) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{ state->mutex };
+                    if (!state->error) state->error = std::current_exception();
+                }
+                if (++state->finished == count) {
+                    std::lock_guard<std::mutex> lock{ state->mutex };
+                    state->condition.notify_all();
+                }
+            }
+        };
+
+        uint32_t helpers = std::min(count - 1, getThreadCount());
+        for (uint32_t i = 0; i < helpers; i++) {
+            submit(claim, Priority::Frame);
+        }
+        claim();
+
+        std::unique_lock<std::mutex> lock{ state->mutex };
+        state->condition.wait(lock, [&]() { return state->finished == count; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    size_t LveThreadPool::getPendingJobCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return frameJobs.size() + jobs.size();
+    }
+}
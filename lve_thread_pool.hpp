@@ -0,0 +1,63 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+    // Fixed size pool of worker threads that run jobs in submission order.
+    // Frame jobs, which the current frame waits for, run before any queued
+    // background job such as a decode, parse or pipeline build.
+    class LveThreadPool {
+    public:
+        enum class Priority { Background, Frame };
+
+        LveThreadPool(uint32_t threadCount = defaultThreadCount());
+        ~LveThreadPool();
+
+        LveThreadPool(const LveThreadPool&) = delete;
+        LveThreadPool& operator=(const LveThreadPool&) = delete;
+
+        static uint32_t defaultThreadCount();
+
+        template <typename F>
+        auto submit(F&& job, Priority priority = Priority::Background) -> std::future<decltype(job())> {
+            using Result = decltype(job());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+            std::future<Result> future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                (priority == Priority::Frame ? frameJobs : jobs).emplace([task]() { (*task)(); });
+            }
+            condition.notify_one();
+            return future;
+        }
+
+        // Runs fn(0) .. fn(count - 1) across the workers and the calling thread,
+        // and returns once all of them have finished. The calling thread
+        // claims indices too, so when every worker is busy with a long
+        // background job it does the work itself instead of waiting.
+        void parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+        size_t getPendingJobCount();
+
+    private:
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> frameJobs;
+        std::queue<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+    };
+}
@@ -0,0 +1,179 @@
+#include "lve_upload_queue.hpp"
+
+#include "lve_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace lve {
+
+    LveUploadQueue::LveUploadQueue(LveDevice& device, VkDeviceSize bytesPerFlush)
+        : lveDevice{ device }, bytesPerFlush{ bytesPerFlush } {}
+
+    LveUploadQueue::~LveUploadQueue() {
+        // Callbacks are dropped, their owners may already be gone
+        for (auto& batch : batches) {
+            vkWaitForFences(lveDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            destroyBatch(batch);
+        }
+        for (auto& batch : freeBatches) {
+            destroyBatch(batch);
+        }
+    }
+
+    void LveUploadQueue::enqueue(Upload upload) {
+        queued.push_back(std::move(upload));
+        LveProfiler::addCounter("uploads.queued", 1);
+    }
+
+    void LveUploadQueue::flush() {
+        if (queued.empty()) return;
+
+        // Offsets are kept 16 byte aligned, which covers every texel block size
+        const VkDeviceSize alignment = 16;
+        size_t count = 0;
+        VkDeviceSize totalSize = 0;
+        while (count < queued.size()) {
+            VkDeviceSize size = (queued[count].size + alignment - 1) & ~(alignment - 1);
+            if (count > 0 && totalSize + size > bytesPerFlush) break;
+            totalSize += size;
+            count++;
+        }
+
+        Batch batch = acquireBatch(totalSize);
+        auto* mapped = static_cast<uint8_t*>(batch.stagingBuffer->getMappedMemory());
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+        VkDeviceSize offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            Upload& upload = queued.front();
+            upload.write(mapped + offset);
+            upload.record(batch.commandBuffer, batch.stagingBuffer->getBuffer(), offset);
+            if (upload.complete) {
+                batch.callbacks.push_back(std::move(upload.complete));
+            }
+            offset += (upload.size + alignment - 1) & ~(alignment - 1);
+            queued.pop_front();
+        }
+
+        if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.commandBuffer;
+        if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        LveProfiler::addCounter("uploads.bytes", static_cast<int64_t>(totalSize));
+        batches.push_back(std::move(batch));
+    }
+
+    void LveUploadQueue::poll() {
+        // Batches complete in submission order
+        while (!batches.empty() &&
+            vkGetFenceStatus(lveDevice.device(), batches.front().fence) == VK_SUCCESS) {
+            Batch batch = std::move(batches.front());
+            batches.pop_front();
+            std::vector<std::function<void()>> callbacks = std::move(batch.callbacks);
+            batch.callbacks.clear();
+            recycleBatch(batch);
+            for (auto& callback : callbacks) {
+                callback();
+            }
+        }
+    }
+
+    void LveUploadQueue::waitIdle() {
+        while (!queued.empty()) {
+            flush();
+        }
+        for (auto& batch : batches) {
+            vkWaitForFences(lveDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        }
+        poll();
+    }
+
+    LveUploadQueue::Batch LveUploadQueue::acquireBatch(VkDeviceSize stagingSize) {
+        Batch batch{};
+        if (!freeBatches.empty()) {
+            // The smallest staging buffer that fits, else any batch for its
+            // fence and command buffer
+            auto sizeOf = [](const Batch& free) {
+                return free.stagingBuffer != nullptr ? free.stagingBuffer->getBufferSize() : 0;
+            };
+            auto best = freeBatches.begin();
+            for (auto it = freeBatches.begin(); it != freeBatches.end(); ++it) {
+                VkDeviceSize size = sizeOf(*it);
+                VkDeviceSize bestSize = sizeOf(*best);
+                if (size >= stagingSize && (bestSize < stagingSize || size < bestSize)) {
+                    best = it;
+                }
+            }
+            batch = std::move(*best);
+            freeBatches.erase(best);
+            vkResetFences(lveDevice.device(), 1, &batch.fence);
+        } else {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = lveDevice.getCommandPool();
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &batch.commandBuffer) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+                vkFreeCommandBuffers(lveDevice.device(), lveDevice.getCommandPool(), 1, &batch.commandBuffer);
+                throw std::runtime_error("failed to create upload fence!");
+            }
+        }
+
+        if (batch.stagingBuffer == nullptr || batch.stagingBuffer->getBufferSize() < stagingSize) {
+            // Powers of two, so buffers fit later batches of similar sizes
+            VkDeviceSize size = MIN_STAGING_SIZE;
+            while (size < stagingSize) size *= 2;
+            size = std::min(size, std::max(stagingSize, bytesPerFlush));
+            batch.stagingBuffer = nullptr;
+            batch.stagingBuffer = std::make_unique<LveBuffer>(
+                lveDevice,
+                size,
+                1,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            batch.stagingBuffer->map();
+            LveProfiler::addCounter("uploads.stagingAllocated", 1);
+        }
+        return batch;
+    }
+
+    void LveUploadQueue::recycleBatch(Batch& batch) {
+        if (freeBatches.size() >= MAX_FREE_BATCHES) {
+            destroyBatch(batch);
+            return;
+        }
+        // A single upload larger than a flush doesn't keep its memory
+        if (batch.stagingBuffer != nullptr && batch.stagingBuffer->getBufferSize() > bytesPerFlush) {
+            batch.stagingBuffer = nullptr;
+        }
+        freeBatches.push_back(std::move(batch));
+    }
+
+    void LveUploadQueue::destroyBatch(Batch& batch) {
+        vkDestroyFence(lveDevice.device(), batch.fence, nullptr);
+        vkFreeCommandBuffers(lveDevice.device(), lveDevice.getCommandPool(), 1, &batch.commandBuffer);
+        batch.stagingBuffer = nullptr;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+    // Uploads to device local resources without stalling the frame. Queued
+    // uploads are copied into a staging buffer and recorded into one command
+    // buffer per flush, which is submitted with its own fence instead of
+    // waiting for the queue to go idle. poll runs the completion callbacks of
+    // batches the GPU has finished, on the calling thread, and keeps a few of
+    // their staging buffers, fences and command buffers for later flushes.
+    class LveUploadQueue {
+    public:
+        struct Upload {
+            VkDeviceSize size = 0;
+            // Fills the upload's part of the staging buffer
+            std::function<void(void* dst)> write;
+            // Records the copies out of the staging buffer, starting at offset
+            std::function<void(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize offset)> record;
+            // Called from poll once the copies have completed
+            std::function<void()> complete;
+        };
+
+        // bytesPerFlush limits the staging memory submitted at once; a single
+        // larger upload is still submitted, alone
+        LveUploadQueue(LveDevice& device, VkDeviceSize bytesPerFlush = 32 * 1024 * 1024);
+        ~LveUploadQueue();
+
+        LveUploadQueue(const LveUploadQueue&) = delete;
+        LveUploadQueue& operator=(const LveUploadQueue&) = delete;
+
+        void enqueue(Upload upload);
+
+        // Submits queued uploads, oldest first, up to bytesPerFlush
+        void flush();
+        // Runs the callbacks of completed batches and frees their staging memory
+        void poll();
+        // Blocks until everything queued so far has completed, then polls
+        void waitIdle();
+
+        size_t getQueuedCount() const { return queued.size(); }
+        size_t getBatchesInFlight() const { return batches.size(); }
+
+    private:
+        struct Batch {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            std::unique_ptr<LveBuffer> stagingBuffer;
+            std::vector<std::function<void()>> callbacks;
+        };
+
+        // Completed batches kept for reuse, beyond which they are destroyed
+        static constexpr size_t MAX_FREE_BATCHES = 4;
+        static constexpr VkDeviceSize MIN_STAGING_SIZE = 64 * 1024;
+
+        Batch acquireBatch(VkDeviceSize stagingSize);
+        void recycleBatch(Batch& batch);
+        void destroyBatch(Batch& batch);
+
+        LveDevice& lveDevice;
+        VkDeviceSize bytesPerFlush;
+
+        std::deque<Upload> queued;
+        std::deque<Batch> batches;
+        std::vector<Batch> freeBatches;
+    };
+}
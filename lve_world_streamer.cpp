@@ -0,0 +1,315 @@
+#include "lve_world_streamer.hpp"
+
+#include "lve_profiler.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve {
+
+    LveWorldStreamer::LveWorldStreamer(
+        LveDevice& device,
+        LveUploadQueue& uploadQueue,
+        LveThreadPool& threadPool,
+        const std::string& levelFile,
+        const Settings& settings)
+        : lveDevice{ device },
+        uploadQueue{ uploadQueue },
+        threadPool{ threadPool },
+        settings{ settings },
+        scene{ levelFile },
+        maxParsesInFlight{ std::max(1u, std::min(settings.parsesInFlight, threadPool.getThreadCount() - 1)) } {
+        if (!(settings.cellSize > 0.f) || settings.unloadRadius < settings.loadRadius) {
+            throw std::runtime_error("world streaming needs a positive cell size and unloadRadius >= loadRadius");
+        }
+
+        models.resize(scene.getModelCount());
+        const TransformComponent* transforms = scene.transforms();
+        for (uint32_t i = 0; i < scene.getObjectCount(); i++) {
+            int32_t x = static_cast<int32_t>(std::floor(transforms[i].translation.x / settings.cellSize));
+            int32_t z = static_cast<int32_t>(std::floor(transforms[i].translation.z / settings.cellSize));
+            Cell& cell = cells[cellKey(x, z)];
+            cell.x = x;
+            cell.z = z;
+            cell.objects.push_back(i);
+        }
+
+        const uint32_t* modelIndices = scene.modelIndices();
+        for (auto& [key, cell] : cells) {
+            for (uint32_t object : cell.objects) {
+                if (modelIndices[object] != LveSceneFile::NO_MODEL) {
+                    cell.models.push_back(modelIndices[object]);
+                }
+            }
+            std::sort(cell.models.begin(), cell.models.end());
+            cell.models.erase(std::unique(cell.models.begin(), cell.models.end()), cell.models.end());
+        }
+    }
+
+    LveWorldStreamer::~LveWorldStreamer() {
+        // Completion callbacks of queued model uploads refer to this
+        uploadQueue.waitIdle();
+    }
+
+    uint64_t LveWorldStreamer::cellKey(int32_t x, int32_t z) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+
+    float LveWorldStreamer::distanceToCell(const Cell& cell, const glm::vec3& position) const {
+        // To the nearest point of the cell's square on the XZ plane
+        float minX = cell.x * settings.cellSize;
+        float minZ = cell.z * settings.cellSize;
+        float dx = std::max({ minX - position.x, 0.f, position.x - (minX + settings.cellSize) });
+        float dz = std::max({ minZ - position.z, 0.f, position.z - (minZ + settings.cellSize) });
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    void LveWorldStreamer::update(const glm::vec3& viewerPosition, LveGameObject::Map& gameObjects) {
+        LveProfiler::ScopedTimer timer{ "world.update" };
+        frameCounter++;
+
+        retiredModels.erase(
+            std::remove_if(retiredModels.begin(), retiredModels.end(), [&](const RetiredModel& retired) {
+                return frameCounter - retired.frame > static_cast<uint64_t>(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+            }),
+            retiredModels.end());
+
+        activeCells.erase(
+            std::remove_if(activeCells.begin(), activeCells.end(), [&](Cell* cell) {
+                if (distanceToCell(*cell, viewerPosition) <= settings.unloadRadius) return false;
+                unloadCell(*cell, gameObjects);
+                return true;
+            }),
+            activeCells.end());
+
+        int32_t minX = static_cast<int32_t>(std::floor((viewerPosition.x - settings.loadRadius) / settings.cellSize));
+        int32_t maxX = static_cast<int32_t>(std::floor((viewerPosition.x + settings.loadRadius) / settings.cellSize));
+        int32_t minZ = static_cast<int32_t>(std::floor((viewerPosition.z - settings.loadRadius) / settings.cellSize));
+        int32_t maxZ = static_cast<int32_t>(std::floor((viewerPosition.z + settings.loadRadius) / settings.cellSize));
+        for (int32_t z = minZ; z <= maxZ; z++) {
+            for (int32_t x = minX; x <= maxX; x++) {
+                auto it = cells.find(cellKey(x, z));
+                if (it == cells.end() || it->second.state != CellState::Unloaded ||
+                    distanceToCell(it->second, viewerPosition) > settings.loadRadius) {
+                    continue;
+                }
+                loadCell(it->second);
+                activeCells.push_back(&it->second);
+            }
+        }
+
+        // Nearest first for uploads and object budgets
+        std::sort(activeCells.begin(), activeCells.end(), [&](const Cell* a, const Cell* b) {
+            return distanceToCell(*a, viewerPosition) < distanceToCell(*b, viewerPosition);
+        });
+        updateModels();
+
+        uint32_t objectBudget = settings.objectsPerFrame;
+        for (Cell* cell : activeCells) {
+            if (cell->state != CellState::Loading || objectBudget == 0) continue;
+            bool modelsReady = std::all_of(cell->models.begin(), cell->models.end(), [&](uint32_t model) {
+                return models[model].state == ModelState::Resident || models[model].state == ModelState::Failed;
+            });
+            if (!modelsReady) continue;
+
+            objectBudget -= addObjects(*cell, gameObjects, objectBudget);
+            if (cell->gameObjectIds.size() == cell->objects.size()) {
+                cell->state = CellState::Resident;
+            }
+        }
+
+        Stats stats = getStats();
+        LveProfiler::setGauge("world.residentCells", stats.residentCells);
+        LveProfiler::setGauge("world.pendingCells", stats.pendingCells);
+        LveProfiler::setGauge("world.pendingModels", stats.pendingModels);
+        LveProfiler::setGauge("world.residentObjects", static_cast<int64_t>(stats.residentObjects));
+    }
+
+    void LveWorldStreamer::loadCell(Cell& cell) {
+        // Parses are started by updateModels, nearest cells first
+        cell.state = CellState::Loading;
+        for (uint32_t index : cell.models) {
+            models[index].users++;
+        }
+    }
+
+    void LveWorldStreamer::startParses() {
+        for (Cell* cell : activeCells) {
+            for (uint32_t index : cell->models) {
+                if (parsesInFlight >= maxParsesInFlight) return;
+                Model& model = models[index];
+                if (model.state != ModelState::Unloaded || model.users == 0) continue;
+
+                // Parsed on a worker, along with the model's bounds and
+                // triangle BVH. The upload is started from updateModels.
+                std::string name = scene.getModelName(index);
+                model.parsed = threadPool.submit([name]() {
+                    auto builder = std::make_shared<LveModel::Builder>();
+                    builder->loadModel(name);
+                    return std::shared_ptr<const LveModel::Builder>{ std::move(builder) };
+                });
+                model.state = ModelState::Parsing;
+                parsesInFlight++;
+            }
+        }
+    }
+
+    void LveWorldStreamer::unloadCell(Cell& cell, LveGameObject::Map& gameObjects) {
+        for (LveGameObject::id_t id : cell.gameObjectIds) {
+            gameObjects.erase(id);
+            if (spatialIndex != nullptr) {
+                spatialIndex->remove(id);
+            }
+        }
+        residentObjects -= cell.gameObjectIds.size();
+        cell.gameObjectIds.clear();
+        cell.state = CellState::Unloaded;
+
+        for (uint32_t index : cell.models) {
+            if (--models[index].users == 0) {
+                releaseModel(index);
+            }
+        }
+    }
+
+    void LveWorldStreamer::releaseModel(uint32_t index) {
+        Model& model = models[index];
+        switch (model.state) {
+        case ModelState::Parsing:
+            // Can't be cancelled, updateModels drops the result
+            return;
+        case ModelState::Resident:
+            if (model.model != nullptr) {
+                retiredModels.push_back({ std::move(model.model), frameCounter });
+            }
+            break;
+        default:
+            // An upload in flight keeps its model alive until it completes,
+            // and the completion sees that the model was released
+            break;
+        }
+        model.model.reset();
+        model.builder.reset();
+        model.state = ModelState::Unloaded;
+        model.generation++;
+    }
+
+    void LveWorldStreamer::updateModels() {
+        for (uint32_t i = 0; i < models.size(); i++) {
+            Model& model = models[i];
+            if (model.state != ModelState::Parsing ||
+                model.parsed.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+            parsesInFlight--;
+            try {
+                model.builder = model.parsed.get();
+                if (model.builder->vertices.size() < 3) {
+                    throw std::runtime_error("model has no triangles");
+                }
+                model.state = ModelState::Parsed;
+            } catch (const std::exception& e) {
+                // The cell's objects are added without the model
+                std::cerr << "World streaming failed to load " << scene.getModelName(i) << ": " << e.what()
+                    << std::endl;
+                model.builder.reset();
+                model.state = ModelState::Failed;
+            }
+            if (model.users == 0) {
+                model.builder.reset();
+                model.state = ModelState::Unloaded;
+            }
+        }
+        startParses();
+
+        // Cell order gives the nearest cells' models the budget first
+        uint64_t bytesThisFrame = 0;
+        for (Cell* cell : activeCells) {
+            for (uint32_t index : cell->models) {
+                Model& model = models[index];
+                if (model.state != ModelState::Parsed) continue;
+
+                uint64_t size = model.builder->vertices.size() * sizeof(LveModel::Vertex) +
+                    model.builder->indices.size() * sizeof(uint32_t);
+                if (bytesThisFrame > 0 && bytesThisFrame + size > settings.uploadBytesPerFrame) {
+                    LveProfiler::addCounter("world.bytesStreamed", static_cast<int64_t>(bytesThisFrame));
+                    return;
+                }
+                bytesThisFrame += size;
+                bytesStreamed += size;
+
+                uint32_t generation = model.generation;
+                model.model = LveModel::createWithUploadQueue(
+                    lveDevice, uploadQueue, std::move(model.builder), [this, index, generation]() {
+                        // A model released while uploading may be loading again by now
+                        Model& uploaded = models[index];
+                        if (uploaded.generation == generation && uploaded.state == ModelState::Uploading) {
+                            uploaded.state = ModelState::Resident;
+                        }
+                    });
+                model.state = ModelState::Uploading;
+            }
+        }
+        LveProfiler::addCounter("world.bytesStreamed", static_cast<int64_t>(bytesThisFrame));
+    }
+
+    uint32_t LveWorldStreamer::addObjects(Cell& cell, LveGameObject::Map& gameObjects, uint32_t maxObjects) {
+        const uint32_t* modelIndices = scene.modelIndices();
+        uint32_t added = 0;
+        while (added < maxObjects && cell.gameObjectIds.size() < cell.objects.size()) {
+            uint32_t object = cell.objects[cell.gameObjectIds.size()];
+            uint32_t model = modelIndices[object];
+            auto gameObject = scene.createGameObject(
+                object, model != LveSceneFile::NO_MODEL ? models[model].model : nullptr);
+            cell.gameObjectIds.push_back(gameObject.getId());
+            if (spatialIndex != nullptr) {
+                spatialIndex->insert(gameObject);
+            }
+            gameObjects.emplace(gameObject.getId(), std::move(gameObject));
+            added++;
+        }
+        residentObjects += added;
+        return added;
+    }
+
+    void LveWorldStreamer::unloadAll(LveGameObject::Map& gameObjects) {
+        for (Cell* cell : activeCells) {
+            unloadCell(*cell, gameObjects);
+        }
+        activeCells.clear();
+    }
+
+    LveWorldStreamer::Stats LveWorldStreamer::getStats() const {
+        Stats stats{};
+        stats.cells = static_cast<uint32_t>(cells.size());
+        for (const Cell* cell : activeCells) {
+            (cell->state == CellState::Resident ? stats.residentCells : stats.pendingCells)++;
+        }
+        for (const Model& model : models) {
+            if (model.state == ModelState::Resident) {
+                stats.residentModels++;
+            } else if (model.state == ModelState::Failed) {
+                stats.failedModels++;
+            } else if (model.state != ModelState::Unloaded) {
+                stats.pendingModels++;
+            }
+        }
+        stats.residentObjects = residentObjects;
+        stats.bytesStreamed = bytesStreamed;
+        return stats;
+    }
+
+    void LveWorldStreamer::printStats(std::ostream& out) const {
+        Stats stats = getStats();
+        out << "World streaming: " << stats.residentCells << " of " << stats.cells << " cells resident, "
+            << stats.pendingCells << " loading, " << stats.residentModels << " models resident, "
+            << stats.pendingModels << " loading, " << stats.failedModels << " failed, "
+            << stats.residentObjects << " objects, "
+            << (stats.bytesStreamed >> 20) << " MB streamed" << std::endl;
+    }
+}
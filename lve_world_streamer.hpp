@@ -0,0 +1,143 @@
+#pragma once
+
+#include "lve_bvh.hpp"
+#include "lve_device.hpp"
+#include "lve_game_object.hpp"
+#include "lve_scene_file.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_queue.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+    // Streams a level file in square cells on the XZ plane around the viewer.
+    // Objects are binned into cells by their translation once, up front.
+    // Cells closer than loadRadius are loaded: their models are parsed on the
+    // thread pool, uploaded through the upload queue, and then their objects
+    // are added to the game object map. Only a few parses run at once, so
+    // workers stay free for the frame's own jobs. Cells further than
+    // unloadRadius have their objects removed again; the gap between the radii
+    // keeps a viewer at the edge from loading and unloading the same cell
+    // every frame.
+    //
+    // Models are shared between cells and released when no loaded cell uses
+    // them. Released models are kept for MAX_FRAMES_IN_FLIGHT frames, since
+    // frames in flight may still draw them. Each frame starts uploads only
+    // up to uploadBytesPerFrame and adds at most objectsPerFrame objects, so
+    // streaming work is spread over frames.
+    class LveWorldStreamer {
+    public:
+        struct Settings {
+            float cellSize = 64.f;
+            float loadRadius = 192.f;
+            float unloadRadius = 256.f;
+            // A single larger model still starts, alone
+            uint64_t uploadBytesPerFrame = 8 * 1024 * 1024;
+            uint32_t objectsPerFrame = 2048;
+            // Capped one below the pool's thread count
+            uint32_t parsesInFlight = 2;
+        };
+
+        struct Stats {
+            uint32_t cells;
+            uint32_t residentCells;
+            uint32_t pendingCells;
+            uint32_t pendingModels;
+            uint32_t residentModels;
+            uint32_t failedModels;
+            uint64_t residentObjects;
+            uint64_t bytesStreamed;
+        };
+
+        LveWorldStreamer(
+            LveDevice& device,
+            LveUploadQueue& uploadQueue,
+            LveThreadPool& threadPool,
+            const std::string& levelFile,
+            const Settings& settings);
+        ~LveWorldStreamer();
+
+        LveWorldStreamer(const LveWorldStreamer&) = delete;
+        LveWorldStreamer& operator=(const LveWorldStreamer&) = delete;
+
+        // Call once per frame before the upload queue is flushed. Adds and
+        // removes objects of gameObjects, which must be the same map every
+        // frame.
+        void update(const glm::vec3& viewerPosition, LveGameObject::Map& gameObjects);
+        // Removes every streamed object, e.g. before the map is cleared
+        void unloadAll(LveGameObject::Map& gameObjects);
+        // Streamed objects are inserted into and removed from index as well
+        void setSpatialIndex(LveBvh* index) { spatialIndex = index; }
+
+        Stats getStats() const;
+        void printStats(std::ostream& out) const;
+
+    private:
+        enum class CellState { Unloaded, Loading, Resident };
+        // Failed models are never uploaded, their objects are added without one
+        enum class ModelState { Unloaded, Parsing, Parsed, Uploading, Resident, Failed };
+
+        struct Cell {
+            int32_t x;
+            int32_t z;
+            std::vector<uint32_t> objects;
+            // Distinct scene model indices of the objects
+            std::vector<uint32_t> models;
+            CellState state = CellState::Unloaded;
+            // Added to the map so far, objects are added over several frames
+            std::vector<LveGameObject::id_t> gameObjectIds;
+        };
+
+        struct Model {
+            ModelState state = ModelState::Unloaded;
+            // Loaded cells using the model
+            uint32_t users = 0;
+            std::future<std::shared_ptr<const LveModel::Builder>> parsed;
+            std::shared_ptr<const LveModel::Builder> builder;
+            std::shared_ptr<LveModel> model;
+            // Bumped on release so a stale upload completion is ignored
+            uint32_t generation = 0;
+        };
+
+        struct RetiredModel {
+            std::shared_ptr<LveModel> model;
+            uint64_t frame;
+        };
+
+        static uint64_t cellKey(int32_t x, int32_t z);
+        float distanceToCell(const Cell& cell, const glm::vec3& position) const;
+        void loadCell(Cell& cell);
+        void unloadCell(Cell& cell, LveGameObject::Map& gameObjects);
+        void releaseModel(uint32_t index);
+        void updateModels();
+        void startParses();
+        uint32_t addObjects(Cell& cell, LveGameObject::Map& gameObjects, uint32_t maxObjects);
+
+        LveDevice& lveDevice;
+        LveUploadQueue& uploadQueue;
+        LveThreadPool& threadPool;
+        Settings settings;
+        LveSceneFile scene;
+        LveBvh* spatialIndex = nullptr;
+
+        std::unordered_map<uint64_t, Cell> cells;
+        // Cells that aren't Unloaded, nearest to the viewer first
+        std::vector<Cell*> activeCells;
+        std::vector<Model> models;
+        std::vector<RetiredModel> retiredModels;
+
+        uint32_t maxParsesInFlight;
+        uint32_t parsesInFlight = 0;
+        uint64_t frameCounter = 0;
+        uint64_t bytesStreamed = 0;
+        uint64_t residentObjects = 0;
+    };
+}
@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+# Builds tools/lve_pack and packs the models and compiled shaders into
+# assets.lvepak, which FirstApp mounts at startup when it exists. Run
+# compile_shaders.sh first. The compiler is taken from $CXX, then c++.
+set -euo pipefail
+
+cd "$(dirname "$0")"
+
+CXX="${CXX:-c++}"
+TOOL=tools/lve_pack
+
+"$CXX" -std=c++17 -O2 -o "$TOOL" \
+    tools/lve_pack.cpp lve_archive.cpp lve_lz4.cpp lve_mapped_file.cpp lve_profiler.cpp
+
+ASSETS=()
+for asset in koenig.obj quad.obj scene.glb level.lvescene *.spv; do
+    if [ -f "$asset" ]; then
+        ASSETS+=("$asset")
+    else
+        echo "Skipping missing $asset" >&2
+    fi
+done
+
+"$TOOL" assets.lvepak "${ASSETS[@]}"
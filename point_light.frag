@@ -7,12 +7,18 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor;
+  uvec4 clusterGrid; // xyz cluster counts, w light count
+  vec4 clusterParams; // xy tile size in pixels, z slice scale, w slice bias
 } ubo;
 
+layout(push_constant) uniform Push {
+  vec4 position;
+  vec4 color;
+  float radius;
+} push;
+
 void main() {
 	float dis = sqrt(dot(fragOffset, fragOffset));
 	if(dis>= 1.0) { discard; }
-	outColor = vec4(ubo.lightColor.xyz, 1.0);
-}
\ No newline at end of file
+	outColor = vec4(push.color.xyz, 1.0);
+}
@@ -16,21 +16,25 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor;
+  uvec4 clusterGrid; // xyz cluster counts, w light count
+  vec4 clusterParams; // xy tile size in pixels, z slice scale, w slice bias
 } ubo;
 
-const float LIGHT_RADIUS = 0.1;
+layout(push_constant) uniform Push {
+  vec4 position;
+  vec4 color;
+  float radius;
+} push;
 
 void main(){
 	fragOffset = OFFSETS[gl_VertexIndex];
 	vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-	vec3 positionWorld = ubo.lightPosition.xyz
-	+	LIGHT_RADIUS * fragOffset.x * cameraRightWorld
-	+	LIGHT_RADIUS * fragOffset.y * cameraUpWorld;
+	vec3 positionWorld = push.position.xyz
+	+	push.radius * fragOffset.x * cameraRightWorld
+	+	push.radius * fragOffset.y * cameraUpWorld;
 
 	gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 
-}
\ No newline at end of file
+}
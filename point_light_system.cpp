@@ -1,5 +1,8 @@
 #include "point_light_system.hpp"
 
+#include "lve_layout_cache.hpp"
+#include "lve_shader_module_cache.hpp"
+
 //libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,42 +15,36 @@
 
 namespace lve {
 
+    struct PointLightPushConstants {
+        glm::vec4 position{};
+        glm::vec4 color{};
+        float radius;
+    };
+
     PointLightSystem::PointLightSystem(
-        LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : lveDevice{ device } {
+        LveDevice& device,
+        LvePipelineManager& pipelineManager,
+        const RenderTargetInfo& renderTarget,
+        VkDescriptorSetLayout globalSetLayout) : lveDevice{ device } {
 
         createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        createPipeline(pipelineManager, renderTarget);
     }
 
-    PointLightSystem::~PointLightSystem() {
-        vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
-    }
+    PointLightSystem::~PointLightSystem() {}
 
     void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-     //    VkPushConstantRange pushConstantRange{};
-     //   pushConstantRange.stageFlags =
-     //       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-     //   pushConstantRange.offset = 0;
-     //   pushConstantRange.size = sizeof(SimplePushConstantData);
-
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
-
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType =
-            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
-        if (vkCreatePipelineLayout(
-            lveDevice.device(), &pipelineLayoutInfo,
-            nullptr, &pipelineLayout) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline layout!");
-        }
+        // Bindings and push constants come from the shaders, set 0 is the shared global set
+        auto& shaderModules = lveDevice.shaderModuleCache();
+        auto vertShader = shaderModules.load("point_light.vert.spv");
+        auto fragShader = shaderModules.load("point_light.frag.spv");
+        pipelineLayout = lveDevice.layoutCache().getPipelineLayout(
+            { &vertShader->getReflection(), &fragShader->getReflection() },
+            { globalSetLayout });
     }
 
-    void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+    void PointLightSystem::createPipeline(
+        LvePipelineManager& pipelineManager, const RenderTargetInfo& renderTarget) {
         assert(pipelineLayout != nullptr &&
             "Cannot create pipeline before pipeline layout");
 
@@ -55,11 +52,10 @@ namespace lve {
         LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
         pipelineConfig.attributeDescriptions.clear();
         pipelineConfig.bindingDescriptions.clear();
-        pipelineConfig.renderPass = renderPass;
+        LvePipeline::setRenderTarget(pipelineConfig, renderTarget);
         pipelineConfig.pipelineLayout = pipelineLayout;
 
-        lvePipeline = std::make_unique<LvePipeline>(
-            lveDevice,
+        lvePipeline = pipelineManager.request(
             "point_light.vert.spv",
             "point_light.frag.spv",
             pipelineConfig);
@@ -67,19 +63,26 @@ namespace lve {
 
     void PointLightSystem::render(FrameInfo& frameInfo) {
 
-        lvePipeline->bind(frameInfo.commandBuffer);
-
-        vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipelineLayout,
-            0,
-            1,
-            &frameInfo.globalDescriptionSet,
-            0,
-            nullptr
-        );
-
-        vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+        // The global set is already bound, this layout is compatible for set 0
+        lvePipeline.bind(frameInfo.commandBuffer);
+
+        for (auto& kv : frameInfo.gameObjects) {
+            auto& obj = kv.second;
+            if (obj.pointLight == nullptr) continue;
+
+            PointLightPushConstants push{};
+            push.position = glm::vec4(obj.transform.translation, 1.f);
+            push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+            push.radius = obj.transform.scale.x;
+
+            vkCmdPushConstants(
+                frameInfo.commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                0,
+                sizeof(PointLightPushConstants),
+                &push);
+            vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+        }
     }
 }
\ No newline at end of file
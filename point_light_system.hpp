@@ -3,6 +3,7 @@
 #include "lve_camera.hpp"
 #include "lve_device.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_manager.hpp"
 #include "lve_game_object.hpp"
 #include "lve_frame_info.hpp"
 
@@ -14,7 +15,11 @@
 namespace lve {
 	class PointLightSystem {
 	public:
-		PointLightSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		PointLightSystem(
+			LveDevice& device,
+			LvePipelineManager& pipelineManager,
+			const RenderTargetInfo& renderTarget,
+			VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
 		PointLightSystem(const PointLightSystem&) = delete;
@@ -24,11 +29,11 @@ namespace lve {
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(LvePipelineManager& pipelineManager, const RenderTargetInfo& renderTarget);
 
 		LveDevice& lveDevice;
 
-		std::unique_ptr<LvePipeline> lvePipeline;
+		LvePipelineManager::Handle lvePipeline;
 		VkPipelineLayout pipelineLayout;
 	};
 }
\ No newline at end of file
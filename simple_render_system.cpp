@@ -1,5 +1,8 @@
 #include "simple_render_system.hpp"
 
+#include "lve_layout_cache.hpp"
+#include "lve_shader_module_cache.hpp"
+
 //libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,94 +15,128 @@
 
 namespace lve {
 
+    // normalMatrix only uses its upper 3x3, the x of its last column carries
+    // the material index. This keeps the block at the 128 bytes every layout
+    // shares, growing it would make the layouts incompatible.
     struct SimplePushConstantData {
         glm::mat4 modelMatrix{ 1.f };
         glm::mat4 normalMatrix{ 1.f };
     };
 
     SimpleRenderSystem::SimpleRenderSystem(
-        LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : lveDevice{ device } {
-
-        createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        LveDevice& device,
+        LvePipelineManager& pipelineManager,
+        const RenderTargetInfo& renderTarget,
+        VkDescriptorSetLayout globalSetLayout,
+        VkDescriptorSetLayout materialSetLayout) : lveDevice{ device } {
+
+        createPipelineLayout(globalSetLayout, materialSetLayout);
+        createPipeline(pipelineManager, renderTarget);
     }
 
-    SimpleRenderSystem::~SimpleRenderSystem() {
-        vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+    SimpleRenderSystem::~SimpleRenderSystem() {}
+
+    void SimpleRenderSystem::createPipelineLayout(
+        VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout materialSetLayout) {
+        // Bindings and push constants come from the shaders, set 0 is the shared
+        // global set and set 1 the bindless material set
+        auto& shaderModules = lveDevice.shaderModuleCache();
+        auto vertShader = shaderModules.load("simple_shader.vert.spv");
+        auto fragShader = shaderModules.load("simple_shader.frag.spv");
+        pipelineLayout = lveDevice.layoutCache().getPipelineLayout(
+            { &vertShader->getReflection(), &fragShader->getReflection() },
+            { globalSetLayout, materialSetLayout });
     }
 
-    void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags =
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(SimplePushConstantData);
-
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
-
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType =
-            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-        if (vkCreatePipelineLayout(
-            lveDevice.device(), &pipelineLayoutInfo,
-            nullptr, &pipelineLayout) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline layout!");
-        }
-    }
-
-    void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+    void SimpleRenderSystem::createPipeline(
+        LvePipelineManager& pipelineManager, const RenderTargetInfo& renderTarget) {
         assert(pipelineLayout != nullptr &&
             "Cannot create pipeline before pipeline layout");
 
         PipelineConfigInfo pipelineConfig{};
         LvePipeline::defaultPipelineConfigInfo(pipelineConfig),
-        pipelineConfig.renderPass = renderPass;
+        LvePipeline::setRenderTarget(pipelineConfig, renderTarget);
         pipelineConfig.pipelineLayout = pipelineLayout;
-        lvePipeline = std::make_unique<LvePipeline>(
-            lveDevice,
+        // Built on worker threads, ready once the manager is waited on
+        LvePipeline::setSpecializationConstant(pipelineConfig, 0, MAX_CLUSTER_LIGHTS);
+        LvePipeline::setSpecializationConstant(pipelineConfig, 1, FEATURE_POINT_LIGHTS);
+        lvePipelines[VARIANT_LIT] = pipelineManager.request(
             "simple_shader.vert.spv",
             "simple_shader.frag.spv",
             pipelineConfig);
+
+        LvePipeline::setSpecializationConstant(pipelineConfig, 1, 0u);
+        lvePipelines[VARIANT_AMBIENT_ONLY] = pipelineManager.request(
+            "simple_shader.vert.spv",
+            "simple_shader.frag.spv",
+            pipelineConfig,
+            lvePipelines[VARIANT_LIT]);
+    }
+
+    SimpleRenderSystem::Variant SimpleRenderSystem::selectVariant(LveGameObject& obj) {
+        // Only the lights whose boxes overlap the object's get the exact test
+        LveBvh::BoundingBox worldBounds = LveBvh::computeWorldBounds(obj);
+        nearbyLights.clear();
+        lightBvh.queryOverlap(worldBounds, nearbyLights);
+        for (LveBvh::id_t light : nearbyLights) {
+            const glm::vec4& sphere = lightSpheres[light];
+            glm::vec3 closest = glm::clamp(glm::vec3(sphere), worldBounds.min, worldBounds.max);
+            glm::vec3 offset = closest - glm::vec3(sphere);
+            if (glm::dot(offset, offset) <= sphere.w * sphere.w) {
+                return VARIANT_LIT;
+            }
+        }
+        return VARIANT_AMBIENT_ONLY;
     }
 
     void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo){
-        
-        lvePipeline->bind(frameInfo.commandBuffer);
-
-        vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipelineLayout,
-            0,
-            1,
-            &frameInfo.globalDescriptionSet,
-            0,
-            nullptr
-        );
 
+        lightSpheres.clear();
+        lightBvh.clear();
         for (auto& keyValue : frameInfo.gameObjects) {
             auto& obj = keyValue.second;
+            if (obj.pointLight == nullptr) continue;
+            glm::vec3 center = obj.transform.translation;
+            float range = obj.pointLight->range;
+            lightBvh.insert(static_cast<LveBvh::id_t>(lightSpheres.size()), { center - range, center + range });
+            lightSpheres.emplace_back(center, range);
+        }
+        lightBvh.rebuild();
 
-            if (obj.model == nullptr) continue;
-
-            SimplePushConstantData push{};
-            push.modelMatrix = obj.transform.mat4();
-            push.normalMatrix = obj.transform.normalMatrix();
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push);
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
+        for (auto& objects : variantObjects) {
+            objects.clear();
+        }
+        frameInfo.forEachVisibleObject([&](LveGameObject::id_t id, LveGameObject& obj) {
+            if (obj.model == nullptr) return;
+            if (frameInfo.occludedObjects != nullptr &&
+                frameInfo.occludedObjects->count(id) > 0) return;
+
+            variantObjects[selectVariant(obj)].push_back(&obj);
+        });
+
+        // Grouped so each variant's pipeline is bound once. The global and
+        // material sets are already bound, every variant's layout is compatible
+        // for sets 0 and 1.
+        for (uint32_t variant = 0; variant < VARIANT_COUNT; variant++) {
+            if (variantObjects[variant].empty()) continue;
+            lvePipelines[variant].bind(frameInfo.commandBuffer);
+
+            for (LveGameObject* obj : variantObjects[variant]) {
+                SimplePushConstantData push{};
+                push.modelMatrix = obj->transform.mat4();
+                push.normalMatrix = obj->transform.normalMatrix();
+                push.normalMatrix[3][0] = glm::uintBitsToFloat(obj->materialIndex);
+
+                vkCmdPushConstants(
+                    frameInfo.commandBuffer,
+                    pipelineLayout,
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                    0,
+                    sizeof(SimplePushConstantData),
+                    &push);
+                obj->model->bind(frameInfo.commandBuffer);
+                obj->model->draw(frameInfo.commandBuffer);
+            }
         }
     }
 }
\ No newline at end of file
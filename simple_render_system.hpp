@@ -1,20 +1,40 @@
 #pragma once
 
+#include "lve_bvh.hpp"
 #include "lve_camera.hpp"
 #include "lve_device.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_manager.hpp"
 #include "lve_game_object.hpp"
 #include "lve_frame_info.hpp"
 
 
 // std
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace lve {
 	class SimpleRenderSystem {
 	public:
-		SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// Pipeline variants, from most to least expensive. Each object is drawn
+		// with the cheapest one that still shades it correctly.
+		enum Variant : uint32_t {
+			VARIANT_LIT,
+			VARIANT_AMBIENT_ONLY,
+			VARIANT_COUNT
+		};
+
+		// Specialization constants of simple_shader.frag
+		static constexpr uint32_t MAX_CLUSTER_LIGHTS = 64;
+		static constexpr uint32_t FEATURE_POINT_LIGHTS = 1;
+
+		SimpleRenderSystem(
+			LveDevice& device,
+			LvePipelineManager& pipelineManager,
+			const RenderTargetInfo& renderTarget,
+			VkDescriptorSetLayout globalSetLayout,
+			VkDescriptorSetLayout materialSetLayout);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
@@ -23,12 +43,21 @@ namespace lve {
 		void renderGameObjects(FrameInfo& frameInfo);
 
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
-		
+		void createPipelineLayout(
+			VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout materialSetLayout);
+		void createPipeline(LvePipelineManager& pipelineManager, const RenderTargetInfo& renderTarget);
+		Variant selectVariant(LveGameObject& obj);
+
 		LveDevice& lveDevice;
 
-		std::unique_ptr<LvePipeline> lvePipeline;
+		std::array<LvePipelineManager::Handle, VARIANT_COUNT> lvePipelines;
 		VkPipelineLayout pipelineLayout;
+
+		// Scratch for grouping draws by variant and the frame's light spheres,
+		// indexed by their id in lightBvh
+		std::array<std::vector<LveGameObject*>, VARIANT_COUNT> variantObjects;
+		std::vector<glm::vec4> lightSpheres;
+		LveBvh lightBvh;
+		std::vector<LveBvh::id_t> nearbyLights;
 	};
 }
\ No newline at end of file
@@ -1,30 +1,105 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
 layout (location = 2) in vec3 fragNormalWorld;
+layout (location = 3) in vec2 fragUv;
 
 layout (location = 0) out vec4 outColor;
 
+struct PointLight {
+  vec4 position; // w is range
+  vec4 color; // w is intensity
+};
+
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor;
+  uvec4 clusterGrid; // xyz cluster counts, w light count
+  vec4 clusterParams; // xy tile size in pixels, z slice scale, w slice bias
 } ubo;
 
+layout(set = 0, binding = 1) readonly buffer LightBuffer {
+  PointLight lights[];
+} lightBuffer;
+
+layout(set = 0, binding = 2) readonly buffer ClusterBuffer {
+  uvec2 ranges[]; // x offset into light indices, y count
+} clusterBuffer;
+
+layout(set = 0, binding = 3) readonly buffer LightIndexBuffer {
+  uint indices[];
+} lightIndexBuffer;
+
+struct Material {
+  vec4 baseColorFactor;
+  vec2 uvScale;
+  uint baseColorTexture;
+  uint padding;
+};
+
+// Bindless: every texture and material, indexed per draw
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(set = 1, binding = 1) readonly buffer MaterialBuffer {
+  Material materials[];
+} materialBuffer;
+
+// Maps texture ids to slots of the textures array, per frame
+layout(set = 1, binding = 2) readonly buffer TextureTable {
+  uint slots[];
+} textureTable;
+
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
-  mat4 normalMatrix;
+  mat4 normalMatrix; // upper 3x3, x of the last column is the material index
 } push;
 
+// Set per pipeline variant, so disabled features are compiled out
+layout(constant_id = 0) const uint MAX_CLUSTER_LIGHTS = 64;
+layout(constant_id = 1) const uint FEATURE_BITS = 1;
+
+const uint FEATURE_POINT_LIGHTS = 1;
+
+uint clusterIndex() {
+  float viewZ = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+  uint slice = uint(max(log(viewZ) * ubo.clusterParams.z + ubo.clusterParams.w, 0.0));
+  uvec2 tile = uvec2(gl_FragCoord.xy / ubo.clusterParams.xy);
+
+  tile = min(tile, ubo.clusterGrid.xy - 1);
+  slice = min(slice, ubo.clusterGrid.z - 1);
+  return tile.x + ubo.clusterGrid.x * (tile.y + ubo.clusterGrid.y * slice);
+}
+
 void main() {
-  vec3 directionToLight = ubo.lightPosition - fragPosWorld;
-  float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
-
-  vec3 lightColor = ubo.lightColor.xyz * ubo.lightColor.w * attenuation;
-  vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-  vec3 diffuseLight = lightColor * max(dot(normalize(fragNormalWorld), normalize(directionToLight)), 0);
-  outColor = vec4((diffuseLight + ambientLight) * fragColor, 1.0);
-}
\ No newline at end of file
+  vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+  vec3 surfaceNormal = normalize(fragNormalWorld);
+
+  if ((FEATURE_BITS & FEATURE_POINT_LIGHTS) != 0) {
+    uvec2 range = clusterBuffer.ranges[clusterIndex()];
+    uint lightCount = min(range.y, MAX_CLUSTER_LIGHTS);
+    for (uint i = 0; i < lightCount; i++) {
+      PointLight light = lightBuffer.lights[lightIndexBuffer.indices[range.x + i]];
+      vec3 directionToLight = light.position.xyz - fragPosWorld;
+      float distanceSquared = dot(directionToLight, directionToLight);
+
+      // inverse square falloff, windowed to reach zero at the light's range
+      float falloff = distanceSquared / (light.position.w * light.position.w);
+      float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+      float attenuation = window * window / max(distanceSquared, 0.0001);
+
+      float cosAngIncidence = max(dot(surfaceNormal, normalize(directionToLight)), 0);
+      diffuseLight += light.color.xyz * light.color.w * attenuation * cosAngIncidence;
+    }
+  }
+
+  // The index comes from a push constant, so it is uniform across the draw
+  Material material = materialBuffer.materials[floatBitsToUint(push.normalMatrix[3].x)];
+  uint textureSlot = textureTable.slots[material.baseColorTexture];
+  vec4 baseColor = texture(textures[textureSlot], fragUv * material.uvScale) *
+    material.baseColorFactor;
+
+  outColor = vec4(diffuseLight * fragColor * baseColor.rgb, 1.0);
+}
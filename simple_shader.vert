@@ -8,18 +8,19 @@ layout(location = 3) in vec2 uv;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor;
+  uvec4 clusterGrid; // xyz cluster counts, w light count
+  vec4 clusterParams; // xy tile size in pixels, z slice scale, w slice bias
 } ubo;
 
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
-  mat4 normalMatrix;
+  mat4 normalMatrix; // upper 3x3, x of the last column is the material index
 } push;
 
 void main() {
@@ -28,4 +29,5 @@ void main() {
   fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
   fragPosWorld = positionWorld.xyz;
   fragColor = color;
+  fragUv = uv;
 }
\ No newline at end of file
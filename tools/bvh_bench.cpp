@@ -0,0 +1,206 @@
+// Times LveBvh queries against brute force over the same boxes, checking
+// that both find the same objects. Build from the repository root with
+//   c++ -std=c++17 -O2 -I. -o tools/bvh_bench tools/bvh_bench.cpp lve_bvh.cpp lve_camera.cpp
+//       lve_game_object.cpp lve_profiler.cpp
+// on one line, plus the include paths for Vulkan, GLFW and GLM that
+// lve_game_object.hpp needs.
+//
+//   bvh_bench [objects...]    defaults to 10000 100000 1000000
+
+#include "../lve_bvh.hpp"
+#include "../lve_camera.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using BoundingBox = lve::LveBvh::BoundingBox;
+    using id_t = lve::LveBvh::id_t;
+
+    constexpr int QUERIES = 200;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // What iterating the game object map amounts to, minus the hashing
+    struct BruteForce {
+        std::vector<id_t> ids;
+        std::vector<BoundingBox> boxes;
+
+        void frustum(const lve::LveBvh::Frustum& frustum, std::vector<id_t>& results) const {
+            for (size_t i = 0; i < boxes.size(); i++) {
+                bool outside = false;
+                for (const glm::vec4& plane : frustum.planes) {
+                    glm::vec3 positive{
+                        plane.x >= 0.f ? boxes[i].max.x : boxes[i].min.x,
+                        plane.y >= 0.f ? boxes[i].max.y : boxes[i].min.y,
+                        plane.z >= 0.f ? boxes[i].max.z : boxes[i].min.z };
+                    if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) {
+                        outside = true;
+                        break;
+                    }
+                }
+                if (!outside) results.push_back(ids[i]);
+            }
+        }
+
+        void overlap(const BoundingBox& box, std::vector<id_t>& results) const {
+            for (size_t i = 0; i < boxes.size(); i++) {
+                const BoundingBox& b = boxes[i];
+                if (b.min.x <= box.max.x && b.max.x >= box.min.x && b.min.y <= box.max.y &&
+                    b.max.y >= box.min.y && b.min.z <= box.max.z && b.max.z >= box.min.z) {
+                    results.push_back(ids[i]);
+                }
+            }
+        }
+
+        bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& nearest) const {
+            glm::vec3 inverse = 1.f / direction;
+            nearest = FLT_MAX;
+            for (const BoundingBox& b : boxes) {
+                glm::vec3 t0 = (b.min - origin) * inverse;
+                glm::vec3 t1 = (b.max - origin) * inverse;
+                float tNear = std::max({ 0.f, std::min(t0.x, t1.x), std::min(t0.y, t1.y), std::min(t0.z, t1.z) });
+                float tFar = std::min({
+                    maxDistance, std::max(t0.x, t1.x), std::max(t0.y, t1.y), std::max(t0.z, t1.z) });
+                if (tNear <= tFar && tNear < nearest) nearest = tNear;
+            }
+            return nearest != FLT_MAX;
+        }
+    };
+
+    bool sameIds(std::vector<id_t> a, std::vector<id_t> b) {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        return a == b;
+    }
+
+    void run(uint32_t count) {
+        // Roughly constant density: a 10 box per 1000 m^2 city, 50 m tall
+        std::mt19937 random{ count };
+        float side = std::sqrt(count * 100.f);
+        std::uniform_real_distribution<float> position{ 0.f, side };
+        std::uniform_real_distribution<float> height{ 0.f, 50.f };
+        std::uniform_real_distribution<float> size{ .5f, 4.f };
+        std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+
+        BruteForce brute{};
+        lve::LveBvh bvh{};
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 center{ position(random), height(random), position(random) };
+            glm::vec3 extent{ size(random), size(random), size(random) };
+            brute.ids.push_back(i);
+            brute.boxes.push_back({ center - extent, center + extent });
+            bvh.insert(i, brute.boxes.back());
+        }
+
+        auto start = Clock::now();
+        bvh.rebuild();
+        double buildMilliseconds = millisecondsSince(start);
+
+        // Query inputs, shared by both sides
+        std::vector<lve::LveBvh::Frustum> frustums;
+        std::vector<BoundingBox> regions;
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+        for (int i = 0; i < QUERIES; i++) {
+            glm::vec3 eye{ position(random), 20.f, position(random) };
+            glm::vec3 direction = glm::normalize(glm::vec3{ unit(random), unit(random) * .2f, unit(random) });
+            lve::LveCamera camera{};
+            camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, .1f, 1000.f);
+            camera.setViewDirection(eye, direction);
+            frustums.push_back(lve::LveBvh::Frustum::fromViewProjection(camera.getProjection() * camera.getView()));
+            regions.push_back({ eye - glm::vec3{ 20.f }, eye + glm::vec3{ 20.f } });
+            origins.push_back(eye);
+            directions.push_back(direction);
+        }
+
+        std::vector<id_t> bvhResults;
+        std::vector<id_t> bruteResults;
+        double bvhTimes[3] = {};
+        double bruteTimes[3] = {};
+        size_t visible = 0;
+        uint32_t mismatches = 0;
+        for (int i = 0; i < QUERIES; i++) {
+            bvhResults.clear();
+            bruteResults.clear();
+            start = Clock::now();
+            bvh.queryFrustum(frustums[i], bvhResults);
+            bvhTimes[0] += millisecondsSince(start);
+            start = Clock::now();
+            brute.frustum(frustums[i], bruteResults);
+            bruteTimes[0] += millisecondsSince(start);
+            mismatches += !sameIds(bvhResults, bruteResults);
+            visible += bvhResults.size();
+
+            bvhResults.clear();
+            bruteResults.clear();
+            start = Clock::now();
+            bvh.queryOverlap(regions[i], bvhResults);
+            bvhTimes[1] += millisecondsSince(start);
+            start = Clock::now();
+            brute.overlap(regions[i], bruteResults);
+            bruteTimes[1] += millisecondsSince(start);
+            mismatches += !sameIds(bvhResults, bruteResults);
+
+            lve::LveBvh::RayHit hit{};
+            float nearest = 0.f;
+            start = Clock::now();
+            bool bvhFound = bvh.raycast(origins[i], directions[i], 1000.f, hit);
+            bvhTimes[2] += millisecondsSince(start);
+            start = Clock::now();
+            bool bruteFound = brute.raycast(origins[i], directions[i], 1000.f, nearest);
+            bruteTimes[2] += millisecondsSince(start);
+            mismatches += bvhFound != bruteFound || (bvhFound && hit.distance != nearest);
+        }
+
+        // A tenth of the objects move a little, as a frame of animation would
+        std::uniform_int_distribution<uint32_t> pick{ 0, count - 1 };
+        for (uint32_t i = 0; i < count / 10; i++) {
+            uint32_t object = pick(random);
+            glm::vec3 offset{ unit(random), unit(random), unit(random) };
+            brute.boxes[object] = { brute.boxes[object].min + offset, brute.boxes[object].max + offset };
+            bvh.update(object, brute.boxes[object]);
+        }
+        start = Clock::now();
+        bvh.commit();
+        double commitMilliseconds = millisecondsSince(start);
+        bvhResults.clear();
+        bruteResults.clear();
+        bvh.queryFrustum(frustums[0], bvhResults);
+        brute.frustum(frustums[0], bruteResults);
+        mismatches += !sameIds(bvhResults, bruteResults);
+
+        std::printf("%u objects, build %.1f ms, refit after moving 10%% %.2f ms, %zu visible per frustum\n",
+            count, buildMilliseconds, commitMilliseconds, visible / QUERIES);
+        const char* names[3] = { "frustum", "overlap 40 m box", "nearest ray hit" };
+        for (int i = 0; i < 3; i++) {
+            std::printf("  %-18s bvh %9.4f ms   brute force %9.4f ms   %7.1fx\n",
+                names[i], bvhTimes[i] / QUERIES, bruteTimes[i] / QUERIES, bruteTimes[i] / bvhTimes[i]);
+        }
+        if (mismatches > 0) {
+            std::printf("  %u queries differ from brute force\n", mismatches);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        for (uint32_t count : { 10000u, 100000u, 1000000u }) {
+            run(count);
+        }
+        return EXIT_SUCCESS;
+    }
+    for (int i = 1; i < argc; i++) {
+        run(static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 10)));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+// Packs asset files into an archive for LveArchive::mount, e.g.
+//   lve_pack assets.lvepak koenig.obj quad.obj simple_shader.vert.spv
+// Entries are named by the paths as given, which is how the engine opens
+// them. Built and run by pack_assets.sh.
+
+#include "../lve_archive.hpp"
+
+// std
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    void printUsage() {
+        std::cerr << "usage: lve_pack [--store] [--align <bytes>] <archive> <files...>\n"
+                  << "  --store          don't compress entries\n"
+                  << "  --align <bytes>  data alignment, a power of two of at least 8 (default "
+                  << lve::LveArchive::DEFAULT_ALIGNMENT << ")\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    auto compression = lve::LveArchive::Compression::Lz4;
+    uint32_t alignment = lve::LveArchive::DEFAULT_ALIGNMENT;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--store") == 0) {
+            compression = lve::LveArchive::Compression::None;
+        } else if (std::strcmp(argv[i], "--align") == 0 && i + 1 < argc) {
+            alignment = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        lve::LveArchiveWriter writer{ alignment };
+        for (size_t i = 1; i < positional.size(); i++) {
+            writer.addFile(positional[i], positional[i], compression);
+        }
+        writer.write(positional[0]);
+
+        // Read everything back, so a broken archive never ships
+        lve::LveArchive archive{ positional[0] };
+        for (size_t i = 1; i < positional.size(); i++) {
+            if (archive.read(positional[i]) == nullptr) {
+                throw std::runtime_error("entry missing after writing: " + positional[i]);
+            }
+        }
+
+        std::cout << "Packed " << writer.getEntryCount() << " files into " << positional[0] << ": "
+                  << writer.getTotalSize() / 1024 << " KB stored as "
+                  << writer.getTotalStoredSize() / 1024 << " KB\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+// Creates, dumps and times scene files for LveSceneFile. Build from the
+// repository root with
+//   c++ -std=c++17 -O2 -I. -o tools/lve_scene tools/lve_scene.cpp lve_scene_file.cpp lve_game_object.cpp
+//       lve_archive.cpp lve_lz4.cpp lve_mapped_file.cpp lve_profiler.cpp
+// on one line, plus the include paths for Vulkan, GLFW and GLM that
+// lve_game_object.hpp needs.
+//
+//   lve_scene generate <file.lvescene> <objects>   a grid of cars with a light every 100 objects
+//   lve_scene dump <file.lvescene>                 the text export, for diffing
+//   lve_scene bench <file.lvescene>                times opening, bulk copies and instantiation
+
+#include "../lve_scene_file.hpp"
+
+// std
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void generate(const std::string& filepath, uint32_t count) {
+        lve::LveSceneWriter writer{};
+        uint32_t models[2] = { writer.addModel("koenig.obj"), writer.addModel("quad.obj") };
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        for (uint32_t i = 0; i < count; i++) {
+            auto gameObject = lve::LveGameObject::createGameObject();
+            gameObject.transform.translation = { (i % side) * 5.f, 0.f, (i / side) * 5.f };
+            gameObject.transform.rotation = { 0.f, i * 0.1f, 0.f };
+            gameObject.color = { 1.f, 1.f, 1.f };
+            if (i % 100 == 99) {
+                gameObject.pointLight = std::make_unique<lve::PointLightComponent>();
+                gameObject.pointLight->lightIntensity = 2.f;
+                writer.addObject(gameObject);
+            } else {
+                writer.addObject(gameObject, models[i % 2]);
+            }
+        }
+        writer.write(filepath);
+    }
+
+    void bench(const std::string& filepath) {
+        auto start = Clock::now();
+        lve::LveSceneFile scene{ filepath };
+        double openMilliseconds = millisecondsSince(start);
+
+        // What contiguous component storage gets: one copy per array
+        start = Clock::now();
+        std::vector<lve::TransformComponent> transforms(scene.getObjectCount());
+        std::memcpy(transforms.data(), scene.transforms(), transforms.size() * sizeof(transforms[0]));
+        double copyMilliseconds = millisecondsSince(start);
+
+        start = Clock::now();
+        lve::LveGameObject::Map gameObjects;
+        scene.instantiate(gameObjects, [](const std::string&) { return std::shared_ptr<lve::LveModel>{}; });
+        double instantiateMilliseconds = millisecondsSince(start);
+
+        std::printf("%s: %u objects, %u models\n", filepath.c_str(), scene.getObjectCount(), scene.getModelCount());
+        std::printf("  open and validate   %8.2f ms\n", openMilliseconds);
+        std::printf("  copy transforms     %8.2f ms\n", copyMilliseconds);
+        std::printf("  instantiate         %8.2f ms\n", instantiateMilliseconds);
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc == 4 && std::strcmp(argv[1], "generate") == 0) {
+            generate(argv[2], static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)));
+            return EXIT_SUCCESS;
+        }
+        if (argc == 3 && std::strcmp(argv[1], "dump") == 0) {
+            lve::LveSceneFile{ argv[2] }.exportText(std::cout);
+            return EXIT_SUCCESS;
+        }
+        if (argc == 3 && std::strcmp(argv[1], "bench") == 0) {
+            bench(argv[2]);
+            return EXIT_SUCCESS;
+        }
+        std::cerr << "usage: lve_scene generate <file.lvescene> <objects>\n"
+                  << "       lve_scene dump <file.lvescene>\n"
+                  << "       lve_scene bench <file.lvescene>\n";
+        return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,327 @@
+// Compares LveObjParser with tinyobj, the OBJ loader it replaced, for
+// speed and output, and the OBJ path with the .glb path. Build from the
+// repository root with
+//   c++ -std=c++17 -O2 -I. -o tools/obj_bench tools/obj_bench.cpp lve_obj_parser.cpp lve_gltf.cpp
+//       lve_archive.cpp lve_lz4.cpp lve_mapped_file.cpp lve_profiler.cpp
+// on one line, plus the include paths for Vulkan, GLFW and GLM that lve_model.hpp needs.
+//
+//   obj_bench <file.obj> [iterations]            times both and diffs the vertices
+//   obj_bench --glb <file.obj> <file.glb> [iterations]
+//                                                times loading each into staging sized memory
+//   obj_bench --generate <file.obj> <quads>      writes a quads x quads grid, 600+ MB at 4000,
+//                                                and the same grid as <file>.glb
+
+#include "../lve_gltf.hpp"
+#include "../lve_mapped_file.hpp"
+#include "../lve_obj_parser.hpp"
+
+// libs
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    using Vertex = lve::LveModel::Vertex;
+    using Clock = std::chrono::steady_clock;
+
+    // What LveModel::Builder::loadModel did before LveObjParser
+    std::vector<Vertex> loadWithTinyObj(const std::string& filepath) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+            throw std::runtime_error(warn + err);
+        }
+
+        std::vector<Vertex> vertices;
+        for (const auto& shape : shapes) {
+            for (const auto& index : shape.mesh.indices) {
+                Vertex vertex{};
+                if (index.vertex_index >= 0) {
+                    vertex.position = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2],
+                    };
+                    vertex.color = {
+                        attrib.colors[3 * index.vertex_index + 0],
+                        attrib.colors[3 * index.vertex_index + 1],
+                        attrib.colors[3 * index.vertex_index + 2],
+                    };
+                }
+                if (index.normal_index >= 0) {
+                    vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2],
+                    };
+                }
+                if (index.texcoord_index >= 0) {
+                    vertex.uv = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        attrib.texcoords[2 * index.texcoord_index + 1],
+                    };
+                }
+                vertices.push_back(vertex);
+            }
+        }
+        return vertices;
+    }
+
+    std::vector<Vertex> loadWithParser(const std::string& filepath) {
+        lve::LveMappedFile file{ filepath };
+        std::vector<Vertex> vertices;
+        lve::LveObjParser::parse(file.data(), file.size(), filepath, vertices);
+        return vertices;
+    }
+
+    // tinyobj's own float parsing can differ from from_chars in the last bit
+    bool nearlyEqual(float a, float b) {
+        return a == b || std::fabs(a - b) <= 4.f * std::numeric_limits<float>::epsilon() *
+            std::max(std::fabs(a), std::fabs(b));
+    }
+
+    bool nearlyEqual(const Vertex& a, const Vertex& b) {
+        for (int i = 0; i < 3; i++) {
+            if (!nearlyEqual(a.position[i], b.position[i]) || !nearlyEqual(a.color[i], b.color[i]) ||
+                !nearlyEqual(a.normal[i], b.normal[i])) {
+                return false;
+            }
+        }
+        return nearlyEqual(a.uv[0], b.uv[0]) && nearlyEqual(a.uv[1], b.uv[1]);
+    }
+
+    template <typename F>
+    double timeBest(uint32_t iterations, F&& load, std::vector<Vertex>& result) {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = Clock::now();
+            result = load();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            best = i == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+
+    void generateGrid(const std::string& filepath, uint32_t quads) {
+        FILE* out = std::fopen(filepath.c_str(), "wb");
+        if (out == nullptr) {
+            throw std::runtime_error("failed to open " + filepath);
+        }
+        uint32_t side = quads + 1;
+        for (uint32_t z = 0; z < side; z++) {
+            for (uint32_t x = 0; x < side; x++) {
+                float height = 0.25f * std::sin(x * 0.1f) * std::cos(z * 0.1f);
+                std::fprintf(out, "v %.6f %.6f %.6f\n", x * 0.01f, height, z * 0.01f);
+            }
+        }
+        for (uint32_t z = 0; z < side; z++) {
+            for (uint32_t x = 0; x < side; x++) {
+                std::fprintf(out, "vt %.6f %.6f\n", x / static_cast<float>(quads), z / static_cast<float>(quads));
+            }
+        }
+        std::fprintf(out, "vn 0.000000 1.000000 0.000000\n");
+        for (uint32_t z = 0; z < quads; z++) {
+            for (uint32_t x = 0; x < quads; x++) {
+                uint32_t i0 = z * side + x + 1;
+                uint32_t i1 = i0 + 1;
+                uint32_t i2 = i0 + side + 1;
+                uint32_t i3 = i0 + side;
+                std::fprintf(out, "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\n", i0, i0, i1, i1, i2, i2, i3, i3);
+            }
+        }
+        std::fclose(out);
+    }
+
+    // Indexed, interleaved exactly like LveModel::Vertex, which is what the
+    // content pipeline is expected to write
+    void generateGlb(const std::string& filepath, uint32_t quads) {
+        uint32_t side = quads + 1;
+        std::vector<Vertex> vertices;
+        vertices.reserve(static_cast<size_t>(side) * side);
+        glm::vec3 min{ 0.f }, max{ 0.f };
+        for (uint32_t z = 0; z < side; z++) {
+            for (uint32_t x = 0; x < side; x++) {
+                Vertex vertex{};
+                vertex.position = { x * 0.01f, 0.25f * std::sin(x * 0.1f) * std::cos(z * 0.1f), z * 0.01f };
+                vertex.color = glm::vec3{ 1.f };
+                vertex.normal = { 0.f, 1.f, 0.f };
+                vertex.uv = { x / static_cast<float>(quads), z / static_cast<float>(quads) };
+                min = vertices.empty() ? vertex.position : glm::min(min, vertex.position);
+                max = vertices.empty() ? vertex.position : glm::max(max, vertex.position);
+                vertices.push_back(vertex);
+            }
+        }
+        std::vector<uint32_t> indices;
+        indices.reserve(static_cast<size_t>(quads) * quads * 6);
+        for (uint32_t z = 0; z < quads; z++) {
+            for (uint32_t x = 0; x < quads; x++) {
+                uint32_t i0 = z * side + x;
+                uint32_t i1 = i0 + 1;
+                uint32_t i2 = i0 + side + 1;
+                uint32_t i3 = i0 + side;
+                for (uint32_t index : { i0, i1, i2, i0, i2, i3 }) indices.push_back(index);
+            }
+        }
+
+        size_t vertexBytes = vertices.size() * sizeof(Vertex);
+        size_t indexBytes = indices.size() * sizeof(uint32_t);
+        char json[2048];
+        int jsonLength = std::snprintf(json, sizeof(json),
+            "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+            "\"nodes\":[{\"mesh\":0}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"COLOR_0\":1,\"NORMAL\":2,"
+            "\"TEXCOORD_0\":3},\"indices\":4}]}],"
+            "\"buffers\":[{\"byteLength\":%zu}],"
+            "\"bufferViews\":[{\"buffer\":0,\"byteLength\":%zu,\"byteStride\":%zu},"
+            "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+            "\"accessors\":["
+            "{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\","
+            "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+            "{\"bufferView\":1,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+            vertexBytes + indexBytes, vertexBytes, sizeof(Vertex), vertexBytes, indexBytes,
+            vertices.size(), min.x, min.y, min.z, max.x, max.y, max.z,
+            offsetof(Vertex, color), vertices.size(), offsetof(Vertex, normal), vertices.size(),
+            offsetof(Vertex, uv), vertices.size(), indices.size());
+        std::string jsonChunk{ json, static_cast<size_t>(jsonLength) };
+        while (jsonChunk.size() % 4 != 0) jsonChunk += ' ';
+
+        uint32_t jsonSize = static_cast<uint32_t>(jsonChunk.size());
+        uint32_t binSize = static_cast<uint32_t>(vertexBytes + indexBytes);
+        uint32_t header[3] = { 0x46546C67, 2, 12 + 8 + jsonSize + 8 + binSize };
+        uint32_t jsonHeader[2] = { jsonSize, 0x4E4F534A };
+        uint32_t binHeader[2] = { binSize, 0x004E4942 };
+        std::ofstream out{ filepath, std::ios::binary };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(jsonHeader), sizeof(jsonHeader));
+        out.write(jsonChunk.data(), jsonChunk.size());
+        out.write(reinterpret_cast<const char*>(binHeader), sizeof(binHeader));
+        out.write(reinterpret_cast<const char*>(vertices.data()), vertexBytes);
+        out.write(reinterpret_cast<const char*>(indices.data()), indexBytes);
+        if (!out) {
+            throw std::runtime_error("failed to write " + filepath);
+        }
+    }
+
+    // From file to bytes in memory the size of the staging buffers, the CPU
+    // side of LveModel creation for each path
+    double timeObjToStaging(const std::string& filepath, uint32_t iterations, size_t& bytes) {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = Clock::now();
+            std::vector<Vertex> vertices = loadWithParser(filepath);
+            bytes = vertices.size() * sizeof(Vertex);
+            std::unique_ptr<unsigned char[]> staging{ new unsigned char[bytes] };
+            std::memcpy(staging.get(), vertices.data(), bytes);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            best = i == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+
+    double timeGlbToStaging(const std::string& filepath, uint32_t iterations, size_t& bytes) {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = Clock::now();
+            lve::LveGltfFile file{ filepath };
+            bytes = 0;
+            for (const auto& mesh : file.getMeshes()) {
+                for (const auto& primitive : mesh.primitives) {
+                    size_t vertexBytes = file.getVertexCount(primitive) * sizeof(Vertex);
+                    size_t indexBytes = file.getIndexCount(primitive) * sizeof(uint32_t);
+                    std::unique_ptr<unsigned char[]> vertexStaging{ new unsigned char[vertexBytes] };
+                    std::unique_ptr<unsigned char[]> indexStaging{ new unsigned char[indexBytes] };
+                    file.writeVertices(primitive, reinterpret_cast<Vertex*>(vertexStaging.get()));
+                    file.writeIndices(primitive, reinterpret_cast<uint32_t*>(indexStaging.get()));
+                    bytes += vertexBytes + indexBytes;
+                }
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            best = i == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc == 4 && std::strcmp(argv[1], "--generate") == 0) {
+            std::string filepath = argv[2];
+            uint32_t quads = static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10));
+            generateGrid(filepath, quads);
+            generateGlb(filepath.substr(0, filepath.rfind('.')) + ".glb", quads);
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 4 && std::strcmp(argv[1], "--glb") == 0) {
+            uint32_t iterations = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : 3;
+            iterations = std::max(iterations, 1u);
+            size_t objBytes = 0, glbBytes = 0;
+            double objSeconds = timeObjToStaging(argv[2], iterations, objBytes);
+            double glbSeconds = timeGlbToStaging(argv[3], iterations, glbBytes);
+            std::printf("file to staging memory, best of %u\n", iterations);
+            std::printf("  %-24s %8.1f ms  %7.1f MB staged\n",
+                argv[2], objSeconds * 1000.0, objBytes / (1024.0 * 1024.0));
+            std::printf("  %-24s %8.1f ms  %7.1f MB staged  (%.1fx)\n",
+                argv[3], glbSeconds * 1000.0, glbBytes / (1024.0 * 1024.0), objSeconds / glbSeconds);
+            return EXIT_SUCCESS;
+        }
+        if (argc < 2) {
+            std::cerr << "usage: obj_bench <file.obj> [iterations]\n"
+                      << "       obj_bench --glb <file.obj> <file.glb> [iterations]\n"
+                      << "       obj_bench --generate <file.obj> <quads>\n";
+            return EXIT_FAILURE;
+        }
+
+        std::string filepath = argv[1];
+        uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 3;
+        iterations = std::max(iterations, 1u);
+        double megabytes = lve::LveMappedFile{ filepath }.size() / (1024.0 * 1024.0);
+
+        std::vector<Vertex> reference, parsed;
+        double tinyObjSeconds = timeBest(iterations, [&]() { return loadWithTinyObj(filepath); }, reference);
+        double parserSeconds = timeBest(iterations, [&]() { return loadWithParser(filepath); }, parsed);
+
+        std::printf("%s: %.1f MB, %zu vertices, best of %u\n", filepath.c_str(), megabytes, parsed.size(), iterations);
+        std::printf("  tinyobj       %8.1f ms  %7.1f MB/s\n", tinyObjSeconds * 1000.0, megabytes / tinyObjSeconds);
+        std::printf("  LveObjParser  %8.1f ms  %7.1f MB/s  (%.1fx)\n",
+            parserSeconds * 1000.0, megabytes / parserSeconds, tinyObjSeconds / parserSeconds);
+
+        if (reference.size() != parsed.size()) {
+            std::printf("MISMATCH: tinyobj produced %zu vertices\n", reference.size());
+            return EXIT_FAILURE;
+        }
+        size_t exact = 0, different = 0;
+        for (size_t i = 0; i < parsed.size(); i++) {
+            if (parsed[i] == reference[i]) {
+                exact++;
+            } else if (!nearlyEqual(parsed[i], reference[i])) {
+                if (different++ == 0) {
+                    std::printf("MISMATCH: first at vertex %zu\n", i);
+                }
+            }
+        }
+        std::printf("  %zu of %zu vertices identical, %zu differ beyond rounding\n",
+            exact, parsed.size(), different);
+        return different == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
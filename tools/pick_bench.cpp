@@ -0,0 +1,220 @@
+// Times ray casts through LveMeshBvh against testing every triangle, and
+// picking through an LveBvh of instanced meshes against testing every
+// instance's triangles, checking that both find the same distances. Build
+// from the repository root with
+//   c++ -std=c++17 -O2 -I. -o tools/pick_bench tools/pick_bench.cpp lve_mesh_bvh.cpp lve_bvh.cpp
+//       lve_game_object.cpp lve_profiler.cpp
+// on one line, plus the include paths for Vulkan, GLFW and GLM that
+// lve_model.hpp needs.
+//
+//   pick_bench [triangles...]    defaults to 10000 100000 1000000
+
+#include "../lve_bvh.hpp"
+#include "../lve_mesh_bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Vertex = lve::LveModel::Vertex;
+
+    constexpr int RAYS = 10000;
+    // Brute force is slow enough that a sample says enough
+    constexpr int BRUTE_FORCE_RAYS = 50;
+    constexpr uint32_t INSTANCES = 1000;
+
+    double microsecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    struct Mesh {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // A bumpy indexed height field of about the given triangle count,
+    // spanning 0 to 100 on x and z, heights along y
+    Mesh makeTerrain(uint32_t triangles) {
+        uint32_t side = std::max(1u, static_cast<uint32_t>(std::sqrt(triangles / 2.f)));
+        Mesh mesh{};
+        for (uint32_t z = 0; z <= side; z++) {
+            for (uint32_t x = 0; x <= side; x++) {
+                Vertex vertex{};
+                float fx = 100.f * x / side;
+                float fz = 100.f * z / side;
+                vertex.position = { fx, 3.f * std::sin(fx * .3f) * std::cos(fz * .2f) + std::sin(fx * fz * .01f), fz };
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t z = 0; z < side; z++) {
+            for (uint32_t x = 0; x < side; x++) {
+                uint32_t i = z * (side + 1) + x;
+                mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + side + 1, i + 1, i + side + 2, i + side + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    // The same test LveMeshBvh makes, over every triangle
+    bool bruteForce(const Mesh& mesh, const glm::vec3& origin, const glm::vec3& direction, float& nearest) {
+        nearest = FLT_MAX;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3& v0 = mesh.vertices[mesh.indices[i]].position;
+            glm::vec3 edge1 = mesh.vertices[mesh.indices[i + 1]].position - v0;
+            glm::vec3 edge2 = mesh.vertices[mesh.indices[i + 2]].position - v0;
+            glm::vec3 p = glm::cross(direction, edge2);
+            float determinant = glm::dot(edge1, p);
+            if (determinant == 0.f) continue;
+            float inverseDeterminant = 1.f / determinant;
+            glm::vec3 s = origin - v0;
+            float u = glm::dot(s, p) * inverseDeterminant;
+            if (u < 0.f || u > 1.f) continue;
+            glm::vec3 q = glm::cross(s, edge1);
+            float v = glm::dot(direction, q) * inverseDeterminant;
+            if (v < 0.f || u + v > 1.f) continue;
+            float t = glm::dot(edge2, q) * inverseDeterminant;
+            if (t >= 0.f && t < nearest) nearest = t;
+        }
+        return nearest != FLT_MAX;
+    }
+
+    void run(uint32_t triangles) {
+        std::mt19937 random{ triangles };
+        std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+        Mesh mesh = makeTerrain(triangles);
+        auto start = Clock::now();
+        lve::LveMeshBvh meshBvh{ mesh.vertices, mesh.indices };
+        double buildMilliseconds = microsecondsSince(start) / 1000.0;
+
+        // From above the terrain down to a random point on it, some grazing
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+        for (int i = 0; i < RAYS; i++) {
+            glm::vec3 origin{ unit(random) * 200.f - 50.f, -20.f - unit(random) * 30.f, unit(random) * 200.f - 50.f };
+            glm::vec3 target{ unit(random) * 100.f, 0.f, unit(random) * 100.f };
+            origins.push_back(origin);
+            directions.push_back(glm::normalize(target - origin));
+        }
+
+        uint32_t hits = 0;
+        start = Clock::now();
+        for (int i = 0; i < RAYS; i++) {
+            lve::LveMeshBvh::Hit hit{};
+            hits += meshBvh.intersect(origins[i], directions[i], FLT_MAX, hit);
+        }
+        double meshMicroseconds = microsecondsSince(start) / RAYS;
+
+        uint32_t mismatches = 0;
+        double bruteMicroseconds = 0.0;
+        for (int i = 0; i < BRUTE_FORCE_RAYS; i++) {
+            lve::LveMeshBvh::Hit hit{};
+            bool found = meshBvh.intersect(origins[i], directions[i], FLT_MAX, hit);
+            float nearest = 0.f;
+            start = Clock::now();
+            bool bruteFound = bruteForce(mesh, origins[i], directions[i], nearest);
+            bruteMicroseconds += microsecondsSince(start);
+            mismatches += found != bruteFound || (found && hit.distance != nearest);
+        }
+        bruteMicroseconds /= BRUTE_FORCE_RAYS;
+
+        // Instances of the mesh scattered over a 2 km square, each scaled
+        // and offset, picked top down through the object BVH
+        std::vector<glm::vec3> offsets(INSTANCES);
+        std::vector<float> scales(INSTANCES);
+        lve::LveBvh sceneBvh{};
+        glm::vec3 meshMin{ FLT_MAX };
+        glm::vec3 meshMax{ -FLT_MAX };
+        for (const Vertex& vertex : mesh.vertices) {
+            meshMin = glm::min(meshMin, vertex.position);
+            meshMax = glm::max(meshMax, vertex.position);
+        }
+        for (uint32_t i = 0; i < INSTANCES; i++) {
+            offsets[i] = { unit(random) * 2000.f, unit(random) * 50.f, unit(random) * 2000.f };
+            scales[i] = .5f + unit(random);
+            sceneBvh.insert(i, { offsets[i] + meshMin * scales[i], offsets[i] + meshMax * scales[i] });
+        }
+        sceneBvh.rebuild();
+
+        auto pick = [&](const glm::vec3& origin, const glm::vec3& direction, lve::LveBvh::RayHit& hit) {
+            float best = FLT_MAX;
+            return sceneBvh.raycast(origin, direction, FLT_MAX, hit, [&](uint32_t id, float) {
+                lve::LveMeshBvh::Hit meshHit{};
+                // Object space ray with the direction scaled, so distances stay in world units
+                if (!meshBvh.intersect((origin - offsets[id]) / scales[id], direction / scales[id], best, meshHit)) {
+                    return -1.f;
+                }
+                best = meshHit.distance;
+                return meshHit.distance;
+            });
+        };
+
+        std::vector<glm::vec3> pickOrigins;
+        std::vector<glm::vec3> pickDirections;
+        for (int i = 0; i < RAYS; i++) {
+            glm::vec3 origin{ unit(random) * 2000.f, -100.f, unit(random) * 2000.f };
+            glm::vec3 target{ origin.x + unit(random) * 400.f - 200.f, 60.f, origin.z + unit(random) * 400.f - 200.f };
+            pickOrigins.push_back(origin);
+            pickDirections.push_back(glm::normalize(target - origin));
+        }
+        uint32_t picks = 0;
+        start = Clock::now();
+        for (int i = 0; i < RAYS; i++) {
+            lve::LveBvh::RayHit hit{};
+            picks += pick(pickOrigins[i], pickDirections[i], hit);
+        }
+        double pickMicroseconds = microsecondsSince(start) / RAYS;
+
+        // Every instance's BVH, which is already far better than every triangle
+        double everyInstanceMicroseconds = 0.0;
+        for (int i = 0; i < BRUTE_FORCE_RAYS; i++) {
+            lve::LveBvh::RayHit hit{};
+            bool found = pick(pickOrigins[i], pickDirections[i], hit);
+            float nearest = FLT_MAX;
+            start = Clock::now();
+            for (uint32_t id = 0; id < INSTANCES; id++) {
+                lve::LveMeshBvh::Hit meshHit{};
+                if (meshBvh.intersect((pickOrigins[i] - offsets[id]) / scales[id], pickDirections[i] / scales[id],
+                    nearest, meshHit)) {
+                    nearest = meshHit.distance;
+                }
+            }
+            everyInstanceMicroseconds += microsecondsSince(start);
+            mismatches += found != (nearest != FLT_MAX) || (found && hit.distance != nearest);
+        }
+        everyInstanceMicroseconds /= BRUTE_FORCE_RAYS;
+
+        std::printf("%u triangles, build %.1f ms, %u nodes, %.1f MB, %u of %d rays hit\n",
+            meshBvh.getTriangleCount(), buildMilliseconds, meshBvh.getNodeCount(),
+            meshBvh.getMemorySize() / (1024.0 * 1024.0), hits, RAYS);
+        std::printf("  %-28s bvh %9.3f us   every triangle %11.1f us   %9.0fx\n",
+            "mesh ray", meshMicroseconds, bruteMicroseconds, bruteMicroseconds / meshMicroseconds);
+        std::printf("  %-28s bvh %9.3f us   every instance %11.1f us   %9.0fx   %u of %d hit\n",
+            "pick among 1000 instances", pickMicroseconds, everyInstanceMicroseconds,
+            everyInstanceMicroseconds / pickMicroseconds, picks, RAYS);
+        if (mismatches > 0) {
+            std::printf("  %u rays differ from brute force\n", mismatches);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        for (uint32_t triangles : { 10000u, 100000u, 1000000u }) {
+            run(triangles);
+        }
+        return EXIT_SUCCESS;
+    }
+    for (int i = 1; i < argc; i++) {
+        run(static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 10)));
+    }
+    return EXIT_SUCCESS;
+}